@@ -0,0 +1,115 @@
+#include "Timeline.hpp"
+
+#include "io/FileUtils.hpp"
+#include "io/Path.hpp"
+
+#include "Debug.hpp"
+
+#include <tinyformat/tinyformat.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <mutex>
+
+namespace Tungsten {
+
+namespace Timeline {
+
+struct Event
+{
+    const char *name;
+    const char *argName;
+    int64 arg;
+    double begin, end;
+};
+
+// Only the owning thread appends to its buffer. The mutex is uncontended
+// except while the timeline is being saved
+struct ThreadBuffer
+{
+    std::mutex mutex;
+    std::string name;
+    uint32 tid;
+    std::vector<Event> events;
+};
+
+static std::atomic<bool> recording(false);
+static std::mutex bufferMutex;
+static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+static ThreadBuffer &threadBuffer()
+{
+    static thread_local ThreadBuffer *buffer = nullptr;
+    if (!buffer) {
+        std::unique_lock<std::mutex> lock(bufferMutex);
+        buffers.emplace_back(new ThreadBuffer());
+        buffer = buffers.back().get();
+        buffer->tid = uint32(buffers.size());
+        buffer->name = tfm::format("Thread %d", buffer->tid);
+    }
+    return *buffer;
+}
+
+void enable()
+{
+    recording = true;
+}
+
+bool enabled()
+{
+    return recording.load(std::memory_order_relaxed);
+}
+
+void setThreadName(const std::string &name)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    std::unique_lock<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+double now()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void addEvent(const char *name, double begin, double end, const char *argName, int64 arg)
+{
+    ThreadBuffer &buffer = threadBuffer();
+    std::unique_lock<std::mutex> lock(buffer.mutex);
+    buffer.events.emplace_back(Event{name, argName, arg, begin, end});
+}
+
+void save(const Path &path)
+{
+    OutputStreamHandle out = FileUtils::openOutputStream(path);
+    if (!out) {
+        DBG("Failed to open timeline file at '%s'", path);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(bufferMutex);
+    *out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const std::unique_ptr<ThreadBuffer> &buffer : buffers) {
+        std::unique_lock<std::mutex> bufferLock(buffer->mutex);
+
+        *out << (first ? "" : ",\n") << tfm::format("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                "\"tid\":%d,\"args\":{\"name\":\"%s\"}}", buffer->tid, buffer->name);
+        first = false;
+
+        for (const Event &e : buffer->events) {
+            *out << tfm::format(",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    e.name, buffer->tid, e.begin, e.end - e.begin);
+            if (e.argName)
+                *out << tfm::format(",\"args\":{\"%s\":%d}", e.argName, e.arg);
+            *out << "}";
+        }
+    }
+    *out << "\n]}\n";
+}
+
+}
+
+}
@@ -0,0 +1,66 @@
+#ifndef TIMELINE_HPP_
+#define TIMELINE_HPP_
+
+#include "IntTypes.hpp"
+
+#include <string>
+
+namespace Tungsten {
+
+class Path;
+
+// Records timed events per thread and saves them in the Chrome trace event
+// format, which can be opened in chrome://tracing or the Perfetto UI.
+// Recording is off by default, and scopes cost a single flag check until
+// it is enabled. Event names must be string literals; they are stored as
+// pointers and only read when the timeline is saved
+namespace Timeline {
+
+void enable();
+bool enabled();
+
+// Names the calling thread in the saved timeline
+void setThreadName(const std::string &name);
+
+// Microseconds since the timeline was first used
+double now();
+
+void addEvent(const char *name, double begin, double end, const char *argName = nullptr, int64 arg = 0);
+
+void save(const Path &path);
+
+class Scope
+{
+    const char *_name;
+    const char *_argName;
+    int64 _arg;
+    double _begin;
+    bool _enabled;
+
+public:
+    Scope(const char *name, const char *argName = nullptr, int64 arg = 0)
+    : _name(name),
+      _argName(argName),
+      _arg(arg),
+      _begin(0.0),
+      _enabled(enabled())
+    {
+        if (_enabled)
+            _begin = now();
+    }
+
+    ~Scope()
+    {
+        if (_enabled)
+            addEvent(_name, _begin, now(), _argName, _arg);
+    }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+};
+
+}
+
+}
+
+#endif /* TIMELINE_HPP_ */
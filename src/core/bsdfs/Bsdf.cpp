@@ -12,7 +12,8 @@ namespace Tungsten {
 std::shared_ptr<Texture> Bsdf::_defaultAlbedo = std::make_shared<ConstantTexture>(1.0f);
 
 Bsdf::Bsdf()
-: _albedo(_defaultAlbedo)
+: _albedo(_defaultAlbedo),
+  _statisticsSlot(0)
 {
 }
 
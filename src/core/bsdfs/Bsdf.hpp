@@ -7,6 +7,8 @@
 
 #include "primitives/IntersectionInfo.hpp"
 
+#include "renderer/RenderStatistics.hpp"
+
 #include "textures/Texture.hpp"
 
 #include "math/TangentFrame.hpp"
@@ -35,6 +37,8 @@ protected:
     std::shared_ptr<Texture> _albedo;
     std::shared_ptr<Texture> _bump;
 
+    uint32 _statisticsSlot;
+
     Vec3f albedo(const IntersectionInfo *info) const
     {
         return (*_albedo)[*info];
@@ -67,6 +71,8 @@ public:
 
     inline bool sample(SurfaceScatterEvent &event, bool adjoint) const
     {
+        RENDER_STAT_BSDF_SAMPLE(_statisticsSlot);
+
         if (!sample(event))
             return false;
 
@@ -81,6 +87,8 @@ public:
     }
     inline Vec3f eval(const SurfaceScatterEvent &event, bool adjoint) const
     {
+        RENDER_STAT_BSDF_EVAL(_statisticsSlot);
+
         Vec3f f = eval(event);
 
         if (adjoint)
@@ -136,6 +144,11 @@ public:
     {
         return _bump;
     }
+
+    void setStatisticsSlot(uint32 slot)
+    {
+        _statisticsSlot = slot;
+    }
 };
 
 }
@@ -2,6 +2,7 @@
 
 #include "sampling/PathSampleGenerator.hpp"
 
+#include "bsdfs/PrecomputedTableCache.hpp"
 #include "bsdfs/Fresnel.hpp"
 
 #include "math/GaussLegendre.hpp"
@@ -315,12 +316,9 @@ float HairBcsdf::pdf(const SurfaceScatterEvent &event) const
 }
 
 
-void HairBcsdf::precomputeAzimuthalDistributions()
+void HairBcsdf::precomputeAzimuthalDistributions(Vec3f *valuesR, Vec3f *valuesTT, Vec3f *valuesTRT) const
 {
     const int Resolution = PrecomputedAzimuthalLobe::AzimuthalResolution;
-    std::unique_ptr<Vec3f[]> valuesR  (new Vec3f[Resolution*Resolution]);
-    std::unique_ptr<Vec3f[]> valuesTT (new Vec3f[Resolution*Resolution]);
-    std::unique_ptr<Vec3f[]> valuesTRT(new Vec3f[Resolution*Resolution]);
 
     // Ideally we could simply make this a constexpr, but MSVC does not support that yet (boo!)
     #define NumPoints 140
@@ -407,11 +405,6 @@ void HairBcsdf::precomputeAzimuthalDistributions()
             valuesTRT[phiI + y*Resolution] = 0.5f*integralTRT;
         }
     }
-
-    // Hand the values off to the helper class to construct sampling CDFs and so forth
-    _nR  .reset(new PrecomputedAzimuthalLobe(std::move(valuesR)));
-    _nTT .reset(new PrecomputedAzimuthalLobe(std::move(valuesTT)));
-    _nTRT.reset(new PrecomputedAzimuthalLobe(std::move(valuesTRT)));
 }
 
 void HairBcsdf::prepareForRender()
@@ -440,7 +433,26 @@ void HairBcsdf::prepareForRender()
         _sigmaA = _melaninConcentration*lerp(eumelaninSigmaA, pheomelaninSigmaA, _melaninRatio);
     }
 
-    precomputeAzimuthalDistributions();
+    // The azimuthal tables only depend on the roughness and absorption, so we
+    // can share them with all other hair BCSDFs using the same parameters
+    const int LobeSize = PrecomputedAzimuthalLobe::AzimuthalResolution*PrecomputedAzimuthalLobe::AzimuthalResolution;
+    std::string key = PrecomputedTableCache::makeKey("hair-azimuthal", 1,
+            {Eta, _betaR, _sigmaA.x(), _sigmaA.y(), _sigmaA.z()});
+    auto table = PrecomputedTableCache::fetch(key, 3*3*LobeSize, [&](PrecomputedTableCache::Table &dst) {
+        Vec3f *values = reinterpret_cast<Vec3f *>(&dst[0]);
+        precomputeAzimuthalDistributions(values, values + LobeSize, values + 2*LobeSize);
+    });
+
+    // Hand the values off to the helper class to construct sampling CDFs and so forth
+    auto makeLobe = [&](int lobe) {
+        const Vec3f *src = reinterpret_cast<const Vec3f *>(&(*table)[0]) + lobe*LobeSize;
+        std::unique_ptr<Vec3f[]> values(new Vec3f[LobeSize]);
+        std::copy(src, src + LobeSize, values.get());
+        return new PrecomputedAzimuthalLobe(std::move(values));
+    };
+    _nR  .reset(makeLobe(0));
+    _nTT .reset(makeLobe(1));
+    _nTRT.reset(makeLobe(2));
 }
 
 
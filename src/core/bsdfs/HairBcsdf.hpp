@@ -45,7 +45,7 @@ class HairBcsdf : public Bsdf
 
     float sampleM(float v, float sinThetaI, float cosThetaI, float xi1, float xi2) const;
 
-    void precomputeAzimuthalDistributions();
+    void precomputeAzimuthalDistributions(Vec3f *valuesR, Vec3f *valuesTT, Vec3f *valuesTRT) const;
 
 public:
     HairBcsdf();
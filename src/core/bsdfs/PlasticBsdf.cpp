@@ -1,4 +1,5 @@
 #include "PlasticBsdf.hpp"
+#include "PrecomputedTableCache.hpp"
 #include "Fresnel.hpp"
 
 #include "samplerecords/SurfaceScatterEvent.hpp"
@@ -146,7 +147,7 @@ void PlasticBsdf::prepareForRender()
     _scaledSigmaA = _thickness*_sigmaA;
     _avgTransmittance = std::exp(-2.0f*_scaledSigmaA.avg());
 
-    _diffuseFresnel = Fresnel::computeDiffuseFresnel(_ior, 1000000);
+    _diffuseFresnel = PrecomputedTableCache::diffuseFresnel(_ior, 1000000);
 }
 
 }
@@ -0,0 +1,121 @@
+#include "PrecomputedTableCache.hpp"
+#include "Fresnel.hpp"
+
+#include "io/FileUtils.hpp"
+
+#include "math/BitManip.hpp"
+
+#include "IntTypes.hpp"
+
+#include <tinyformat/tinyformat.hpp>
+
+namespace Tungsten {
+
+static CONSTEXPR uint32 CacheFileMagic = 0x43505354; // "TSPC"
+
+std::unordered_map<std::string, std::shared_ptr<PrecomputedTableCache::Entry>> PrecomputedTableCache::_entries;
+std::mutex PrecomputedTableCache::_entryMutex;
+std::mutex PrecomputedTableCache::_ioMutex;
+Path PrecomputedTableCache::_persistentDirectory;
+
+bool PrecomputedTableCache::loadTable(const std::string &key, size_t size, Table &dst)
+{
+    std::unique_lock<std::mutex> lock(_ioMutex);
+    if (_persistentDirectory.empty())
+        return false;
+
+    Path path = _persistentDirectory/(key + ".bin");
+    if (!FileUtils::isFile(path))
+        return false;
+
+    InputStreamHandle in = FileUtils::openInputStream(path);
+    if (!in)
+        return false;
+
+    uint32 magic;
+    uint64 fileSize;
+    FileUtils::streamRead(in, magic);
+    FileUtils::streamRead(in, fileSize);
+    if (!in->good() || magic != CacheFileMagic || fileSize != uint64(size))
+        return false;
+
+    dst.resize(size);
+    FileUtils::streamRead(in, dst);
+
+    return bool(*in);
+}
+
+void PrecomputedTableCache::saveTable(const std::string &key, const Table &src)
+{
+    std::unique_lock<std::mutex> lock(_ioMutex);
+    if (_persistentDirectory.empty())
+        return;
+
+    OutputStreamHandle out = FileUtils::openOutputStream(_persistentDirectory/(key + ".bin"));
+    if (!out)
+        return;
+
+    FileUtils::streamWrite(out, CacheFileMagic);
+    FileUtils::streamWrite(out, uint64(src.size()));
+    FileUtils::streamWrite(out, src);
+}
+
+std::string PrecomputedTableCache::makeKey(const char *name, int version, std::initializer_list<float> params)
+{
+    // Use the exact bit patterns so that keys are unambiguous and double as file names
+    std::string key = tfm::format("%s-v%d", name, version);
+    for (float f : params)
+        key += tfm::format("-%08x", BitManip::floatBitsToUint(f));
+    return key;
+}
+
+std::shared_ptr<const PrecomputedTableCache::Table> PrecomputedTableCache::fetch(const std::string &key,
+        size_t size, TableBuilder builder)
+{
+    std::shared_ptr<Entry> entry;
+    {
+        std::unique_lock<std::mutex> lock(_entryMutex);
+        std::shared_ptr<Entry> &slot = _entries[key];
+        if (!slot)
+            slot = std::make_shared<Entry>();
+        entry = slot;
+    }
+
+    std::unique_lock<std::mutex> lock(entry->mutex);
+    if (!entry->table) {
+        std::shared_ptr<Table> table = std::make_shared<Table>();
+        if (!loadTable(key, size, *table)) {
+            table->clear();
+            table->resize(size, 0.0f);
+            builder(*table);
+            saveTable(key, *table);
+        }
+        entry->table = std::move(table);
+    }
+
+    return entry->table;
+}
+
+float PrecomputedTableCache::diffuseFresnel(float ior, int sampleCount)
+{
+    std::string key = makeKey("diffuse-fresnel", 1, {ior, float(sampleCount)});
+    return (*fetch(key, 1, [&](Table &dst) {
+        dst[0] = Fresnel::computeDiffuseFresnel(ior, sampleCount);
+    }))[0];
+}
+
+void PrecomputedTableCache::setPersistentDirectory(const Path &dir)
+{
+    std::unique_lock<std::mutex> lock(_ioMutex);
+    _persistentDirectory = dir;
+    if (!_persistentDirectory.empty() && !FileUtils::exists(_persistentDirectory))
+        FileUtils::createDirectory(_persistentDirectory, true);
+}
+
+void PrecomputedTableCache::clear()
+{
+    std::unique_lock<std::mutex> lock(_entryMutex);
+    _entries.clear();
+}
+
+}
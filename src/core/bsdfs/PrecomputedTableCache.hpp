@@ -0,0 +1,60 @@
+#ifndef PRECOMPUTEDTABLECACHE_HPP_
+#define PRECOMPUTEDTABLECACHE_HPP_
+
+#include "io/Path.hpp"
+
+#include <initializer_list>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+
+namespace Tungsten {
+
+// Process-wide cache for expensive BSDF precomputations (diffuse Fresnel integrals,
+// azimuthal hair scattering tables, ...). Tables are keyed by the exact bit patterns
+// of the parameters they depend on, so materials with identical parameters only pay
+// for the precomputation once per process. If a persistent directory is set, tables
+// are additionally stored on disk and reused across renders and processes.
+//
+// All functions are thread-safe. Concurrent requests for the same key block until
+// the first requester has finished computing the table.
+class PrecomputedTableCache
+{
+public:
+    typedef std::vector<float> Table;
+    typedef std::function<void(Table &)> TableBuilder;
+
+private:
+    struct Entry
+    {
+        std::mutex mutex;
+        std::shared_ptr<const Table> table;
+    };
+
+    static std::unordered_map<std::string, std::shared_ptr<Entry>> _entries;
+    static std::mutex _entryMutex;
+    static std::mutex _ioMutex;
+    static Path _persistentDirectory;
+
+    static bool loadTable(const std::string &key, size_t size, Table &dst);
+    static void saveTable(const std::string &key, const Table &src);
+
+public:
+    static std::string makeKey(const char *name, int version, std::initializer_list<float> params);
+
+    // Returns the table associated with key, invoking builder on a miss.
+    // The builder receives a table of the requested size
+    static std::shared_ptr<const Table> fetch(const std::string &key, size_t size, TableBuilder builder);
+
+    static float diffuseFresnel(float ior, int sampleCount);
+
+    static void setPersistentDirectory(const Path &dir);
+    static void clear();
+};
+
+}
+
+#endif /* PRECOMPUTEDTABLECACHE_HPP_ */
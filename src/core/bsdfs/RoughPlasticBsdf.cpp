@@ -1,5 +1,6 @@
 #include "RoughPlasticBsdf.hpp"
 #include "RoughDielectricBsdf.hpp"
+#include "PrecomputedTableCache.hpp"
 #include "Fresnel.hpp"
 
 #include "samplerecords/SurfaceScatterEvent.hpp"
@@ -175,7 +176,7 @@ void RoughPlasticBsdf::prepareForRender()
     _scaledSigmaA = _thickness*_sigmaA;
     _avgTransmittance = std::exp(-2.0f*_scaledSigmaA.avg());
 
-    _diffuseFresnel = Fresnel::computeDiffuseFresnel(_ior, 1000000);
+    _diffuseFresnel = PrecomputedTableCache::diffuseFresnel(_ior, 1000000);
 }
 
 }
@@ -10,15 +10,25 @@
 
 namespace Tungsten {
 
+CONSTEXPR float TransparencyBsdf::AlphaCutoff;
+
+DEFINE_STRINGABLE_ENUM(TransparencyBsdf::AlphaMode, "alpha mode", ({
+    {"blend", TransparencyBsdf::ALPHA_BLEND},
+    {"cutout", TransparencyBsdf::ALPHA_CUTOUT},
+    {"stochastic", TransparencyBsdf::ALPHA_STOCHASTIC}
+}))
+
 TransparencyBsdf::TransparencyBsdf()
 : _opacity(std::make_shared<ConstantTexture>(1.0f)),
-  _base(std::make_shared<LambertBsdf>())
+  _base(std::make_shared<LambertBsdf>()),
+  _alphaMode("blend")
 {
 }
 
 TransparencyBsdf::TransparencyBsdf(std::shared_ptr<Texture> opacity, std::shared_ptr<Bsdf> base)
 : _opacity(opacity),
-  _base(base)
+  _base(base),
+  _alphaMode("blend")
 {
 }
 
@@ -29,6 +39,7 @@ void TransparencyBsdf::fromJson(JsonPtr value, const Scene &scene)
         _base = scene.fetchBsdf(base);
     if (auto alpha = value["alpha"])
         _opacity = scene.fetchTexture(alpha, TexelConversion::REQUEST_AVERAGE);
+    _alphaMode = value["alpha_mode"];
 }
 
 rapidjson::Value TransparencyBsdf::toJson(Allocator &allocator) const
@@ -36,7 +47,8 @@ rapidjson::Value TransparencyBsdf::toJson(Allocator &allocator) const
     return JsonObject{Bsdf::toJson(allocator), allocator,
         "type", "transparency",
         "base", *_base,
-        "alpha", *_opacity
+        "alpha", *_opacity,
+        "alpha_mode", _alphaMode.toString()
     };
 }
 
@@ -3,12 +3,31 @@
 
 #include "Bsdf.hpp"
 
+#include "StringableEnum.hpp"
+
 namespace Tungsten {
 
 class TransparencyBsdf : public Bsdf
 {
+    // How the opacity is applied. Blending treats the surface as partially
+    // transparent. Cutout and stochastic alpha instead decide per ray whether
+    // a hit is opaque (by thresholding the opacity or by accepting the hit with
+    // probability equal to the opacity), which triangle meshes do while
+    // traversing their BVH. Other primitives always blend
+    enum AlphaModeEnum
+    {
+        ALPHA_BLEND,
+        ALPHA_CUTOUT,
+        ALPHA_STOCHASTIC,
+    };
+    typedef StringableEnum<AlphaModeEnum> AlphaMode;
+    friend AlphaMode;
+
+    static CONSTEXPR float AlphaCutoff = 0.5f;
+
     std::shared_ptr<Texture> _opacity;
     std::shared_ptr<Bsdf> _base;
+    AlphaMode _alphaMode;
 
 public:
     TransparencyBsdf();
@@ -23,6 +42,22 @@ public:
 
     virtual void prepareForRender() override;
 
+    bool alphaTested() const
+    {
+        return _alphaMode != ALPHA_BLEND;
+    }
+
+    // Whether a hit at uv is opaque. xi is a uniform random number used by
+    // stochastic alpha
+    bool alphaTest(const Vec2f &uv, float xi) const
+    {
+        float opacity = (*_opacity)[uv].x();
+        if (_alphaMode == ALPHA_CUTOUT)
+            return opacity >= AlphaCutoff;
+        else
+            return xi < opacity;
+    }
+
     const std::shared_ptr<Texture> &opacity() const
     {
         return _opacity;
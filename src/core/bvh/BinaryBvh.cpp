@@ -0,0 +1,108 @@
+#include "BinaryBvh.hpp"
+#include "SahSplit.hpp"
+
+#include "thread/ThreadUtils.hpp"
+#include "thread/ThreadPool.hpp"
+
+#include "math/MathUtil.hpp"
+
+#include <atomic>
+
+namespace Tungsten {
+
+namespace Bvh {
+
+// Subtrees smaller than this are built on the calling thread
+static CONSTEXPR uint32 ParallelSubtreeThreshold = 4*1024;
+
+struct BinaryBvh::BuildContext
+{
+    PrimVector &prims;
+    PrimVector scratch;
+    std::atomic<uint32> tail;
+    uint32 maxPrimsPerLeaf;
+
+    BuildContext(PrimVector &prims_, uint32 maxPrimsPerLeaf_)
+    : prims(prims_),
+      scratch(prims_.size()),
+      tail(1),
+      maxPrimsPerLeaf(maxPrimsPerLeaf_)
+    {
+    }
+};
+
+// Primitives are partitioned in place, so that every leaf references a
+// contiguous range of prims. Child pairs are allocated from a shared atomic
+// counter, which allows subtrees to be built concurrently directly into the
+// final node array
+uint32 BinaryBvh::recursiveBuild(BuildContext &context, uint32 head, uint32 start, uint32 end,
+        const Box3f &geomBox, const Box3f &centroidBox)
+{
+    uint32 numPrims = end - start + 1;
+    if (numPrims <= context.maxPrimsPerLeaf) {
+        _nodes[head].setJointBbox(geomBox, geomBox);
+        _nodes[head].setPrimIndex(numPrims, start);
+        _nodes[head].setRchild(nullptr);
+        return 1;
+    }
+
+    SplitInfo split;
+    twoWaySahSplit(start, end, context.prims, context.scratch, geomBox, centroidBox, split);
+
+    uint32 starts[] = {start, split.idx};
+    uint32 ends[] = {split.idx - 1, end};
+    Box3f geomBoxes[] = {narrow(split.lBox), narrow(split.rBox)};
+    Box3f centroidBoxes[] = {narrow(split.lCentroidBox), narrow(split.rCentroidBox)};
+
+    uint32 childIdx = context.tail.fetch_add(2);
+    _nodes[head].setJointBbox(geomBoxes[0], geomBoxes[1]);
+    _nodes[head].setLchild(&_nodes[childIdx + 0]);
+    _nodes[head].setRchild(&_nodes[childIdx + 1]);
+
+    uint32 depths[2];
+    if (numPrims <= ParallelSubtreeThreshold) {
+        for (uint32 i = 0; i < 2; ++i)
+            depths[i] = recursiveBuild(context, childIdx + i, starts[i], ends[i], geomBoxes[i], centroidBoxes[i]);
+    } else {
+        std::shared_ptr<TaskGroup> group = ThreadUtils::pool->enqueue([&](uint32 i, uint32, uint32) {
+            depths[i] = recursiveBuild(context, childIdx + i, starts[i], ends[i], geomBoxes[i], centroidBoxes[i]);
+        }, 2);
+        // Do some work while we wait
+        ThreadUtils::pool->yield(*group);
+    }
+
+    return max(depths[0], depths[1]) + 1;
+}
+
+BinaryBvh::BinaryBvh(PrimVector prims, int maxPrimsPerLeaf)
+{
+    size_t count = prims.size();
+
+    if (prims.empty()) {
+        _depth = 0;
+        _nodes.push_back(TinyBvhNode());
+        _nodes.back().setJointBbox(Box3f(), Box3f());
+        _nodes.back().setRchild(&_nodes.back());
+    } else {
+        uint32 end = uint32(count - 1);
+        Box3f centroidBox;
+        computeBounds(0, end, prims, _bounds, centroidBox);
+
+        // A binary tree with count leaves has at most 2*count - 1 nodes.
+        // Nodes must not be reallocated after this point, since children
+        // are referenced by pointer
+        _nodes.resize(2*count - 1);
+
+        BuildContext context(prims, max(maxPrimsPerLeaf, 1));
+        _depth = recursiveBuild(context, 0, 0, end, _bounds, centroidBox);
+        _nodes.resize(context.tail);
+
+        _primIndices.resize(count);
+        for (size_t i = 0; i < count; ++i)
+            _primIndices[i] = prims[i].id();
+    }
+}
+
+}
+
+}
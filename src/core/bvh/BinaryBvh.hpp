@@ -1,9 +1,10 @@
 #ifndef BINARYBVH_HPP_
 #define BINARYBVH_HPP_
 
-#include "BvhBuilder.hpp"
+#include "Primitive.hpp"
 
 #include "math/Box.hpp"
+#include "math/Ray.hpp"
 #include "math/Vec.hpp"
 #include "sse/SimdUtils.hpp"
 
@@ -114,34 +115,10 @@ class BinaryBvh
     std::vector<uint32> _primIndices;
     Box3f _bounds;
 
-    uint32 recursiveBuild(const NaiveBvhNode *node, uint32 head, uint32 &tail, uint32 &primIndex,
-            std::vector<uint32> &primIndices, uint32 maxPrimsPerLeaf)
-    {
-        if (node->isLeaf()) {
-            _nodes[head].setJointBbox(node->bbox(), node->bbox());
-            _nodes[head].setPrimIndex(1, primIndex);
-            _nodes[head].setRchild(nullptr);
-            primIndices[primIndex++] = node->id();
-
-            return 1;
-        } else {
-            int childIdx = tail;
-            _nodes[head].setJointBbox(node->child(0)->bbox(), node->child(1)->bbox());
-            _nodes[head].setLchild(&_nodes[childIdx + 0]);
-            _nodes[head].setRchild(&_nodes[childIdx + 1]);
-            tail += 2;
-            uint32 lPrims = recursiveBuild(node->child(0), childIdx + 0, tail, primIndex, primIndices, maxPrimsPerLeaf);
-            uint32 rPrims = recursiveBuild(node->child(1), childIdx + 1, tail, primIndex, primIndices, maxPrimsPerLeaf);
-
-            if (lPrims + rPrims <= maxPrimsPerLeaf) {
-                _nodes[head].setPrimIndex(lPrims + rPrims, _nodes[childIdx].primIndex());
-                _nodes[head].setRchild(nullptr);
-                tail = childIdx;
-            }
+    struct BuildContext;
 
-            return lPrims + rPrims;
-        }
-    }
+    uint32 recursiveBuild(BuildContext &context, uint32 head, uint32 start, uint32 end,
+            const Box3f &geomBox, const Box3f &centroidBox);
 
     bool bboxIntersection(const Box3f &box, const Vec3f &o, const Vec3f &d, float &tMin, float &tMax) const
     {
@@ -169,30 +146,7 @@ class BinaryBvh
     }
 
 public:
-    BinaryBvh(PrimVector prims, int maxPrimsPerLeaf)
-    {
-        size_t count = prims.size();
-
-        if (prims.empty()) {
-            _depth = 0;
-            _nodes.push_back(TinyBvhNode());
-            _nodes.back().setJointBbox(Box3f(), Box3f());
-            _nodes.back().setRchild(&_nodes.back());
-        } else {
-            BvhBuilder builder(2);
-            builder.build(std::move(prims));
-
-            _primIndices.resize(count);
-            _nodes.resize(builder.numNodes());
-            _depth = builder.depth();
-            _bounds = builder.root()->bbox();
-
-            uint32 tail = 1, primIndex = 0;
-            recursiveBuild(builder.root().get(), 0, tail, primIndex, _primIndices, maxPrimsPerLeaf);
-            builder.root().reset();
-            _nodes.resize(tail);
-        }
-    }
+    BinaryBvh(PrimVector prims, int maxPrimsPerLeaf);
 
     template<typename LAMBDA>
     void trace(Ray &ray, LAMBDA intersector) const
@@ -19,11 +19,6 @@ class BinnedSahSplitter
     Vec3f _centroidMin, _centroidSpan;
     int _counts[3][BinCount];
 
-    int primitiveBin(const Primitive &prim, int dim) const
-    {
-        return clamp(int(BinCount*((prim.centroid()[dim] - _centroidMin[dim])/_centroidSpan[dim])), 0, BinCount - 1);
-    }
-
     void binPrimitives(uint32 start, uint32 end, int dim, PrimVector &prims)
     {
         for (uint32 i = start; i <= end; ++i) {
@@ -87,6 +82,11 @@ public:
         std::memset(_counts, 0, sizeof(_counts));
     }
 
+    int primitiveBin(const Primitive &prim, int dim) const
+    {
+        return clamp(int(BinCount*((prim.centroid()[dim] - _centroidMin[dim])/_centroidSpan[dim])), 0, BinCount - 1);
+    }
+
     void partialBin(uint32 start, uint32 end, PrimVector &prims, const Box3f &centroidBox)
     {
         _centroidMin = centroidBox.min();
@@ -107,7 +107,9 @@ public:
         }
     }
 
-    void twoWaySahSplit(uint32 start, uint32 end, PrimVector &prims, const Box3f &box, SplitInfo &split)
+    // Selects the split dimension from the binned primitives. split.idx receives
+    // the bin index of the split plane, not the primitive index
+    void findSplit(uint32 start, uint32 end, const Box3f &box, SplitInfo &split)
     {
         split.dim = -1;
         split.cost = box.area()*((end - start + 1)*Splitter::IntersectionCost - Splitter::TraversalCost);
@@ -120,9 +122,12 @@ public:
             split.dim = box.diagonal().maxDim();
             split.idx = BinCount/2;
         }
-        int bin = split.idx;
-        split.idx = sortByBin(start, end, prims, split.dim, bin);
+    }
 
+    // Computes the child bounds after prims were partitioned at split.idx.
+    // A split.idx past end signals a degenerate partition
+    void finishSplit(uint32 start, uint32 end, PrimVector &prims, int bin, SplitInfo &split)
+    {
         if (split.idx > end || _centroidSpan == 0.0f) { /* Degenerate case */
             split.idx = start + (end - start + 1)/2;
             split.lBox = prims[start].box();
@@ -156,6 +161,14 @@ public:
         }
     }
 
+    void twoWaySahSplit(uint32 start, uint32 end, PrimVector &prims, const Box3f &box, SplitInfo &split)
+    {
+        findSplit(start, end, box, split);
+        int bin = split.idx;
+        split.idx = sortByBin(start, end, prims, split.dim, bin);
+        finishSplit(start, end, prims, bin, split);
+    }
+
     void fullSplit(uint32 start, uint32 end, PrimVector &prims,
             const Box3f &geomBox, const Box3f &centroidBox, SplitInfo &split)
     {
@@ -1,8 +1,5 @@
 #include "BvhBuilder.hpp"
-
-#include "BinnedSahSplitter.hpp"
-#include "MidpointSplitter.hpp"
-#include "FullSahSplitter.hpp"
+#include "SahSplit.hpp"
 
 #include "thread/ThreadUtils.hpp"
 #include "thread/ThreadPool.hpp"
@@ -26,42 +23,8 @@ struct BuildResult
     uint32 depth;
 };
 
-static void twoWaySahSplit(uint32 start, uint32 end, PrimVector &prims, const Box3f &geomBox,
-        const Box3f &centroidBox, SplitInfo &split)
-{
-    uint32 numPrims = end - start + 1;
-
-    if (numPrims <= 64) {
-        // O(n log n) exact SAH split for small workloads
-        FullSahSplitter().twoWaySahSplit(start, end, prims, geomBox, centroidBox, split);
-    } else if (numPrims <= 1024*1024) {
-        // O(n) approximate binned SAH split for medium workloads
-        BinnedSahSplitter().fullSplit(start, end, prims, geomBox, centroidBox, split);
-    } else {
-        // Parallel O(n) approximate binned SAH split with
-        // serial reduce for large workloads
-
-        CONSTEXPR uint32 NumTasks = 8;
-        BinnedSahSplitter splitters[NumTasks];
-
-        std::shared_ptr<TaskGroup> group = ThreadUtils::pool->enqueue([&](uint32 i, uint32 numTasks, uint32) {
-            uint32 span = numPrims/numTasks;
-            uint32 primStart = start + span*i;
-            uint32 primEnd = min(primStart + span, end);
-            splitters[i].partialBin(primStart, primEnd, prims, centroidBox);
-        }, NumTasks);
-        // Do some work while we wait
-        ThreadUtils::pool->yield(*group);
-
-        for (uint32 i = 1; i < NumTasks; ++i)
-            splitters[0].merge(splitters[i]);
-
-        splitters[0].twoWaySahSplit(start, end, prims, geomBox, split);
-    }
-}
-
 static uint32 sahSplit(uint32 starts[], uint32 ends[], Box3f geomBoxes[],
-        Box3f centroidBoxes[], PrimVector &prims, uint32 branchFactor)
+        Box3f centroidBoxes[], PrimVector &prims, PrimVector &scratch, uint32 branchFactor)
 {
     uint32 childCount;
 
@@ -79,7 +42,7 @@ static uint32 sahSplit(uint32 starts[], uint32 ends[], Box3f geomBoxes[],
 
         // If not, split the largest child
         SplitInfo split;
-        twoWaySahSplit(starts[interval], ends[interval], prims, geomBoxes[interval],
+        twoWaySahSplit(starts[interval], ends[interval], prims, scratch, geomBoxes[interval],
                 centroidBoxes[interval], split);
 
         // Create two new children
@@ -97,7 +60,7 @@ static uint32 sahSplit(uint32 starts[], uint32 ends[], Box3f geomBoxes[],
 }
 
 static void recursiveBuild(BuildResult &result, NaiveBvhNode &dst, uint32 start, uint32 end,
-        PrimVector &prims, const Box3f &geomBox, const Box3f &centroidBox, uint32 branchFactor)
+        PrimVector &prims, PrimVector &scratch, const Box3f &geomBox, const Box3f &centroidBox, uint32 branchFactor)
 {
     result = BuildResult{1, 1};
 
@@ -122,7 +85,7 @@ static void recursiveBuild(BuildResult &result, NaiveBvhNode &dst, uint32 start,
         centroidBoxes[0] = centroidBox;
 
         // Perform the split (potentially in parallel)
-        uint32 childCount = sahSplit(starts, ends, geomBoxes, centroidBoxes, prims, branchFactor);
+        uint32 childCount = sahSplit(starts, ends, geomBoxes, centroidBoxes, prims, scratch, branchFactor);
 
         // TODO: Use pool allocator?
         for (unsigned i = 0; i < childCount; ++i)
@@ -133,7 +96,7 @@ static void recursiveBuild(BuildResult &result, NaiveBvhNode &dst, uint32 start,
             for (unsigned i = 0; i < childCount; ++i) {
                 BuildResult recursiveResult;
                 recursiveBuild(recursiveResult, *dst.child(i), starts[i], ends[i],
-                        prims, geomBoxes[i], centroidBoxes[i], branchFactor);
+                        prims, scratch, geomBoxes[i], centroidBoxes[i], branchFactor);
                 result.nodeCount += recursiveResult.nodeCount;
                 result.depth = max(result.depth, recursiveResult.depth + 1);
             }
@@ -142,7 +105,7 @@ static void recursiveBuild(BuildResult &result, NaiveBvhNode &dst, uint32 start,
             BuildResult results[4];
             std::shared_ptr<TaskGroup> group = ThreadUtils::pool->enqueue([&](uint32 i, uint32, uint32) {
                 recursiveBuild(results[i], *dst.child(i), starts[i], ends[i],
-                        prims, geomBoxes[i], centroidBoxes[i], branchFactor);
+                        prims, scratch, geomBoxes[i], centroidBoxes[i], branchFactor);
             }, childCount);
             // Do some work while we wait
             ThreadUtils::pool->yield(*group);
@@ -168,14 +131,13 @@ void BvhBuilder::build(PrimVector prims)
 {
     if (prims.empty())
         return;
-    Box3fp geomBounds, centroidBounds;
-    for (const Primitive &p : prims) {
-        geomBounds.grow(p.box());
-        centroidBounds.grow(p.centroid());
-    }
+    uint32 end = uint32(prims.size() - 1);
+    Box3f geomBox, centroidBox;
+    computeBounds(0, end, prims, geomBox, centroidBox);
 
+    PrimVector scratch(prims.size());
     BuildResult result;
-    recursiveBuild(result, *_root, 0, uint32(prims.size() - 1), prims, narrow(geomBounds), narrow(centroidBounds), _branchFactor);
+    recursiveBuild(result, *_root, 0, end, prims, scratch, geomBox, centroidBox, _branchFactor);
     _numNodes = result.nodeCount;
     _depth = result.depth;
 
@@ -0,0 +1,150 @@
+#include "OrientedQuadBvh.hpp"
+#include "BvhBuilder.hpp"
+
+#include "math/TangentFrame.hpp"
+#include "math/Box.hpp"
+
+namespace Tungsten {
+
+namespace Bvh {
+
+CONSTEXPR uint32 OrientedQuadBvh::MaxPrimsPerLeaf;
+
+OrientedQuadBvh::OrientedQuadBvh(const std::vector<Segment> &segments)
+: _depth(0)
+{
+    if (segments.empty())
+        return;
+
+    PrimVector prims;
+    prims.reserve(segments.size());
+    for (uint32 i = 0; i < segments.size(); ++i) {
+        const Segment &s = segments[i];
+        Box3f box;
+        box.grow(s.p0);
+        box.grow(s.p1);
+        box.grow(s.p2);
+        box.grow(box.min() - s.radius);
+        box.grow(box.max() + s.radius);
+        prims.emplace_back(box, (s.p0 + s.p1 + s.p2)*(1.0f/3.0f), i);
+    }
+
+    BvhBuilder builder(4);
+    builder.build(std::move(prims));
+
+    _primIndices.reserve(segments.size());
+    _nodes.reserve(builder.numNodes());
+    recursiveBuild(builder.root().get(), segments, 1);
+    builder.root().reset();
+}
+
+void OrientedQuadBvh::collectPrims(const NaiveBvhNode *node, std::vector<uint32> &dst) const
+{
+    if (node->isLeaf()) {
+        dst.push_back(node->id());
+        return;
+    }
+    for (int i = 0; i < 4 && node->child(i); ++i)
+        collectPrims(node->child(i), dst);
+}
+
+void OrientedQuadBvh::fitChild(Node &node, int lane, const std::vector<Segment> &segments,
+        const std::vector<uint32> &prims) const
+{
+    // Estimate the dominant direction as the sign-aligned sum of segment chords
+    Vec3f axis(0.0f);
+    for (uint32 idx : prims) {
+        Vec3f chord = segments[idx].p2 - segments[idx].p0;
+        axis += axis.dot(chord) < 0.0f ? -chord : chord;
+    }
+
+    auto fitBox = [&](const Vec3f &lx, const Vec3f &ly, const Vec3f &lz) {
+        Box3f box;
+        for (uint32 idx : prims) {
+            const Segment &s = segments[idx];
+            for (const Vec3f &p : {s.p0, s.p1, s.p2}) {
+                Vec3f q(lx.dot(p), ly.dot(p), lz.dot(p));
+                box.grow(q - s.radius);
+                box.grow(q + s.radius);
+            }
+        }
+        return box;
+    };
+
+    Vec3f lx(1.0f, 0.0f, 0.0f), ly(0.0f, 1.0f, 0.0f), lz(0.0f, 0.0f, 1.0f);
+    Box3f box = fitBox(lx, ly, lz);
+
+    float axisLength = axis.length();
+    if (axisLength > 0.0f) {
+        TangentFrame frame(axis/axisLength);
+        Box3f orientedBox = fitBox(frame.tangent, frame.bitangent, frame.normal);
+        if (orientedBox.area() < box.area()) {
+            lx = frame.tangent;
+            ly = frame.bitangent;
+            lz = frame.normal;
+            box = orientedBox;
+        }
+    }
+
+    // Guard against degenerate extents, which would produce infinite scale factors
+    Vec3f extent = max(box.diagonal(), Vec3f(1e-6f*max(box.diagonal().max(), 1e-6f)));
+    const Vec3f axes[] = {lx, ly, lz};
+    for (int i = 0; i < 3; ++i) {
+        float invExtent = 1.0f/extent[i];
+        for (int j = 0; j < 3; ++j)
+            node.xfm[i][j][lane] = axes[i][j]*invExtent;
+        node.xfm[i][3][lane] = -box.min()[i]*invExtent;
+    }
+}
+
+uint32 OrientedQuadBvh::recursiveBuild(const NaiveBvhNode *node, const std::vector<Segment> &segments, uint32 depth)
+{
+    _depth = max(_depth, depth);
+
+    uint32 index = _nodes.size();
+    _nodes.emplace_back();
+
+    // Unused lanes map rays to a point outside the unit box. This is not
+    // enough to reject rays with infinite extent, so trace() skips them explicitly
+    Node result;
+    for (int lane = 0; lane < 4; ++lane) {
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j)
+                result.xfm[i][j][lane] = 0.0f;
+            result.xfm[i][3][lane] = 2.0f;
+        }
+        result.child[lane] = 0;
+        result.count[lane] = 0;
+    }
+
+    // The builder produces single-primitive roots for tiny inputs
+    const NaiveBvhNode *children[4] = {nullptr, nullptr, nullptr, nullptr};
+    if (node->isLeaf())
+        children[0] = node;
+    else
+        for (int i = 0; i < 4; ++i)
+            children[i] = node->child(i);
+
+    std::vector<uint32> prims;
+    for (int lane = 0; lane < 4 && children[lane]; ++lane) {
+        prims.clear();
+        collectPrims(children[lane], prims);
+        fitChild(result, lane, segments, prims);
+
+        if (prims.size() <= MaxPrimsPerLeaf) {
+            result.child[lane] = _primIndices.size();
+            result.count[lane] = prims.size();
+            _primIndices.insert(_primIndices.end(), prims.begin(), prims.end());
+        } else {
+            result.child[lane] = recursiveBuild(children[lane], segments, depth + 1);
+        }
+    }
+
+    _nodes[index] = result;
+
+    return index;
+}
+
+}
+
+}
@@ -0,0 +1,145 @@
+#ifndef ORIENTEDQUADBVH_HPP_
+#define ORIENTEDQUADBVH_HPP_
+
+#include "NaiveBvhNode.hpp"
+
+#include "math/Ray.hpp"
+#include "math/Vec.hpp"
+#include "sse/SimdUtils.hpp"
+
+#include "AlignedAllocator.hpp"
+#include "IntTypes.hpp"
+
+#include <vector>
+
+namespace Tungsten {
+
+namespace Bvh {
+
+// A 4-wide BVH for long, thin primitives such as hair segments. Instead of
+// axis-aligned boxes, each child stores an affine transform that maps its
+// oriented bounding box onto the unit cube. The orientation is fitted to the
+// average direction of the segments contained in the child, which keeps the
+// bounds tight around diagonal strands that would otherwise produce mostly
+// empty axis-aligned boxes. Children are traversed four at a time with SSE.
+class OrientedQuadBvh
+{
+public:
+    // Quadratic Bezier hull swept by a radius. The segment is
+    // guaranteed to lie inside the convex hull of the three points
+    // dilated by the radius
+    struct Segment
+    {
+        Vec3f p0, p1, p2;
+        float radius;
+    };
+
+    static CONSTEXPR uint32 MaxPrimsPerLeaf = 2;
+
+private:
+    template<typename T> using aligned_vector = std::vector<T, AlignedAllocator<T, 64>>;
+
+    struct Node
+    {
+        // Row-major 3x4 transform into the unit box of each child, stored SoA
+        // The last column holds the translation
+        float4 xfm[3][4];
+        // Index of the child node, or start of the leaf primitive range if count > 0
+        uint32 child[4];
+        uint32 count[4];
+    };
+
+    uint32 _depth;
+    aligned_vector<Node> _nodes;
+    std::vector<uint32> _primIndices;
+
+    void collectPrims(const NaiveBvhNode *node, std::vector<uint32> &dst) const;
+    void fitChild(Node &node, int lane, const std::vector<Segment> &segments,
+            const std::vector<uint32> &prims) const;
+    uint32 recursiveBuild(const NaiveBvhNode *node, const std::vector<Segment> &segments, uint32 depth);
+
+public:
+    OrientedQuadBvh(const std::vector<Segment> &segments);
+
+    template<typename LAMBDA>
+    void trace(Ray &ray, LAMBDA intersector) const
+    {
+        struct StackNode
+        {
+            uint32 index;
+            uint32 count;
+            float tMin;
+        };
+        if (_nodes.empty())
+            return;
+
+        // Every visited node pushes at most 4 and pops 1 entry
+        StackNode *stack = reinterpret_cast<StackNode *>(alloca((3*_depth + 4)*sizeof(StackNode)));
+        StackNode *stackPtr = stack;
+
+        const float4 ox(ray.pos().x()), oy(ray.pos().y()), oz(ray.pos().z());
+        const float4 dx(ray.dir().x()), dy(ray.dir().y()), dz(ray.dir().z());
+        const float4 one(1.0f);
+
+        StackNode cur{0, 0, ray.nearT()};
+        while (true) {
+            if (cur.count > 0) {
+                for (uint32 i = cur.index; i < cur.index + cur.count; ++i)
+                    intersector(ray, _primIndices[i]);
+            } else {
+                const Node &node = _nodes[cur.index];
+
+                float4 tNear(ray.nearT()), tFar(ray.farT());
+                for (int i = 0; i < 3; ++i) {
+                    const float4 *row = node.xfm[i];
+                    float4 o = row[0]*ox + row[1]*oy + row[2]*oz + row[3];
+                    float4 invD = one/(row[0]*dx + row[1]*dy + row[2]*dz);
+                    float4 t0 = -o*invD;
+                    float4 t1 = (one - o)*invD;
+                    tNear = max(tNear, min(t0, t1));
+                    tFar  = min(tFar,  max(t0, t1));
+                }
+                bool4 hit = tNear <= tFar;
+
+                // Push children far to near so that the closest one is popped first
+                StackNode children[4];
+                int numHits = 0;
+                for (int i = 0; i < 4; ++i) {
+                    // Unused lanes have no valid slab and are marked by a child
+                    // index of 0, which can never be referenced since it is the root
+                    if (!hit[i] || (node.count[i] == 0 && node.child[i] == 0))
+                        continue;
+                    StackNode child{node.child[i], node.count[i], tNear[i]};
+                    int j = numHits++;
+                    for (; j > 0 && children[j - 1].tMin < child.tMin; --j)
+                        children[j] = children[j - 1];
+                    children[j] = child;
+                }
+                for (int i = 0; i < numHits; ++i)
+                    *stackPtr++ = children[i];
+            }
+
+            do {
+                if (stackPtr == stack)
+                    return;
+                cur = *--stackPtr;
+            } while (cur.tMin > ray.farT());
+        }
+    }
+
+    uint32 depth() const
+    {
+        return _depth;
+    }
+
+    size_t numNodes() const
+    {
+        return _nodes.size();
+    }
+};
+
+}
+
+}
+
+#endif /* ORIENTEDQUADBVH_HPP_ */
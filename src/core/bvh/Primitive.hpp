@@ -20,6 +20,8 @@ class Primitive
 
     float _area;
 public:
+    Primitive() = default;
+
     Primitive(const Box3f &box, const Vec3f &centroid, uint32 id)
     : _box(expand(box)), _centroid(expand(centroid)), _id(id), _area(box.area())
     {
@@ -0,0 +1,148 @@
+#include "SahSplit.hpp"
+#include "BinnedSahSplitter.hpp"
+#include "FullSahSplitter.hpp"
+
+#include "thread/ThreadUtils.hpp"
+#include "thread/ThreadPool.hpp"
+
+#include "math/MathUtil.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace Tungsten {
+
+namespace Bvh {
+
+// Below this many primitives, the overhead of spawning tasks outweighs
+// the benefits of binning and partitioning in parallel
+static CONSTEXPR uint32 ParallelThreshold = 64*1024;
+static CONSTEXPR uint32 MinPrimsPerTask = 16*1024;
+
+static uint32 parallelTaskCount(uint32 numPrims)
+{
+    uint32 maxTasks = 4*ThreadUtils::pool->threadCount();
+    return clamp(numPrims/MinPrimsPerTask, 1u, max(maxTasks, 1u));
+}
+
+static void taskRange(uint32 start, uint32 end, uint32 task, uint32 numTasks, uint32 &taskStart, uint32 &taskEnd)
+{
+    uint32 span = (end - start + numTasks)/numTasks;
+    taskStart = min(start + span*task, end + 1);
+    taskEnd   = min(taskStart + span, end + 1);
+}
+
+// Stable two-pass partition: Each task counts the primitives on the left of
+// the split plane in its block, followed by a prefix sum over the counts and
+// a parallel scatter into scratch. Returns the index of the first primitive
+// on the right, or end + 1 if the partition is degenerate
+static uint32 parallelPartition(uint32 start, uint32 end, PrimVector &prims, PrimVector &scratch,
+        const BinnedSahSplitter &splitter, int dim, int bin, uint32 numTasks)
+{
+    std::vector<uint32> lCounts(numTasks);
+    ThreadUtils::parallelFor(0, numTasks, numTasks, [&](uint32 task) {
+        uint32 taskStart, taskEnd;
+        taskRange(start, end, task, numTasks, taskStart, taskEnd);
+        uint32 count = 0;
+        for (uint32 i = taskStart; i < taskEnd; ++i)
+            if (splitter.primitiveBin(prims[i], dim) < bin)
+                count++;
+        lCounts[task] = count;
+    });
+
+    std::vector<uint32> lOffsets(numTasks), rOffsets(numTasks);
+    uint32 numLeft = 0;
+    for (uint32 i = 0; i < numTasks; ++i) {
+        lOffsets[i] = numLeft;
+        numLeft += lCounts[i];
+    }
+    if (numLeft == 0 || numLeft == end - start + 1)
+        return end + 1;
+
+    uint32 numRight = 0;
+    for (uint32 i = 0; i < numTasks; ++i) {
+        uint32 taskStart, taskEnd;
+        taskRange(start, end, i, numTasks, taskStart, taskEnd);
+        rOffsets[i] = numLeft + numRight;
+        numRight += (taskEnd - taskStart) - lCounts[i];
+    }
+
+    ThreadUtils::parallelFor(0, numTasks, numTasks, [&](uint32 task) {
+        uint32 taskStart, taskEnd;
+        taskRange(start, end, task, numTasks, taskStart, taskEnd);
+        uint32 l = start + lOffsets[task], r = start + rOffsets[task];
+        for (uint32 i = taskStart; i < taskEnd; ++i) {
+            if (splitter.primitiveBin(prims[i], dim) < bin)
+                scratch[l++] = prims[i];
+            else
+                scratch[r++] = prims[i];
+        }
+    });
+    ThreadUtils::parallelFor(0, numTasks, numTasks, [&](uint32 task) {
+        uint32 taskStart, taskEnd;
+        taskRange(start, end, task, numTasks, taskStart, taskEnd);
+        std::copy(scratch.begin() + taskStart, scratch.begin() + taskEnd, prims.begin() + taskStart);
+    });
+
+    return start + numLeft;
+}
+
+void computeBounds(uint32 start, uint32 end, const PrimVector &prims, Box3f &geomBox, Box3f &centroidBox)
+{
+    uint32 numPrims = end - start + 1;
+    uint32 numTasks = numPrims <= ParallelThreshold ? 1 : parallelTaskCount(numPrims);
+
+    std::vector<Box3fp> geomBounds(numTasks), centroidBounds(numTasks);
+    ThreadUtils::parallelFor(0, numTasks, numTasks, [&](uint32 task) {
+        uint32 taskStart, taskEnd;
+        taskRange(start, end, task, numTasks, taskStart, taskEnd);
+        for (uint32 i = taskStart; i < taskEnd; ++i) {
+            geomBounds[task].grow(prims[i].box());
+            centroidBounds[task].grow(prims[i].centroid());
+        }
+    });
+
+    for (uint32 i = 1; i < numTasks; ++i) {
+        geomBounds[0].grow(geomBounds[i]);
+        centroidBounds[0].grow(centroidBounds[i]);
+    }
+    geomBox = narrow(geomBounds[0]);
+    centroidBox = narrow(centroidBounds[0]);
+}
+
+void twoWaySahSplit(uint32 start, uint32 end, PrimVector &prims, PrimVector &scratch,
+        const Box3f &geomBox, const Box3f &centroidBox, SplitInfo &split)
+{
+    uint32 numPrims = end - start + 1;
+
+    if (numPrims <= 64) {
+        // O(n log n) exact SAH split for small workloads
+        FullSahSplitter().twoWaySahSplit(start, end, prims, geomBox, centroidBox, split);
+    } else if (numPrims <= ParallelThreshold) {
+        // O(n) approximate binned SAH split for medium workloads
+        BinnedSahSplitter().fullSplit(start, end, prims, geomBox, centroidBox, split);
+    } else {
+        // Parallel O(n) approximate binned SAH split and partition
+        // with serial reduce for large workloads
+        uint32 numTasks = parallelTaskCount(numPrims);
+        std::unique_ptr<BinnedSahSplitter[]> splitters(new BinnedSahSplitter[numTasks]);
+
+        ThreadUtils::parallelFor(0, numTasks, numTasks, [&](uint32 task) {
+            uint32 taskStart, taskEnd;
+            taskRange(start, end, task, numTasks, taskStart, taskEnd);
+            splitters[task].partialBin(taskStart, taskEnd - 1, prims, centroidBox);
+        });
+
+        for (uint32 i = 1; i < numTasks; ++i)
+            splitters[0].merge(splitters[i]);
+
+        splitters[0].findSplit(start, end, geomBox, split);
+        int bin = split.idx;
+        split.idx = parallelPartition(start, end, prims, scratch, splitters[0], split.dim, bin, numTasks);
+        splitters[0].finishSplit(start, end, prims, bin, split);
+    }
+}
+
+}
+
+}
@@ -0,0 +1,30 @@
+#ifndef SAHSPLIT_HPP_
+#define SAHSPLIT_HPP_
+
+#include "Primitive.hpp"
+#include "Splitter.hpp"
+
+#include "math/Box.hpp"
+
+#include "IntTypes.hpp"
+
+namespace Tungsten {
+
+namespace Bvh {
+
+// Computes the bounds of primitives and primitive centroids in [start, end].
+// Large ranges are reduced in parallel on the thread pool
+void computeBounds(uint32 start, uint32 end, const PrimVector &prims, Box3f &geomBox, Box3f &centroidBox);
+
+// Finds a two-way SAH split of the primitives in [start, end] and partitions
+// them accordingly. Large ranges are binned and partitioned in parallel on the
+// thread pool, using scratch as the target of the partition. scratch must be at
+// least as large as prims
+void twoWaySahSplit(uint32 start, uint32 end, PrimVector &prims, PrimVector &scratch,
+        const Box3f &geomBox, const Box3f &centroidBox, SplitInfo &split);
+
+}
+
+}
+
+#endif /* SAHSPLIT_HPP_ */
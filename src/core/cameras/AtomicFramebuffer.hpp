@@ -5,6 +5,8 @@
 
 #include "math/Vec.hpp"
 
+#include "io/FileUtils.hpp"
+
 #include <memory>
 #include <atomic>
 
@@ -89,6 +91,16 @@ public:
     {
         std::memset(&_buffer[0].x(), 0, _w*_h*sizeof(Vec3fa));
     }
+
+    void serialize(OutputStreamHandle &out) const
+    {
+        FileUtils::streamWrite(out, reinterpret_cast<const float *>(_buffer.get()), _w*_h*3);
+    }
+
+    void deserialize(InputStreamHandle &in)
+    {
+        FileUtils::streamRead(in, reinterpret_cast<float *>(_buffer.get()), _w*_h*3);
+    }
 };
 
 }
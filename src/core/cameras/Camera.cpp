@@ -21,7 +21,9 @@ Camera::Camera()
 Camera::Camera(const Mat4f &transform, const Vec2u &res)
 : _tonemapOp("gamma"),
   _transform(transform),
-  _res(res)
+  _res(res),
+  _windowSize(0u),
+  _windowOrigin(0u)
 {
     _colorBufferSettings.setType(OutputColor);
 
@@ -130,19 +132,25 @@ void Camera::teardownAfterRender()
         _normalBuffer.reset();
         _albedoBuffer.reset();
     _visibilityBuffer.reset();
+          _costBuffer.reset();
 
     _splatBuffer.reset();
+    _previewBuffer.reset();
+
+    _windowWriter.reset();
+    _windowSize = _windowOrigin = Vec2u(0u);
 }
 
 void Camera::requestOutputBuffers(const std::vector<OutputBufferSettings> &settings)
 {
     for (const auto &b : settings) {
         switch (b.type()) {
-        case OutputColor:           _colorBuffer.reset(new OutputBufferVec3f(_res, b)); break;
-        case OutputDepth:           _depthBuffer.reset(new OutputBufferF    (_res, b)); break;
-        case OutputNormal:         _normalBuffer.reset(new OutputBufferVec3f(_res, b)); break;
-        case OutputAlbedo:         _albedoBuffer.reset(new OutputBufferVec3f(_res, b)); break;
-        case OutputVisibility: _visibilityBuffer.reset(new OutputBufferF    (_res, b)); break;
+        case OutputColor:           _colorBuffer.reset(new OutputBufferVec3f(bufferResolution(), b)); break;
+        case OutputDepth:           _depthBuffer.reset(new OutputBufferF    (bufferResolution(), b)); break;
+        case OutputNormal:         _normalBuffer.reset(new OutputBufferVec3f(bufferResolution(), b)); break;
+        case OutputAlbedo:         _albedoBuffer.reset(new OutputBufferVec3f(bufferResolution(), b)); break;
+        case OutputVisibility: _visibilityBuffer.reset(new OutputBufferF    (bufferResolution(), b)); break;
+        case OutputCost:             _costBuffer.reset(new OutputBufferVec3f(bufferResolution(), b)); break;
         default: break;
         }
     }
@@ -151,7 +159,7 @@ void Camera::requestOutputBuffers(const std::vector<OutputBufferSettings> &setti
 void Camera::requestColorBuffer()
 {
     if (!_colorBuffer)
-        _colorBuffer.reset(new OutputBufferVec3f(_res, _colorBufferSettings));
+        _colorBuffer.reset(new OutputBufferVec3f(bufferResolution(), _colorBufferSettings));
     _colorBufferWeight = 1.0;
 }
 
@@ -161,6 +169,11 @@ void Camera::requestSplatBuffer()
     _splatWeight = 1.0;
 }
 
+void Camera::requestPreviewBuffer()
+{
+    _previewBuffer = ThreadUtils::parallelZeroAlloc<Vec3f>(_res.product());
+}
+
 void Camera::blitSplatBuffer()
 {
     for (uint32 y = 0; y < _res.y(); ++y)
@@ -169,6 +182,69 @@ void Camera::blitSplatBuffer()
     _splatBuffer->unsafeReset();
 }
 
+bool Camera::openWindowOutputs(const Path &hdrFile)
+{
+    Vec2u bufferRes = bufferResolution();
+    bool success = true;
+
+    if (!hdrFile.empty()) {
+        _windowWriter = ImageIO::openHdrBlockWriter(hdrFile, _res.x(), _res.y(), 3, bufferRes.x());
+        success = success && _windowWriter;
+    }
+    if (     _colorBuffer) success =      _colorBuffer->openWindowOutput(_res) && success;
+    if (     _depthBuffer) success =      _depthBuffer->openWindowOutput(_res) && success;
+    if (    _normalBuffer) success =     _normalBuffer->openWindowOutput(_res) && success;
+    if (    _albedoBuffer) success =     _albedoBuffer->openWindowOutput(_res) && success;
+    if (_visibilityBuffer) success = _visibilityBuffer->openWindowOutput(_res) && success;
+    if (      _costBuffer) success =       _costBuffer->openWindowOutput(_res) && success;
+
+    return success;
+}
+
+void Camera::setOutputWindow(Vec2u origin)
+{
+    _windowOrigin = origin;
+
+    if (     _colorBuffer)      _colorBuffer->setWindow(origin);
+    if (     _depthBuffer)      _depthBuffer->setWindow(origin);
+    if (    _normalBuffer)     _normalBuffer->setWindow(origin);
+    if (    _albedoBuffer)     _albedoBuffer->setWindow(origin);
+    if (_visibilityBuffer) _visibilityBuffer->setWindow(origin);
+    if (      _costBuffer)       _costBuffer->setWindow(origin);
+}
+
+void Camera::saveOutputWindow()
+{
+    Vec2u size = min(bufferResolution(), _res - _windowOrigin);
+
+    if (_windowWriter) {
+        std::unique_ptr<Vec3f[]> hdr(new Vec3f[size.product()]);
+        for (uint32 y = 0; y < size.y(); ++y)
+            for (uint32 x = 0; x < size.x(); ++x)
+                hdr[x + y*size.x()] = getLinear(_windowOrigin.x() + x, _windowOrigin.y() + y);
+        _windowWriter->writeBlock(hdr[0].data(), _windowOrigin.x(), _windowOrigin.y(), size.x(), size.y());
+    }
+
+    if (     _colorBuffer)      _colorBuffer->saveWindow(size.x(), size.y());
+    if (     _depthBuffer)      _depthBuffer->saveWindow(size.x(), size.y());
+    if (    _normalBuffer)     _normalBuffer->saveWindow(size.x(), size.y());
+    if (    _albedoBuffer)     _albedoBuffer->saveWindow(size.x(), size.y());
+    if (_visibilityBuffer) _visibilityBuffer->saveWindow(size.x(), size.y());
+    if (      _costBuffer)       _costBuffer->saveWindow(size.x(), size.y());
+}
+
+void Camera::closeWindowOutputs()
+{
+    _windowWriter.reset();
+
+    if (     _colorBuffer)      _colorBuffer->closeWindowOutput();
+    if (     _depthBuffer)      _depthBuffer->closeWindowOutput();
+    if (    _normalBuffer)     _normalBuffer->closeWindowOutput();
+    if (    _albedoBuffer)     _albedoBuffer->closeWindowOutput();
+    if (_visibilityBuffer) _visibilityBuffer->closeWindowOutput();
+    if (      _costBuffer)       _costBuffer->closeWindowOutput();
+}
+
 void Camera::setTransform(const Vec3f &pos, const Vec3f &lookAt, const Vec3f &up)
 {
     _pos = pos;
@@ -206,6 +282,7 @@ void Camera::saveOutputBuffers() const
     if (    _normalBuffer)     _normalBuffer->save();
     if (    _albedoBuffer)     _albedoBuffer->save();
     if (_visibilityBuffer) _visibilityBuffer->save();
+    if (      _costBuffer)       _costBuffer->save();
 }
 
 void Camera::serializeOutputBuffers(OutputStreamHandle &out) const
@@ -215,6 +292,8 @@ void Camera::serializeOutputBuffers(OutputStreamHandle &out) const
     if (    _normalBuffer)     _normalBuffer->serialize(out);
     if (    _albedoBuffer)     _albedoBuffer->serialize(out);
     if (_visibilityBuffer) _visibilityBuffer->serialize(out);
+    if (      _costBuffer)       _costBuffer->serialize(out);
+    if (     _splatBuffer)      _splatBuffer->serialize(out);
 }
 
 void Camera::deserializeOutputBuffers(InputStreamHandle &in)
@@ -224,6 +303,8 @@ void Camera::deserializeOutputBuffers(InputStreamHandle &in)
     if (    _normalBuffer)     _normalBuffer->deserialize(in);
     if (    _albedoBuffer)     _albedoBuffer->deserialize(in);
     if (_visibilityBuffer) _visibilityBuffer->deserialize(in);
+    if (      _costBuffer)       _costBuffer->deserialize(in);
+    if (     _splatBuffer)      _splatBuffer->deserialize(in);
 }
 
 }
@@ -55,12 +55,21 @@ protected:
     std::unique_ptr<OutputBufferVec3f> _normalBuffer;
     std::unique_ptr<OutputBufferVec3f> _albedoBuffer;
     std::unique_ptr<OutputBufferF> _visibilityBuffer;
+    std::unique_ptr<OutputBufferVec3f> _costBuffer;
 
     double _colorBufferWeight;
 
     std::unique_ptr<AtomicFramebuffer> _splatBuffer;
     double _splatWeight;
 
+    // Low resolution preview of the image, shown for pixels the color buffer
+    // has no samples for yet. It never ends up in any of the outputs
+    std::unique_ptr<Vec3f[]> _previewBuffer;
+
+    Vec2u _windowSize;
+    Vec2u _windowOrigin;
+    std::unique_ptr<ImageIO::HdrBlockWriter> _windowWriter;
+
 private:
     void precompute();
 
@@ -90,8 +99,14 @@ public:
     void requestOutputBuffers(const std::vector<OutputBufferSettings> &settings);
     void requestColorBuffer();
     void requestSplatBuffer();
+    void requestPreviewBuffer();
     void blitSplatBuffer();
 
+    bool openWindowOutputs(const Path &hdrFile);
+    void setOutputWindow(Vec2u origin);
+    void saveOutputWindow();
+    void closeWindowOutputs();
+
     void setTransform(const Vec3f &pos, const Vec3f &lookAt, const Vec3f &up);
     void setPos(const Vec3f &pos);
     void setLookAt(const Vec3f &lookAt);
@@ -126,6 +141,11 @@ public:
         return _visibilityBuffer.get();
     }
 
+    OutputBufferVec3f *costBuffer()
+    {
+        return _costBuffer.get();
+    }
+
     const OutputBufferVec3f *colorBuffer() const
     {
         return _colorBuffer.get();
@@ -151,6 +171,11 @@ public:
         return _visibilityBuffer.get();
     }
 
+    const OutputBufferVec3f *costBuffer() const
+    {
+        return _costBuffer.get();
+    }
+
     inline Vec3f tonemap(const Vec3f &c) const
     {
         return Tonemap::tonemap(_tonemapOp, max(c, Vec3f(0.0f)));
@@ -158,10 +183,20 @@ public:
 
     inline Vec3f getLinear(int x, int y) const
     {
-        int idx = x + y*_res.x();
         Vec3f result(0.0f);
-        if (_colorBuffer)
-            result += (*_colorBuffer)[idx]*_colorBufferWeight;
+        if (_colorBuffer) {
+            // With an output window, only pixels inside the window are resident
+            Vec2u bufferRes = bufferResolution();
+            int wx = x - int(_windowOrigin.x());
+            int wy = y - int(_windowOrigin.y());
+            if (wx >= 0 && wy >= 0 && wx < int(bufferRes.x()) && wy < int(bufferRes.y())) {
+                uint32 idx = wx + wy*bufferRes.x();
+                if (_previewBuffer && _colorBuffer->sampleCount(idx) == 0)
+                    result += _previewBuffer[x + y*_res.x()];
+                else
+                    result += (*_colorBuffer)[idx]*_colorBufferWeight;
+            }
+        }
         if (_splatBuffer)
             result += Vec3f(Vec3d(_splatBuffer->get(x, y))*_splatWeight);
         return result;
@@ -177,6 +212,13 @@ public:
         _splatWeight = weight;
     }
 
+    void setPreviewBlock(Vec2u origin, Vec2u size, const Vec3f &c)
+    {
+        for (uint32 y = origin.y(); y < origin.y() + size.y(); ++y)
+            for (uint32 x = origin.x(); x < origin.x() + size.x(); ++x)
+                _previewBuffer[x + y*_res.x()] = c;
+    }
+
     inline Vec3f get(int x, int y) const
     {
         return tonemap(getLinear(x, y));
@@ -212,6 +254,23 @@ public:
         _res = res;
     }
 
+    // Restricts the output buffers to a movable window of the given size,
+    // e.g. for bucket rendering. Needs to be set before buffers are requested
+    void setOutputWindowSize(Vec2u size)
+    {
+        _windowSize = size;
+    }
+
+    bool hasOutputWindow() const
+    {
+        return _windowSize.x() > 0 && _windowSize.y() > 0;
+    }
+
+    Vec2u bufferResolution() const
+    {
+        return hasOutputWindow() ? min(_windowSize, _res) : _res;
+    }
+
     const std::shared_ptr<Medium> &medium() const
     {
         return _medium;
@@ -1,6 +1,7 @@
 #ifndef OUTPUTBUFFER_HPP_
 #define OUTPUTBUFFER_HPP_
 
+#include "OutputBufferStorage.hpp"
 #include "OutputBufferSettings.hpp"
 
 #include "math/Vec.hpp"
@@ -10,9 +11,11 @@
 #include "io/FileUtils.hpp"
 #include "io/ImageIO.hpp"
 
-#include "Memory.hpp"
+#include "thread/ThreadUtils.hpp"
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 namespace Tungsten {
 
@@ -20,13 +23,16 @@ template<typename T>
 class OutputBuffer
 {
     Vec2u _res;
+    Vec2u _origin;
 
-    std::unique_ptr<T[]> _bufferA, _bufferB;
+    std::unique_ptr<OutputBufferStorage<T>> _bufferA, _bufferB;
     std::unique_ptr<float[]> _variance;
     std::unique_ptr<uint32[]> _sampleCount;
 
     const OutputBufferSettings &_settings;
 
+    std::unique_ptr<ImageIO::HdrBlockWriter> _windowWriter;
+
     inline float average(float x) const
     {
         return x;
@@ -54,9 +60,59 @@ class OutputBuffer
         return 3;
     }
 
+    // Blue-cyan-green-yellow-red color ramp for t in [0, 1]
+    static Vec3c heatmapColor(float t)
+    {
+        static const Vec3f ramp[] = {
+            Vec3f(0.0f, 0.0f, 1.0f),
+            Vec3f(0.0f, 1.0f, 1.0f),
+            Vec3f(0.0f, 1.0f, 0.0f),
+            Vec3f(1.0f, 1.0f, 0.0f),
+            Vec3f(1.0f, 0.0f, 0.0f),
+        };
+        float x = clamp(t, 0.0f, 1.0f)*4.0f;
+        int i = min(int(x), 3);
+        Vec3f c = lerp(ramp[i], ramp[i + 1], x - i);
+        return Vec3c(clamp(Vec3i(c*255.0f), Vec3i(0), Vec3i(255)));
+    }
+
+    // The channels of a cost buffer measure unrelated quantities, so each of
+    // them is saved as a separate heatmap. Pixels are normalized to the 99th
+    // percentile, so that a handful of outliers do not wash out the image
+    template<typename Texel>
+    void saveHeatmaps(const Texel *hdr, const Path &path) const
+    {
+        static const char *channelNames[] = {"Time", "Rays", "Length"};
+
+        uint32 pixelCount = _res.product();
+        int channels = elementCount(hdr[0]);
+        const float *values = elementPointer(hdr);
+
+        std::vector<float> sorted(pixelCount);
+        std::unique_ptr<Vec3c[]> ldr(new Vec3c[pixelCount]);
+        for (int c = 0; c < channels; ++c) {
+            for (uint32 i = 0; i < pixelCount; ++i)
+                sorted[i] = values[i*channels + c];
+            auto percentile = sorted.begin() + (pixelCount - 1)*99/100;
+            std::nth_element(sorted.begin(), percentile, sorted.end());
+            float maximum = max(*percentile, 1e-6f);
+
+            for (uint32 i = 0; i < pixelCount; ++i)
+                ldr[i] = heatmapColor(values[i*channels + c]/maximum);
+
+            Path channelPath = channels == 1 ? path : path.stripExtension() + channelNames[c] + path.extension();
+            ImageIO::saveLdr(channelPath, &ldr[0].x(), _res.x(), _res.y(), 3);
+        }
+    }
+
     template<typename Texel>
     void saveLdr(const Texel *hdr, const Path &path, bool rescale) const
     {
+        if (_settings.type() == OutputCost) {
+            saveHeatmaps(hdr, path);
+            return;
+        }
+
         uint32 pixelCount = _res.product();
         std::unique_ptr<Vec3c[]> ldr(new Vec3c[pixelCount]);
 
@@ -89,16 +145,19 @@ class OutputBuffer
 public:
     OutputBuffer(Vec2u res, const OutputBufferSettings &settings)
     : _res(res),
+      _origin(0u),
       _settings(settings)
     {
         size_t numPixels = res.product();
 
-        _bufferA = zeroAlloc<T>(numPixels);
+        // Zeroed in parallel, so that with pinned threads, each part
+        // of the image is placed on the NUMA node that renders it
+        _bufferA.reset(new OutputBufferStorage<T>(numPixels, settings.precision()));
         if (settings.twoBufferVariance())
-            _bufferB = zeroAlloc<T>(numPixels);
+            _bufferB.reset(new OutputBufferStorage<T>(numPixels, settings.precision()));
         if (settings.sampleVariance())
-            _variance = zeroAlloc<float>(numPixels);
-        _sampleCount = zeroAlloc<uint32>(numPixels);
+            _variance = ThreadUtils::parallelZeroAlloc<float>(numPixels);
+        _sampleCount = ThreadUtils::parallelZeroAlloc<uint32>(numPixels);
     }
 
     void addSample(Vec2u pixel, T c)
@@ -106,16 +165,16 @@ public:
         if (std::isnan(c))
             return;
 
-        int idx = pixel.x() + pixel.y()*_res.x();
+        int idx = (pixel.x() - _origin.x()) + (pixel.y() - _origin.y())*_res.x();
         uint32 sampleIdx = _sampleCount[idx]++;
         if (_variance) {
             T curr;
             if (_bufferB && sampleIdx > 0) {
                 uint32 sampleCountA = (sampleIdx + 1)/2;
                 uint32 sampleCountB = sampleIdx/2;
-                curr = (_bufferA[idx]*sampleCountA + _bufferB[idx]*sampleCountB)/sampleIdx;
+                curr = (_bufferA->get(idx)*sampleCountA + _bufferB->get(idx)*sampleCountB)/sampleIdx;
             } else {
-                curr = _bufferA[idx];
+                curr = _bufferA->get(idx);
             }
             T delta = c - curr;
             curr += delta/(sampleIdx + 1);
@@ -123,11 +182,10 @@ public:
         }
 
         if (_bufferB) {
-            T *feature = (sampleIdx & 1) ? _bufferB.get() : _bufferA.get();
-            uint32 perBufferSampleCount = sampleIdx/2 + 1;
-            feature[idx] += (c - feature[idx])/perBufferSampleCount;
+            OutputBufferStorage<T> &feature = (sampleIdx & 1) ? *_bufferB : *_bufferA;
+            feature.accumulate(idx, c, sampleIdx/2 + 1);
         } else {
-            _bufferA[idx] += (c - _bufferA[idx])/(sampleIdx + 1);
+            _bufferA->accumulate(idx, c, sampleIdx + 1);
         }
     }
 
@@ -137,9 +195,9 @@ public:
             uint32 sampleIdx = _sampleCount[idx];
             uint32 sampleCountA = (sampleIdx + 1)/2;
             uint32 sampleCountB = sampleIdx/2;
-            return (_bufferA[idx]*sampleCountA + _bufferB[idx]*sampleCountB)/float(max(sampleIdx, uint32(1)));
+            return (_bufferA->get(idx)*sampleCountA + _bufferB->get(idx)*sampleCountB)/float(max(sampleIdx, uint32(1)));
         } else {
-            return _bufferA[idx];
+            return _bufferA->get(idx);
         }
     }
 
@@ -155,26 +213,30 @@ public:
         Path hdrFileB = hdrFile.stripExtension() + "B" + hdrFile.extension();
 
         uint32 numPixels = _res.product();
+        std::unique_ptr<T[]> hdr(new T[numPixels]);
+        for (uint32 i = 0; i < numPixels; ++i)
+            hdr[i] = (*this)[i];
+
+        if (!hdrFile.empty())
+            ImageIO::saveHdr(hdrFile, elementPointer(hdr.get()), _res.x(), _res.y(), elementCount(hdr[0]));
+        if (!ldrFile.empty())
+            saveLdr(hdr.get(), ldrFile, true);
+
         if (_bufferB) {
-            std::unique_ptr<T[]> hdr(new T[numPixels]);
-            for (uint32 i = 0; i < numPixels; ++i)
-                hdr[i] = (*this)[i];
+            std::unique_ptr<T[]> hdrA(new T[numPixels]), hdrB(new T[numPixels]);
+            for (uint32 i = 0; i < numPixels; ++i) {
+                hdrA[i] = _bufferA->get(i);
+                hdrB[i] = _bufferB->get(i);
+            }
 
             if (!hdrFile.empty()) {
-                ImageIO::saveHdr(hdrFile,  elementPointer(hdr.get()),      _res.x(), _res.y(), elementCount(hdr[0]));
-                ImageIO::saveHdr(hdrFileA, elementPointer(_bufferA.get()), _res.x(), _res.y(), elementCount(_bufferA[0]));
-                ImageIO::saveHdr(hdrFileB, elementPointer(_bufferA.get()), _res.x(), _res.y(), elementCount(_bufferB[0]));
+                ImageIO::saveHdr(hdrFileA, elementPointer(hdrA.get()), _res.x(), _res.y(), elementCount(hdrA[0]));
+                ImageIO::saveHdr(hdrFileB, elementPointer(hdrB.get()), _res.x(), _res.y(), elementCount(hdrB[0]));
             }
             if (!ldrFile.empty()) {
-                saveLdr(hdr.get(), ldrFile, true);
-                saveLdr(_bufferA.get(), ldrFileA, true);
-                saveLdr(_bufferB.get(), ldrFileB, true);
+                saveLdr(hdrA.get(), ldrFileA, true);
+                saveLdr(hdrB.get(), ldrFileB, true);
             }
-        } else {
-            if (!hdrFile.empty())
-                ImageIO::saveHdr(hdrFile, elementPointer(_bufferA.get()), _res.x(), _res.y(), elementCount(_bufferA[0]));
-            if (!ldrFile.empty())
-                saveLdr(_bufferA.get(), ldrFile, true);
         }
         if (_variance) {
             std::unique_ptr<float[]> scaled(new float[numPixels]);
@@ -188,12 +250,56 @@ public:
         }
     }
 
+    // In bucket rendering, the buffer only holds a window of the image the
+    // size of one bucket. Samples are still added in image coordinates, and
+    // finished windows are streamed to the HDR output file of the buffer
+    bool openWindowOutput(Vec2u imageRes)
+    {
+        Path hdrFile = _settings.hdrOutputFile();
+        if (hdrFile.empty())
+            return true;
+        _windowWriter = ImageIO::openHdrBlockWriter(hdrFile, imageRes.x(), imageRes.y(),
+                elementCount(T()), _res.x());
+        return bool(_windowWriter);
+    }
+
+    void closeWindowOutput()
+    {
+        _windowWriter.reset();
+    }
+
+    void setWindow(Vec2u origin)
+    {
+        _origin = origin;
+        _bufferA->clear();
+        if (_bufferB)
+            _bufferB->clear();
+        if (_variance)
+            ThreadUtils::parallelZero(_variance.get(), _res.product()*sizeof(float));
+        ThreadUtils::parallelZero(_sampleCount.get(), _res.product()*sizeof(uint32));
+    }
+
+    // Writes the top left w x h pixels of the window, which may be smaller
+    // than the buffer at the right and bottom edges of the image
+    void saveWindow(uint32 w, uint32 h) const
+    {
+        if (!_windowWriter)
+            return;
+
+        std::unique_ptr<T[]> hdr(new T[w*h]);
+        for (uint32 y = 0; y < h; ++y)
+            for (uint32 x = 0; x < w; ++x)
+                hdr[x + y*w] = (*this)[x + y*_res.x()];
+
+        _windowWriter->writeBlock(elementPointer(hdr.get()), _origin.x(), _origin.y(), w, h);
+    }
+
     void deserialize(InputStreamHandle &in) const
     {
         size_t numPixels = _res.product();
-        FileUtils::streamRead(in, _bufferA.get(), numPixels);
+        _bufferA->deserialize(in);
         if (_bufferB)
-            FileUtils::streamRead(in, _bufferB.get(), numPixels);
+            _bufferB->deserialize(in);
         if (_variance)
             FileUtils::streamRead(in, _variance.get(), numPixels);
         FileUtils::streamRead(in, _sampleCount.get(), numPixels);
@@ -202,14 +308,19 @@ public:
     void serialize(OutputStreamHandle &out) const
     {
         size_t numPixels = _res.product();
-        FileUtils::streamWrite(out, _bufferA.get(), numPixels);
+        _bufferA->serialize(out);
         if (_bufferB)
-            FileUtils::streamWrite(out, _bufferB.get(), numPixels);
+            _bufferB->serialize(out);
         if (_variance)
             FileUtils::streamWrite(out, _variance.get(), numPixels);
         FileUtils::streamWrite(out, _sampleCount.get(), numPixels);
     }
 
+    inline uint32 sampleCount(uint32 idx) const
+    {
+        return _sampleCount[idx];
+    }
+
     inline float variance(int x, int y) const
     {
         return _variance[x + y*_res.x()]/max(uint32(1), _sampleCount[x + y*_res.x()] - 1);
@@ -10,11 +10,19 @@ DEFINE_STRINGABLE_ENUM(OutputBufferSettings::Type, "output buffer type", ({
     {"depth", OutputDepth},
     {"normal", OutputNormal},
     {"albedo", OutputAlbedo},
-    {"visibility", OutputVisibility}
+    {"visibility", OutputVisibility},
+    {"cost", OutputCost}
+}))
+
+DEFINE_STRINGABLE_ENUM(OutputBufferSettings::Precision, "output buffer precision", ({
+    {"half_checkpoint", PrecisionHalfCheckpoint},
+    {"float", PrecisionFloat},
+    {"double", PrecisionDouble}
 }))
 
 OutputBufferSettings::OutputBufferSettings()
 : _type("color"),
+  _precision("float"),
   _twoBufferVariance(false),
   _sampleVariance(false)
 {
@@ -23,6 +31,7 @@ OutputBufferSettings::OutputBufferSettings()
 void OutputBufferSettings::fromJson(JsonPtr value, const Scene &/*scene*/)
 {
     _type = value.getRequiredMember("type");
+    _precision = value["precision"];
     value.getField("ldr_output_file", _ldrOutputFile);
     value.getField("hdr_output_file", _hdrOutputFile);
     value.getField("two_buffer_variance", _twoBufferVariance);
@@ -35,7 +44,8 @@ rapidjson::Value OutputBufferSettings::toJson(Allocator &allocator) const
         "two_buffer_variance", _twoBufferVariance,
         "sample_variance", _sampleVariance
     };
-    result.add("type", _type.toString());
+    result.add("type", _type.toString(),
+               "precision", _precision.toString());
     if (!_ldrOutputFile.empty())
         result.add("output_file", _ldrOutputFile);
     if (!_hdrOutputFile.empty())
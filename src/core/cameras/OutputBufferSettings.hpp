@@ -15,14 +15,31 @@ enum OutputBufferTypeEnum
     OutputNormal     = 2,
     OutputAlbedo     = 3,
     OutputVisibility = 4,
+    // Per sample cost: nanoseconds, rays cast and path segments traced
+    OutputCost       = 5,
+};
+
+enum OutputBufferPrecisionEnum
+{
+    // Accumulates in single precision like PrecisionFloat, but writes half
+    // precision resume checkpoints, which are half the size. Memory use is
+    // the same as PrecisionFloat. Checkpointed values above 65504 turn into
+    // infinity, so depth buffers should stay in float
+    PrecisionHalfCheckpoint = 0,
+    PrecisionFloat          = 1,
+    // Keeps running means accurate at very high sample counts
+    PrecisionDouble         = 2,
 };
 
 class OutputBufferSettings : public JsonSerializable
 {
     typedef StringableEnum<OutputBufferTypeEnum> Type;
+    typedef StringableEnum<OutputBufferPrecisionEnum> Precision;
     friend Type;
+    friend Precision;
 
     Type _type;
+    Precision _precision;
     Path _ldrOutputFile;
     Path _hdrOutputFile;
     Path _outputDirectory;
@@ -52,6 +69,11 @@ public:
         return _type;
     }
 
+    Precision precision() const
+    {
+        return _precision;
+    }
+
     bool twoBufferVariance() const
     {
         return _twoBufferVariance;
@@ -0,0 +1,124 @@
+#ifndef OUTPUTBUFFERSTORAGE_HPP_
+#define OUTPUTBUFFERSTORAGE_HPP_
+
+#include "OutputBufferSettings.hpp"
+
+#include "math/MathUtil.hpp"
+#include "math/Half.hpp"
+
+#include "io/FileUtils.hpp"
+
+#include "thread/ThreadUtils.hpp"
+
+#include "IntTypes.hpp"
+
+#include <memory>
+
+namespace Tungsten {
+
+// Per pixel running means of an output buffer in the precision selected in the
+// buffer settings. Values are always passed in and out in single precision.
+// Buffers with half precision checkpoints accumulate in single precision, since
+// a running mean stored in half stops converging after a few thousand samples;
+// they are only rounded to half when written to a resume checkpoint
+template<typename T>
+class OutputBufferStorage
+{
+    static_assert(sizeof(T) % sizeof(float) == 0, "Output buffer elements must consist of floats");
+    static CONSTEXPR size_t Channels = sizeof(T)/sizeof(float);
+    static CONSTEXPR size_t HalfChunkSize = 64*1024;
+
+    size_t _numElements;
+    bool _halfCheckpoint;
+    std::unique_ptr<float[]> _float;
+    std::unique_ptr<double[]> _double;
+
+public:
+    OutputBufferStorage(size_t numPixels, OutputBufferPrecisionEnum precision)
+    : _numElements(numPixels*Channels),
+      _halfCheckpoint(precision == PrecisionHalfCheckpoint)
+    {
+        if (precision == PrecisionDouble)
+            _double = ThreadUtils::parallelZeroAlloc<double>(_numElements);
+        else
+            _float = ThreadUtils::parallelZeroAlloc<float>(_numElements);
+    }
+
+    void clear()
+    {
+        if (_float)
+            ThreadUtils::parallelZero(_float.get(), _numElements*sizeof(float));
+        else
+            ThreadUtils::parallelZero(_double.get(), _numElements*sizeof(double));
+    }
+
+    T get(size_t idx) const
+    {
+        T result;
+        float *dst = reinterpret_cast<float *>(&result);
+        const size_t base = idx*Channels;
+        if (_float) {
+            for (size_t i = 0; i < Channels; ++i)
+                dst[i] = _float[base + i];
+        } else {
+            for (size_t i = 0; i < Channels; ++i)
+                dst[i] = float(_double[base + i]);
+        }
+        return result;
+    }
+
+    // Moves the running mean of a pixel towards c by 1/sampleCount
+    void accumulate(size_t idx, const T &c, uint32 sampleCount)
+    {
+        const float *src = reinterpret_cast<const float *>(&c);
+        const size_t base = idx*Channels;
+        if (_float) {
+            for (size_t i = 0; i < Channels; ++i)
+                _float[base + i] += (src[i] - _float[base + i])/sampleCount;
+        } else {
+            for (size_t i = 0; i < Channels; ++i)
+                _double[base + i] += (double(src[i]) - _double[base + i])/sampleCount;
+        }
+    }
+
+    void deserialize(InputStreamHandle &in)
+    {
+        if (_halfCheckpoint) {
+            std::unique_ptr<Half[]> chunk(new Half[min(_numElements, HalfChunkSize)]);
+            for (size_t i = 0; i < _numElements; i += HalfChunkSize) {
+                size_t n = min(_numElements - i, HalfChunkSize);
+                FileUtils::streamRead(in, chunk.get(), n);
+                for (size_t j = 0; j < n; ++j)
+                    _float[i + j] = float(chunk[j]);
+            }
+        } else if (_float) {
+            FileUtils::streamRead(in, _float.get(), _numElements);
+        } else {
+            FileUtils::streamRead(in, _double.get(), _numElements);
+        }
+    }
+
+    void serialize(OutputStreamHandle &out) const
+    {
+        if (_halfCheckpoint) {
+            std::unique_ptr<Half[]> chunk(new Half[min(_numElements, HalfChunkSize)]);
+            for (size_t i = 0; i < _numElements; i += HalfChunkSize) {
+                size_t n = min(_numElements - i, HalfChunkSize);
+                for (size_t j = 0; j < n; ++j)
+                    chunk[j] = Half(_float[i + j]);
+                FileUtils::streamWrite(out, chunk.get(), n);
+            }
+        } else if (_float) {
+            FileUtils::streamWrite(out, _float.get(), _numElements);
+        } else {
+            FileUtils::streamWrite(out, _double.get(), _numElements);
+        }
+    }
+};
+
+template<typename T>
+CONSTEXPR size_t OutputBufferStorage<T>::HalfChunkSize;
+
+}
+
+#endif /* OUTPUTBUFFERSTORAGE_HPP_ */
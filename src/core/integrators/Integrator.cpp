@@ -4,8 +4,6 @@
 
 #include "cameras/Camera.hpp"
 
-#include "math/BitManip.hpp"
-
 #include "io/JsonDocument.hpp"
 #include "io/FileUtils.hpp"
 #include "io/ImageIO.hpp"
@@ -13,9 +11,7 @@
 
 #include "Timer.hpp"
 
-#include <rapidjson/stringbuffer.h>
 #include <rapidjson/document.h>
-#include <rapidjson/writer.h>
 #include <lodepng/lodepng.h>
 #include <algorithm>
 
@@ -40,7 +36,8 @@ static Path incrementalFilename(const Path &dstFile, const std::string &suffix,
 Integrator::Integrator()
 : _scene(nullptr),
   _currentSpp(0),
-  _nextSpp(0)
+  _nextSpp(0),
+  _previewFocus(0.5f)
 {
 }
 
@@ -55,6 +52,16 @@ void Integrator::advanceSpp()
 
 void Integrator::writeBuffers(const std::string &suffix, bool overwrite)
 {
+    // Bucket renders stream out every bucket as soon as it is finished. If the
+    // render is stopped early, only the partially rendered bucket remains
+    if (_scene->cam().hasOutputWindow()) {
+        if (suffix.empty()) {
+            _scene->cam().saveOutputWindow();
+            _scene->cam().closeWindowOutputs();
+        }
+        return;
+    }
+
     Vec2u res = _scene->cam().resolution();
     std::unique_ptr<Vec3f[]> hdr(new Vec3f[res.product()]);
     std::unique_ptr<Vec3c[]> ldr(new Vec3c[res.product()]);
@@ -89,22 +96,6 @@ void Integrator::saveCheckpoint()
     writeBuffers("_checkpoint", true);
 }
 
-// Computes a hash of everything in the scene except the renderer settings
-// This is done by serializing everything to JSON and hashing the resulting string
-static uint64 sceneHash(Scene &scene)
-{
-    rapidjson::Document document;
-    document.SetObject();
-    *(static_cast<rapidjson::Value *>(&document)) = scene.toJson(document.GetAllocator());
-    document.RemoveMember("renderer");
-
-    rapidjson::GenericStringBuffer<rapidjson::UTF8<>> buffer;
-    rapidjson::Writer<rapidjson::GenericStringBuffer<rapidjson::UTF8<>>> jsonWriter(buffer);
-    document.Accept(jsonWriter);
-
-    return BitManip::hash(buffer.GetString());
-}
-
 void Integrator::saveRenderResumeData(Scene &scene)
 {
     Path path = _scene->rendererSettings().resumeRenderFile();
@@ -114,7 +105,6 @@ void Integrator::saveRenderResumeData(Scene &scene)
         return;
     }
 
-    // TODO: Camera splat buffer not saved/reconstructed
     rapidjson::Document document;
     document.SetObject();
     document.AddMember("current_spp", _currentSpp, document.GetAllocator());
@@ -122,7 +112,7 @@ void Integrator::saveRenderResumeData(Scene &scene)
     document.AddMember("stratified_sampler", _scene->rendererSettings().useSobol(), document.GetAllocator());
 
     FileUtils::streamWrite(out, JsonUtils::jsonToString(document));
-    uint64 jsonHash = sceneHash(scene);
+    uint64 jsonHash = scene.contentHash();
     FileUtils::streamWrite(out, jsonHash);
     _scene->cam().serializeOutputBuffers(out);
     saveState(out);
@@ -130,7 +120,7 @@ void Integrator::saveRenderResumeData(Scene &scene)
 
 bool Integrator::resumeRender(Scene &scene)
 {
-    const Path &file = _scene->rendererSettings().resumeRenderFile();
+    Path file = _scene->rendererSettings().resumeRenderFile();
     InputStreamHandle in = FileUtils::openInputStream(file);
     if (!in)
         return false;
@@ -149,7 +139,7 @@ bool Integrator::resumeRender(Scene &scene)
 
     uint64 jsonHash;
     FileUtils::streamRead(in, jsonHash);
-    if (jsonHash != sceneHash(scene))
+    if (jsonHash != scene.contentHash())
         return false;
 
     _scene->cam().deserializeOutputBuffers(in);
@@ -166,4 +156,9 @@ bool Integrator::supportsResumeRender() const
     return false;
 }
 
+bool Integrator::supportsBucketRendering() const
+{
+    return false;
+}
+
 }
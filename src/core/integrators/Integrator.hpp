@@ -4,6 +4,8 @@
 #include "io/JsonSerializable.hpp"
 #include "io/FileUtils.hpp"
 
+#include "math/Vec.hpp"
+
 #include "IntTypes.hpp"
 
 #include <functional>
@@ -21,6 +23,8 @@ protected:
     uint32 _currentSpp;
     uint32 _nextSpp;
 
+    Vec2f _previewFocus;
+
     void advanceSpp();
 
     void writeBuffers(const std::string &suffix, bool overwrite);
@@ -45,6 +49,14 @@ public:
     void saveRenderResumeData(Scene &scene);
     bool resumeRender(Scene &scene);
     virtual bool supportsResumeRender() const;
+    virtual bool supportsBucketRendering() const;
+
+    // Position in the image, in [0, 1] image coordinates, that progressive
+    // preview passes start from. Defaults to the image centre
+    void setPreviewFocus(Vec2f focus)
+    {
+        _previewFocus = focus;
+    }
 
     bool done() const
     {
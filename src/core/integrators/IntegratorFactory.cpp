@@ -6,6 +6,7 @@
 #include "kelemen_mlt/KelemenMltIntegrator.hpp"
 #include "path_tracer/PathTraceIntegrator.hpp"
 #include "photon_map/PhotonMapIntegrator.hpp"
+#include "vcm/VcmIntegrator.hpp"
 
 namespace Tungsten {
 
@@ -16,6 +17,7 @@ DEFINE_STRINGABLE_ENUM(IntegratorFactory, "integrator", ({
     {"progressive_photon_map", std::make_shared<ProgressivePhotonMapIntegrator>},
     {"bidirectional_path_tracer", std::make_shared<BidirectionalPathTraceIntegrator>},
     {"kelemen_mlt", std::make_shared<KelemenMltIntegrator>},
+    {"vcm", std::make_shared<VcmIntegrator>},
 }))
 
 }
@@ -0,0 +1,56 @@
+#ifndef SAMPLECOST_HPP_
+#define SAMPLECOST_HPP_
+
+#include "renderer/TraceableScene.hpp"
+
+#include "cameras/OutputBuffer.hpp"
+
+#include "math/Vec.hpp"
+
+#include "IntTypes.hpp"
+
+#include <chrono>
+
+namespace Tungsten {
+
+// Measures the cost of individual camera samples and records it into the
+// render cost buffer: wall clock nanoseconds, rays cast (including shadow
+// rays and any light subpaths) and path segments traced. Does nothing
+// unless the camera has a cost buffer
+class SampleCost
+{
+    typedef std::chrono::steady_clock Clock;
+
+    OutputBufferVec3f *_buffer;
+    Clock::time_point _start;
+    TraceableScene::RayCount _rays;
+
+public:
+    SampleCost(OutputBufferVec3f *buffer)
+    : _buffer(buffer)
+    {
+    }
+
+    void start()
+    {
+        if (_buffer) {
+            _rays = TraceableScene::threadRayCount();
+            _start = Clock::now();
+        }
+    }
+
+    void stop(Vec2u pixel)
+    {
+        if (_buffer) {
+            double ns = std::chrono::duration<double, std::nano>(Clock::now() - _start).count();
+            const TraceableScene::RayCount &rays = TraceableScene::threadRayCount();
+            uint64 pathRays = rays.pathRays - _rays.pathRays;
+            uint64 shadowRays = rays.shadowRays - _rays.shadowRays;
+            _buffer->addSample(pixel, Vec3f(float(ns), float(pathRays + shadowRays), float(pathRays)));
+        }
+    }
+};
+
+}
+
+#endif /* SAMPLECOST_HPP_ */
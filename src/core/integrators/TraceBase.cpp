@@ -70,13 +70,22 @@ inline Vec3f TraceBase::generalizedShadowRayImpl(PathSampleGenerator &sampler,
                            float &pdfForward,
                            float &pdfBackward) const
 {
+    // Most shadow rays are decided by an opaque blocker, which an any-hit
+    // query finds much more cheaply. Closest hits only need to be processed
+    // if the ray passes through transparent surfaces or a medium
+    bool hitTransparent;
+    if (_scene->occludedByOpaque(ray, endCap, hitTransparent))
+        return Vec3f(0.0f);
+    if (!hitTransparent && !medium)
+        return bounce >= _settings.minBounces ? Vec3f(1.0f) : Vec3f(0.0f);
+
     IntersectionTemporary data;
     IntersectionInfo info;
 
     float initialFarT = ray.farT();
     Vec3f throughput(1.0f);
     do {
-        bool didHit = _scene->intersect(ray, data, info) && info.primitive != endCap;
+        bool didHit = _scene->intersectShadow(ray, data, info) && info.primitive != endCap;
         if (didHit) {
             if (!info.bsdf->lobes().hasForward())
                 return Vec3f(0.0f);
@@ -495,6 +504,8 @@ bool TraceBase::handleVolume(PathSampleGenerator &sampler, MediumSample &mediumS
            const Medium *&medium, int bounce, bool adjoint, bool enableLightSampling,
            Ray &ray, Vec3f &throughput, Vec3f &emission, bool &wasSpecular)
 {
+    RENDER_STAT(RenderStatistics::MediumScatterEvents);
+
     wasSpecular = !enableLightSampling;
 
     if (!adjoint && enableLightSampling && bounce < _settings.maxBounces - 1)
@@ -515,7 +526,8 @@ bool TraceBase::handleSurface(SurfaceScatterEvent &event, IntersectionTemporary
                               IntersectionInfo &info, const Medium *&medium,
                               int bounce, bool adjoint, bool enableLightSampling, Ray &ray,
                               Vec3f &throughput, Vec3f &emission, bool &wasSpecular,
-                              Medium::MediumState &state, Vec3f *transmittance)
+                              Medium::MediumState &state, Vec3f *transmittance,
+                              SurfaceDirectionSampler *directionSampler)
 {
     const Bsdf &bsdf = *info.bsdf;
 
@@ -541,9 +553,14 @@ bool TraceBase::handleSurface(SurfaceScatterEvent &event, IntersectionTemporary
             }
         }
 
-        event.requestedLobe = BsdfLobes::AllLobes;
-        if (!bsdf.sample(event, adjoint))
-            return false;
+        if (directionSampler) {
+            if (!directionSampler->sampleDirection(event, info))
+                return false;
+        } else {
+            event.requestedLobe = BsdfLobes::AllLobes;
+            if (!bsdf.sample(event, adjoint))
+                return false;
+        }
 
         wo = event.frame.toGlobal(event.wo);
 
@@ -30,6 +30,17 @@
 
 namespace Tungsten {
 
+// Replaces BSDF sampling of the scattered direction in TraceBase::handleSurface,
+// e.g. to sample from a learned guiding distribution. The sampled event needs
+// the same weight and pdf conventions as Bsdf::sample
+class SurfaceDirectionSampler
+{
+public:
+    virtual ~SurfaceDirectionSampler() = default;
+
+    virtual bool sampleDirection(SurfaceScatterEvent &event, const IntersectionInfo &info) = 0;
+};
+
 class TraceBase
 {
 protected:
@@ -167,7 +178,8 @@ public:
                IntersectionInfo &info, const Medium *&medium,
                int bounce, bool adjoint, bool enableLightSampling, Ray &ray,
                Vec3f &throughput, Vec3f &emission, bool &wasSpecular,
-               Medium::MediumState &state, Vec3f *transmittance = nullptr);
+               Medium::MediumState &state, Vec3f *transmittance = nullptr,
+               SurfaceDirectionSampler *directionSampler = nullptr);
 
     void handleInfiniteLights(IntersectionTemporary &data,
             IntersectionInfo &info, bool enableLightSampling, Ray &ray,
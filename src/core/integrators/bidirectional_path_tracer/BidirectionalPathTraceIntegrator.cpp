@@ -1,5 +1,7 @@
 #include "BidirectionalPathTraceIntegrator.hpp"
 
+#include "integrators/SampleCost.hpp"
+
 #include "sampling/SobolPathSampler.hpp"
 
 #include "cameras/Camera.hpp"
@@ -34,11 +36,17 @@ void BidirectionalPathTraceIntegrator::diceTiles()
             );
         }
     }
+    _tileQueue.init(uint32(_tiles.size()));
 }
 
-void BidirectionalPathTraceIntegrator::renderTile(uint32 id, uint32 tileId)
+void BidirectionalPathTraceIntegrator::renderTile(uint32 id)
 {
+    uint32 tileId;
+    if (!_tileQueue.pop(id, tileId))
+        return;
+
     int spp = _nextSpp - _currentSpp;
+    SampleCost cost(_scene->cam().costBuffer());
 
     ImageTile &tile = _tiles[tileId];
     for (uint32 y = 0; y < tile.h; ++y) {
@@ -48,8 +56,10 @@ void BidirectionalPathTraceIntegrator::renderTile(uint32 id, uint32 tileId)
 
             for (int i = 0; i < spp; ++i) {
                 uint32 lightPathId = pixelIndex*_scene->rendererSettings().spp() + _currentSpp + i;
+                cost.start();
                 tile.sampler->startPath(pixelIndex, _currentSpp + i);
                 Vec3f c = _tracers[id]->traceSample(pixel, lightPathId, *tile.sampler);
+                cost.stop(pixel);
 
                 _scene->cam().colorBuffer()->addSample(pixel, c);
             }
@@ -121,9 +131,11 @@ void BidirectionalPathTraceIntegrator::startRender(std::function<void()> complet
 
     _scene->cam().setSplatWeight(1.0/(_w*_h*_nextSpp));
 
+    _tileQueue.reset();
+
     using namespace std::placeholders;
     _group = ThreadUtils::pool->enqueue(
-        std::bind(&BidirectionalPathTraceIntegrator::renderTile, this, _3, _1),
+        std::bind(&BidirectionalPathTraceIntegrator::renderTile, this, _3),
         _tiles.size(),
         [&, completionCallback]() {
             _currentSpp = _nextSpp;
@@ -11,6 +11,7 @@
 #include "sampling/UniformPathSampler.hpp"
 #include "sampling/UniformSampler.hpp"
 
+#include "thread/NumaWorkQueue.hpp"
 #include "thread/TaskGroup.hpp"
 
 #include "math/MathUtil.hpp"
@@ -37,10 +38,11 @@ class BidirectionalPathTraceIntegrator : public Integrator
     std::vector<std::unique_ptr<BidirectionalPathTracer>> _tracers;
 
     std::vector<ImageTile> _tiles;
+    NumaWorkQueue _tileQueue;
 
     void diceTiles();
 
-    void renderTile(uint32 id, uint32 tileId);
+    void renderTile(uint32 id);
 
     virtual void saveState(OutputStreamHandle &out) override;
     virtual void loadState(InputStreamHandle &in) override;
@@ -94,60 +94,113 @@ void LightPath::toAreaMeasure()
 }
 
 float LightPath::misWeight(const LightPath &camera, const LightPath &emitter,
-            const PathEdge &edge, int s, int t)
+            const PathEdge &edge, int s, int t, float mergeArea, bool merging)
 {
-    float *pdfForward  = reinterpret_cast<float *>(alloca((s + t)*sizeof(float)));
-    float *pdfBackward = reinterpret_cast<float *>(alloca((s + t)*sizeof(float)));
-    bool  *connectable = reinterpret_cast<bool  *>(alloca((s + t)*sizeof(bool)));
+    int n = s + t;
+    float *pdfForward  = reinterpret_cast<float *>(alloca(n*sizeof(float)));
+    float *pdfBackward = reinterpret_cast<float *>(alloca(n*sizeof(float)));
+    float *ratio       = reinterpret_cast<float *>(alloca(n*sizeof(float)));
+    bool  *connectable = reinterpret_cast<bool  *>(alloca(n*sizeof(bool)));
+    bool  *mergeable   = reinterpret_cast<bool  *>(alloca(n*sizeof(bool)));
 
     for (int i = 0; i < s; ++i) {
         pdfForward [i] = emitter[i].pdfForward();
         pdfBackward[i] = emitter[i].pdfBackward();
         connectable[i] = !emitter[i].isDirac();
+        mergeable  [i] = emitter[i].onSurface();
     }
     for (int i = 0; i < t; ++i) {
-        pdfForward [s + t - (i + 1)] = camera[i].pdfBackward();
-        pdfBackward[s + t - (i + 1)] = camera[i].pdfForward();
-        connectable[s + t - (i + 1)] = !camera[i].isDirac();
+        pdfForward [n - (i + 1)] = camera[i].pdfBackward();
+        pdfBackward[n - (i + 1)] = camera[i].pdfForward();
+        connectable[n - (i + 1)] = !camera[i].isDirac();
+        mergeable  [n - (i + 1)] = camera[i].onSurface();
     }
-    connectable[s - 1] = connectable[s] = true;
+    // When merging, the camera subpath leaves camera[t - 1] the way it was sampled
+    connectable[s - 1] = true;
+    if (!merging)
+        connectable[s] = true;
 
     emitter[s - 1].evalPdfs(s == 1 ? nullptr : &emitter[s - 2],
                             s == 1 ? nullptr : &emitter.edge(s - 2),
                             camera[t - 1], edge, &pdfForward[s],
                             s == 1 ? nullptr : &pdfBackward[s - 2]);
-    camera[t - 1].evalPdfs(t == 1 ? nullptr : &camera[t - 2],
-                           t == 1 ? nullptr : &camera.edge(t - 2),
-                           emitter[s - 1], edge.reverse(), &pdfBackward[s - 1],
-                           t == 1 ? nullptr : &pdfForward[s + 1]);
+    if (merging) {
+        // The merged vertex stands in for camera[t], so the camera subpath
+        // densities stored during tracing still apply
+        pdfBackward[s - 1] = camera[t].pdfForward();
+    } else {
+        camera[t - 1].evalPdfs(t == 1 ? nullptr : &camera[t - 2],
+                               t == 1 ? nullptr : &camera.edge(t - 2),
+                               emitter[s - 1], edge.reverse(), &pdfBackward[s - 1],
+                               t == 1 ? nullptr : &pdfForward[s + 1]);
+    }
+
+    auto invGeometryFactor = [&](int i) {
+        if (i < s - 1)
+            return emitter.invGeometryFactor(i);
+        else if (i >= s)
+            return camera.invGeometryFactor(n - 2 - i);
+        else
+            return edge.rSq/(emitter[s - 1].cosineFactor(edge.d)*camera[t - 1].cosineFactor(edge.d));
+    };
 
     // Convert densities of dirac vertices sampled from non-dirac vertices to projected solid angle measure
     if (connectable[0] && !connectable[1] && !emitter[0].isInfiniteEmitter())
-        pdfForward[1] *= emitter.invGeometryFactor(0);
-    for (int i = 1; i < s + t - 1; ++i)
+        pdfForward[1] *= invGeometryFactor(0);
+    for (int i = 1; i < n - 1; ++i)
         if (connectable[i] && !connectable[i + 1])
-            pdfForward[i + 1] *= (i < s) ? emitter.invGeometryFactor(i) : camera.invGeometryFactor(s + t - 2 - i);
-    for (int i = s + t - 1; i >= 1; --i)
+            pdfForward[i + 1] *= invGeometryFactor(i);
+    for (int i = n - 1; i >= 1; --i)
         if (connectable[i] && !connectable[i - 1])
-            pdfBackward[i - 1] *= (i < s) ? emitter.invGeometryFactor(i - 1) : camera.invGeometryFactor(s + t - 1 - i);
-
-    float weight = 1.0f;
-    float pi = 1.0f;
-    for (int i = s + 1; i < s + t; ++i) {
-        pi *= pdfForward[i - 1]/pdfBackward[i - 1];
+            pdfBackward[i - 1] *= invGeometryFactor(i - 1);
+
+    // Densities of all connection techniques relative to connecting vertices s - 1 and s,
+    // where technique i samples the first i vertices from the emitter
+    ratio[s] = 1.0f;
+    for (int i = s + 1; i < n; ++i)
+        ratio[i] = ratio[i - 1]*pdfForward[i - 1]/pdfBackward[i - 1];
+    for (int i = s - 1; i >= 0; --i)
+        ratio[i] = ratio[i + 1]*pdfBackward[i]/pdfForward[i];
+
+    // Merging at vertex i samples both subpaths up to and including i, and accepts
+    // the camera vertex if it lands within the merge radius. Both expressions are
+    // the same; they are picked to avoid dividing by the density of vertex i
+    auto mergeRatio = [&](int i) {
+        if (i < s)
+            return ratio[i + 1]*pdfBackward[i]*mergeArea;
+        else
+            return ratio[i]*pdfForward[i]*mergeArea;
+    };
+
+    float weight = emitter[0].emitter()->isDirac() ? 0.0f : ratio[0];
+    for (int i = 1; i < n; ++i)
         if (connectable[i - 1] && connectable[i])
-            weight += pi;
+            weight += ratio[i];
+    if (mergeArea > 0.0f)
+        for (int i = 1; i < n - 1; ++i)
+            if (connectable[i] && mergeable[i])
+                weight += mergeRatio(i);
+
+    return (merging ? mergeRatio(s - 1) : 1.0f)/weight;
+}
+
+void LightPath::copy(const LightPath &o)
+{
+    if (_maxLength < o._length) {
+        _maxLength = o._length;
+        _vertexIndex.reset(new int[_maxLength + 4]);
+        _vertices.reset(new PathVertex[_maxLength + 4]);
+        _edges.reset(new PathEdge[_maxLength + 4]);
     }
-    pi = 1.0f;
-    for (int i = s - 1; i >= 1; --i) {
-        pi *= pdfBackward[i]/pdfForward[i];
-        if (connectable[i - 1] && connectable[i])
-            weight += pi;
+    _length = o._length;
+    _adjoint = o._adjoint;
+    for (int i = 0; i < _length; ++i) {
+        _vertexIndex[i] = o._vertexIndex[i];
+        _vertices[i] = o._vertices[i];
+        _edges[i] = o._edges[i];
+        if (i > 0 && _vertices[i].onSurface())
+            _vertices[i].pointerFixup();
     }
-    if (!emitter[0].emitter()->isDirac())
-        weight += pi*pdfBackward[0]/pdfForward[0];
-
-    return 1.0f/weight;
 }
 
 void LightPath::tracePath(const TraceableScene &scene, TraceBase &tracer, PathSampleGenerator &sampler, int length)
@@ -176,7 +229,7 @@ void LightPath::tracePath(const TraceableScene &scene, TraceBase &tracer, PathSa
     toAreaMeasure();
 }
 
-Vec3f LightPath::bdptWeightedPathEmission(int minLength, int maxLength) const
+Vec3f LightPath::bdptWeightedPathEmission(int minLength, int maxLength, float mergeArea) const
 {
     // TODO: Naive, slow version to make sure it's correct. Optimize this
 
@@ -245,6 +298,8 @@ Vec3f LightPath::bdptWeightedPathEmission(int minLength, int maxLength) const
             pi *= pdfForward[i - 1]/pdfBackward[i - 1];
             if (connectable[i - 1] && connectable[i])
                 weight += pi;
+            if (mergeArea > 0.0f && i < t - 1 && connectable[i] && _vertices[t - 1 - i].onSurface())
+                weight += pi*pdfForward[i]*mergeArea;
         }
 
         result += _vertices[t - 1].throughput()*emission/weight;
@@ -254,7 +309,7 @@ Vec3f LightPath::bdptWeightedPathEmission(int minLength, int maxLength) const
 }
 
 Vec3f LightPath::bdptConnect(const TraceBase &tracer, const LightPath &camera, const LightPath &emitter,
-        int s, int t, int maxBounce, PathSampleGenerator &sampler)
+        int s, int t, int maxBounce, PathSampleGenerator &sampler, float mergeArea)
 {
     const PathVertex &a = emitter[s - 1];
     const PathVertex &b = camera[t - 1];
@@ -281,7 +336,7 @@ Vec3f LightPath::bdptConnect(const TraceBase &tracer, const LightPath &camera, c
 
         Vec3f unweightedContrib = transmittance*a.throughput()*a.eval(d, true)*b.eval(-d, false)*b.throughput();
 
-        return unweightedContrib*misWeight(camera, emitter, edge, s, t);
+        return unweightedContrib*misWeight(camera, emitter, edge, s, t, mergeArea);
     } else {
         PathEdge edge(a, b);
         // Catch the case where both vertices land on the same surface
@@ -295,12 +350,13 @@ Vec3f LightPath::bdptConnect(const TraceBase &tracer, const LightPath &camera, c
 
         Vec3f unweightedContrib = transmittance*a.throughput()*a.eval(edge.d, true)*b.eval(-edge.d, false)*b.throughput()/edge.rSq;
 
-        return unweightedContrib*misWeight(camera, emitter, edge, s, t);
+        return unweightedContrib*misWeight(camera, emitter, edge, s, t, mergeArea);
     }
 }
 
 bool LightPath::bdptCameraConnect(const TraceBase &tracer, const LightPath &camera, const LightPath &emitter,
-        int s, int maxBounce, PathSampleGenerator &sampler, Vec3f &weight, Vec2f &pixel)
+        int s, int maxBounce, PathSampleGenerator &sampler, Vec3f &weight, Vec2f &pixel,
+        float mergeArea)
 {
     const PathVertex &a = emitter[s - 1];
     const PathVertex &b = camera[0];
@@ -325,9 +381,33 @@ bool LightPath::bdptCameraConnect(const TraceBase &tracer, const LightPath &came
         return false;
 
     weight = transmittance*splatWeight*b.throughput()*a.eval(edge.d, true)*a.throughput()/edge.rSq;
-    weight *= misWeight(camera, emitter, edge, s, 1);
+    weight *= misWeight(camera, emitter, edge, s, 1, mergeArea);
 
     return true;
 }
 
+Vec3f LightPath::vcmMerge(const LightPath &camera, const LightPath &emitter, int s, int t,
+        int maxBounce, float mergeArea)
+{
+    const PathVertex &a = emitter[s - 1];
+    const PathVertex &b = camera[t - 1];
+
+    // The merged vertex counts as a single bounce
+    int bounce = emitter.vertexIndex(s - 1) + camera.vertexIndex(t - 1) - 1;
+    if (bounce >= maxBounce)
+        return Vec3f(0.0f);
+
+    // The light arriving at the emitter vertex is reflected by the BSDF of the
+    // camera vertex. The BSDF includes the cosine term, which a density estimate
+    // must not, so it is divided out again
+    Vec3f d = -emitter.edge(s - 2).d;
+    float cosine = std::abs(b.surfaceRecord().event.frame.toLocal(d).z());
+    if (cosine < 1e-5f)
+        return Vec3f(0.0f);
+
+    Vec3f unweightedContrib = a.throughput()*b.eval(d, false)*b.throughput()/(cosine*mergeArea);
+
+    return unweightedContrib*misWeight(camera, emitter, camera.edge(t - 2).reverse(), s, t - 1, mergeArea, true);
+}
+
 }
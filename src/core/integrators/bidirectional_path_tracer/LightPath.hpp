@@ -22,8 +22,12 @@ class LightPath
 
     void toAreaMeasure();
 
+    // Weight of the path formed by emitter[0..s-1] and camera[0..t-1]. A non-zero
+    // merge area adds vertex merging techniques at all mergeable vertices.
+    // When merging is set, the path was formed by merging emitter[s - 1] with
+    // camera[t], and camera[t - 1] is joined to emitter[s - 1] through edge
     static float misWeight(const LightPath &camera, const LightPath &emitter,
-            const PathEdge &edge, int s, int t);
+            const PathEdge &edge, int s, int t, float mergeArea = 0.0f, bool merging = false);
 
 public:
     LightPath(int maxLength)
@@ -41,6 +45,8 @@ public:
         _length = 0;
     }
 
+    void copy(const LightPath &o);
+
     void startCameraPath(const Camera *camera, Vec2u pixel)
     {
         _vertices[0] = PathVertex(camera, pixel);
@@ -90,12 +96,20 @@ public:
         return _vertexIndex[i];
     }
 
-    Vec3f bdptWeightedPathEmission(int minLength, int maxLength) const;
+    // The merge area (pi*r^2 times the number of light paths) is non-zero when
+    // the paths are used by vertex connection and merging, which adds merging
+    // techniques to the MIS weights
+    Vec3f bdptWeightedPathEmission(int minLength, int maxLength, float mergeArea = 0.0f) const;
 
     static Vec3f bdptConnect(const TraceBase &tracer, const LightPath &camera, const LightPath &emitter,
-            int s, int t, int maxBounce, PathSampleGenerator &sampler);
+            int s, int t, int maxBounce, PathSampleGenerator &sampler, float mergeArea = 0.0f);
     static bool bdptCameraConnect(const TraceBase &tracer, const LightPath &camera, const LightPath &emitter,
-            int s, int maxBounce, PathSampleGenerator &sampler, Vec3f &weight, Vec2f &pixel);
+            int s, int maxBounce, PathSampleGenerator &sampler, Vec3f &weight, Vec2f &pixel,
+            float mergeArea = 0.0f);
+    // Merges emitter[s - 1] with the nearby camera[t - 1]; the light subpath is
+    // extended to the camera by treating the two vertices as coincident
+    static Vec3f vcmMerge(const LightPath &camera, const LightPath &emitter, int s, int t,
+            int maxBounce, float mergeArea);
 };
 
 }
@@ -148,6 +148,7 @@ bool PathVertex::sampleNextVertex(const TraceableScene &scene, TraceBase &tracer
     float edgePdfBackward;
     MediumRecord mediumRecord;
     if (state.medium) {
+        RENDER_STAT(RenderStatistics::MediumSamples);
         if (!state.medium->sampleDistance(state.sampler, state.ray, state.mediumState, mediumRecord.mediumSample))
             return false;
         if (mediumRecord.mediumSample.t < 1e-6f)
@@ -8,6 +8,8 @@
 #include "thread/ThreadUtils.hpp"
 #include "thread/ThreadPool.hpp"
 
+#include <algorithm>
+
 namespace Tungsten {
 
 KelemenMltIntegrator::KelemenMltIntegrator()
@@ -18,12 +20,34 @@ KelemenMltIntegrator::KelemenMltIntegrator()
 {
 }
 
-void KelemenMltIntegrator::saveState(OutputStreamHandle &/*out*/)
+void KelemenMltIntegrator::saveState(OutputStreamHandle &out)
 {
+    _sampler.saveState(out);
+    FileUtils::streamWrite(out, _chainsLaunched);
+    FileUtils::streamWrite(out, _luminanceScale);
+    FileUtils::streamWrite(out, _pathCandidates);
+    FileUtils::streamWrite(out, uint32(_tracers.size()));
+    for (std::unique_ptr<KelemenMltTracer> &tracer : _tracers)
+        tracer->saveState(out);
 }
 
-void KelemenMltIntegrator::loadState(InputStreamHandle &/*in*/)
+void KelemenMltIntegrator::loadState(InputStreamHandle &in)
 {
+    _sampler.loadState(in);
+    FileUtils::streamRead(in, _chainsLaunched);
+    FileUtils::streamRead(in, _luminanceScale);
+    FileUtils::streamRead(in, _pathCandidates);
+
+    // The chains can only be restored on the same number of threads. Otherwise
+    // they are restarted from the saved seed paths
+    uint32 tracerCount;
+    FileUtils::streamRead(in, tracerCount);
+    if (tracerCount == _tracers.size()) {
+        for (std::unique_ptr<KelemenMltTracer> &tracer : _tracers)
+            tracer->loadState(in);
+    } else if (_chainsLaunched) {
+        seedChains();
+    }
 }
 
 void KelemenMltIntegrator::fromJson(JsonPtr value, const Scene &/*scene*/)
@@ -51,6 +75,8 @@ void KelemenMltIntegrator::prepareForRender(TraceableScene &scene, uint32 seed)
 
     for (uint32 i = 0; i < ThreadUtils::pool->threadCount(); ++i)
         _tracers.emplace_back(new KelemenMltTracer(&scene, _settings, _sampler.state(), i));
+
+    _pathCandidates.resize(_settings.initialSamplePool);
 }
 
 void KelemenMltIntegrator::teardownAfterRender()
@@ -58,7 +84,14 @@ void KelemenMltIntegrator::teardownAfterRender()
     _group.reset();
 
     _tracers.clear();
+    _pathCandidates.clear();
     _tracers.shrink_to_fit();
+    _pathCandidates.shrink_to_fit();
+}
+
+bool KelemenMltIntegrator::supportsResumeRender() const
+{
+    return true;
 }
 
 void KelemenMltIntegrator::traceSamplePool(uint32 taskId, uint32 numSubTasks, uint32 /*threadId*/)
@@ -71,6 +104,7 @@ void KelemenMltIntegrator::traceSamplePool(uint32 taskId, uint32 numSubTasks, ui
     UniformPathSampler pathSampler(_tracers[taskId]->sampler());
     for (uint32 i = rayBase; i < rayTail; ++i) {
         _pathCandidates[i].state = pathSampler.sampler().state();
+        _pathCandidates[i].sequence = pathSampler.sampler().sequence();
         _tracers[taskId]->tracePath(pathSampler, pathSampler, *queue);
 
         _pathCandidates[i].luminanceSum = queue->totalLuminance();
@@ -88,10 +122,16 @@ void KelemenMltIntegrator::runSampleChain(uint32 taskId, uint32 numSubTasks, uin
 {
     uint32 rayCount = _w*_h*(_nextSpp - _currentSpp);
 
-    uint32 rayBase    = intLerp(0, rayCount, taskId + 0, numSubTasks);
-    uint32 raysToCast = intLerp(0, rayCount, taskId + 1, numSubTasks) - rayBase;
+    uint32 rayBase = intLerp(0, rayCount, taskId + 0, numSubTasks);
+    uint32 rayTail = intLerp(0, rayCount, taskId + 1, numSubTasks);
 
-    _tracers[taskId]->runSampleChain(raysToCast, _luminanceScale);
+    KelemenMltTracer &tracer = *_tracers[taskId];
+    int chainCount = tracer.chainCount();
+    for (int i = 0; i < chainCount; ++i) {
+        uint32 chainBase = intLerp(rayBase, rayTail, i + 0, chainCount);
+        uint32 chainTail = intLerp(rayBase, rayTail, i + 1, chainCount);
+        tracer.runSampleChain(i, chainTail - chainBase, _luminanceScale);
+    }
 }
 
 void KelemenMltIntegrator::selectSeedPaths()
@@ -99,23 +139,27 @@ void KelemenMltIntegrator::selectSeedPaths()
     for (int i = 1; i < _settings.initialSamplePool; ++i)
         _pathCandidates[i].luminanceSum += _pathCandidates[i - 1].luminanceSum;
 
-    double totalLuminance = _pathCandidates[_settings.initialSamplePool - 1].luminanceSum;
-    for (size_t i = 0; i < _tracers.size(); ++i) {
-        double target = _sampler.next1D()*totalLuminance;
+    _scene->cam().blitSplatBuffer();
+    _luminanceScale = _pathCandidates.back().luminanceSum/_settings.initialSamplePool;
 
-        int idx;
-        for (idx = 0; idx < _settings.initialSamplePool - 1; ++idx)
-            if (target < _pathCandidates[idx].luminanceSum)
-                break;
+    seedChains();
+}
 
-        uint64 sequence = _tracers[(idx*_tracers.size())/_settings.initialSamplePool]->sampler().sequence();
-        UniformSampler replaySampler(_pathCandidates[idx].state, sequence);
-        _tracers[i]->startSampleChain(replaySampler, _pathCandidates[idx].luminance);
+void KelemenMltIntegrator::seedChains()
+{
+    double totalLuminance = _pathCandidates.back().luminanceSum;
+    for (std::unique_ptr<KelemenMltTracer> &tracer : _tracers) {
+        for (int i = 0; i < tracer->chainCount(); ++i) {
+            double target = _sampler.next1D()*totalLuminance;
+
+            auto iter = std::upper_bound(_pathCandidates.begin(), _pathCandidates.end(), target,
+                    [](double t, const PathCandidate &c) { return t < c.luminanceSum; });
+            const PathCandidate &seed = _pathCandidates[min(size_t(iter - _pathCandidates.begin()), _pathCandidates.size() - 1)];
+
+            UniformSampler replaySampler(seed.state, seed.sequence);
+            tracer->startSampleChain(i, replaySampler, seed.luminance);
+        }
     }
-
-    _scene->cam().blitSplatBuffer();
-    _luminanceScale = totalLuminance/_settings.initialSamplePool;
-    _pathCandidates.reset();
 }
 
 void KelemenMltIntegrator::startRender(std::function<void()> completionCallback)
@@ -131,8 +175,6 @@ void KelemenMltIntegrator::startRender(std::function<void()> completionCallback)
 
     using namespace std::placeholders;
     if (!_chainsLaunched) {
-        _pathCandidates.reset(new PathCandidate[_settings.initialSamplePool]);
-
         _group = ThreadUtils::pool->enqueue(
             std::bind(&KelemenMltIntegrator::traceSamplePool, this, _1, _2, _3),
             _tracers.size(),
@@ -147,8 +189,13 @@ void KelemenMltIntegrator::startRender(std::function<void()> completionCallback)
             std::bind(&KelemenMltIntegrator::runSampleChain, this, _1, _2, _3),
             _tracers.size(),
             [&, completionCallback]() {
+                uint32 interval = _settings.reseedInterval;
+                bool reseed = interval > 0 && _nextSpp/interval > _currentSpp/interval;
+
                 _currentSpp = _nextSpp;
                 advanceSpp();
+                if (reseed && !done())
+                    seedChains();
                 completionCallback();
             }
         );
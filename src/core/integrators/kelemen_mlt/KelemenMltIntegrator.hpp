@@ -26,6 +26,7 @@ class KelemenMltIntegrator : public Integrator
     struct PathCandidate
     {
         uint64 state;
+        uint64 sequence;
         double luminanceSum;
         float luminance;
     };
@@ -42,7 +43,8 @@ class KelemenMltIntegrator : public Integrator
 
     bool _chainsLaunched;
     double _luminanceScale;
-    std::unique_ptr<PathCandidate[]> _pathCandidates;
+    // Kept after the chains are launched, so that they can be reseeded
+    std::vector<PathCandidate> _pathCandidates;
 
     virtual void saveState(OutputStreamHandle &out) override;
     virtual void loadState(InputStreamHandle &in) override;
@@ -51,6 +53,7 @@ class KelemenMltIntegrator : public Integrator
     void runSampleChain(uint32 taskId, uint32 numSubTasks, uint32 threadId);
 
     void selectSeedPaths();
+    void seedChains();
 
 public:
     KelemenMltIntegrator();
@@ -61,6 +64,8 @@ public:
     virtual void prepareForRender(TraceableScene &scene, uint32 seed) override;
     virtual void teardownAfterRender() override;
 
+    virtual bool supportsResumeRender() const override;
+
     virtual void startRender(std::function<void()> completionCallback) override;
     virtual void waitForCompletion() override;
     virtual void abortRender() override;
@@ -12,11 +12,15 @@ struct KelemenMltSettings : public PathTracerSettings
     int initialSamplePool;
     bool bidirectional;
     float largeStepProbability;
+    int chainsPerThread;
+    int reseedInterval;
 
     KelemenMltSettings()
     : initialSamplePool(10000),
       bidirectional(true),
-      largeStepProbability(0.1f)
+      largeStepProbability(0.1f),
+      chainsPerThread(1),
+      reseedInterval(0)
     {
     }
 
@@ -26,6 +30,8 @@ struct KelemenMltSettings : public PathTracerSettings
         value.getField("initial_sample_pool", initialSamplePool);
         value.getField("bidirectional", bidirectional);
         value.getField("large_step_probability", largeStepProbability);
+        value.getField("chains_per_thread", chainsPerThread);
+        value.getField("reseed_interval", reseedInterval);
     }
 
     rapidjson::Value toJson(rapidjson::Document::AllocatorType &allocator) const
@@ -37,7 +43,9 @@ struct KelemenMltSettings : public PathTracerSettings
             "type", "kelemen_mlt",
             "initial_sample_pool", initialSamplePool,
             "bidirectional", bidirectional,
-            "large_step_probability", largeStepProbability
+            "large_step_probability", largeStepProbability,
+            "chains_per_thread", chainsPerThread,
+            "reseed_interval", reseedInterval
         };
     }
 };
@@ -11,11 +11,18 @@ KelemenMltTracer::KelemenMltTracer(TraceableScene *scene, const KelemenMltSettin
   _splatBuffer(scene->cam().splatBuffer()),
   _settings(settings),
   _sampler(seed, threadId),
-  _currentSplats(new SplatQueue(sqr(_settings.maxBounces + 2))),
   _proposedSplats(new SplatQueue(sqr(_settings.maxBounces + 2))),
+  _chainCount(max(settings.chainsPerThread, 1)),
   _cameraPath(new LightPath(settings.maxBounces + 1)),
   _emitterPath(new LightPath(settings.maxBounces + 1))
 {
+    _chains.reset(new MarkovChain[_chainCount]);
+    for (int i = 0; i < _chainCount; ++i) {
+        _chains[i].currentSplats.reset(new SplatQueue(sqr(_settings.maxBounces + 2)));
+        _chains[i].cameraSampler .reset(new MetropolisSampler(&_sampler, _settings.maxBounces*16));
+        _chains[i].emitterSampler.reset(new MetropolisSampler(&_sampler, _settings.maxBounces*16));
+        _chains[i].accumulatedWeight = 0.0f;
+    }
 }
 
 void KelemenMltTracer::tracePath(PathSampleGenerator &cameraSampler, PathSampleGenerator &emitterSampler,
@@ -68,33 +75,35 @@ void KelemenMltTracer::tracePath(PathSampleGenerator &cameraSampler, PathSampleG
     splatQueue.addSplat(pixel, primarySplat);
 }
 
-void KelemenMltTracer::startSampleChain(UniformSampler &replaySampler, float luminance)
+void KelemenMltTracer::startSampleChain(int chain, UniformSampler &replaySampler, float luminance)
 {
-    _cameraSampler.reset (new MetropolisSampler(&replaySampler, _settings.maxBounces*16));
-    _emitterSampler.reset(new MetropolisSampler(&replaySampler, _settings.maxBounces*16));
+    MarkovChain &c = _chains[chain];
+    c.cameraSampler .reset(new MetropolisSampler(&replaySampler, _settings.maxBounces*16));
+    c.emitterSampler.reset(new MetropolisSampler(&replaySampler, _settings.maxBounces*16));
+    c.accumulatedWeight = 0.0f;
 
-    tracePath(*_cameraSampler, *_emitterSampler, *_currentSplats);
+    tracePath(*c.cameraSampler, *c.emitterSampler, *c.currentSplats);
 
-    if (_currentSplats->totalLuminance() != luminance)
-        FAIL("Underlying integrator is not consistent. Expected a value of %f, but received %f", luminance, _currentSplats->totalLuminance());
+    if (c.currentSplats->totalLuminance() != luminance)
+        FAIL("Underlying integrator is not consistent. Expected a value of %f, but received %f", luminance, c.currentSplats->totalLuminance());
 
-    _cameraSampler->accept();
-    _emitterSampler->accept();
-    _cameraSampler->setHelperGenerator(&_sampler);
-    _emitterSampler->setHelperGenerator(&_sampler);
+    c.cameraSampler->accept();
+    c.emitterSampler->accept();
+    c.cameraSampler->setHelperGenerator(&_sampler);
+    c.emitterSampler->setHelperGenerator(&_sampler);
 }
 
-void KelemenMltTracer::runSampleChain(int chainLength, float luminanceScale)
+void KelemenMltTracer::runSampleChain(int chain, int chainLength, float luminanceScale)
 {
-    float accumulatedWeight = 0.0f;
+    MarkovChain &c = _chains[chain];
     for (int i = 0; i < chainLength; ++i) {
         bool largeStep = _sampler.next1D() < _settings.largeStepProbability;
-        _cameraSampler->setLargeStep(largeStep);
-        _emitterSampler->setLargeStep(largeStep);
+        c.cameraSampler->setLargeStep(largeStep);
+        c.emitterSampler->setLargeStep(largeStep);
 
-        tracePath(*_cameraSampler, *_emitterSampler, *_proposedSplats);
+        tracePath(*c.cameraSampler, *c.emitterSampler, *_proposedSplats);
 
-        float currentI = _currentSplats->totalLuminance();
+        float currentI = c.currentSplats->totalLuminance();
         float proposedI = _proposedSplats->totalLuminance();
 
         float a = currentI == 0.0f ? 1.0f : min(proposedI/currentI, 1.0f);
@@ -102,25 +111,54 @@ void KelemenMltTracer::runSampleChain(int chainLength, float luminanceScale)
         float currentWeight = (1.0f - a)/((currentI/luminanceScale) + _settings.largeStepProbability);
         float proposedWeight = (a + (largeStep ? 1.0f : 0.0f))/((proposedI/luminanceScale) + _settings.largeStepProbability);
 
-        accumulatedWeight += currentWeight;
+        c.accumulatedWeight += currentWeight;
 
         if (_sampler.next1D() < a) {
             if (currentI != 0.0f)
-                _currentSplats->apply(*_splatBuffer, accumulatedWeight);
+                c.currentSplats->apply(*_splatBuffer, c.accumulatedWeight);
 
-            std::swap(_currentSplats, _proposedSplats);
-            accumulatedWeight = proposedWeight;
+            std::swap(c.currentSplats, _proposedSplats);
+            c.accumulatedWeight = proposedWeight;
 
-            _cameraSampler->accept();
-            _emitterSampler->accept();
+            c.cameraSampler->accept();
+            c.emitterSampler->accept();
         } else {
             if (proposedI != 0.0f)
                 _proposedSplats->apply(*_splatBuffer, proposedWeight);
 
-            _cameraSampler->reject();
-            _emitterSampler->reject();
+            c.cameraSampler->reject();
+            c.emitterSampler->reject();
         }
     }
+
+    // Splat the remaining weight of the current state, so that the splat buffer
+    // is complete at the end of every pass
+    if (c.currentSplats->totalLuminance() != 0.0f)
+        c.currentSplats->apply(*_splatBuffer, c.accumulatedWeight);
+    c.accumulatedWeight = 0.0f;
+}
+
+void KelemenMltTracer::saveState(OutputStreamHandle &out)
+{
+    _sampler.saveState(out);
+    for (int i = 0; i < _chainCount; ++i) {
+        _chains[i].currentSplats->saveState(out);
+        _chains[i].cameraSampler->saveState(out);
+        _chains[i].emitterSampler->saveState(out);
+    }
+}
+
+void KelemenMltTracer::loadState(InputStreamHandle &in)
+{
+    _sampler.loadState(in);
+    for (int i = 0; i < _chainCount; ++i) {
+        _chains[i].currentSplats->loadState(in);
+        _chains[i].cameraSampler->loadState(in);
+        _chains[i].emitterSampler->loadState(in);
+        _chains[i].cameraSampler->setHelperGenerator(&_sampler);
+        _chains[i].emitterSampler->setHelperGenerator(&_sampler);
+        _chains[i].accumulatedWeight = 0.0f;
+    }
 }
 
 }
@@ -15,14 +15,22 @@ class AtomicFramebuffer;
 
 class KelemenMltTracer : public PathTracer
 {
+    struct MarkovChain
+    {
+        std::unique_ptr<SplatQueue> currentSplats;
+        std::unique_ptr<MetropolisSampler> cameraSampler;
+        std::unique_ptr<MetropolisSampler> emitterSampler;
+        // Weight of the current state that has not been splatted yet
+        float accumulatedWeight;
+    };
+
     AtomicFramebuffer *_splatBuffer;
     KelemenMltSettings _settings;
     UniformSampler _sampler;
 
-    std::unique_ptr<SplatQueue> _currentSplats;
     std::unique_ptr<SplatQueue> _proposedSplats;
-    std::unique_ptr<MetropolisSampler> _cameraSampler;
-    std::unique_ptr<MetropolisSampler> _emitterSampler;
+    std::unique_ptr<MarkovChain[]> _chains;
+    int _chainCount;
     std::unique_ptr<LightPath> _cameraPath;
     std::unique_ptr<LightPath> _emitterPath;
 
@@ -31,8 +39,16 @@ public:
 
     void tracePath(PathSampleGenerator &cameraSampler, PathSampleGenerator &emitterSampler, SplatQueue &splatQueue);
 
-    void startSampleChain(UniformSampler &replaySampler, float luminance);
-    void runSampleChain(int chainLength, float luminanceScale);
+    void startSampleChain(int chain, UniformSampler &replaySampler, float luminance);
+    void runSampleChain(int chain, int chainLength, float luminanceScale);
+
+    void saveState(OutputStreamHandle &out);
+    void loadState(InputStreamHandle &in);
+
+    int chainCount() const
+    {
+        return _chainCount;
+    }
 
     UniformSampler &sampler()
     {
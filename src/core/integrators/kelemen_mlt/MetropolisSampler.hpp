@@ -84,11 +84,20 @@ public:
     {
     }
 
-    virtual void saveState(OutputStreamHandle &/*out*/) override
+    // Only the accepted state is saved, so this must be called between mutations
+    virtual void saveState(OutputStreamHandle &out) override
     {
+        FileUtils::streamWrite(out, _sampleVector.get(), _maxSize);
+        FileUtils::streamWrite(out, _currentTime);
+        FileUtils::streamWrite(out, _largeStepTime);
     }
-    virtual void loadState(InputStreamHandle &/*in*/) override
+    virtual void loadState(InputStreamHandle &in) override
     {
+        FileUtils::streamRead(in, _sampleVector.get(), _maxSize);
+        FileUtils::streamRead(in, _currentTime);
+        FileUtils::streamRead(in, _largeStepTime);
+        _vectorIdx = 0;
+        _stackIdx = 0;
     }
 
     void setHelperGenerator(UniformSampler *generator)
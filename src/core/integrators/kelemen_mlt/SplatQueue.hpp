@@ -5,6 +5,8 @@
 
 #include "math/Vec.hpp"
 
+#include "io/FileUtils.hpp"
+
 #include <memory>
 
 namespace Tungsten {
@@ -64,13 +66,32 @@ public:
         return _totalLuminance;
     }
 
-    void apply(AtomicFramebuffer &buffer, float scale)
+    // The splats stay in the queue, so that a Markov chain can keep splatting
+    // its current state until it moves on
+    void apply(AtomicFramebuffer &buffer, float scale) const
     {
         for (int i = 0; i < _filteredSplatCount; ++i)
             buffer.splatFiltered(_filteredSplats[i].pixel, _filteredSplats[i].value*scale);
         for (int i = 0; i < _splatCount; ++i)
             buffer.splat(_splats[i].pixel, _splats[i].value*scale);
-        clear();
+    }
+
+    void saveState(OutputStreamHandle &out) const
+    {
+        FileUtils::streamWrite(out, _filteredSplatCount);
+        FileUtils::streamWrite(out, _splatCount);
+        FileUtils::streamWrite(out, _totalLuminance);
+        FileUtils::streamWrite(out, _filteredSplats.get(), _filteredSplatCount);
+        FileUtils::streamWrite(out, _splats.get(), _splatCount);
+    }
+
+    void loadState(InputStreamHandle &in)
+    {
+        FileUtils::streamRead(in, _filteredSplatCount);
+        FileUtils::streamRead(in, _splatCount);
+        FileUtils::streamRead(in, _totalLuminance);
+        FileUtils::streamRead(in, _filteredSplats.get(), _filteredSplatCount);
+        FileUtils::streamRead(in, _splats.get(), _splatCount);
     }
 };
 
@@ -53,6 +53,8 @@ void LightTracer::traceSample(PathSampleGenerator &sampler)
     while ((didHit || medium) && bounce < _settings.maxBounces - 1) {
         bool hitSurface = true;
         if (medium) {
+            RENDER_STAT(RenderStatistics::MediumSamples);
+            state.throughput = throughput;
             if (!medium->sampleDistance(sampler, ray, state, mediumSample))
                 break;
             throughput *= mediumSample.weight;
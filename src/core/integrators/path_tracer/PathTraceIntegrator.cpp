@@ -1,5 +1,7 @@
 #include "PathTraceIntegrator.hpp"
 
+#include "integrators/SampleCost.hpp"
+
 #include "sampling/UniformPathSampler.hpp"
 #include "sampling/SobolPathSampler.hpp"
 
@@ -8,19 +10,47 @@
 #include "thread/ThreadUtils.hpp"
 #include "thread/ThreadPool.hpp"
 
+#include <tinyformat/tinyformat.hpp>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+
 namespace Tungsten {
 
+// Training parameters suggested by Mueller et al.
+static const float GuidingSpatialThreshold = 12000.0f;
+static const float GuidingDirectionalThreshold = 0.01f;
+static const int GuidingMaxDirectionalDepth = 20;
+
+// Side lengths of the pixel blocks that each preview pass traces a single
+// sample for, i.e. 1/16 and then 1/4 of the image resolution
+static const uint32 PreviewBlockSizes[] = {16, 4};
+
 CONSTEXPR uint32 PathTraceIntegrator::TileSize;
 CONSTEXPR uint32 PathTraceIntegrator::VarianceTileSize;
 CONSTEXPR uint32 PathTraceIntegrator::AdaptiveThreshold;
+CONSTEXPR uint32 PathTraceIntegrator::PreviewPassCount;
 
 PathTraceIntegrator::PathTraceIntegrator()
 : Integrator(),
+  _origin(0u),
   _w(0),
   _h(0),
   _varianceW(0),
   _varianceH(0),
-  _sampler(0xBA5EBA11)
+  _sampler(0xBA5EBA11),
+  _previewPass(0),
+  _spiralTileOrder(false),
+  _nextOrderedTile(0),
+  _bucketSize(0),
+  _bucketsX(0),
+  _bucketsY(0),
+  _bucket(0),
+  _guideIteration(0),
+  _guideIterationStart(0),
+  _guideIterationLength(0),
+  _guideTraining(false),
+  _guideTrainingTime(0.0)
 {
 }
 
@@ -29,8 +59,8 @@ void PathTraceIntegrator::diceTiles()
     for (uint32 y = 0; y < _h; y += TileSize) {
         for (uint32 x = 0; x < _w; x += TileSize) {
             _tiles.emplace_back(
-                x,
-                y,
+                _origin.x() + x,
+                _origin.y() + y,
                 min(TileSize, _w - x),
                 min(TileSize, _h - y),
                 _scene->rendererSettings().useSobol() ?
@@ -39,6 +69,87 @@ void PathTraceIntegrator::diceTiles()
             );
         }
     }
+    _tileQueue.init(uint32(_tiles.size()));
+}
+
+// Orders tiles in rings of increasing distance around the preview focus, and
+// by angle within each ring. Preview passes and the first full pass hand out
+// tiles in this order, so the region being looked at resolves first
+void PathTraceIntegrator::orderTilesFromFocus()
+{
+    Vec2f focus = _previewFocus*Vec2f(_scene->cam().resolution());
+
+    std::vector<std::pair<Vec2f, uint32>> keys;
+    keys.reserve(_tiles.size());
+    for (uint32 i = 0; i < _tiles.size(); ++i) {
+        const ImageTile &tile = _tiles[i];
+        Vec2f d = Vec2f(tile.x + tile.w*0.5f, tile.y + tile.h*0.5f) - focus;
+        float ring = std::floor(max(std::abs(d.x()), std::abs(d.y()))/TileSize + 0.5f);
+        keys.emplace_back(Vec2f(ring, std::atan2(d.y(), d.x())), i);
+    }
+    std::sort(keys.begin(), keys.end(), [](const std::pair<Vec2f, uint32> &a, const std::pair<Vec2f, uint32> &b) {
+        return a.first.x() != b.first.x() ? a.first.x() < b.first.x() : a.first.y() < b.first.y();
+    });
+
+    _tileOrder.clear();
+    for (const auto &key : keys)
+        _tileOrder.push_back(key.second);
+}
+
+// Preview passes run before the first sample of a render that starts from
+// scratch. They only write to the preview buffer of the camera, which is
+// displayed wherever the color buffer has no samples yet, so they have no
+// influence on the final image. Bucket renders are not interactive and skip them
+bool PathTraceIntegrator::previewPending() const
+{
+    return _scene->rendererSettings().progressivePreview() && _bucketSize == 0 &&
+            _currentSpp == 0 && _previewPass < PreviewPassCount;
+}
+
+bool PathTraceIntegrator::popTile(uint32 threadId, uint32 &tileId)
+{
+    if (!_spiralTileOrder)
+        return _tileQueue.pop(threadId, tileId);
+
+    uint32 index = _nextOrderedTile++;
+    if (index >= _tileOrder.size())
+        return false;
+    tileId = _tileOrder[index];
+    return true;
+}
+
+// In bucket mode, the image is rendered one bucket at a time, each to the full
+// sample count, and the camera only keeps the buffers of the current bucket in
+// memory. Primary rays are placed by importance sampling the reconstruction
+// filter, so every sample only lands in its own pixel and buckets are
+// independent of each other, without any overlap at their borders
+void PathTraceIntegrator::startBucket()
+{
+    Vec2u res = _scene->cam().resolution();
+    _origin = Vec2u(_bucket % _bucketsX, _bucket/_bucketsX)*_bucketSize;
+    _w = min(_bucketSize, res.x() - _origin.x());
+    _h = min(_bucketSize, res.y() - _origin.y());
+    _varianceW = (_w + VarianceTileSize - 1)/VarianceTileSize;
+    _varianceH = (_h + VarianceTileSize - 1)/VarianceTileSize;
+
+    _tiles.clear();
+    diceTiles();
+    _samples.assign(_varianceW*_varianceH, SampleRecord());
+    _scene->cam().setOutputWindow(_origin);
+
+    _currentSpp = 0;
+    advanceSpp();
+}
+
+void PathTraceIntegrator::finishBucket()
+{
+    _scene->cam().saveOutputWindow();
+    std::cout << tfm::format("Finished bucket %d/%d", _bucket + 1, _bucketsX*_bucketsY) << std::endl;
+
+    if (++_bucket < _bucketsX*_bucketsY)
+        startBucket();
+    else
+        _scene->cam().closeWindowOutputs();
 }
 
 float PathTraceIntegrator::errorPercentile95()
@@ -133,20 +244,61 @@ bool PathTraceIntegrator::generateWork()
     return true;
 }
 
-void PathTraceIntegrator::renderTile(uint32 id, uint32 tileId)
+// Guiding is trained in iterations of doubling length, so that every
+// iteration learns from a distribution twice as refined as the last one.
+// Samples taken during training still contribute to the image
+void PathTraceIntegrator::updateGuide()
+{
+    if (!_guideTraining)
+        return;
+
+    _guideTimer.stop();
+    _guideTrainingTime += _guideTimer.elapsed();
+
+    uint32 iterationSpp = _currentSpp - _guideIterationStart;
+    bool trainingDone = _currentSpp >= uint32(_settings.guidingTrainingSpp);
+    if (iterationSpp < _guideIterationLength && !trainingDone)
+        return;
+
+    Timer refineTimer;
+    _guide->refine(uint32(GuidingSpatialThreshold*std::sqrt(float(iterationSpp))),
+            GuidingDirectionalThreshold, GuidingMaxDirectionalDepth);
+    refineTimer.stop();
+
+    std::cout << tfm::format("Path guiding iteration %d (%d spp): %d spatial nodes, %d directional nodes, "
+            "%.1f MB, refinement took %.3f s, %.2f s spent training",
+            _guideIteration, iterationSpp, _guide->numSpatialNodes(), _guide->numDirectionalNodes(),
+            _guide->memoryUsage()/(1024.0*1024.0), refineTimer.elapsed(), _guideTrainingTime) << std::endl;
+
+    _guideIteration++;
+    _guideIterationStart = _currentSpp;
+    _guideIterationLength *= 2;
+}
+
+void PathTraceIntegrator::renderTile(uint32 id)
 {
+    uint32 tileId;
+    if (!popTile(id, tileId))
+        return;
+
+    SampleCost cost(_scene->cam().costBuffer());
+    uint32 imageW = _scene->cam().resolution().x();
+
     ImageTile &tile = _tiles[tileId];
     for (uint32 y = 0; y < tile.h; ++y) {
         for (uint32 x = 0; x < tile.w; ++x) {
             Vec2u pixel(tile.x + x, tile.y + y);
-            uint32 pixelIndex = pixel.x() + pixel.y()*_w;
-            uint32 variancePixelIndex = pixel.x()/VarianceTileSize + pixel.y()/VarianceTileSize*_varianceW;
+            Vec2u local = pixel - _origin;
+            uint32 pixelIndex = pixel.x() + pixel.y()*imageW;
+            uint32 variancePixelIndex = local.x()/VarianceTileSize + local.y()/VarianceTileSize*_varianceW;
 
             SampleRecord &record = _samples[variancePixelIndex];
             int spp = record.nextSampleCount;
             for (int i = 0; i < spp; ++i) {
+                cost.start();
                 tile.sampler->startPath(pixelIndex, record.sampleIndex + i);
                 Vec3f c = _tracers[id]->traceSample(pixel, *tile.sampler);
+                cost.stop(pixel);
 
                 record.addSample(c);
                 _scene->cam().colorBuffer()->addSample(pixel, c);
@@ -155,12 +307,46 @@ void PathTraceIntegrator::renderTile(uint32 id, uint32 tileId)
     }
 }
 
+// Uses its own sampler, so that the tile samplers produce the same sequence
+// with and without preview passes
+void PathTraceIntegrator::renderPreviewTile(uint32 id)
+{
+    uint32 tileId;
+    if (!popTile(id, tileId))
+        return;
+
+    uint32 imageW = _scene->cam().resolution().x();
+    uint32 blockSize = PreviewBlockSizes[_previewPass];
+    UniformPathSampler sampler(MathUtil::hash32(tileId*PreviewPassCount + _previewPass));
+
+    const ImageTile &tile = _tiles[tileId];
+    for (uint32 y = 0; y < tile.h; y += blockSize) {
+        for (uint32 x = 0; x < tile.w; x += blockSize) {
+            Vec2u origin(tile.x + x, tile.y + y);
+            Vec2u size(min(blockSize, tile.w - x), min(blockSize, tile.h - y));
+            Vec2u pixel = origin + size/2u;
+
+            sampler.startPath(pixel.x() + pixel.y()*imageW, 0);
+            Vec3f c = _tracers[id]->tracePreviewSample(pixel, sampler);
+            if (!std::isnan(c.sum()))
+                _scene->cam().setPreviewBlock(origin, size, c);
+        }
+    }
+}
+
 void PathTraceIntegrator::saveState(OutputStreamHandle &out)
 {
     for (SampleRecord &s : _samples)
         s.saveState(out);
     for (ImageTile &i : _tiles)
         i.sampler->saveState(out);
+    if (_guide) {
+        _guide->saveState(out);
+        FileUtils::streamWrite(out, _guideIteration);
+        FileUtils::streamWrite(out, _guideIterationStart);
+        FileUtils::streamWrite(out, _guideIterationLength);
+        FileUtils::streamWrite(out, _guideTrainingTime);
+    }
 }
 
 void PathTraceIntegrator::loadState(InputStreamHandle &in)
@@ -169,6 +355,13 @@ void PathTraceIntegrator::loadState(InputStreamHandle &in)
         s.loadState(in);
     for (ImageTile &i : _tiles)
         i.sampler->loadState(in);
+    if (_guide) {
+        _guide->loadState(in);
+        FileUtils::streamRead(in, _guideIteration);
+        FileUtils::streamRead(in, _guideIterationStart);
+        FileUtils::streamRead(in, _guideIterationLength);
+        FileUtils::streamRead(in, _guideTrainingTime);
+    }
 }
 
 void PathTraceIntegrator::fromJson(JsonPtr value, const Scene &/*scene*/)
@@ -192,47 +385,129 @@ void PathTraceIntegrator::prepareForRender(TraceableScene &scene, uint32 seed)
     for (uint32 i = 0; i < ThreadUtils::pool->threadCount(); ++i)
         _tracers.emplace_back(new PathTracer(&scene, _settings, i));
 
-    _w = scene.cam().resolution().x();
-    _h = scene.cam().resolution().y();
-    _varianceW = (_w + VarianceTileSize - 1)/VarianceTileSize;
-    _varianceH = (_h + VarianceTileSize - 1)/VarianceTileSize;
-    diceTiles();
-    _samples.resize(_varianceW*_varianceH);
+    if (scene.cam().hasOutputWindow()) {
+        const RendererSettings &settings = scene.rendererSettings();
+        Vec2u res = scene.cam().resolution();
+        _bucketSize = settings.bucketSize();
+        _bucketsX = (res.x() + _bucketSize - 1)/_bucketSize;
+        _bucketsY = (res.y() + _bucketSize - 1)/_bucketSize;
+        _bucket = 0;
+
+        // PNG files cannot be written incrementally, so the color output
+        // goes to a PFM next to the LDR output if no HDR output is set
+        Path hdrFile = settings.hdrOutputFile();
+        if (hdrFile.empty() && !settings.outputFile().empty())
+            hdrFile = settings.outputFile().stripExtension() + ".pfm";
+        std::cout << tfm::format("Rendering %dx%d buckets of %d pixels to '%s'",
+                _bucketsX, _bucketsY, _bucketSize, hdrFile) << std::endl;
+        if (!scene.cam().openWindowOutputs(hdrFile))
+            std::cout << "Warning: Unable to open some of the outputs for streaming; "
+                         "only PFM and EXR outputs are supported in bucket mode" << std::endl;
+
+        startBucket();
+    } else {
+        _origin = Vec2u(0u);
+        _w = scene.cam().resolution().x();
+        _h = scene.cam().resolution().y();
+        _varianceW = (_w + VarianceTileSize - 1)/VarianceTileSize;
+        _varianceH = (_h + VarianceTileSize - 1)/VarianceTileSize;
+        diceTiles();
+        _samples.resize(_varianceW*_varianceH);
+    }
+
+    // Guiding learns over the course of the whole render, which does not
+    // map onto buckets that each restart from 0 spp
+    if (_settings.enableGuiding && _bucketSize > 0)
+        std::cout << "Warning: Path guiding is not supported in bucket mode and will be disabled" << std::endl;
+    if (_settings.enableGuiding && _bucketSize == 0) {
+        _guide.reset(new SdTree(scene.bounds()));
+        _guideIteration = 0;
+        _guideIterationStart = 0;
+        _guideIterationLength = _nextSpp;
+        _guideTrainingTime = 0.0;
+    }
 }
 
 void PathTraceIntegrator::teardownAfterRender()
 {
     _group.reset();
 
+    _guide.reset();
     _tracers.clear();
     _samples.clear();
     _tiles  .clear();
+    _tileOrder.clear();
     _tracers.shrink_to_fit();
     _samples.shrink_to_fit();
     _tiles  .shrink_to_fit();
+    _bucketSize = 0;
+    _previewPass = 0;
+    _spiralTileOrder = false;
 }
 
 bool PathTraceIntegrator::supportsResumeRender() const
+{
+    return _bucketSize == 0;
+}
+
+bool PathTraceIntegrator::supportsBucketRendering() const
 {
     return true;
 }
 
 void PathTraceIntegrator::startRender(std::function<void()> completionCallback)
 {
+    using namespace std::placeholders;
+
+    if (!done() && previewPending()) {
+        if (_previewPass == 0) {
+            _scene->cam().requestPreviewBuffer();
+            orderTilesFromFocus();
+        }
+        _spiralTileOrder = true;
+        _nextOrderedTile = 0;
+
+        _group = ThreadUtils::pool->enqueue(
+            std::bind(&PathTraceIntegrator::renderPreviewTile, this, _3),
+            _tiles.size(),
+            [&, completionCallback]() {
+                _previewPass++;
+                completionCallback();
+            }
+        );
+        return;
+    }
+
     if (done() || !generateWork()) {
         _currentSpp = _nextSpp;
         advanceSpp();
+        if (_bucketSize > 0 && done())
+            finishBucket();
         completionCallback();
         return;
     }
 
-    using namespace std::placeholders;
+    if (_guide) {
+        _guideTraining = _currentSpp < uint32(_settings.guidingTrainingSpp);
+        for (std::unique_ptr<PathTracer> &tracer : _tracers)
+            tracer->setGuide(_guide.get(), _guideTraining);
+        if (_guideTraining)
+            _guideTimer.start();
+    }
+
+    _tileQueue.reset();
+    _spiralTileOrder = _currentSpp == 0 && !_tileOrder.empty();
+    _nextOrderedTile = 0;
+
     _group = ThreadUtils::pool->enqueue(
-        std::bind(&PathTraceIntegrator::renderTile, this, _3, _1),
+        std::bind(&PathTraceIntegrator::renderTile, this, _3),
         _tiles.size(),
         [&, completionCallback]() {
             _currentSpp = _nextSpp;
+            updateGuide();
             advanceSpp();
+            if (_bucketSize > 0 && done())
+                finishBucket();
             completionCallback();
         }
     );
@@ -4,6 +4,7 @@
 #include "PathTracerSettings.hpp"
 #include "SampleRecord.hpp"
 #include "PathTracer.hpp"
+#include "SdTree.hpp"
 
 #include "integrators/Integrator.hpp"
 #include "integrators/ImageTile.hpp"
@@ -11,10 +12,13 @@
 #include "sampling/PathSampleGenerator.hpp"
 #include "sampling/UniformSampler.hpp"
 
+#include "thread/NumaWorkQueue.hpp"
 #include "thread/TaskGroup.hpp"
 
 #include "math/MathUtil.hpp"
 
+#include "Timer.hpp"
+
 #include <thread>
 #include <memory>
 #include <vector>
@@ -27,11 +31,13 @@ class PathTraceIntegrator : public Integrator
     static CONSTEXPR uint32 TileSize = 16;
     static CONSTEXPR uint32 VarianceTileSize = 4;
     static CONSTEXPR uint32 AdaptiveThreshold = 16;
+    static CONSTEXPR uint32 PreviewPassCount = 2;
 
     PathTracerSettings _settings;
 
     std::shared_ptr<TaskGroup> _group;
 
+    Vec2u _origin;
     uint32 _w;
     uint32 _h;
     uint32 _varianceW;
@@ -42,15 +48,43 @@ class PathTraceIntegrator : public Integrator
 
     std::vector<SampleRecord> _samples;
     std::vector<ImageTile> _tiles;
+    NumaWorkQueue _tileQueue;
+
+    uint32 _previewPass;
+    bool _spiralTileOrder;
+    std::vector<uint32> _tileOrder;
+    std::atomic<uint32> _nextOrderedTile;
+
+    uint32 _bucketSize;
+    uint32 _bucketsX;
+    uint32 _bucketsY;
+    uint32 _bucket;
+
+    std::unique_ptr<SdTree> _guide;
+    uint32 _guideIteration;
+    uint32 _guideIterationStart;
+    uint32 _guideIterationLength;
+    bool _guideTraining;
+    double _guideTrainingTime;
+    Timer _guideTimer;
 
     void diceTiles();
+    void orderTilesFromFocus();
+    bool previewPending() const;
+    bool popTile(uint32 threadId, uint32 &tileId);
+
+    void startBucket();
+    void finishBucket();
+
+    void updateGuide();
 
     float errorPercentile95();
     void dilateAdaptiveWeights();
     void distributeAdaptiveSamples(int spp);
     bool generateWork();
 
-    void renderTile(uint32 id, uint32 tileId);
+    void renderTile(uint32 id);
+    void renderPreviewTile(uint32 id);
 
     virtual void saveState(OutputStreamHandle &out) override;
     virtual void loadState(InputStreamHandle &in) override;
@@ -65,6 +99,7 @@ public:
     virtual void teardownAfterRender() override;
 
     virtual bool supportsResumeRender() const override;
+    virtual bool supportsBucketRendering() const override;
 
     virtual void startRender(std::function<void()> completionCallback) override;
     virtual void waitForCompletion() override;
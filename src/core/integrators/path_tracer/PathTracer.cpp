@@ -7,11 +7,106 @@ namespace Tungsten {
 PathTracer::PathTracer(TraceableScene *scene, const PathTracerSettings &settings, uint32 threadId)
 : TraceBase(scene, settings, threadId),
   _settings(settings),
-  _trackOutputValues(!scene->rendererSettings().renderOutputs().empty())
+  _trackOutputValues(!scene->rendererSettings().renderOutputs().empty()),
+  _guide(nullptr),
+  _trainGuide(false),
+  _guideRegion(nullptr)
 {
 }
 
+// Samples a direction from the one-sample mixture of the BSDF and the guiding
+// distribution of the region. Specular lobes cannot be guided and keep their
+// discrete BSDF weight, scaled by the probability of picking the BSDF
+bool PathTracer::sampleGuided(SurfaceScatterEvent &event, const SdTree::Region &region, float &woPdf)
+{
+    const Bsdf &bsdf = *event.info->bsdf;
+    event.requestedLobe = BsdfLobes::AllLobes;
+
+    float bsdfFraction = 1.0f;
+    if (region.canSample() && !bsdf.lobes().isPureSpecular())
+        bsdfFraction = _settings.guidingBsdfFraction;
+
+    if (bsdfFraction == 1.0f || event.sampler->next1D() < bsdfFraction) {
+        if (!bsdf.sample(event, false))
+            return false;
+        if (event.sampledLobe.hasSpecular()) {
+            event.weight /= bsdfFraction;
+            event.pdf *= bsdfFraction;
+            woPdf = event.pdf;
+            return true;
+        }
+        if (bsdfFraction == 1.0f) {
+            woPdf = event.pdf;
+            return true;
+        }
+    } else {
+        event.wo = event.frame.toLocal(region.sample(event.sampler->next2D()));
+        event.sampledLobe = BsdfLobes::AllButSpecular;
+    }
+
+    Vec3f f = bsdf.eval(event, false);
+    woPdf = bsdfFraction*bsdf.pdf(event) + (1.0f - bsdfFraction)*region.pdf(event.frame.toGlobal(event.wo));
+    if (woPdf == 0.0f || f == 0.0f)
+        return false;
+
+    event.weight = f/woPdf;
+    event.pdf = woPdf;
+    return true;
+}
+
+bool PathTracer::sampleDirection(SurfaceScatterEvent &event, const IntersectionInfo &info)
+{
+    SdTree::Region &region = _guide->lookup(info.p);
+    float woPdf;
+    if (!sampleGuided(event, region, woPdf))
+        return false;
+
+    _guideRegion = &region;
+    return true;
+}
+
+void PathTracer::recordGuideVertices(const Vec3f &emission)
+{
+    for (const GuideVertex &v : _guideVertices) {
+        Vec3f radiance(0.0f);
+        for (int i = 0; i < 3; ++i)
+            if (v.throughput[i] > 0.0f)
+                radiance[i] = max((emission[i] - v.emission[i] + v.directEmission[i])/v.throughput[i], 0.0f);
+
+        float flux = radiance.avg()/v.pdf;
+        if (std::isfinite(flux))
+            v.region->record(v.d, flux);
+    }
+    _guideVertices.clear();
+}
+
 Vec3f PathTracer::traceSample(Vec2u pixel, PathSampleGenerator &sampler)
+{
+    RENDER_STAT(RenderStatistics::Paths);
+
+    Vec3f result = tracePath(pixel, sampler);
+    if (_trainGuide)
+        recordGuideVertices(result);
+    return result;
+}
+
+Vec3f PathTracer::tracePreviewSample(Vec2u pixel, PathSampleGenerator &sampler)
+{
+    RenderStatistics::DiscardScope discardStatistics;
+
+    bool trackOutputValues = _trackOutputValues;
+    bool trainGuide = _trainGuide;
+    _trackOutputValues = false;
+    _trainGuide = false;
+
+    Vec3f result = tracePath(pixel, sampler);
+
+    _trackOutputValues = trackOutputValues;
+    _trainGuide = trainGuide;
+    return result;
+}
+
+Vec3f PathTracer::tracePath(Vec2u pixel, PathSampleGenerator &sampler)
 {
     // TODO: Put diagnostic colors in JSON?
     const Vec3f nanDirColor = Vec3f(0.0f);
@@ -47,8 +142,12 @@ Vec3f PathTracer::traceSample(Vec2u pixel, PathSampleGenerator &sampler)
     bool didHit = _scene->intersect(ray, data, info);
     bool wasSpecular = true;
     while ((didHit || medium) && bounce < _settings.maxBounces) {
+        RENDER_STAT(RenderStatistics::PathVertices);
+
         bool hitSurface = true;
         if (medium) {
+            RENDER_STAT(RenderStatistics::MediumSamples);
+            state.throughput = throughput;
             if (!medium->sampleDistance(sampler, ray, state, mediumSample))
                 return emission;
             throughput *= mediumSample.weight;
@@ -60,10 +159,23 @@ Vec3f PathTracer::traceSample(Vec2u pixel, PathSampleGenerator &sampler)
         if (hitSurface) {
             hitDistance += ray.farT();
 
+            // With light sampling, emission reached directly from a guided vertex is
+            // only counted through next event estimation. It still belongs to the
+            // incident radiance of that vertex and is added back for training
+            if (_trainGuide && !_guideVertices.empty() && _guideVertices.back().bounce == bounce - 1 &&
+                    _settings.enableLightSampling && info.primitive->isEmissive() && info.primitive->isSamplable())
+                _guideVertices.back().directEmission += info.primitive->evalDirect(data, info)*throughput;
+
             surfaceEvent = makeLocalScatterEvent(data, info, ray, &sampler);
             Vec3f transmittance(-1.0f);
+            _guideRegion = nullptr;
             bool terminate = !handleSurface(surfaceEvent, data, info, medium, bounce, false,
-                    _settings.enableLightSampling, ray, throughput, emission, wasSpecular, state, &transmittance);
+                    _settings.enableLightSampling, ray, throughput, emission, wasSpecular, state, &transmittance,
+                    _guide ? this : nullptr);
+
+            if (!terminate && _trainGuide && _guideRegion && !wasSpecular)
+                _guideVertices.push_back(GuideVertex{_guideRegion, ray.dir(), throughput, emission,
+                        Vec3f(0.0f), surfaceEvent.pdf, bounce});
 
             if (_trackOutputValues && !recordedOutputValues && (!wasSpecular || terminate)) {
                 if (_scene->cam().depthBuffer())
@@ -98,16 +210,22 @@ Vec3f PathTracer::traceSample(Vec2u pixel, PathSampleGenerator &sampler)
 
         float roulettePdf = std::abs(throughput).max();
         if (bounce > 2 && roulettePdf < 0.1f) {
-            if (sampler.nextBoolean(roulettePdf))
+            if (sampler.nextBoolean(roulettePdf)) {
                 throughput /= roulettePdf;
-            else
+            } else {
+                RENDER_STAT(RenderStatistics::RouletteTerminations);
                 return emission;
+            }
         }
 
-        if (std::isnan(ray.dir().sum() + ray.pos().sum()))
+        if (std::isnan(ray.dir().sum() + ray.pos().sum())) {
+            RENDER_STAT(RenderStatistics::NanPaths);
             return nanDirColor;
-        if (std::isnan(throughput.sum() + emission.sum()))
+        }
+        if (std::isnan(throughput.sum() + emission.sum())) {
+            RENDER_STAT(RenderStatistics::NanPaths);
             return nanBsdfColor;
+        }
 
         bounce++;
         if (bounce < _settings.maxBounces)
@@ -115,8 +233,13 @@ Vec3f PathTracer::traceSample(Vec2u pixel, PathSampleGenerator &sampler)
     }
     if (bounce >= _settings.minBounces && bounce < _settings.maxBounces)
         handleInfiniteLights(data, info, _settings.enableLightSampling, ray, throughput, wasSpecular, emission);
-    if (std::isnan(throughput.sum() + emission.sum()))
+    if (_trainGuide && !_guideVertices.empty() && _guideVertices.back().bounce == bounce - 1 &&
+            _settings.enableLightSampling && _scene->intersectInfinites(ray, data, info) && info.primitive->isSamplable())
+        _guideVertices.back().directEmission += throughput*info.primitive->evalDirect(data, info);
+    if (std::isnan(throughput.sum() + emission.sum())) {
+        RENDER_STAT(RenderStatistics::NanPaths);
         return nanEnvDirColor;
+    }
 
     if (_trackOutputValues && !recordedOutputValues) {
         if (_scene->cam().depthBuffer() && bounce == 0)
@@ -130,6 +253,7 @@ Vec3f PathTracer::traceSample(Vec2u pixel, PathSampleGenerator &sampler)
     return emission;
 
     } catch (std::runtime_error &e) {
+        RENDER_STAT(RenderStatistics::ErrorPaths);
         std::cout << tfm::format("Caught an internal error at pixel %s: %s", pixel, e.what()) << std::endl;
 
         return Vec3f(0.0f);
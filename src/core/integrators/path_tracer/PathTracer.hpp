@@ -2,20 +2,58 @@
 #define PATHTRACER_HPP_
 
 #include "PathTracerSettings.hpp"
+#include "SdTree.hpp"
 
 #include "integrators/TraceBase.hpp"
 
 namespace Tungsten {
 
-class PathTracer : public TraceBase
+class PathTracer : public TraceBase, private SurfaceDirectionSampler
 {
+    // Surface vertex of the current path that was sampled from the guiding
+    // distribution. Its incident radiance is the emission gathered after the
+    // vertex divided by the throughput up to and including the vertex
+    struct GuideVertex
+    {
+        SdTree::Region *region;
+        Vec3f d;
+        Vec3f throughput;
+        Vec3f emission;
+        Vec3f directEmission;
+        float pdf;
+        int bounce;
+    };
+
     PathTracerSettings _settings;
     bool _trackOutputValues;
 
+    SdTree *_guide;
+    bool _trainGuide;
+    std::vector<GuideVertex> _guideVertices;
+    // Region the last surface direction was sampled from, if it was guided
+    SdTree::Region *_guideRegion;
+
+    bool sampleGuided(SurfaceScatterEvent &event, const SdTree::Region &region, float &woPdf);
+    virtual bool sampleDirection(SurfaceScatterEvent &event, const IntersectionInfo &info) override;
+    void recordGuideVertices(const Vec3f &emission);
+
+    Vec3f tracePath(Vec2u pixel, PathSampleGenerator &sampler);
+
 public:
     PathTracer(TraceableScene *scene, const PathTracerSettings &settings, uint32 threadId);
 
+    // Enables guided sampling from the given tree. If train is set, the
+    // radiance estimates of all guided vertices are recorded into the tree
+    void setGuide(SdTree *guide, bool train)
+    {
+        _guide = guide;
+        _trainGuide = guide && train;
+    }
+
     Vec3f traceSample(Vec2u pixel, PathSampleGenerator &sampler);
+    // Traces a throwaway sample that is not recorded into the output
+    // buffers, the render statistics or the guiding tree
+    Vec3f tracePreviewSample(Vec2u pixel, PathSampleGenerator &sampler);
 };
 
 }
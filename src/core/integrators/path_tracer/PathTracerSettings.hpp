@@ -11,10 +11,16 @@ struct PathTracerSettings : public TraceSettings
 {
     bool enableLightSampling;
     bool enableVolumeLightSampling;
+    bool enableGuiding;
+    int guidingTrainingSpp;
+    float guidingBsdfFraction;
 
     PathTracerSettings()
     : enableLightSampling(true),
-      enableVolumeLightSampling(true)
+      enableVolumeLightSampling(true),
+      enableGuiding(false),
+      guidingTrainingSpp(64),
+      guidingBsdfFraction(0.5f)
     {
     }
 
@@ -23,6 +29,9 @@ struct PathTracerSettings : public TraceSettings
         TraceSettings::fromJson(value);
         value.getField("enable_light_sampling", enableLightSampling);
         value.getField("enable_volume_light_sampling", enableVolumeLightSampling);
+        value.getField("enable_guiding", enableGuiding);
+        value.getField("guiding_training_spp", guidingTrainingSpp);
+        value.getField("guiding_bsdf_fraction", guidingBsdfFraction);
     }
 
     rapidjson::Value toJson(rapidjson::Document::AllocatorType &allocator) const
@@ -30,7 +39,10 @@ struct PathTracerSettings : public TraceSettings
         return JsonObject{TraceSettings::toJson(allocator), allocator,
             "type", "path_tracer",
             "enable_light_sampling", enableLightSampling,
-            "enable_volume_light_sampling", enableVolumeLightSampling
+            "enable_volume_light_sampling", enableVolumeLightSampling,
+            "enable_guiding", enableGuiding,
+            "guiding_training_spp", guidingTrainingSpp,
+            "guiding_bsdf_fraction", guidingBsdfFraction
         };
     }
 };
@@ -0,0 +1,352 @@
+#include "SdTree.hpp"
+
+#include "math/MathUtil.hpp"
+
+#include <cmath>
+
+namespace Tungsten {
+
+static void atomicAdd(std::atomic<float> &dst, float add)
+{
+    float current = dst.load();
+    float desired = current + add;
+    while (!dst.compare_exchange_weak(current, desired))
+        desired = current + add;
+}
+
+// Returns the quadrant containing p and maps p into the local coordinates of that quadrant
+static int childQuadrant(Vec2f &p)
+{
+    int qx = p.x() >= 0.5f ? 1 : 0;
+    int qy = p.y() >= 0.5f ? 1 : 0;
+    p.x() = clamp(p.x()*2.0f - qx, 0.0f, 1.0f);
+    p.y() = clamp(p.y()*2.0f - qy, 0.0f, 1.0f);
+    return qx + 2*qy;
+}
+
+DTree::Node::Node()
+{
+    for (int i = 0; i < 4; ++i) {
+        sum[i].store(0.0f, std::memory_order_relaxed);
+        children[i] = 0;
+    }
+}
+
+DTree::Node::Node(const Node &o)
+{
+    *this = o;
+}
+
+DTree::Node &DTree::Node::operator=(const Node &o)
+{
+    for (int i = 0; i < 4; ++i) {
+        sum[i].store(o.sum[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        children[i] = o.children[i];
+    }
+    return *this;
+}
+
+DTree::DTree()
+: _nodes(1),
+  _sampleCount(0)
+{
+}
+
+DTree::DTree(const DTree &o)
+: _nodes(o._nodes),
+  _sampleCount(o.sampleCount())
+{
+}
+
+DTree &DTree::operator=(const DTree &o)
+{
+    _nodes = o._nodes;
+    _sampleCount.store(o.sampleCount(), std::memory_order_relaxed);
+    return *this;
+}
+
+void DTree::record(Vec2f p, float flux)
+{
+    _sampleCount.fetch_add(1, std::memory_order_relaxed);
+    if (!(flux > 0.0f) || std::isinf(flux))
+        return;
+
+    uint32 idx = 0;
+    while (true) {
+        int quadrant = childQuadrant(p);
+        atomicAdd(_nodes[idx].sum[quadrant], flux);
+        if (_nodes[idx].isLeaf(quadrant))
+            return;
+        idx = _nodes[idx].children[quadrant];
+    }
+}
+
+Vec2f DTree::sample(Vec2f xi) const
+{
+    CONSTEXPR float OneMinusEpsilon = 0.99999994f;
+
+    if (!(total() > 0.0f))
+        return xi;
+
+    Vec2f origin(0.0f);
+    float size = 1.0f;
+    uint32 idx = 0;
+    while (true) {
+        const Node &node = _nodes[idx];
+        float sums[4];
+        for (int i = 0; i < 4; ++i)
+            sums[i] = node.sum[i].load(std::memory_order_relaxed);
+
+        // Pick the column first, then the quadrant within the column
+        int qx = 0, qy = 0;
+        float pLeft = (sums[0] + sums[2])/(sums[0] + sums[1] + sums[2] + sums[3]);
+        if (xi.x() < pLeft) {
+            xi.x() /= pLeft;
+        } else {
+            xi.x() = (xi.x() - pLeft)/(1.0f - pLeft);
+            qx = 1;
+        }
+        float pBottom = sums[qx]/(sums[qx] + sums[qx + 2]);
+        if (xi.y() < pBottom) {
+            xi.y() /= pBottom;
+        } else {
+            xi.y() = (xi.y() - pBottom)/(1.0f - pBottom);
+            qy = 1;
+        }
+        xi.x() = min(xi.x(), OneMinusEpsilon);
+        xi.y() = min(xi.y(), OneMinusEpsilon);
+
+        size *= 0.5f;
+        origin += Vec2f(float(qx), float(qy))*size;
+
+        int quadrant = qx + 2*qy;
+        if (node.isLeaf(quadrant))
+            return origin + xi*size;
+        idx = node.children[quadrant];
+    }
+}
+
+float DTree::pdf(Vec2f p) const
+{
+    if (!(total() > 0.0f))
+        return 1.0f;
+
+    float result = 1.0f;
+    uint32 idx = 0;
+    while (true) {
+        const Node &node = _nodes[idx];
+        int quadrant = childQuadrant(p);
+        float sum = node.sum[quadrant].load(std::memory_order_relaxed);
+        if (!(sum > 0.0f))
+            return 0.0f;
+
+        result *= 4.0f*sum/node.total();
+        if (node.isLeaf(quadrant))
+            return result;
+        idx = node.children[quadrant];
+    }
+}
+
+void DTree::build(const DTree &previous, float subdivisionThreshold, int maxDepth)
+{
+    // Quadrants of leaf nodes in previous have no recorded structure below them.
+    // Their flux is assumed to be uniform when subdividing them further
+    struct StackNode
+    {
+        int64 previousIdx;
+        float flux;
+        uint32 idx;
+        int depth;
+    };
+
+    _nodes.clear();
+    _nodes.emplace_back();
+    _sampleCount.store(0, std::memory_order_relaxed);
+
+    float total = previous.total();
+    if (!(total > 0.0f))
+        return;
+
+    std::vector<StackNode> stack;
+    stack.push_back(StackNode{0, total, 0, 1});
+    while (!stack.empty()) {
+        StackNode node = stack.back();
+        stack.pop_back();
+
+        for (int i = 0; i < 4; ++i) {
+            float flux = node.flux*0.25f;
+            int64 previousChild = -1;
+            if (node.previousIdx >= 0) {
+                const Node &src = previous._nodes[node.previousIdx];
+                flux = src.sum[i].load(std::memory_order_relaxed);
+                if (!src.isLeaf(i))
+                    previousChild = src.children[i];
+            }
+
+            if (node.depth < maxDepth && flux/total > subdivisionThreshold) {
+                uint32 child = uint32(_nodes.size());
+                _nodes.emplace_back();
+                _nodes[node.idx].children[i] = child;
+                stack.push_back(StackNode{previousChild, flux, child, node.depth + 1});
+            }
+        }
+    }
+}
+
+void DTree::halve()
+{
+    for (Node &node : _nodes)
+        for (int i = 0; i < 4; ++i)
+            node.sum[i].store(node.sum[i].load(std::memory_order_relaxed)*0.5f, std::memory_order_relaxed);
+    _sampleCount.store(sampleCount()/2, std::memory_order_relaxed);
+}
+
+void DTree::saveState(OutputStreamHandle &out) const
+{
+    FileUtils::streamWrite(out, sampleCount());
+    FileUtils::streamWrite(out, uint32(_nodes.size()));
+    for (const Node &node : _nodes) {
+        for (int i = 0; i < 4; ++i) {
+            FileUtils::streamWrite(out, node.sum[i].load(std::memory_order_relaxed));
+            FileUtils::streamWrite(out, node.children[i]);
+        }
+    }
+}
+
+void DTree::loadState(InputStreamHandle &in)
+{
+    uint32 sampleCount, numNodes;
+    FileUtils::streamRead(in, sampleCount);
+    FileUtils::streamRead(in, numNodes);
+    _sampleCount.store(sampleCount, std::memory_order_relaxed);
+    _nodes.resize(numNodes);
+    for (Node &node : _nodes) {
+        for (int i = 0; i < 4; ++i) {
+            float sum;
+            FileUtils::streamRead(in, sum);
+            FileUtils::streamRead(in, node.children[i]);
+            node.sum[i].store(sum, std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t DTree::memoryUsage() const
+{
+    return _nodes.capacity()*sizeof(Node);
+}
+
+SdTree::SdTree(const Box3f &bounds)
+{
+    // Cubic bounds keep regions from degenerating into thin slabs
+    if (bounds.empty()) {
+        _bounds = Box3f(Vec3f(0.0f), Vec3f(1.0f));
+    } else {
+        float size = max(bounds.diagonal().max()*1.001f, 1e-3f);
+        _bounds = Box3f(bounds.min(), bounds.min() + size);
+    }
+    _nodes.emplace_back(0);
+}
+
+template<typename NodeVector>
+static uint32 findLeaf(const NodeVector &nodes, const Box3f &bounds, Vec3f p)
+{
+    p = (p - bounds.min())/bounds.diagonal();
+    uint32 idx = 0;
+    while (!nodes[idx].isLeaf()) {
+        int axis = nodes[idx].axis;
+        int child = p[axis] >= 0.5f ? 1 : 0;
+        p[axis] = clamp(p[axis]*2.0f - child, 0.0f, 1.0f);
+        idx = nodes[idx].children[child];
+    }
+    return idx;
+}
+
+SdTree::Region &SdTree::lookup(Vec3f p)
+{
+    return _nodes[findLeaf(_nodes, _bounds, p)].region;
+}
+
+const SdTree::Region &SdTree::lookup(Vec3f p) const
+{
+    return _nodes[findLeaf(_nodes, _bounds, p)].region;
+}
+
+void SdTree::refine(uint32 spatialThreshold, float directionalThreshold, int maxDirectionalDepth)
+{
+    // Children are appended to the node list and revisited by this loop,
+    // so regions keep splitting until they are below the threshold
+    for (size_t i = 0; i < _nodes.size(); ++i) {
+        if (!_nodes[i].isLeaf() || _nodes[i].region.building.sampleCount() <= spatialThreshold)
+            continue;
+
+        Region region = _nodes[i].region;
+        region.building.halve();
+        int childAxis = (_nodes[i].axis + 1) % 3;
+
+        uint32 child = uint32(_nodes.size());
+        for (int j = 0; j < 2; ++j) {
+            _nodes.emplace_back(childAxis);
+            _nodes.back().region = region;
+        }
+        _nodes[i].children[0] = child;
+        _nodes[i].children[1] = child + 1;
+        _nodes[i].region = Region();
+    }
+
+    for (Node &node : _nodes) {
+        if (!node.isLeaf())
+            continue;
+        node.region.sampling = node.region.building;
+        node.region.building.build(node.region.sampling, directionalThreshold, maxDirectionalDepth);
+    }
+}
+
+void SdTree::saveState(OutputStreamHandle &out) const
+{
+    FileUtils::streamWrite(out, _bounds);
+    FileUtils::streamWrite(out, uint32(_nodes.size()));
+    for (const Node &node : _nodes) {
+        FileUtils::streamWrite(out, node.children[0]);
+        FileUtils::streamWrite(out, node.children[1]);
+        FileUtils::streamWrite(out, node.axis);
+        node.region.building.saveState(out);
+        node.region.sampling.saveState(out);
+    }
+}
+
+void SdTree::loadState(InputStreamHandle &in)
+{
+    uint32 numNodes;
+    FileUtils::streamRead(in, _bounds);
+    FileUtils::streamRead(in, numNodes);
+    _nodes.clear();
+    _nodes.reserve(numNodes);
+    for (uint32 i = 0; i < numNodes; ++i) {
+        _nodes.emplace_back(0);
+        Node &node = _nodes.back();
+        FileUtils::streamRead(in, node.children[0]);
+        FileUtils::streamRead(in, node.children[1]);
+        FileUtils::streamRead(in, node.axis);
+        node.region.building.loadState(in);
+        node.region.sampling.loadState(in);
+    }
+}
+
+size_t SdTree::numDirectionalNodes() const
+{
+    size_t result = 0;
+    for (const Node &node : _nodes)
+        if (node.isLeaf())
+            result += node.region.building.numNodes() + node.region.sampling.numNodes();
+    return result;
+}
+
+size_t SdTree::memoryUsage() const
+{
+    size_t result = _nodes.capacity()*sizeof(Node);
+    for (const Node &node : _nodes)
+        result += node.region.building.memoryUsage() + node.region.sampling.memoryUsage();
+    return result;
+}
+
+}
@@ -0,0 +1,187 @@
+#ifndef SDTREE_HPP_
+#define SDTREE_HPP_
+
+#include "math/Angle.hpp"
+#include "math/Box.hpp"
+#include "math/Vec.hpp"
+
+#include "io/FileUtils.hpp"
+
+#include "IntTypes.hpp"
+
+#include <vector>
+#include <atomic>
+
+namespace Tungsten {
+
+// Piecewise constant distribution over the sphere of directions, stored as a
+// quadtree over the cylindrical parametrization (cos theta, phi) of the sphere.
+// The parametrization is area preserving, so densities on the unit square only
+// differ from solid angle densities by a factor of 4 pi. Every node stores the
+// radiance flux recorded in each of its quadrants. Records are added with
+// atomics, so that all render threads can train the same tree concurrently
+class DTree
+{
+    struct Node
+    {
+        std::atomic<float> sum[4];
+        uint32 children[4];
+
+        Node();
+        Node(const Node &o);
+        Node &operator=(const Node &o);
+
+        bool isLeaf(int quadrant) const
+        {
+            return children[quadrant] == 0;
+        }
+
+        float total() const
+        {
+            return sum[0].load(std::memory_order_relaxed) + sum[1].load(std::memory_order_relaxed) +
+                   sum[2].load(std::memory_order_relaxed) + sum[3].load(std::memory_order_relaxed);
+        }
+    };
+
+    std::vector<Node> _nodes;
+    std::atomic<uint32> _sampleCount;
+
+public:
+    DTree();
+    DTree(const DTree &o);
+    DTree &operator=(const DTree &o);
+
+    static Vec2f dirToCanonical(const Vec3f &d)
+    {
+        float cosTheta = clamp(d.z(), -1.0f, 1.0f);
+        float phi = std::atan2(d.y(), d.x());
+        if (phi < 0.0f)
+            phi += TWO_PI;
+        return Vec2f((cosTheta + 1.0f)*0.5f, phi*INV_TWO_PI);
+    }
+
+    static Vec3f canonicalToDir(const Vec2f &p)
+    {
+        float cosTheta = 2.0f*p.x() - 1.0f;
+        float sinTheta = std::sqrt(max(1.0f - cosTheta*cosTheta, 0.0f));
+        float phi = TWO_PI*p.y();
+        return Vec3f(std::cos(phi)*sinTheta, std::sin(phi)*sinTheta, cosTheta);
+    }
+
+    void record(Vec2f p, float flux);
+    Vec2f sample(Vec2f xi) const;
+    float pdf(Vec2f p) const;
+
+    // Rebuilds the tree structure from the flux recorded in previous. Quadrants
+    // holding more than subdivisionThreshold of the total flux are subdivided,
+    // all others are collapsed. The recorded flux of the new tree is zero
+    void build(const DTree &previous, float subdivisionThreshold, int maxDepth);
+
+    // Halves the recorded flux and sample count. Used when a spatial
+    // region is split and both halves inherit the same distribution
+    void halve();
+
+    void saveState(OutputStreamHandle &out) const;
+    void loadState(InputStreamHandle &in);
+
+    float total() const
+    {
+        return _nodes[0].total();
+    }
+
+    uint32 sampleCount() const
+    {
+        return _sampleCount.load(std::memory_order_relaxed);
+    }
+
+    size_t numNodes() const
+    {
+        return _nodes.size();
+    }
+
+    size_t memoryUsage() const;
+};
+
+// Spatio-directional tree from "Practical Path Guiding for Efficient Light-Transport
+// Simulation" [Mueller et al. 2017]. A binary tree subdivides the scene bounds,
+// alternating the split axis at every level; each leaf holds a directional tree
+// that is being trained during the current iteration and a directional tree
+// trained during the previous iteration, which is used for sampling.
+class SdTree
+{
+public:
+    struct Region
+    {
+        DTree building;
+        DTree sampling;
+
+        void record(const Vec3f &d, float flux)
+        {
+            building.record(DTree::dirToCanonical(d), flux);
+        }
+
+        Vec3f sample(Vec2f xi) const
+        {
+            return DTree::canonicalToDir(sampling.sample(xi));
+        }
+
+        float pdf(const Vec3f &d) const
+        {
+            return sampling.pdf(DTree::dirToCanonical(d))*INV_FOUR_PI;
+        }
+
+        bool canSample() const
+        {
+            return sampling.total() > 0.0f;
+        }
+    };
+
+private:
+    struct Node
+    {
+        uint32 children[2];
+        int axis;
+        Region region;
+
+        Node(int axis_)
+        : axis(axis_)
+        {
+            children[0] = children[1] = 0;
+        }
+
+        bool isLeaf() const
+        {
+            return children[0] == 0;
+        }
+    };
+
+    Box3f _bounds;
+    std::vector<Node> _nodes;
+
+public:
+    SdTree(const Box3f &bounds);
+
+    Region &lookup(Vec3f p);
+    const Region &lookup(Vec3f p) const;
+
+    // Ends a training iteration. Spatial leaves that received more than
+    // spatialThreshold records are split, and every directional tree is
+    // rebuilt from the flux recorded during the iteration, which then
+    // becomes the sampling distribution of the next iteration
+    void refine(uint32 spatialThreshold, float directionalThreshold, int maxDirectionalDepth);
+
+    void saveState(OutputStreamHandle &out) const;
+    void loadState(InputStreamHandle &in);
+
+    size_t numSpatialNodes() const
+    {
+        return _nodes.size();
+    }
+
+    size_t numDirectionalNodes() const;
+    size_t memoryUsage() const;
+};
+
+}
+
+#endif /* SDTREE_HPP_ */
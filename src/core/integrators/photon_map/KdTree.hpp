@@ -264,6 +264,45 @@ public:
         return 0;
     }
 
+    template<typename Traverser>
+    inline void rangeQuery(Vec3f pos, float radius, Traverser traverser) const
+    {
+        if (_treeEnd == 0)
+            return;
+
+        const float radiusSq = radius*radius;
+
+        const PhotonType *stack[28];
+        const PhotonType **stackPtr = stack;
+
+        const PhotonType *current = &_nodes[0];
+        while (true) {
+            float dSq = (current->pos - pos).lengthSq();
+            if (dSq < radiusSq)
+                traverser(*current, dSq);
+
+            uint32 splitDim = current->splitDim();
+            float planeDist = pos[splitDim] - current->pos[splitDim];
+            bool traverseLeft  = current->hasLeftChild () && (planeDist <= 0.0f || planeDist*planeDist < radiusSq);
+            bool traverseRight = current->hasRightChild() && (planeDist >= 0.0f || planeDist*planeDist < radiusSq);
+
+            uint32 childIdx = current->childIdx();
+            if (traverseLeft && traverseRight) {
+                *stackPtr++ = &_nodes[childIdx + 1];
+                current = &_nodes[childIdx];
+            } else if (traverseLeft) {
+                current = &_nodes[childIdx];
+            } else if (traverseRight) {
+                current = &_nodes[childIdx + 1];
+            } else {
+                if (stackPtr == stack)
+                    return;
+                else
+                    current = *--stackPtr;
+            }
+        }
+    }
+
     template<typename Traverser>
     inline void beamQuery(Vec3f pos, Vec3f dir, float farT, Traverser traverser) const
     {
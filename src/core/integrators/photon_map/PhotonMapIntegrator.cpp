@@ -1,6 +1,8 @@
 #include "PhotonMapIntegrator.hpp"
 #include "PhotonTracer.hpp"
 
+#include "integrators/SampleCost.hpp"
+
 #include "sampling/UniformPathSampler.hpp"
 #include "sampling/SobolPathSampler.hpp"
 
@@ -11,6 +13,8 @@
 
 #include "bvh/BinaryBvh.hpp"
 
+#include "Timeline.hpp"
+
 namespace Tungsten {
 
 CONSTEXPR uint32 PhotonMapIntegrator::TileSize;
@@ -41,6 +45,7 @@ void PhotonMapIntegrator::diceTiles()
             );
         }
     }
+    _tileQueue.init(uint32(_tiles.size()));
 }
 
 void PhotonMapIntegrator::saveState(OutputStreamHandle &/*out*/)
@@ -53,6 +58,8 @@ void PhotonMapIntegrator::loadState(InputStreamHandle &/*in*/)
 
 void PhotonMapIntegrator::tracePhotons(uint32 taskId, uint32 numSubTasks, uint32 threadId, uint32 sampleBase)
 {
+    Timeline::Scope scope("Trace photons");
+
     SubTaskData &data = _taskData[taskId];
     PathSampleGenerator &sampler = *_samplers[taskId];
 
@@ -85,9 +92,16 @@ void PhotonMapIntegrator::tracePhotons(uint32 taskId, uint32 numSubTasks, uint32
     _totalTracedPathPhotons += totalPathsCast;
 }
 
-void PhotonMapIntegrator::tracePixels(uint32 tileId, uint32 threadId, float surfaceRadius, float volumeRadius)
+void PhotonMapIntegrator::tracePixels(uint32 threadId, float surfaceRadius, float volumeRadius)
 {
+    uint32 tileId;
+    if (!_tileQueue.pop(threadId, tileId))
+        return;
+
+    Timeline::Scope scope("Gather");
+
     int spp = _nextSpp - _currentSpp;
+    SampleCost cost(_scene->cam().costBuffer());
 
     ImageTile &tile = _tiles[tileId];
     for (uint32 y = 0; y < tile.h; ++y) {
@@ -96,6 +110,7 @@ void PhotonMapIntegrator::tracePixels(uint32 tileId, uint32 threadId, float surf
             uint32 pixelIndex = pixel.x() + pixel.y()*_w;
 
             for (int i = 0; i < spp; ++i) {
+                cost.start();
                 tile.sampler->startPath(pixelIndex, _currentSpp + i);
                 Vec3f c = _tracers[threadId]->traceSample(pixel,
                     *_surfaceTree,
@@ -106,6 +121,7 @@ void PhotonMapIntegrator::tracePixels(uint32 tileId, uint32 threadId, float surf
                     surfaceRadius,
                     volumeRadius
                 );
+                cost.stop(pixel);
                 _scene->cam().colorBuffer()->addSample(pixel, c);
             }
         }
@@ -151,11 +167,14 @@ std::unique_ptr<KdTree<PhotonType>> streamCompactAndBuild(std::vector<PhotonRang
     for (uint32 i = 0; i < tail; ++i)
         photons[i].power *= scale;
 
+    Timeline::Scope scope("Build KdTree");
     return std::unique_ptr<KdTree<PhotonType>>(new KdTree<PhotonType>(&photons[0], tail));
 }
 
 void PhotonMapIntegrator::buildBeamBvh(std::vector<PathPhotonRange> pathRanges, float volumeRadiusScale)
 {
+    Timeline::Scope scope("Build beam BVH");
+
     float radius = _settings.volumeGatherRadius*volumeRadiusScale;
 
     Bvh::PrimVector beams;
@@ -208,6 +227,7 @@ void PhotonMapIntegrator::buildPhotonDataStructures(float volumeRadiusScale)
     if (!_volumePhotons.empty()) {
         _volumeTree = streamCompactAndBuild(volumeRanges, _volumePhotons, _totalTracedVolumePhotons);
         float volumeRadius = _settings.fixedVolumeRadius ? _settings.volumeGatherRadius : 1.0f;
+        Timeline::Scope scope("Build volume hierarchy");
         _volumeTree->buildVolumeHierarchy(_settings.fixedVolumeRadius, volumeRadius*volumeRadiusScale);
     } else if (!_pathPhotons.empty()) {
         buildBeamBvh(std::move(pathRanges), volumeRadiusScale);
@@ -304,8 +324,9 @@ void PhotonMapIntegrator::startRender(std::function<void()> completionCallback)
             }
         );
     } else {
+        _tileQueue.reset();
         _group = ThreadUtils::pool->enqueue(
-            std::bind(&PhotonMapIntegrator::tracePixels, this, _1, _3, _settings.gatherRadius,
+            std::bind(&PhotonMapIntegrator::tracePixels, this, _3, _settings.gatherRadius,
                     _settings.volumeGatherRadius),
             _tiles.size(),
             [&, completionCallback]() {
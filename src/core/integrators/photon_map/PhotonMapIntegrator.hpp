@@ -11,6 +11,7 @@
 
 #include "sampling/PathSampleGenerator.hpp"
 
+#include "thread/NumaWorkQueue.hpp"
 #include "thread/TaskGroup.hpp"
 
 #include "math/MathUtil.hpp"
@@ -40,6 +41,7 @@ protected:
     };
 
     std::vector<ImageTile> _tiles;
+    NumaWorkQueue _tileQueue;
 
     PhotonMapSettings _settings;
 
@@ -71,7 +73,7 @@ protected:
     virtual void loadState(InputStreamHandle &in) override;
 
     void tracePhotons(uint32 taskId, uint32 numSubTasks, uint32 threadId, uint32 sampleBase);
-    void tracePixels(uint32 tileId, uint32 threadId, float surfaceRadius, float volumeRadius);
+    void tracePixels(uint32 threadId, float surfaceRadius, float volumeRadius);
 
     void buildBeamBvh(std::vector<PathPhotonRange> pathRanges, float volumeRadiusScale);
     void buildPhotonDataStructures(float volumeRadiusScale);
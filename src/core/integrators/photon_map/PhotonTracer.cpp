@@ -52,12 +52,15 @@ void PhotonTracer::tracePhoton(SurfacePhotonRange &surfaceRange, VolumePhotonRan
 
         if (medium) {
             MediumSample mediumSample;
+            RENDER_STAT(RenderStatistics::MediumSamples);
+            state.throughput = throughput;
             if (!medium->sampleDistance(sampler, ray, state, mediumSample))
                 break;
             throughput *= mediumSample.weight;
             hitSurface = mediumSample.exited;
 
             if (!hitSurface) {
+                RENDER_STAT(RenderStatistics::MediumScatterEvents);
                 if (!volumeRange.full()) {
                     VolumePhoton &p = volumeRange.addPhoton();
                     p.pos = mediumSample.p;
@@ -69,8 +69,9 @@ void ProgressivePhotonMapIntegrator::renderSegment(std::function<void()> complet
 
     buildPhotonDataStructures(volumeScale);
 
+    _tileQueue.reset();
     ThreadUtils::pool->yield(*ThreadUtils::pool->enqueue(
-        std::bind(&ProgressivePhotonMapIntegrator::tracePixels, this, _1, _3, surfaceRadius, volumeRadius),
+        std::bind(&ProgressivePhotonMapIntegrator::tracePixels, this, _3, surfaceRadius, volumeRadius),
         _tiles.size(),
         [](){}
     ));
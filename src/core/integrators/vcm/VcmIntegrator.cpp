@@ -0,0 +1,251 @@
+#include "VcmIntegrator.hpp"
+
+#include "integrators/SampleCost.hpp"
+
+#include "sampling/UniformPathSampler.hpp"
+#include "sampling/SobolPathSampler.hpp"
+
+#include "cameras/Camera.hpp"
+
+#include "thread/ThreadUtils.hpp"
+#include "thread/ThreadPool.hpp"
+
+#include "Timeline.hpp"
+
+namespace Tungsten {
+
+CONSTEXPR uint32 VcmIntegrator::TileSize;
+
+VcmIntegrator::VcmIntegrator()
+: Integrator(),
+  _w(0),
+  _h(0),
+  _sampler(0xBA5EBA11)
+{
+}
+
+void VcmIntegrator::diceTiles()
+{
+    for (uint32 y = 0; y < _h; y += TileSize) {
+        for (uint32 x = 0; x < _w; x += TileSize) {
+            _tiles.emplace_back(
+                x,
+                y,
+                min(TileSize, _w - x),
+                min(TileSize, _h - y),
+                _scene->rendererSettings().useSobol() ?
+                    std::unique_ptr<PathSampleGenerator>(new SobolPathSampler(MathUtil::hash32(_sampler.nextI()))) :
+                    std::unique_ptr<PathSampleGenerator>(new UniformPathSampler(MathUtil::hash32(_sampler.nextI())))
+            );
+        }
+    }
+    _tileQueue.init(uint32(_tiles.size()));
+}
+
+void VcmIntegrator::traceLightPaths(uint32 taskId, uint32 numSubTasks, uint32 threadId, uint32 sample)
+{
+    Timeline::Scope scope("Trace light paths");
+
+    PathSampleGenerator &sampler = *_samplers[taskId];
+    std::vector<LightVertex> &vertices = _taskVertices[taskId];
+    vertices.clear();
+
+    uint32 pathCount = uint32(_lightPaths.size());
+    uint32 start = intLerp(0, pathCount, taskId + 0, numSubTasks);
+    uint32 end   = intLerp(0, pathCount, taskId + 1, numSubTasks);
+    for (uint32 i = start; i < end; ++i) {
+        sampler.startPath(i, sample);
+        _tracers[threadId]->traceLightPath(sampler, i, _lightPaths[i], vertices);
+    }
+}
+
+void VcmIntegrator::buildLightVertexTree()
+{
+    std::vector<size_t> offsets(_taskVertices.size() + 1, 0);
+    for (size_t i = 0; i < _taskVertices.size(); ++i)
+        offsets[i + 1] = offsets[i] + _taskVertices[i].size();
+    _lightVertices.resize(offsets.back());
+
+    ThreadUtils::pool->yield(*ThreadUtils::pool->enqueue([&](uint32 taskId, uint32, uint32) {
+        std::copy(_taskVertices[taskId].begin(), _taskVertices[taskId].end(), _lightVertices.begin() + offsets[taskId]);
+    }, _taskVertices.size(), [](){}));
+
+    // Subtrees above 100k vertices are built in parallel on the thread pool
+    Timeline::Scope scope("Build KdTree");
+    _tree.reset(new KdTree<LightVertex>(_lightVertices.data(), uint32(_lightVertices.size())));
+}
+
+void VcmIntegrator::renderTile(uint32 id, uint32 sample, float mergeRadius, float mergeArea)
+{
+    uint32 tileId;
+    if (!_tileQueue.pop(id, tileId))
+        return;
+
+    SampleCost cost(_scene->cam().costBuffer());
+
+    ImageTile &tile = _tiles[tileId];
+    for (uint32 y = 0; y < tile.h; ++y) {
+        for (uint32 x = 0; x < tile.w; ++x) {
+            Vec2u pixel(tile.x + x, tile.y + y);
+            uint32 pixelIndex = pixel.x() + pixel.y()*_w;
+
+            cost.start();
+            tile.sampler->startPath(pixelIndex, sample);
+            Vec3f c = _tracers[id]->traceSample(pixel, _lightPaths, *_tree, mergeRadius, mergeArea, *tile.sampler);
+            cost.stop(pixel);
+
+            _scene->cam().colorBuffer()->addSample(pixel, c);
+        }
+    }
+}
+
+void VcmIntegrator::renderSegment(std::function<void()> completionCallback)
+{
+    using namespace std::placeholders;
+
+    _scene->cam().setSplatWeight(1.0/(_w*_h*_nextSpp));
+
+    for (uint32 sample = _currentSpp; sample < _nextSpp; ++sample) {
+        ThreadUtils::pool->yield(*ThreadUtils::pool->enqueue(
+            std::bind(&VcmIntegrator::traceLightPaths, this, _1, _2, _3, sample),
+            _tracers.size(),
+            [](){}
+        ));
+
+        buildLightVertexTree();
+
+        // Same radius reduction as progressive photon mapping
+        float gamma = 1.0f;
+        for (uint32 i = 1; i <= sample; ++i)
+            gamma *= (i + _settings.alpha)/(i + 1.0f);
+        float mergeRadius = _settings.mergeRadius*std::sqrt(gamma);
+        float mergeArea = PI*mergeRadius*mergeRadius*_lightPaths.size();
+
+        _tileQueue.reset();
+        ThreadUtils::pool->yield(*ThreadUtils::pool->enqueue(
+            std::bind(&VcmIntegrator::renderTile, this, _3, sample, mergeRadius, mergeArea),
+            _tiles.size(),
+            [](){}
+        ));
+    }
+
+    _tree.reset();
+
+    _currentSpp = _nextSpp;
+    advanceSpp();
+
+    completionCallback();
+}
+
+// Light paths and merge radii only depend on the sample index, so the
+// sampler states are all that is needed to continue a render
+void VcmIntegrator::saveState(OutputStreamHandle &out)
+{
+    for (ImageTile &i : _tiles)
+        i.sampler->saveState(out);
+    for (std::unique_ptr<PathSampleGenerator> &s : _samplers)
+        s->saveState(out);
+}
+
+void VcmIntegrator::loadState(InputStreamHandle &in)
+{
+    for (ImageTile &i : _tiles)
+        i.sampler->loadState(in);
+    for (std::unique_ptr<PathSampleGenerator> &s : _samplers)
+        s->loadState(in);
+}
+
+void VcmIntegrator::fromJson(JsonPtr value, const Scene &/*scene*/)
+{
+    _settings.fromJson(value);
+}
+
+rapidjson::Value VcmIntegrator::toJson(Allocator &allocator) const
+{
+    return _settings.toJson(allocator);
+}
+
+void VcmIntegrator::prepareForRender(TraceableScene &scene, uint32 seed)
+{
+    _currentSpp = 0;
+    _sampler = UniformSampler(MathUtil::hash32(seed));
+    _scene = &scene;
+    advanceSpp();
+
+    _w = scene.cam().resolution().x();
+    _h = scene.cam().resolution().y();
+    scene.cam().requestColorBuffer();
+    scene.cam().requestSplatBuffer();
+
+    // One light path per pixel. Paths start out empty and grow to the length they
+    // are traced to
+    _lightPaths.reserve(_w*_h);
+    for (uint32 i = 0; i < _w*_h; ++i)
+        _lightPaths.emplace_back(0);
+
+    for (uint32 i = 0; i < ThreadUtils::pool->threadCount(); ++i) {
+        _tracers.emplace_back(new VcmTracer(&scene, _settings, i));
+        _samplers.emplace_back(_scene->rendererSettings().useSobol() ?
+            std::unique_ptr<PathSampleGenerator>(new SobolPathSampler(MathUtil::hash32(_sampler.nextI()))) :
+            std::unique_ptr<PathSampleGenerator>(new UniformPathSampler(MathUtil::hash32(_sampler.nextI())))
+        );
+    }
+    _taskVertices.resize(_tracers.size());
+
+    diceTiles();
+}
+
+void VcmIntegrator::teardownAfterRender()
+{
+    _group.reset();
+    _tree.reset();
+
+    _tracers      .clear();
+    _samplers     .clear();
+    _tiles        .clear();
+    _lightPaths   .clear();
+    _taskVertices .clear();
+    _lightVertices.clear();
+    _tracers      .shrink_to_fit();
+    _samplers     .shrink_to_fit();
+    _tiles        .shrink_to_fit();
+    _lightPaths   .shrink_to_fit();
+    _taskVertices .shrink_to_fit();
+    _lightVertices.shrink_to_fit();
+}
+
+bool VcmIntegrator::supportsResumeRender() const
+{
+    return true;
+}
+
+void VcmIntegrator::startRender(std::function<void()> completionCallback)
+{
+    if (done()) {
+        completionCallback();
+        return;
+    }
+
+    _group = ThreadUtils::pool->enqueue([&, completionCallback](uint32, uint32, uint32) {
+        renderSegment(completionCallback);
+    }, 1, [](){});
+}
+
+void VcmIntegrator::waitForCompletion()
+{
+    if (_group) {
+        _group->wait();
+        _group.reset();
+    }
+}
+
+void VcmIntegrator::abortRender()
+{
+    if (_group) {
+        _group->abort();
+        _group->wait();
+        _group.reset();
+    }
+}
+
+}
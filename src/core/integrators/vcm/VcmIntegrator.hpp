@@ -0,0 +1,81 @@
+#ifndef VCMINTEGRATOR_HPP_
+#define VCMINTEGRATOR_HPP_
+
+#include "VcmSettings.hpp"
+#include "VcmTracer.hpp"
+
+#include "integrators/bidirectional_path_tracer/LightPath.hpp"
+#include "integrators/photon_map/KdTree.hpp"
+#include "integrators/Integrator.hpp"
+#include "integrators/ImageTile.hpp"
+
+#include "sampling/PathSampleGenerator.hpp"
+#include "sampling/UniformSampler.hpp"
+
+#include "thread/NumaWorkQueue.hpp"
+#include "thread/TaskGroup.hpp"
+
+#include "math/MathUtil.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace Tungsten {
+
+// Vertex connection and merging. Every sample per pixel is one iteration: a light
+// path is traced for every pixel, its surface vertices are put into a kd-tree, and
+// camera paths are both connected to the light path of their pixel (as in BDPT)
+// and merged with all light vertices within the merge radius (as in progressive
+// photon mapping). The merge radius shrinks with every iteration
+class VcmIntegrator : public Integrator
+{
+    static CONSTEXPR uint32 TileSize = 16;
+
+    VcmSettings _settings;
+
+    std::shared_ptr<TaskGroup> _group;
+
+    uint32 _w;
+    uint32 _h;
+
+    UniformSampler _sampler;
+    std::vector<std::unique_ptr<VcmTracer>> _tracers;
+    std::vector<std::unique_ptr<PathSampleGenerator>> _samplers;
+
+    std::vector<ImageTile> _tiles;
+    NumaWorkQueue _tileQueue;
+
+    std::vector<LightPath> _lightPaths;
+    std::vector<std::vector<LightVertex>> _taskVertices;
+    std::vector<LightVertex> _lightVertices;
+    std::unique_ptr<KdTree<LightVertex>> _tree;
+
+    void diceTiles();
+
+    void traceLightPaths(uint32 taskId, uint32 numSubTasks, uint32 threadId, uint32 sample);
+    void buildLightVertexTree();
+    void renderTile(uint32 id, uint32 sample, float mergeRadius, float mergeArea);
+    void renderSegment(std::function<void()> completionCallback);
+
+    virtual void saveState(OutputStreamHandle &out) override;
+    virtual void loadState(InputStreamHandle &in) override;
+
+public:
+    VcmIntegrator();
+
+    virtual void fromJson(JsonPtr value, const Scene &scene) override;
+    virtual rapidjson::Value toJson(Allocator &allocator) const override;
+
+    virtual void prepareForRender(TraceableScene &scene, uint32 seed) override;
+    virtual void teardownAfterRender() override;
+
+    virtual bool supportsResumeRender() const override;
+
+    virtual void startRender(std::function<void()> completionCallback) override;
+    virtual void waitForCompletion() override;
+    virtual void abortRender() override;
+};
+
+}
+
+#endif /* VCMINTEGRATOR_HPP_ */
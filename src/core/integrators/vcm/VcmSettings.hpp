@@ -0,0 +1,40 @@
+#ifndef VCMSETTINGS_HPP_
+#define VCMSETTINGS_HPP_
+
+#include "integrators/TraceSettings.hpp"
+
+#include "io/JsonObject.hpp"
+
+namespace Tungsten {
+
+struct VcmSettings : public TraceSettings
+{
+    float mergeRadius;
+    float alpha;
+
+    VcmSettings()
+    : mergeRadius(0.01f),
+      alpha(0.75f)
+    {
+    }
+
+    void fromJson(JsonPtr value)
+    {
+        TraceSettings::fromJson(value);
+        value.getField("merge_radius", mergeRadius);
+        value.getField("alpha", alpha);
+    }
+
+    rapidjson::Value toJson(rapidjson::Document::AllocatorType &allocator) const
+    {
+        return JsonObject{TraceSettings::toJson(allocator), allocator,
+            "type", "vcm",
+            "merge_radius", mergeRadius,
+            "alpha", alpha
+        };
+    }
+};
+
+}
+
+#endif /* VCMSETTINGS_HPP_ */
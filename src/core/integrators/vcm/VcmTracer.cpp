@@ -0,0 +1,92 @@
+#include "VcmTracer.hpp"
+
+namespace Tungsten {
+
+VcmTracer::VcmTracer(TraceableScene *scene, const VcmSettings &settings, uint32 threadId)
+: TraceBase(scene, settings, threadId),
+  _splatBuffer(scene->cam().splatBuffer()),
+  _cameraPath(new LightPath(settings.maxBounces + 1)),
+  _emitterPath(new LightPath(settings.maxBounces + 1))
+{
+}
+
+void VcmTracer::traceLightPath(PathSampleGenerator &sampler, uint32 pathIndex, LightPath &path,
+        std::vector<LightVertex> &vertices)
+{
+    LightPath &emitterPath = *_emitterPath;
+
+    float lightPdf;
+    const Primitive *light = chooseLightAdjoint(sampler, lightPdf);
+
+    emitterPath.startEmitterPath(light, lightPdf);
+    emitterPath.tracePath(*_scene, *this, sampler);
+
+    // Light paths are kept for the whole iteration, so they are stored compactly
+    // instead of at the maximum path length
+    path.copy(emitterPath);
+
+    for (int i = 1; i < path.length(); ++i) {
+        const PathVertex &v = path[i];
+        if (!v.onSurface() || !v.connectable() || v.isInfiniteSurface())
+            continue;
+
+        LightVertex vertex;
+        vertex.bounce = path.vertexIndex(i);
+        vertex.pos = v.pos();
+        vertex.pathIndex = pathIndex;
+        vertex.vertexIndex = i;
+        vertices.push_back(vertex);
+    }
+}
+
+Vec3f VcmTracer::traceSample(Vec2u pixel, const std::vector<LightPath> &lightPaths, const KdTree<LightVertex> &tree,
+        float mergeRadius, float mergeArea, PathSampleGenerator &sampler)
+{
+    LightPath &cameraPath = *_cameraPath;
+    const LightPath &emitterPath = lightPaths[pixel.x() + pixel.y()*_scene->cam().resolution().x()];
+
+    cameraPath.startCameraPath(&_scene->cam(), pixel);
+    cameraPath.tracePath(*_scene, *this, sampler);
+
+    int cameraLength =  cameraPath.length();
+    int  lightLength = emitterPath.length();
+
+    Vec3f result = cameraPath.bdptWeightedPathEmission(_settings.minBounces + 2, _settings.maxBounces + 1, mergeArea);
+    for (int s = 1; s <= lightLength; ++s) {
+        int upperBound = min(_settings.maxBounces - s + 1, cameraLength);
+        for (int t = 1; t <= upperBound; ++t) {
+            if (!cameraPath[t - 1].connectable() || !emitterPath[s - 1].connectable())
+                continue;
+
+            if (t == 1) {
+                Vec2f pixel;
+                Vec3f splatWeight;
+                if (LightPath::bdptCameraConnect(*this, cameraPath, emitterPath, s, _settings.maxBounces,
+                        sampler, splatWeight, pixel, mergeArea))
+                    _splatBuffer->splatFiltered(pixel, splatWeight);
+            } else {
+                result += LightPath::bdptConnect(*this, cameraPath, emitterPath, s, t, _settings.maxBounces,
+                        sampler, mergeArea);
+            }
+        }
+    }
+
+    for (int t = 2; t <= cameraLength; ++t) {
+        const PathVertex &b = cameraPath[t - 1];
+        if (!b.onSurface() || !b.connectable() || b.isInfiniteSurface())
+            continue;
+        // Merged light vertices contribute at least one more bounce
+        int cameraBounce = cameraPath.vertexIndex(t - 1);
+        if (cameraBounce >= _settings.maxBounces)
+            break;
+
+        tree.rangeQuery(b.pos(), mergeRadius, [&](const LightVertex &v, float /*distSq*/) {
+            result += LightPath::vcmMerge(cameraPath, lightPaths[v.pathIndex], v.vertexIndex + 1, t,
+                    _settings.maxBounces, mergeArea);
+        });
+    }
+
+    return result;
+}
+
+}
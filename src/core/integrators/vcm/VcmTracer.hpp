@@ -0,0 +1,42 @@
+#ifndef VCMTRACER_HPP_
+#define VCMTRACER_HPP_
+
+#include "VcmSettings.hpp"
+
+#include "integrators/bidirectional_path_tracer/LightPath.hpp"
+#include "integrators/photon_map/KdTree.hpp"
+#include "integrators/photon_map/Photon.hpp"
+#include "integrators/TraceBase.hpp"
+
+#include <vector>
+
+namespace Tungsten {
+
+// Light path vertex available for merging. The photon fields other than the
+// position and bounce are unused; the vertex itself is looked up in the light path
+struct LightVertex : public Photon
+{
+    uint32 pathIndex;
+    uint32 vertexIndex;
+};
+
+class VcmTracer : public TraceBase
+{
+    AtomicFramebuffer *_splatBuffer;
+
+    std::unique_ptr<LightPath> _cameraPath;
+    std::unique_ptr<LightPath> _emitterPath;
+
+public:
+    VcmTracer(TraceableScene *scene, const VcmSettings &settings, uint32 threadId);
+
+    void traceLightPath(PathSampleGenerator &sampler, uint32 pathIndex, LightPath &path,
+            std::vector<LightVertex> &vertices);
+
+    Vec3f traceSample(Vec2u pixel, const std::vector<LightPath> &lightPaths, const KdTree<LightVertex> &tree,
+            float mergeRadius, float mergeArea, PathSampleGenerator &sampler);
+};
+
+}
+
+#endif /* VCMTRACER_HPP_ */
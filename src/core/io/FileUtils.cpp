@@ -34,6 +34,7 @@ static Path getNativeCurrentDir();
 
 std::unordered_map<Path, std::shared_ptr<ZipReader>> FileUtils::_archives;
 std::unordered_map<const std::ios *, FileUtils::StreamMetadata> FileUtils::_metaData;
+std::mutex FileUtils::_streamMutex;
 Path FileUtils::_currentDir = getNativeCurrentDir();
 
 typedef std::string::size_type SizeType;
@@ -247,6 +248,7 @@ static Path getNativeCurrentDir()
 
 void FileUtils::finalizeStream(std::ios *stream)
 {
+    std::unique_lock<std::mutex> lock(_streamMutex);
     auto iter = _metaData.find(stream);
 
     delete stream;
@@ -270,7 +272,10 @@ OutputStreamHandle FileUtils::openFileOutputStream(const Path &p)
     std::unique_ptr<FileOutputStreambuf> streambuf(new FileOutputStreambuf(std::move(file)));
     std::shared_ptr<std::ostream> out(new std::ostream(streambuf.get()),
             [](std::ostream *stream){ finalizeStream(stream); });
-    _metaData.insert(std::make_pair(out.get(), std::move(StreamMetadata(std::move(streambuf)))));
+    {
+        std::unique_lock<std::mutex> lock(_streamMutex);
+        _metaData.insert(std::make_pair(out.get(), std::move(StreamMetadata(std::move(streambuf)))));
+    }
 #else
     std::shared_ptr<std::ostream> out(new std::ofstream(p.absolute().asString(),
             std::ios_base::out | std::ios_base::binary),
@@ -279,6 +284,7 @@ OutputStreamHandle FileUtils::openFileOutputStream(const Path &p)
     if (!out->good())
         return nullptr;
 
+    std::unique_lock<std::mutex> lock(_streamMutex);
     _metaData.insert(std::make_pair(out.get(), StreamMetadata()));
 #endif
 
@@ -288,9 +294,12 @@ OutputStreamHandle FileUtils::openFileOutputStream(const Path &p)
 std::shared_ptr<ZipReader> FileUtils::openArchive(const Path &p)
 {
     Path key = p.normalize();
-    auto iter = _archives.find(key);
-    if (iter != _archives.end())
-        return iter->second;
+    {
+        std::unique_lock<std::mutex> lock(_streamMutex);
+        auto iter = _archives.find(key);
+        if (iter != _archives.end())
+            return iter->second;
+    }
 
     std::shared_ptr<ZipReader> archive;
     try {
@@ -299,8 +308,8 @@ std::shared_ptr<ZipReader> FileUtils::openArchive(const Path &p)
         return nullptr;
     }
 
-    _archives.insert(std::make_pair(key, archive));
-    return std::move(archive);
+    std::unique_lock<std::mutex> lock(_streamMutex);
+    return _archives.insert(std::make_pair(key, archive)).first->second;
 }
 
 bool FileUtils::recursiveArchiveFind(const Path &p, std::shared_ptr<ZipReader> &archive,
@@ -562,7 +571,10 @@ InputStreamHandle FileUtils::openInputStream(const Path &p)
         std::unique_ptr<FileInputStreambuf> streambuf(new FileInputStreambuf(std::move(file)));
         std::shared_ptr<std::istream> in(new std::istream(streambuf.get()),
                 [](std::istream *stream){ finalizeStream(stream); });
-        _metaData.insert(std::make_pair(in.get(), StreamMetadata(std::move(streambuf))));
+        {
+            std::unique_lock<std::mutex> lock(_streamMutex);
+            _metaData.insert(std::make_pair(in.get(), StreamMetadata(std::move(streambuf))));
+        }
 #else
         std::shared_ptr<std::istream> in(new std::ifstream(p.absolute().asString(),
                 std::ios_base::in | std::ios_base::binary),
@@ -583,6 +595,7 @@ InputStreamHandle FileUtils::openInputStream(const Path &p)
 
         std::shared_ptr<std::istream> in(new std::istream(streambuf.get()),
                 [](std::istream *stream){ finalizeStream(stream); });
+        std::unique_lock<std::mutex> lock(_streamMutex);
         _metaData.insert(std::make_pair(in.get(), StreamMetadata(std::move(streambuf), std::move(archive))));
 
         return std::move(in);
@@ -603,6 +616,7 @@ OutputStreamHandle FileUtils::openOutputStream(const Path &p)
 
     OutputStreamHandle out = openFileOutputStream(tmpPath);
     if (out) {
+        std::unique_lock<std::mutex> lock(_streamMutex);
         auto iter = _metaData.find(out.get());
         iter->second.srcPath = tmpPath;
         iter->second.targetPath = p;
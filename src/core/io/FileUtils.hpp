@@ -13,6 +13,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <mutex>
 #include <vector>
 
 namespace Tungsten {
@@ -34,6 +35,9 @@ public:
 
 // WARNING: Do not assume any functions operating on the file system to be thread-safe or re-entrant.
 // The underlying operating system API as well as the implementation here do not make this safe.
+// The only exception is opening and closing streams on paths that do not depend on the current
+// directory, which may happen on several threads at once (e.g. while outputs are being written
+// in the background).
 class FileUtils
 {
     FileUtils() {}
@@ -70,6 +74,7 @@ class FileUtils
 
     static std::unordered_map<Path, std::shared_ptr<ZipReader>> _archives;
     static std::unordered_map<const std::ios *, StreamMetadata> _metaData;
+    static std::mutex _streamMutex;
     static Path _currentDir;
 
     static void finalizeStream(std::ios *stream);
@@ -1,9 +1,11 @@
 #include "ImageIO.hpp"
 
+#include "SceneBundle.hpp"
 #include "FileUtils.hpp"
 
 #include "io/FileUtils.hpp"
 
+#include "Platform.hpp"
 #include "Debug.hpp"
 
 #include <lodepng/lodepng.h>
@@ -11,6 +13,7 @@
 #include <cstring>
 
 #if OPENEXR_AVAILABLE
+#include <ImfTiledOutputFile.h>
 #include <ImfChannelList.h>
 #include <ImfOutputFile.h>
 #include <ImfInputFile.h>
@@ -154,7 +157,7 @@ static const stbi_io_callbacks istreamCallback  = stbi_io_callbacks{
     &stbiReadCallback, &stbiSkipCallback, &stbiEofCallback
 };
 
-bool isHdr(const Path &path)
+static bool isHdrFile(const Path &path)
 {
     if (path.testExtension("pfm"))
         return true;
@@ -169,6 +172,19 @@ bool isHdr(const Path &path)
     return stbi_is_hdr_from_callbacks(&istreamCallback, in.get()) != 0;
 }
 
+bool isHdr(const Path &path)
+{
+    SceneBundle *bundle = SceneBundle::current();
+    bool hdr;
+    if (bundle && bundle->isHdr(path, hdr))
+        return hdr;
+
+    hdr = isHdrFile(path);
+    if (bundle)
+        bundle->recordIsHdr(path, hdr);
+    return hdr;
+}
+
 template<typename T>
 static T convertToScalar(TexelConversion request, T r, T g, T b, T a, bool haveAlpha)
 {
@@ -364,7 +380,7 @@ std::unique_ptr<float[]> loadStbiHdr(const Path &path, TexelConversion request,
     return std::move(texels);
 }
 
-std::unique_ptr<float[]> loadHdr(const Path &path, TexelConversion request, int &w, int &h)
+static std::unique_ptr<float[]> loadHdrFile(const Path &path, TexelConversion request, int &w, int &h)
 {
     if (path.testExtension("pfm"))
         return std::move(loadPfm(path, request, w, h));
@@ -376,6 +392,19 @@ std::unique_ptr<float[]> loadHdr(const Path &path, TexelConversion request, int
         return std::move(loadStbiHdr(path, request, w, h));
 }
 
+std::unique_ptr<float[]> loadHdr(const Path &path, TexelConversion request, int &w, int &h)
+{
+    SceneBundle *bundle = SceneBundle::current();
+    std::unique_ptr<float[]> texels;
+    if (bundle && (texels = bundle->loadHdr(path, request, w, h)))
+        return texels;
+
+    texels = loadHdrFile(path, request, w, h);
+    if (bundle && texels)
+        bundle->recordHdr(path, request, texels.get(), w, h, request == TexelConversion::REQUEST_RGB ? 3 : 1);
+    return texels;
+}
+
 typedef std::unique_ptr<uint8[], void(*)(void *)> DeletablePixels;
 static void nop(void *) {}
 static inline DeletablePixels makeVoidPixels()
@@ -490,7 +519,8 @@ DeletablePixels loadStbi(const Path &path, int &w, int &h, int &channels)
             &w, &h, &channels, 4), stbi_image_free);
 }
 
-std::unique_ptr<uint8[]> loadLdr(const Path &path, TexelConversion request, int &w, int &h, bool gammaCorrect)
+static std::unique_ptr<uint8[]> loadLdrFile(const Path &path, TexelConversion request, int &w, int &h,
+        bool gammaCorrect)
 {
     int channels;
     DeletablePixels img(makeVoidPixels());
@@ -525,6 +555,20 @@ std::unique_ptr<uint8[]> loadLdr(const Path &path, TexelConversion request, int
     return std::move(texels);
 }
 
+std::unique_ptr<uint8[]> loadLdr(const Path &path, TexelConversion request, int &w, int &h, bool gammaCorrect)
+{
+    SceneBundle *bundle = SceneBundle::current();
+    std::unique_ptr<uint8[]> texels;
+    if (bundle && (texels = bundle->loadLdr(path, request, w, h, gammaCorrect)))
+        return texels;
+
+    texels = loadLdrFile(path, request, w, h, gammaCorrect);
+    if (bundle && texels)
+        bundle->recordLdr(path, request, texels.get(), w, h, request == TexelConversion::REQUEST_RGB ? 4 : 1,
+                gammaCorrect);
+    return texels;
+}
+
 bool savePfm(const Path &path, const float *img, int w, int h, int channels)
 {
     if (channels != 1 && channels != 3)
@@ -627,6 +671,133 @@ bool saveLdr(const Path &path, const uint8 *img, int w, int h, int channels)
     return false;
 }
 
+// PFM stores uncompressed rows at fixed offsets, so blocks are simply written
+// in place. Rows that have not been written yet are left as a hole in the file
+class PfmBlockWriter : public HdrBlockWriter
+{
+    OutputStreamHandle _out;
+    std::streamoff _dataStart;
+    int _w, _h, _channels;
+
+public:
+    PfmBlockWriter(OutputStreamHandle out, int w, int h, int channels)
+    : _out(std::move(out)),
+      _w(w),
+      _h(h),
+      _channels(channels)
+    {
+        *_out << ((channels == 1) ? "Pf" : "PF") << '\n';
+        *_out << w << " " << h << '\n';
+        *_out << -1.0 << '\n';
+        _dataStart = _out->tellp();
+    }
+
+    virtual bool writeBlock(const float *img, int x, int y, int w, int h) override
+    {
+        for (int i = 0; i < h; ++i) {
+            std::streamoff row = _h - (y + i) - 1;
+            _out->seekp(_dataStart + (row*_w + x)*_channels*std::streamoff(sizeof(float)));
+            _out->write(reinterpret_cast<const char *>(img + i*w*_channels), w*_channels*sizeof(float));
+        }
+        return _out->good();
+    }
+};
+
+#if OPENEXR_AVAILABLE
+// Buckets map directly onto EXR tiles. Tiles are written in random order, so
+// that OpenEXR writes each of them out immediately instead of buffering them
+class ExrBlockWriter : public HdrBlockWriter
+{
+    ExrOStream _out;
+    Imf::TiledOutputFile _file;
+    int _channels;
+    int _blockSize;
+
+    static Imf::Header makeHeader(int w, int h, int channels, int blockSize)
+    {
+        Imf::Header header(w, h, 1.0f, Imath::V2f(0, 0), 1.0f, Imf::RANDOM_Y, Imf::PIZ_COMPRESSION);
+        header.setTileDescription(Imf::TileDescription(blockSize, blockSize, Imf::ONE_LEVEL));
+
+        const char *channelNames[] = {"R", "G", "B", "A"};
+        for (int i = 0; i < channels; ++i)
+            header.channels().insert((channels == 1) ? "Y" : channelNames[i], Imf::Channel(Imf::HALF));
+
+        return header;
+    }
+
+public:
+    ExrBlockWriter(OutputStreamHandle out, int w, int h, int channels, int blockSize)
+    : _out(std::move(out)),
+      _file(_out, makeHeader(w, h, channels, blockSize)),
+      _channels(channels),
+      _blockSize(blockSize)
+    {
+    }
+
+    virtual bool writeBlock(const float *img, int x, int y, int w, int h) override
+    {
+        try {
+
+        std::unique_ptr<half[]> data(new half[w*h*_channels]);
+        for (int i = 0; i < w*h*_channels; ++i)
+            data[i] = half(img[i]);
+
+        // OpenEXR addresses slices in image coordinates, so the base pointer
+        // is offset to where pixel (0, 0) would lie relative to this block
+        size_t xStride = sizeof(half)*_channels;
+        size_t yStride = xStride*w;
+        char *base = reinterpret_cast<char *>(data.get()) - x*xStride - y*yStride;
+
+        Imf::FrameBuffer frameBuffer;
+        const char *channelNames[] = {"R", "G", "B", "A"};
+        for (int i = 0; i < _channels; ++i)
+            frameBuffer.insert((_channels == 1) ? "Y" : channelNames[i],
+                    Imf::Slice(Imf::HALF, base + i*sizeof(half), xStride, yStride));
+
+        _file.setFrameBuffer(frameBuffer);
+        _file.writeTile(x/_blockSize, y/_blockSize);
+
+        return true;
+
+        } catch(const std::exception &e) {
+            std::cout << "OpenEXR writer failed: " << e.what() << std::endl;
+            return false;
+        }
+    }
+};
+#endif
+
+std::unique_ptr<HdrBlockWriter> openHdrBlockWriter(const Path &path, int w, int h, int channels, int blockSize)
+{
+    if (path.testExtension("pfm")) {
+        if (channels != 1 && channels != 3)
+            return nullptr;
+        OutputStreamHandle out = FileUtils::openOutputStream(path);
+        if (!out)
+            return nullptr;
+        return std::unique_ptr<HdrBlockWriter>(new PfmBlockWriter(std::move(out), w, h, channels));
+    }
+#if OPENEXR_AVAILABLE
+    else if (path.testExtension("exr")) {
+        if (channels <= 0 || channels > 4)
+            return nullptr;
+        OutputStreamHandle out = FileUtils::openOutputStream(path);
+        if (!out)
+            return nullptr;
+        try {
+            return std::unique_ptr<HdrBlockWriter>(new ExrBlockWriter(std::move(out), w, h, channels, blockSize));
+        } catch(const std::exception &e) {
+            std::cout << "OpenEXR writer failed: " << e.what() << std::endl;
+            return nullptr;
+        }
+    }
+#else
+    MARK_UNUSED(blockSize);
+#endif
+
+    return nullptr;
+}
+
 }
 
 }
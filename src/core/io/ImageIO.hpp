@@ -32,6 +32,21 @@ std::unique_ptr<uint8[]> loadLdr(const Path &path, TexelConversion request, int
 bool saveHdr(const Path &path, const float *img, int w, int h, int channels);
 bool saveLdr(const Path &path, const uint8 *img, int w, int h, int channels);
 
+// Writes an HDR image one block at a time, so that images too large to be held
+// in memory can be saved while they are being rendered. Blocks are at most
+// blockSize x blockSize pixels, their origins lie on the block grid and they
+// may arrive in any order. The image is finalized when the writer is destroyed
+class HdrBlockWriter
+{
+public:
+    virtual ~HdrBlockWriter() {}
+
+    virtual bool writeBlock(const float *img, int x, int y, int w, int h) = 0;
+};
+
+// Supports PFM files, and tiled EXR files if OpenEXR is available
+std::unique_ptr<HdrBlockWriter> openHdrBlockWriter(const Path &path, int w, int h, int channels, int blockSize);
+
 }
 
 }
@@ -0,0 +1,126 @@
+#include "MemoryMappedFile.hpp"
+#include "UnicodeUtils.hpp"
+#include "FileUtils.hpp"
+
+#if _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Tungsten {
+
+MemoryMappedFile::MemoryMappedFile(const Path &path)
+: _data(nullptr),
+  _size(0),
+  _mapping(nullptr),
+  _fileHandle(nullptr)
+{
+    if (map(path))
+        return;
+
+    uint64 size = FileUtils::fileSize(path);
+    InputStreamHandle in = FileUtils::openInputStream(path);
+    if (!in || size == 0)
+        return;
+
+    _buffer.reset(new uint8[size_t(size)]);
+    in->read(reinterpret_cast<char *>(_buffer.get()), size);
+    if (uint64(in->gcount()) != size) {
+        _buffer.reset();
+        return;
+    }
+    _data = _buffer.get();
+    _size = size;
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    unmap();
+}
+
+#if _WIN32
+bool MemoryMappedFile::map(const Path &path)
+{
+    std::wstring widePath = UnicodeUtils::utf8ToWchar(
+            "\\\\?\\" + path.absolute().normalize().nativeSeparators().asString());
+
+    HANDLE file = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    _fileHandle = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        unmap();
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        unmap();
+        return false;
+    }
+    _mapping = mapping;
+
+    _data = static_cast<const uint8 *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!_data) {
+        unmap();
+        return false;
+    }
+    _size = uint64(size.QuadPart);
+
+    return true;
+}
+
+void MemoryMappedFile::unmap()
+{
+    if (_data && !_buffer)
+        UnmapViewOfFile(_data);
+    if (_mapping)
+        CloseHandle(_mapping);
+    if (_fileHandle)
+        CloseHandle(_fileHandle);
+    _data = nullptr;
+    _mapping = _fileHandle = nullptr;
+}
+#else
+bool MemoryMappedFile::map(const Path &path)
+{
+    int fd = open(path.absolute().asString().c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    // The mapping stays valid after the file descriptor is closed
+    void *mapping = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    _mapping = mapping;
+    _data = static_cast<const uint8 *>(mapping);
+    _size = uint64(info.st_size);
+
+    return true;
+}
+
+void MemoryMappedFile::unmap()
+{
+    if (_mapping)
+        munmap(_mapping, size_t(_size));
+    _data = nullptr;
+    _mapping = nullptr;
+}
+#endif
+
+}
@@ -0,0 +1,53 @@
+#ifndef MEMORYMAPPEDFILE_HPP_
+#define MEMORYMAPPEDFILE_HPP_
+
+#include "Path.hpp"
+
+#include "IntTypes.hpp"
+
+#include <memory>
+
+namespace Tungsten {
+
+// Read-only view of the contents of a file. Files on disk are mapped into
+// memory, so that pages are only read once they are touched. Anything the
+// operating system cannot map (e.g. files inside zip archives) is read into
+// memory in its entirety instead
+class MemoryMappedFile
+{
+    const uint8 *_data;
+    uint64 _size;
+
+    void *_mapping;
+    void *_fileHandle;
+    std::unique_ptr<uint8[]> _buffer;
+
+    bool map(const Path &path);
+    void unmap();
+
+public:
+    MemoryMappedFile(const Path &path);
+    ~MemoryMappedFile();
+
+    MemoryMappedFile(const MemoryMappedFile &) = delete;
+    MemoryMappedFile &operator=(const MemoryMappedFile &) = delete;
+
+    bool valid() const
+    {
+        return _data != nullptr;
+    }
+
+    const uint8 *data() const
+    {
+        return _data;
+    }
+
+    uint64 size() const
+    {
+        return _size;
+    }
+};
+
+}
+
+#endif /* MEMORYMAPPEDFILE_HPP_ */
@@ -1,4 +1,5 @@
 #include "MeshIO.hpp"
+#include "SceneBundle.hpp"
 #include "FileUtils.hpp"
 #include "ObjLoader.hpp"
 #include "IntTypes.hpp"
@@ -67,7 +68,7 @@ bool saveObj(const Path &path, const std::vector<Vertex> &verts, const std::vect
     return true;
 }
 
-bool load(const Path &path, std::vector<Vertex> &verts, std::vector<TriangleI> &tris)
+static bool loadFile(const Path &path, std::vector<Vertex> &verts, std::vector<TriangleI> &tris)
 {
     if (path.testExtension("wo3"))
         return loadWo3(path, verts, tris);
@@ -76,6 +77,19 @@ bool load(const Path &path, std::vector<Vertex> &verts, std::vector<TriangleI> &
     return false;
 }
 
+bool load(const Path &path, std::vector<Vertex> &verts, std::vector<TriangleI> &tris)
+{
+    SceneBundle *bundle = SceneBundle::current();
+    if (bundle && bundle->loadMesh(path, verts, tris))
+        return true;
+
+    if (!loadFile(path, verts, tris))
+        return false;
+    if (bundle)
+        bundle->recordMesh(path, verts, tris);
+    return true;
+}
+
 bool save(const Path &path, const std::vector<Vertex> &verts, const std::vector<TriangleI> &tris)
 {
     if (path.testExtension("wo3"))
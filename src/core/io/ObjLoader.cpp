@@ -15,6 +15,9 @@
 
 #include "cameras/PinholeCamera.hpp"
 
+#include "thread/ThreadUtils.hpp"
+#include "thread/ThreadPool.hpp"
+
 #include "bsdfs/RoughConductorBsdf.hpp"
 #include "bsdfs/RoughPlasticBsdf.hpp"
 #include "bsdfs/TransparencyBsdf.hpp"
@@ -27,10 +30,236 @@
 
 #include <tinyformat/tinyformat.hpp>
 #include <algorithm>
+#include <cstring>
+#include <limits>
 #include <cctype>
 
 namespace Tungsten {
 
+static CONSTEXPR size_t ChunkSize = 1024*1024;
+static CONSTEXPR uint32 ChunksPerThread = 4;
+static CONSTEXPR uint32 MaxIndexPartitions = 64;
+// Below this, deduplicating vertices in parallel is not worth the overhead
+static CONSTEXPR size_t MinParallelCorners = 16*1024;
+
+static void runParallel(uint32 count, std::function<void(uint32)> func)
+{
+    if (ThreadUtils::pool && count > 1)
+        ThreadUtils::parallelFor(0, count, count, func);
+    else
+        for (uint32 i = 0; i < count; ++i)
+            func(i);
+}
+
+static uint32 indexPartitionCount()
+{
+    return ThreadUtils::pool ? clamp(ThreadUtils::pool->threadCount(), 1u, MaxIndexPartitions) : 1;
+}
+
+static inline uint32 indexPartition(const Vec3i &key, uint32 partitions)
+{
+    // The maps themselves use the hash modulo their bucket count, so the
+    // partition is picked from the high bits of a scrambled hash instead
+    uint32 hash = uint32(std::hash<Vec3i>()(key))*0x9E3779B9u;
+    return uint32((uint64(hash)*partitions) >> 32);
+}
+
+static inline bool isWhitespace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+static inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Lines are not null terminated, but anything past a null character would
+// never have been seen by the stream based parsers either
+static inline bool atEnd(const char *s, const char *end)
+{
+    return s == end || *s == '\0';
+}
+
+static inline bool atSeparator(const char *s, const char *end)
+{
+    return atEnd(s, end) || isWhitespace(*s);
+}
+
+static inline void skipSpaces(const char *&s, const char *end)
+{
+    while (s < end && isWhitespace(*s))
+        s++;
+}
+
+// The fast parsers below only accept input for which they produce exactly
+// what the istream based parsers would. Anything else (overlong numbers,
+// denormals, odd formatting) makes them return false, and the line is handed
+// to the stream based parsers instead
+static bool parseFloat(const char *&s, const char *end, float &result)
+{
+    static const double powersOfTen[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char *p = s;
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-'))
+        negative = *p++ == '-';
+
+    uint64 mantissa = 0;
+    int digits = 0, significantDigits = 0, exponent = 0;
+    for (; p < end && isDigit(*p); ++p, ++digits) {
+        mantissa = mantissa*10 + (*p - '0');
+        if (mantissa)
+            significantDigits++;
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && isDigit(*p); ++p, ++digits, --exponent) {
+            mantissa = mantissa*10 + (*p - '0');
+            if (mantissa)
+                significantDigits++;
+        }
+    }
+    if (digits == 0 || significantDigits > 18)
+        return false;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negativeExponent = false;
+        if (p < end && (*p == '+' || *p == '-'))
+            negativeExponent = *p++ == '-';
+        int e = 0, exponentDigits = 0;
+        for (; p < end && isDigit(*p); ++p, ++exponentDigits)
+            if (e < 1000)
+                e = e*10 + (*p - '0');
+        if (exponentDigits == 0)
+            return false;
+        exponent += negativeExponent ? -e : e;
+    }
+    if (!atSeparator(p, end))
+        return false;
+
+    // Both the mantissa and the power of ten are exact, so the division or
+    // multiplication is correctly rounded
+    if (mantissa > (uint64(1) << 53) || exponent < -22 || exponent > 22)
+        return false;
+    double d = double(mantissa);
+    d = exponent < 0 ? d/powersOfTen[-exponent] : d*powersOfTen[exponent];
+
+    // Rounding the double to float again gives the correctly rounded float,
+    // unless it fell exactly halfway between two floats
+    if (d != 0.0 && (d < std::numeric_limits<float>::min() || d > std::numeric_limits<float>::max()))
+        return false;
+    uint64 bits;
+    std::memcpy(&bits, &d, sizeof(double));
+    if ((bits & 0x1FFFFFFFu) == 0x10000000u)
+        return false;
+
+    result = negative ? -float(d) : float(d);
+    s = p;
+    return true;
+}
+
+static bool parseIndex(const char *&s, const char *end, int32 &result, bool allowSign = true)
+{
+    const char *p = s;
+    bool negative = false;
+    if (allowSign && p < end && (*p == '+' || *p == '-'))
+        negative = *p++ == '-';
+
+    int32 value = 0;
+    int digits = 0;
+    for (; p < end && isDigit(*p); ++p, ++digits)
+        value = value*10 + (*p - '0');
+    if (digits == 0 || digits > 9)
+        return false;
+
+    result = negative ? -value : value;
+    s = p;
+    return true;
+}
+
+template<unsigned Size>
+static bool parseVector(const char *s, const char *end, Vec<float, Size> &result)
+{
+    for (unsigned i = 0; i < Size; ++i) {
+        skipSpaces(s, end);
+        if (atEnd(s, end) || !parseFloat(s, end, result[i]))
+            return false;
+    }
+    return true;
+}
+
+// Mirrors loadFace. Corners are stored as (pos, normal, uv)
+static bool parseFace(const char *s, const char *end, std::vector<Vec3i> &corners, uint32 &count)
+{
+    size_t start = corners.size();
+    while (true) {
+        skipSpaces(s, end);
+        if (atEnd(s, end))
+            break;
+
+        int32 indices[] = {0, 0, 0};
+        if (!parseIndex(s, end, indices[0])) {
+            corners.resize(start);
+            return false;
+        }
+        if (indices[0] == 0)
+            break;
+
+        bool valid = true;
+        if (s < end && *s == '/') {
+            ++s;
+            if (s < end && *s == '/') {
+                ++s;
+                valid = parseIndex(s, end, indices[2]);
+            } else {
+                valid = parseIndex(s, end, indices[1]);
+                if (valid && s < end && *s == '/') {
+                    ++s;
+                    valid = parseIndex(s, end, indices[2]);
+                }
+            }
+        }
+        if (!valid || !atSeparator(s, end)) {
+            corners.resize(start);
+            return false;
+        }
+
+        corners.emplace_back(indices[0], indices[2], indices[1]);
+    }
+    count = uint32(corners.size() - start);
+    return true;
+}
+
+// Mirrors loadCurve. Corners are stored as (pos, 0, 0)
+static bool parseCurve(const char *s, const char *end, std::vector<Vec3i> &corners, uint32 &count)
+{
+    size_t start = corners.size();
+    while (true) {
+        skipSpaces(s, end);
+        if (atEnd(s, end))
+            break;
+
+        int32 index, ignored;
+        bool valid = parseIndex(s, end, index);
+        if (valid && s < end && *s == '/') {
+            ++s;
+            valid = parseIndex(s, end, ignored, false);
+        }
+        if (!valid || !atSeparator(s, end)) {
+            corners.resize(start);
+            return false;
+        }
+
+        corners.emplace_back(index, 0, 0);
+    }
+    count = uint32(corners.size() - start);
+    return true;
+}
+
 template<unsigned Size>
 Vec<float, Size> ObjLoader::loadVector(const char *s)
 {
@@ -65,8 +294,10 @@ uint32 ObjLoader::fetchVertex(int32 pos, int32 normal, int32 uv)
     if (uv < 0)
         uv += _uv.size() + 1;
 
-    auto iter = _indices.find(Vec3i(pos, normal, uv));
-    if (iter != _indices.end()) {
+    Vec3i key(pos, normal, uv);
+    auto &indices = _indices[indexPartition(key, uint32(_indices.size()))];
+    auto iter = indices.find(key);
+    if (iter != indices.end()) {
         return iter->second;
     } else {
         Vec3f p(0.0f), n(0.0f, 1.0f, 0.0f);
@@ -84,11 +315,90 @@ uint32 ObjLoader::fetchVertex(int32 pos, int32 normal, int32 uv)
         uint32 index = _verts.size();
         _verts.emplace_back(p, n, u);
 
-        _indices.insert(std::make_pair(Vec3i(pos, normal, uv), index));
+        indices.insert(std::make_pair(key, index));
         return index;
     }
 }
 
+// Same as calling fetchVertex on each key in turn, but with the hash map
+// lookups and the vertex creation done in parallel. Keys must not contain
+// negative indices
+void ObjLoader::fetchVertices(const std::vector<Vec3i> &keys, std::vector<uint32> &result)
+{
+    size_t n = keys.size();
+    result.resize(n);
+
+    uint32 partitions = uint32(_indices.size());
+    if (partitions == 1 || n < MinParallelCorners) {
+        for (size_t i = 0; i < n; ++i)
+            result[i] = fetchVertex(keys[i].x(), keys[i].y(), keys[i].z());
+        return;
+    }
+
+    std::unique_ptr<uint8[]> partition(new uint8[n]);
+    runParallel(partitions, [&](uint32 p) {
+        size_t span = (n + partitions - 1)/partitions;
+        for (size_t i = p*span; i < min((p + 1)*span, n); ++i)
+            partition[i] = uint8(indexPartition(keys[i], partitions));
+    });
+
+    // Every partition walks the corners in order, so the first corner to
+    // insert a key is the first one that uses it. Newly inserted keys are
+    // temporarily mapped to vertsBefore + (index of their first corner)
+    uint32 vertsBefore = uint32(_verts.size());
+    std::unique_ptr<uint32 *[]> slots(new uint32 *[n]);
+    runParallel(partitions, [&](uint32 p) {
+        auto &indices = _indices[p];
+        for (size_t i = 0; i < n; ++i) {
+            if (partition[i] != p)
+                continue;
+            auto insertion = indices.insert(std::make_pair(keys[i], vertsBefore + uint32(i)));
+            result[i] = insertion.first->second;
+            slots[i] = &insertion.first->second;
+        }
+    });
+
+    // New vertices are numbered in order of first use, like fetchVertex would
+    std::vector<uint32> newCorners;
+    for (size_t i = 0; i < n; ++i) {
+        if (result[i] < vertsBefore)
+            continue;
+        uint32 first = result[i] - vertsBefore;
+        if (first == i) {
+            result[i] = vertsBefore + uint32(newCorners.size());
+            newCorners.push_back(uint32(i));
+        } else {
+            result[i] = result[first];
+        }
+    }
+
+    size_t newVerts = newCorners.size();
+    _verts.resize(vertsBefore + newVerts);
+    std::vector<Box3f> bounds(partitions);
+    runParallel(partitions, [&](uint32 p) {
+        size_t span = (newVerts + partitions - 1)/partitions;
+        for (size_t i = p*span; i < min((p + 1)*span, newVerts); ++i) {
+            uint32 corner = newCorners[i];
+            *slots[corner] = result[corner];
+
+            const Vec3i &key = keys[corner];
+            Vec3f pos(0.0f), normal(0.0f, 1.0f, 0.0f);
+            Vec2f uv(0.0f);
+            if (key.x())
+                pos = _pos[key.x() - 1];
+            if (key.y())
+                normal = _normal[key.y() - 1];
+            if (key.z())
+                uv = _uv[key.z() - 1];
+
+            bounds[p].grow(pos);
+            _verts[vertsBefore + i] = Vertex(pos, normal, uv);
+        }
+    });
+    for (const Box3f &b : bounds)
+        _bounds.grow(b);
+}
+
 void ObjLoader::loadCurve(const char *line)
 {
     uint32 prev = 0;
@@ -98,6 +408,8 @@ void ObjLoader::loadCurve(const char *line)
     while (!ss.fail() && !ss.eof()) {
         int32 index;
         ss >> index;
+        if (ss.fail())
+            break;
         if (ss.peek() == '/') {
             ss.get();
             uint32 tmp;
@@ -323,7 +635,8 @@ std::string ObjLoader::generateDummyName() const
 void ObjLoader::clearPerMeshData()
 {
     _meshName.clear();
-    _indices.clear();
+    for (auto &indices : _indices)
+        indices.clear();
     _tris.clear();
     _verts.clear();
 }
@@ -516,26 +829,187 @@ std::shared_ptr<Primitive> ObjLoader::finalizeMesh()
     return std::move(prim);
 }
 
-void ObjLoader::loadFile(std::istream &in)
+void ObjLoader::parseChunk(Chunk &chunk)
+{
+    const char *lineStart = chunk.begin;
+    while (lineStart < chunk.end) {
+        const char *lineEnd = static_cast<const char *>(std::memchr(lineStart, '\n', chunk.end - lineStart));
+        if (!lineEnd)
+            lineEnd = chunk.end;
+
+        const char *line = lineStart;
+        lineStart = lineEnd + 1;
+
+        // Same as the prefix matching of loadLine, which requires a
+        // whitespace character after the command
+        const char *s = line;
+        skipSpaces(s, lineEnd);
+        if (atEnd(s, lineEnd) || *s == '#')
+            continue;
+        size_t length = lineEnd - s;
+        char c0 = std::tolower(s[0]);
+        char c1 = length > 1 ? std::tolower(s[1]) : '\0';
+        bool isVertex   = c0 == 'v' && length > 1 && isWhitespace(s[1]);
+        bool isNormal   = c0 == 'v' && c1 == 'n' && length > 2 && isWhitespace(s[2]);
+        bool isTexCoord = c0 == 'v' && c1 == 't' && length > 2 && isWhitespace(s[2]);
+        bool isFace     = c0 == 'f' && length > 1 && isWhitespace(s[1]);
+        bool isCurve    = c0 == 'l' && length > 1 && isWhitespace(s[1]);
+
+        if (isVertex) {
+            Vec3f v;
+            if (!parseVector(s + 2, lineEnd, v))
+                v = loadVector<3>(std::string(s, lineEnd).c_str() + 2);
+            chunk.pos.push_back(v);
+        } else if (isNormal) {
+            Vec3f n;
+            if (!parseVector(s + 3, lineEnd, n))
+                n = loadVector<3>(std::string(s, lineEnd).c_str() + 3);
+            chunk.normal.push_back(n);
+        } else if (isTexCoord) {
+            Vec2f uv;
+            if (!parseVector(s + 3, lineEnd, uv))
+                uv = loadVector<2>(std::string(s, lineEnd).c_str() + 3);
+            chunk.uv.push_back(uv);
+        } else {
+            Record record;
+            record.posCount    = uint32(chunk.pos.size());
+            record.normalCount = uint32(chunk.normal.size());
+            record.uvCount     = uint32(chunk.uv.size());
+            if (isFace && parseFace(s + 2, lineEnd, chunk.corners, record.count)) {
+                record.type = RecordFace;
+            } else if (isCurve && parseCurve(s + 2, lineEnd, chunk.corners, record.count)) {
+                record.type = RecordCurve;
+            } else {
+                record.type = RecordLine;
+                record.line = line;
+                record.count = uint32(lineEnd - line);
+            }
+            chunk.records.push_back(record);
+        }
+    }
+}
+
+void ObjLoader::mergeVertexData(Chunk &chunk, uint32 posCount, uint32 normalCount, uint32 uvCount)
+{
+    _pos   .insert(_pos   .end(), chunk.pos   .begin() + chunk.posMerged,    chunk.pos   .begin() + posCount);
+    _normal.insert(_normal.end(), chunk.normal.begin() + chunk.normalMerged, chunk.normal.begin() + normalCount);
+    _uv    .insert(_uv    .end(), chunk.uv    .begin() + chunk.uvMerged,     chunk.uv    .begin() + uvCount);
+    chunk.posMerged = posCount;
+    chunk.normalMerged = normalCount;
+    chunk.uvMerged = uvCount;
+}
+
+void ObjLoader::mergeChunk(Chunk &chunk)
+{
+    uint32 posBase = uint32(_pos.size());
+    uint32 normalBase = uint32(_normal.size());
+    uint32 uvBase = uint32(_uv.size());
+
+    size_t corner = 0;
+    for (const Record &record : chunk.records) {
+        if (record.type == RecordLine) {
+            // Lines may use the state of the loader, so everything before
+            // them has to be in place
+            mergeVertexData(chunk, record.posCount, record.normalCount, record.uvCount);
+            flushPendingRecords();
+            loadLine(std::string(record.line, record.count).c_str());
+            continue;
+        }
+
+        for (uint32 i = 0; i < record.count; ++i) {
+            Vec3i key = chunk.corners[corner++];
+            if (key.x() < 0)
+                key.x() += posBase + record.posCount + 1;
+            if (key.y() < 0)
+                key.y() += normalBase + record.normalCount + 1;
+            if (key.z() < 0)
+                key.z() += uvBase + record.uvCount + 1;
+            _pendingCorners.push_back(key);
+        }
+        _pendingRecords.push_back(record);
+    }
+
+    mergeVertexData(chunk, uint32(chunk.pos.size()), uint32(chunk.normal.size()), uint32(chunk.uv.size()));
+}
+
+void ObjLoader::flushPendingRecords()
+{
+    if (_pendingRecords.empty())
+        return;
+
+    std::vector<uint32> verts;
+    fetchVertices(_pendingCorners, verts);
+
+    size_t corner = 0;
+    for (const Record &record : _pendingRecords) {
+        const uint32 *v = verts.data() + corner;
+        if (record.type == RecordFace)
+            for (uint32 i = 2; i < record.count; ++i)
+                _tris.emplace_back(v[0], v[i - 1], v[i], _currentMaterial);
+        else
+            for (uint32 i = 1; i < record.count; ++i)
+                _segments.emplace_back(SegmentI{v[i - 1], v[i]});
+        corner += record.count;
+    }
+
+    _pendingCorners.clear();
+    _pendingRecords.clear();
+}
+
+// The file is split into newline-aligned chunks that are parsed in parallel.
+// Vertex data, faces and curves are parsed directly, and everything else is
+// kept as text and passed to loadLine when the chunks are merged. Merging
+// happens in file order, so that the result is the same as parsing the file
+// line by line. To bound memory use, the file is processed a few chunks per
+// thread at a time
+void ObjLoader::loadFile(const MemoryMappedFile &file)
 {
-    std::string line;
-    while (!in.fail() && !in.eof()) {
-        std::getline(in, line);
+    if (!file.valid())
+        return;
+
+    const char *src = reinterpret_cast<const char *>(file.data());
+    const char *end = src + file.size();
+
+    uint32 threadCount = ThreadUtils::pool ? max(ThreadUtils::pool->threadCount(), 1u) : 1;
+    std::vector<Chunk> chunks;
+    while (src < end) {
+        chunks.clear();
+        while (src < end && chunks.size() < threadCount*ChunksPerThread) {
+            const char *chunkEnd = src + min(ChunkSize, size_t(end - src));
+            if (chunkEnd < end) {
+                chunkEnd = static_cast<const char *>(std::memchr(chunkEnd, '\n', end - chunkEnd));
+                chunkEnd = chunkEnd ? chunkEnd + 1 : end;
+            }
+
+            Chunk chunk;
+            chunk.begin = src;
+            chunk.end = chunkEnd;
+            chunk.posMerged = chunk.normalMerged = chunk.uvMerged = 0;
+            chunks.emplace_back(std::move(chunk));
+            src = chunkEnd;
+        }
 
-        loadLine(line.c_str());
+        runParallel(uint32(chunks.size()), [&](uint32 i) {
+            parseChunk(chunks[i]);
+        });
+
+        for (Chunk &chunk : chunks)
+            mergeChunk(chunk);
+        flushPendingRecords();
     }
 }
 
-ObjLoader::ObjLoader(std::istream &in, const Path &path, std::shared_ptr<TextureCache> cache)
+ObjLoader::ObjLoader(const MemoryMappedFile &file, const Path &path, std::shared_ptr<TextureCache> cache)
 : _geometryOnly(false),
   _errorMaterial(std::make_shared<ErrorBsdf>()),
   _textureCache(std::move(cache)),
   _currentMaterial(-1),
-  _meshSmoothed(false)
+  _meshSmoothed(false),
+  _indices(indexPartitionCount())
 {
     DirectoryChange context(path.parent());
 
-    loadFile(in);
+    loadFile(file);
 
     if (!_tris.empty() || !_segments.empty()) {
         _meshes.emplace_back(finalizeMesh());
@@ -543,16 +1017,27 @@ ObjLoader::ObjLoader(std::istream &in, const Path &path, std::shared_ptr<Texture
     }
 }
 
-ObjLoader::ObjLoader(std::istream &in)
-: _geometryOnly(true)
+ObjLoader::ObjLoader(const MemoryMappedFile &file)
+: _geometryOnly(true),
+  _currentMaterial(-1),
+  _indices(indexPartitionCount())
 {
-    loadFile(in);
+    loadFile(file);
+}
+
+// Empty files cannot be mapped, but are still valid
+static std::unique_ptr<MemoryMappedFile> mapObjFile(const Path &path)
+{
+    std::unique_ptr<MemoryMappedFile> file(new MemoryMappedFile(path));
+    if (!file->valid() && (!FileUtils::exists(path) || FileUtils::fileSize(path) != 0))
+        return nullptr;
+    return file;
 }
 
 Scene *ObjLoader::load(const Path &path, std::shared_ptr<TextureCache> cache)
 {
 
-    InputStreamHandle file = FileUtils::openInputStream(path);
+    std::unique_ptr<MemoryMappedFile> file = mapObjFile(path);
 
     if (file) {
         if (!cache)
@@ -580,7 +1065,7 @@ Scene *ObjLoader::load(const Path &path, std::shared_ptr<TextureCache> cache)
 
 bool ObjLoader::loadGeometryOnly(const Path &path, std::vector<Vertex> &verts, std::vector<TriangleI> &tris)
 {
-    InputStreamHandle file = FileUtils::openInputStream(path);
+    std::unique_ptr<MemoryMappedFile> file = mapObjFile(path);
     if (!file)
         return false;
 
@@ -594,7 +1079,7 @@ bool ObjLoader::loadGeometryOnly(const Path &path, std::vector<Vertex> &verts, s
 
 bool ObjLoader::loadCurvesOnly(const Path &path, std::vector<uint32> &curveEnds, std::vector<Vec4f> &nodeData)
 {
-    InputStreamHandle file = FileUtils::openInputStream(path);
+    std::unique_ptr<MemoryMappedFile> file = mapObjFile(path);
     if (!file)
         return false;
 
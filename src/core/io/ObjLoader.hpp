@@ -1,6 +1,7 @@
 #ifndef OBJLOADER_HPP_
 #define OBJLOADER_HPP_
 
+#include "MemoryMappedFile.hpp"
 #include "TextureCache.hpp"
 #include "ObjMaterial.hpp"
 #include "Path.hpp"
@@ -30,6 +31,45 @@ class ObjLoader
         uint32 v1;
     };
 
+    enum RecordType
+    {
+        RecordFace,
+        RecordCurve,
+        RecordLine,
+    };
+
+    // A face or curve with its corners stored in the corner list of the chunk,
+    // or any other line, which is passed to loadLine in file order. The vertex
+    // data counts are those of the chunk at the point of the record and are
+    // needed to resolve negative indices
+    struct Record
+    {
+        RecordType type;
+        uint32 count;
+        const char *line;
+        uint32 posCount;
+        uint32 normalCount;
+        uint32 uvCount;
+    };
+
+    // A newline-aligned piece of the file. Chunks are parsed independently and
+    // in parallel, and then merged one after the other
+    struct Chunk
+    {
+        const char *begin;
+        const char *end;
+
+        std::vector<Vec3f> pos;
+        std::vector<Vec3f> normal;
+        std::vector<Vec2f> uv;
+        std::vector<Vec3i> corners;
+        std::vector<Record> records;
+
+        uint32 posMerged;
+        uint32 normalMerged;
+        uint32 uvMerged;
+    };
+
     bool _geometryOnly;
 
     std::shared_ptr<Bsdf> _errorMaterial;
@@ -46,7 +86,9 @@ class ObjLoader
     std::string _meshName;
     bool _meshSmoothed;
 
-    std::unordered_map<Vec3i, uint32> _indices;
+    // Partitioned by the hash of the key, so that the partitions can be
+    // filled in parallel
+    std::vector<std::unordered_map<Vec3i, uint32>> _indices;
     std::vector<TriangleI> _tris;
     std::vector<SegmentI> _segments;
     std::vector<Vertex> _verts;
@@ -54,9 +96,13 @@ class ObjLoader
 
     std::vector<std::shared_ptr<Primitive>> _meshes;
 
+    std::vector<Vec3i> _pendingCorners;
+    std::vector<Record> _pendingRecords;
+
     void skipWhitespace(const char *&s);
     bool hasPrefix(const char *s, const char *pre);
     uint32 fetchVertex(int32 pos, int32 normal, int32 uv);
+    void fetchVertices(const std::vector<Vec3i> &keys, std::vector<uint32> &result);
 
     std::string extractString(const char *line);
     std::string extractPath(const char *line);
@@ -67,7 +113,12 @@ class ObjLoader
     void loadFace(const char *line);
     void loadMaterialLibrary(const char *path);
     void loadLine(const char *line);
-    void loadFile(std::istream &in);
+
+    void parseChunk(Chunk &chunk);
+    void mergeVertexData(Chunk &chunk, uint32 posCount, uint32 normalCount, uint32 uvCount);
+    void mergeChunk(Chunk &chunk);
+    void flushPendingRecords();
+    void loadFile(const MemoryMappedFile &file);
 
     std::shared_ptr<Bsdf> convertObjMaterial(const ObjMaterial &mat);
 
@@ -82,8 +133,8 @@ class ObjLoader
     std::shared_ptr<Primitive> tryInstantiateDisk(const std::string &name, std::shared_ptr<Bsdf> &bsdf);
     std::shared_ptr<Primitive> finalizeMesh();
 
-    ObjLoader(std::istream &in, const Path &path, std::shared_ptr<TextureCache> cache);
-    ObjLoader(std::istream &in);
+    ObjLoader(const MemoryMappedFile &file, const Path &path, std::shared_ptr<TextureCache> cache);
+    ObjLoader(const MemoryMappedFile &file);
 
 public:
     static Scene *load(const Path &path, std::shared_ptr<TextureCache> cache = nullptr);
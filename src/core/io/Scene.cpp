@@ -1,7 +1,9 @@
 #include "Scene.hpp"
 
+#include "JsonLoadException.hpp"
 #include "DirectoryChange.hpp"
 #include "JsonDocument.hpp"
+#include "SceneBundle.hpp"
 #include "JsonObject.hpp"
 #include "FileUtils.hpp"
 
@@ -23,11 +25,18 @@
 
 #include "bsdfs/BsdfFactory.hpp"
 
+#include "math/BitManip.hpp"
+
 #include "grids/GridFactory.hpp"
 
+#include "Debug.hpp"
+
 #include <tinyformat/tinyformat.hpp>
+#include <rapidjson/stringbuffer.h>
 #include <rapidjson/document.h>
+#include <rapidjson/writer.h>
 #include <functional>
+#include <deque>
 
 namespace Tungsten {
 
@@ -269,12 +278,15 @@ rapidjson::Value Scene::toJson(Allocator &allocator) const
 
 void Scene::loadResources()
 {
+    SceneBundle::Scope scope(_bundle.get());
+
     for (const std::shared_ptr<Medium> &b : _media)
         b->loadResources();
     for (const std::shared_ptr<Bsdf> &b : _bsdfs)
         b->loadResources();
     for (const std::shared_ptr<Primitive> &t : _primitives)
-        t->loadResources();
+        if (!_reusedPrimitives.count(t.get()))
+            t->loadResources();
 
     _camera->loadResources();
     _integrator->loadResources();
@@ -359,23 +371,111 @@ void Scene::pruneMedia()
     pruneObjects(_media);
 }
 
-TraceableScene *Scene::makeTraceable(uint32 seed)
+// Primitives are compared by their JSON without the transform. Named BSDFs
+// only serialize their name, so their content is added to the key as well;
+// prepared meshes bake alpha testing into their BVH and cannot take over a
+// BSDF that changed in between frames
+static std::string primitiveKey(Primitive &primitive)
 {
-    return new TraceableScene(*_camera, *_integrator, _primitives, _bsdfs, _media, _rendererSettings, seed);
+    rapidjson::Document document;
+    document.SetObject();
+    *(static_cast<rapidjson::Value *>(&document)) = primitive.toJson(document.GetAllocator());
+    document.RemoveMember("transform");
+
+    rapidjson::Value bsdfs(rapidjson::kArrayType);
+    for (int i = 0; i < primitive.numBsdfs(); ++i)
+        if (!primitive.bsdf(i)->unnamed())
+            bsdfs.PushBack(primitive.bsdf(i)->toJson(document.GetAllocator()), document.GetAllocator());
+    document.AddMember("named_bsdfs", std::move(bsdfs), document.GetAllocator());
+
+    rapidjson::GenericStringBuffer<rapidjson::UTF8<>> buffer;
+    rapidjson::Writer<rapidjson::GenericStringBuffer<rapidjson::UTF8<>>> jsonWriter(buffer);
+    document.Accept(jsonWriter);
+
+    return buffer.GetString();
+}
+
+int Scene::reusePrimitives(const Scene &previous)
+{
+    std::unordered_map<std::string, std::deque<std::shared_ptr<Primitive>>> candidates;
+    for (const std::shared_ptr<Primitive> &t : previous._primitives)
+        if (!previous._helperPrimitives.count(t.get()))
+            candidates[primitiveKey(*t)].push_back(t);
+
+    int reusedCount = 0;
+    for (std::shared_ptr<Primitive> &t : _primitives) {
+        auto iter = candidates.find(primitiveKey(*t));
+        if (iter == candidates.end() || iter->second.empty())
+            continue;
+
+        std::shared_ptr<Primitive> reused = std::move(iter->second.front());
+        iter->second.pop_front();
+
+        // Named BSDFs and media belong to this frame; unnamed ones are
+        // identical and stay with the reused primitive. Named BSDFs have
+        // the same content as the ones the primitive was prepared with
+        for (int i = 0; i < reused->numBsdfs(); ++i)
+            if (!reused->bsdf(i)->unnamed())
+                reused->setBsdf(i, t->bsdf(i));
+        reused->setIntMedium(t->intMedium());
+        reused->setExtMedium(t->extMedium());
+        reused->setTransform(t->transform());
+
+        _reusedPrimitives.insert(reused.get());
+        t = std::move(reused);
+        reusedCount++;
+    }
+
+    return reusedCount;
+}
+
+TraceableScene *Scene::makeTraceable(uint32 seed, TraceableScene *previous)
+{
+    return new TraceableScene(*_camera, *_integrator, _primitives, _bsdfs, _media, _rendererSettings, seed,
+            previous);
+}
+
+// This is done by serializing everything to JSON and hashing the resulting string
+uint64 Scene::contentHash() const
+{
+    rapidjson::Document document;
+    document.SetObject();
+    *(static_cast<rapidjson::Value *>(&document)) = toJson(document.GetAllocator());
+    document.RemoveMember("renderer");
+
+    rapidjson::GenericStringBuffer<rapidjson::UTF8<>> buffer;
+    rapidjson::Writer<rapidjson::GenericStringBuffer<rapidjson::UTF8<>>> jsonWriter(buffer);
+    document.Accept(jsonWriter);
+
+    return BitManip::hash(buffer.GetString());
 }
 
 Scene *Scene::load(const Path &path, std::shared_ptr<TextureCache> cache)
 {
-    JsonDocument document(path);
+    std::shared_ptr<SceneBundle> bundle;
+    if (SceneBundle::isBundle(path)) {
+        bundle = SceneBundle::open(path);
+        if (!bundle)
+            throw JsonLoadException(tfm::format("Unable to load scene bundle '%s'. "
+                    "It is either damaged or was baked by a different version", path.fileName()), "");
+    }
+    std::unique_ptr<JsonDocument> document(bundle ? new JsonDocument(path, bundle->json()) : new JsonDocument(path));
 
     DirectoryChange context(path.parent());
     if (!cache)
         cache = std::make_shared<TextureCache>();
 
     Scene *scene = new Scene(path.parent(), std::move(cache));
-    scene->fromJson(document, *scene);
+    scene->fromJson(*document, *scene);
     scene->setPath(path);
 
+    // Resources in the bundle were decoded for the scene that was baked. If
+    // the scene does not come out the same, fall back to the original files
+    if (bundle && scene->contentHash() != bundle->sceneHash())
+        DBG("Scene bundle '%s' does not match its scene and will be ignored", path);
+    else
+        scene->_bundle = std::move(bundle);
+
     return scene;
 }
 
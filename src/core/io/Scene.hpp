@@ -32,6 +32,8 @@
 
 namespace Tungsten {
 
+class SceneBundle;
+
 class Scene : public JsonSerializable
 {
     Path _srcDir;
@@ -45,10 +47,13 @@ class Scene : public JsonSerializable
     std::shared_ptr<Integrator> _integrator;
 
     std::unordered_set<const Primitive *> _helperPrimitives;
+    std::unordered_set<const Primitive *> _reusedPrimitives;
     mutable std::unordered_map<Path, PathPtr> _resources;
 
     RendererSettings _rendererSettings;
 
+    std::shared_ptr<SceneBundle> _bundle;
+
 public:
     Scene();
 
@@ -88,7 +93,18 @@ public:
 
     void merge(Scene scene);
 
-    TraceableScene *makeTraceable(uint32 seed = 0xBA5EBA11);
+    // Replaces primitives that are identical to one in the previous frame of an
+    // animation (up to their transform) with the already loaded primitive of
+    // that frame, so that its resources are not loaded again. Must be called
+    // before loadResources. Returns the number of primitives reused
+    int reusePrimitives(const Scene &previous);
+
+    // If a previous frame is passed, primitives reused from it are handed over
+    // without being prepared again, unless they moved
+    TraceableScene *makeTraceable(uint32 seed = 0xBA5EBA11, TraceableScene *previous = nullptr);
+
+    // Hash of everything in the scene except the renderer settings
+    uint64 contentHash() const;
 
     std::vector<std::shared_ptr<Medium>> &media()
     {
@@ -0,0 +1,261 @@
+#include "SceneBundle.hpp"
+#include "FileUtils.hpp"
+#include "Scene.hpp"
+
+#include "Debug.hpp"
+
+#include <tinyformat/tinyformat.hpp>
+#include <cstring>
+
+namespace Tungsten {
+
+CONSTEXPR uint32 SceneBundle::Magic;
+CONSTEXPR uint32 SceneBundle::Version;
+CONSTEXPR uint64 SceneBundle::DataAlignment;
+
+SceneBundle *SceneBundle::_current = nullptr;
+
+static std::string resourceKey(const std::string &type, const Path &path)
+{
+    return tfm::format("%s:%s", type, path.normalizeSeparators().asString());
+}
+
+SceneBundle::SceneBundle()
+: _recording(false),
+  _sceneHash(0),
+  _recordOffset(0)
+{
+}
+
+const SceneBundle::Entry *SceneBundle::find(const std::string &key, uint64 elementSize) const
+{
+    // Resources recorded while baking are already on their way to the bundle
+    // file and have no data to serve; they are loaded again from the source
+    auto iter = _entries.find(key);
+    if (iter == _entries.end() || iter->second.size % elementSize != 0)
+        return nullptr;
+    if (iter->second.size > 0 && !iter->second.data)
+        return nullptr;
+    return &iter->second;
+}
+
+static void writePadding(std::ostream &out, uint64 size, uint64 alignment)
+{
+    const char padding[64] = {0};
+    out.write(padding, (alignment - size % alignment) % alignment);
+}
+
+void SceneBundle::record(const std::string &key, const void *data, uint64 size, int w, int h)
+{
+    if (!_recording || _entries.count(key))
+        return;
+
+    Entry entry;
+    entry.w = w;
+    entry.h = h;
+    entry.offset = _recordOffset;
+    entry.size = size;
+    entry.data = nullptr;
+    if (size > 0) {
+        _recordStream->write(reinterpret_cast<const char *>(data), size);
+        writePadding(*_recordStream, size, DataAlignment);
+        _recordOffset += (size + DataAlignment - 1)/DataAlignment*DataAlignment;
+    }
+    _entries.insert(std::make_pair(key, entry));
+}
+
+std::shared_ptr<SceneBundle> SceneBundle::open(const Path &path)
+{
+    InputStreamHandle in = FileUtils::openInputStream(path);
+    if (!in)
+        return nullptr;
+
+    uint32 magic = 0, version = 0;
+    FileUtils::streamRead(in, magic);
+    FileUtils::streamRead(in, version);
+    if (!in->good() || magic != Magic || version != Version)
+        return nullptr;
+
+    uint64 indexOffset = 0;
+    in->seekg(-std::streamoff(sizeof(indexOffset)), std::ios_base::end);
+    FileUtils::streamRead(in, indexOffset);
+    in->seekg(std::streamoff(indexOffset));
+    if (!in->good())
+        return nullptr;
+
+    std::shared_ptr<SceneBundle> bundle(new SceneBundle());
+    FileUtils::streamRead(in, bundle->_sceneHash);
+    bundle->_json = FileUtils::streamRead<std::string>(in);
+
+    uint32 entryCount = 0;
+    FileUtils::streamRead(in, entryCount);
+    for (uint32 i = 0; i < entryCount && in->good(); ++i) {
+        std::string key = FileUtils::streamRead<std::string>(in);
+        Entry entry;
+        FileUtils::streamRead(in, entry.w);
+        FileUtils::streamRead(in, entry.h);
+        FileUtils::streamRead(in, entry.offset);
+        FileUtils::streamRead(in, entry.size);
+        entry.data = nullptr;
+        bundle->_entries.insert(std::make_pair(std::move(key), entry));
+    }
+    if (!in->good())
+        return nullptr;
+    in.reset();
+
+    bundle->_file.reset(new MemoryMappedFile(path));
+    if (!bundle->_file->valid())
+        return nullptr;
+
+    for (auto &iter : bundle->_entries) {
+        Entry &entry = iter.second;
+        if (DataAlignment + entry.offset + entry.size > indexOffset) {
+            DBG("Scene bundle '%s' is truncated", path);
+            return nullptr;
+        }
+        entry.data = bundle->_file->data() + DataAlignment + entry.offset;
+    }
+
+    return bundle;
+}
+
+bool SceneBundle::isBundle(const Path &path)
+{
+    InputStreamHandle in = FileUtils::openInputStream(path);
+    if (!in)
+        return false;
+
+    uint32 magic = 0;
+    FileUtils::streamRead(in, magic);
+    return in->good() && magic == Magic;
+}
+
+bool SceneBundle::bake(Scene &scene, const Path &dst)
+{
+    if (isBundle(scene.path()))
+        return false;
+
+    SceneBundle bundle;
+    bundle._recording = true;
+    bundle._sceneHash = scene.contentHash();
+    // Serializing the scene does not round-trip exactly (e.g. transforms), so
+    // the original document is stored to reproduce the hash on load
+    bundle._json = FileUtils::loadText(scene.path());
+    if (bundle._json.empty())
+        return false;
+
+    OutputStreamHandle out = FileUtils::openOutputStream(dst);
+    if (!out)
+        return false;
+
+    // The data section starts at the first aligned offset after the magic
+    // and version, so that entries stay aligned when the file is mapped
+    FileUtils::streamWrite(out, Magic);
+    FileUtils::streamWrite(out, Version);
+    writePadding(*out, sizeof(Magic) + sizeof(Version), DataAlignment);
+
+    bundle._recordStream = out;
+    {
+        Scope scope(&bundle);
+        scene.loadResources();
+    }
+    bundle._recording = false;
+    bundle._recordStream.reset();
+
+    uint64 indexOffset = DataAlignment + bundle._recordOffset;
+    FileUtils::streamWrite(out, bundle._sceneHash);
+    FileUtils::streamWrite(out, bundle._json);
+    FileUtils::streamWrite(out, uint32(bundle._entries.size()));
+    for (const auto &iter : bundle._entries) {
+        FileUtils::streamWrite(out, iter.first);
+        FileUtils::streamWrite(out, iter.second.w);
+        FileUtils::streamWrite(out, iter.second.h);
+        FileUtils::streamWrite(out, iter.second.offset);
+        FileUtils::streamWrite(out, iter.second.size);
+    }
+    FileUtils::streamWrite(out, indexOffset);
+
+    return out->good();
+}
+
+bool SceneBundle::isHdr(const Path &path, bool &hdr) const
+{
+    const Entry *entry = find(resourceKey("is_hdr", path), 1);
+    if (entry)
+        hdr = entry->w != 0;
+    return entry != nullptr;
+}
+
+std::unique_ptr<float[]> SceneBundle::loadHdr(const Path &path, TexelConversion request, int &w, int &h) const
+{
+    const Entry *entry = find(resourceKey(tfm::format("hdr%d", int(request)), path), sizeof(float));
+    if (!entry)
+        return nullptr;
+
+    std::unique_ptr<float[]> texels(new float[size_t(entry->size/sizeof(float))]);
+    std::memcpy(texels.get(), entry->data, size_t(entry->size));
+    w = entry->w;
+    h = entry->h;
+
+    return texels;
+}
+
+std::unique_ptr<uint8[]> SceneBundle::loadLdr(const Path &path, TexelConversion request, int &w, int &h,
+        bool gammaCorrect) const
+{
+    const Entry *entry = find(resourceKey(tfm::format("ldr%d%s", int(request),
+            gammaCorrect ? "g" : ""), path), 1);
+    if (!entry)
+        return nullptr;
+
+    std::unique_ptr<uint8[]> texels(new uint8[size_t(entry->size)]);
+    std::memcpy(texels.get(), entry->data, size_t(entry->size));
+    w = entry->w;
+    h = entry->h;
+
+    return texels;
+}
+
+bool SceneBundle::loadMesh(const Path &path, std::vector<Vertex> &verts, std::vector<TriangleI> &tris) const
+{
+    const Entry *vertEntry = find(resourceKey("verts", path), sizeof(Vertex));
+    const Entry *triEntry = find(resourceKey("tris", path), sizeof(TriangleI));
+    if (!vertEntry || !triEntry)
+        return false;
+
+    verts.resize(size_t(vertEntry->size/sizeof(Vertex)));
+    tris.resize(size_t(triEntry->size/sizeof(TriangleI)));
+    if (!verts.empty())
+        std::memcpy(&verts[0], vertEntry->data, size_t(vertEntry->size));
+    if (!tris.empty())
+        std::memcpy(&tris[0], triEntry->data, size_t(triEntry->size));
+
+    return true;
+}
+
+void SceneBundle::recordIsHdr(const Path &path, bool hdr)
+{
+    record(resourceKey("is_hdr", path), nullptr, 0, hdr ? 1 : 0, 0);
+}
+
+void SceneBundle::recordHdr(const Path &path, TexelConversion request, const float *texels, int w, int h,
+        int channels)
+{
+    record(resourceKey(tfm::format("hdr%d", int(request)), path), texels,
+            uint64(w)*uint64(h)*channels*sizeof(float), w, h);
+}
+
+void SceneBundle::recordLdr(const Path &path, TexelConversion request, const uint8 *texels, int w, int h,
+        int channels, bool gammaCorrect)
+{
+    record(resourceKey(tfm::format("ldr%d%s", int(request), gammaCorrect ? "g" : ""), path), texels,
+            uint64(w)*uint64(h)*channels, w, h);
+}
+
+void SceneBundle::recordMesh(const Path &path, const std::vector<Vertex> &verts, const std::vector<TriangleI> &tris)
+{
+    record(resourceKey("verts", path), verts.data(), verts.size()*sizeof(Vertex), int(verts.size()), 1);
+    record(resourceKey("tris", path), tris.data(), tris.size()*sizeof(TriangleI), int(tris.size()), 1);
+}
+
+}
@@ -0,0 +1,130 @@
+#ifndef SCENEBUNDLE_HPP_
+#define SCENEBUNDLE_HPP_
+
+#include "MemoryMappedFile.hpp"
+#include "FileUtils.hpp"
+#include "ImageIO.hpp"
+#include "Path.hpp"
+
+#include "primitives/Triangle.hpp"
+#include "primitives/Vertex.hpp"
+
+#include "IntTypes.hpp"
+
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Tungsten {
+
+class Scene;
+
+// A scene document together with all of its decoded resources in a single
+// binary file, written by scenemanip --bake. Texels are stored exactly as
+// ImageIO returns them and meshes exactly as MeshIO returns them, so loading
+// a bundle skips all parsing and decoding. The file is memory mapped and its
+// contents are only copied out when a resource is requested. Resources are
+// keyed by their path as written in the scene document, so a bundle does not
+// depend on the location of the original files.
+//
+// While a bundle is current, ImageIO and MeshIO consult it before touching
+// the file system. A recording bundle instead streams everything the loaders
+// return straight to the bundle file, which is how bundles are baked. Since
+// the resources are only known once they have been written, the index of the
+// file follows the data and is found through a trailer at the end of the file.
+//
+// Like FileUtils, none of this is thread-safe.
+class SceneBundle
+{
+    static CONSTEXPR uint32 Magic = 0x42535754; // "TWSB"
+    static CONSTEXPR uint32 Version = 2;
+    static CONSTEXPR uint64 DataAlignment = 64;
+
+    struct Entry
+    {
+        int32 w, h;
+        uint64 offset;
+        uint64 size;
+        const uint8 *data;
+    };
+
+    static SceneBundle *_current;
+
+    bool _recording;
+    uint64 _sceneHash;
+    std::string _json;
+    std::unordered_map<std::string, Entry> _entries;
+
+    std::unique_ptr<MemoryMappedFile> _file;
+    OutputStreamHandle _recordStream;
+    uint64 _recordOffset;
+
+    const Entry *find(const std::string &key, uint64 elementSize) const;
+    void record(const std::string &key, const void *data, uint64 size, int w, int h);
+
+    SceneBundle();
+
+public:
+    // Returns null if the file is not a bundle or was written by a different version
+    static std::shared_ptr<SceneBundle> open(const Path &path);
+    static bool isBundle(const Path &path);
+
+    // Loads all resources of a freshly loaded scene and writes them to dst
+    // together with the scene document
+    static bool bake(Scene &scene, const Path &dst);
+
+    bool isHdr(const Path &path, bool &hdr) const;
+    std::unique_ptr<float[]> loadHdr(const Path &path, TexelConversion request, int &w, int &h) const;
+    std::unique_ptr<uint8[]> loadLdr(const Path &path, TexelConversion request, int &w, int &h,
+            bool gammaCorrect) const;
+    bool loadMesh(const Path &path, std::vector<Vertex> &verts, std::vector<TriangleI> &tris) const;
+
+    void recordIsHdr(const Path &path, bool hdr);
+    void recordHdr(const Path &path, TexelConversion request, const float *texels, int w, int h, int channels);
+    void recordLdr(const Path &path, TexelConversion request, const uint8 *texels, int w, int h, int channels,
+            bool gammaCorrect);
+    void recordMesh(const Path &path, const std::vector<Vertex> &verts, const std::vector<TriangleI> &tris);
+
+    const std::string &json() const
+    {
+        return _json;
+    }
+
+    uint64 sceneHash() const
+    {
+        return _sceneHash;
+    }
+
+    static SceneBundle *current()
+    {
+        return _current;
+    }
+
+    // Makes a bundle current for the lifetime of this object. A null bundle
+    // leaves the current bundle untouched
+    class Scope
+    {
+        SceneBundle *_previous;
+        bool _active;
+
+    public:
+        Scope(SceneBundle *bundle)
+        : _previous(_current),
+          _active(bundle != nullptr)
+        {
+            if (_active)
+                _current = bundle;
+        }
+
+        ~Scope()
+        {
+            if (_active)
+                _current = _previous;
+        }
+    };
+};
+
+}
+
+#endif /* SCENEBUNDLE_HPP_ */
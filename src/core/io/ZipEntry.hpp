@@ -9,6 +9,12 @@
 
 namespace Tungsten {
 
+// ZipWriter compresses large files as a sequence of chunks that can be
+// inflated independently of each other. Their layout is stored in the file
+// comment, as this tag followed by the uncompressed chunk size and the
+// compressed size of every chunk
+static const char *const ZipChunkIndexTag = "tungsten-chunks";
+
 struct ZipEntry
 {
     Path name;
@@ -17,6 +23,10 @@ struct ZipEntry
     bool isDirectory;
     int archiveIndex;
     std::vector<int> contents;
+
+    // Empty unless the file was written in independently compressed chunks
+    uint32 chunkSize;
+    std::vector<uint32> compressedChunkSizes;
 };
 
 }
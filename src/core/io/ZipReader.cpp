@@ -4,6 +4,9 @@
 
 #include "Debug.hpp"
 
+#include <cstring>
+#include <sstream>
+
 namespace Tungsten {
 
 static size_t minizFileReadFunc(void *userPtr, mz_uint64 file_ofs, void *pBuf, size_t n)
@@ -15,6 +18,57 @@ static size_t minizFileReadFunc(void *userPtr, mz_uint64 file_ofs, void *pBuf, s
     return size_t(in.gcount());
 }
 
+// Central directory file header, as laid out in the zip format
+static const size_t CentralHeaderSize = 46;
+static const size_t CentralHeaderNameLengthOffset = 28;
+static const size_t CentralHeaderExtraLengthOffset = 30;
+static const size_t CentralHeaderCommentLengthOffset = 32;
+
+static inline uint32 readLe16(const uint8 *p)
+{
+    return uint32(p[0]) | (uint32(p[1]) << 8);
+}
+
+// The file comment returned by miniz is truncated, so the full comment is read
+// straight from the central directory
+bool ZipReader::readChunkIndex(const mz_zip_archive_file_stat &stat, ZipEntry &entry)
+{
+    size_t tagLength = std::strlen(ZipChunkIndexTag);
+    if (stat.m_comment_size < tagLength || std::strncmp(stat.m_comment, ZipChunkIndexTag, tagLength) != 0)
+        return false;
+
+    uint8 header[CentralHeaderSize];
+    uint64 headerOffset = _archive.m_central_directory_file_ofs + stat.m_central_dir_ofs;
+    if (minizFileReadFunc(_in.get(), headerOffset, header, sizeof(header)) != sizeof(header))
+        return false;
+    uint64 commentOffset = headerOffset + CentralHeaderSize + readLe16(header + CentralHeaderNameLengthOffset)
+            + readLe16(header + CentralHeaderExtraLengthOffset);
+    std::string comment(readLe16(header + CentralHeaderCommentLengthOffset), '\0');
+    if (minizFileReadFunc(_in.get(), commentOffset, &comment[0], comment.size()) != comment.size())
+        return false;
+
+    std::istringstream in(comment.substr(tagLength));
+    uint32 chunkSize = 0;
+    in >> chunkSize;
+    if (chunkSize == 0)
+        return false;
+    uint64 numChunks = (stat.m_uncomp_size + chunkSize - 1)/chunkSize;
+
+    std::vector<uint32> compressedSizes;
+    uint64 compressedSize = 0;
+    uint32 size;
+    while (in >> size) {
+        compressedSizes.push_back(size);
+        compressedSize += size;
+    }
+    if (compressedSizes.size() != numChunks || compressedSize != stat.m_comp_size)
+        return false;
+
+    entry.chunkSize = chunkSize;
+    entry.compressedChunkSizes = std::move(compressedSizes);
+    return true;
+}
+
 ZipReader::ZipReader(const Path &p)
 : _path(p),
   _in(FileUtils::openInputStream(p))
@@ -42,6 +96,9 @@ ZipReader::ZipReader(const Path &p)
         entry.size = uint32(stat.m_uncomp_size);
         entry.isDirectory = !entry.fullPath.empty() && entry.fullPath.asString().back() == '/';
         entry.archiveIndex = i;
+        entry.chunkSize = 0;
+        if (stat.m_method == MZ_DEFLATED)
+            readChunkIndex(stat, entry);
 
         addPath(Path(stat.m_filename).stripSeparator(), std::move(entry));
     }
@@ -67,6 +124,7 @@ int ZipReader::addPath(const Path &p, ZipEntry entry)
             parentEntry.size = 0;
             parentEntry.isDirectory = true;
             parentEntry.archiveIndex = -1;
+            parentEntry.chunkSize = 0;
 
             _entries[addPath(parent, std::move(parentEntry))].contents.push_back(index);
         }
@@ -94,7 +152,7 @@ std::unique_ptr<ZipInputStreambuf> ZipReader::openStreambuf(const ZipEntry &entr
     } catch (const std::runtime_error &) {
         return nullptr;
     }
-    return std::move(result);
+    return result;
 }
 
 }
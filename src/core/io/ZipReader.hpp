@@ -24,6 +24,7 @@ class ZipReader
     InputStreamHandle _in;
 
     int addPath(const Path &p, ZipEntry entry);
+    bool readChunkIndex(const mz_zip_archive_file_stat &stat, ZipEntry &entry);
 
 public:
     ZipReader(const Path &p);
@@ -1,14 +1,23 @@
 #include "ZipStreambuf.hpp"
 #include "ZipEntry.hpp"
 
+#include "thread/ThreadUtils.hpp"
+#include "thread/ThreadPool.hpp"
+
 #include "math/MathUtil.hpp"
 
 #include "Debug.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 namespace Tungsten {
 
 static const uint64 InputBufferSize = TINFL_LZ_DICT_SIZE;
 static const uint64 OutputBufferSize = TINFL_LZ_DICT_SIZE;
+// Multiple of the output buffer size. Every checkpoint holds a copy of the
+// inflator and of the output buffer, i.e. about 43KB
+static const uint64 CheckpointSpacing = 2*1024*1024;
 
 ZipInputStreambuf::ZipInputStreambuf(InputStreamHandle in, mz_zip_archive &archive, const ZipEntry &entry)
 : _in(std::move(in)),
@@ -20,7 +29,8 @@ ZipInputStreambuf::ZipInputStreambuf(InputStreamHandle in, mz_zip_archive &archi
   _seekOffset(0),
   _status(TINFL_STATUS_NEEDS_MORE_INPUT),
   _inputBuffer(new uint8[InputBufferSize]),
-  _outputBuffer(new uint8[OutputBufferSize])
+  _outputBuffer(new uint8[OutputBufferSize]),
+  _chunkSize(0)
 {
     if (!mz_zip_reader_parse_zip_file_header(&archive, entry.archiveIndex, &_header))
         FAIL("ZipInputStreambuf: Failed to parse Zip file header");
@@ -31,20 +41,146 @@ ZipInputStreambuf::ZipInputStreambuf(InputStreamHandle in, mz_zip_archive &archi
     if (_header.is_compressed)
         tinfl_init(&_inflator);
 
+    if (_header.is_compressed && !entry.compressedChunkSizes.empty()) {
+        _chunkSize = entry.chunkSize;
+        _chunkOffsets.resize(entry.compressedChunkSizes.size() + 1, 0);
+        for (size_t i = 0; i < entry.compressedChunkSizes.size(); ++i)
+            _chunkOffsets[i + 1] = _chunkOffsets[i] + entry.compressedChunkSizes[i];
+        _chunks.resize(entry.compressedChunkSizes.size());
+    }
+
     char *start = reinterpret_cast<char *>(_outputBuffer.get());
     setg(start, start, start);
 }
 
+uint64 ZipInputStreambuf::chunkLength(size_t chunk) const
+{
+    return std::min(_chunkSize, _uncompressedSize - chunk*_chunkSize);
+}
+
+// Only called when the output buffer is full, at which point it holds exactly
+// the dictionary the inflator needs to continue
+void ZipInputStreambuf::saveCheckpoint()
+{
+    uint64 outputOffset = _outputStreamOffset + _outputBufOffset;
+    if (outputOffset % CheckpointSpacing != 0)
+        return;
+    if (!_checkpoints.empty() && _checkpoints.back().outputOffset >= outputOffset)
+        return;
+
+    _checkpoints.emplace_back();
+    Checkpoint &checkpoint = _checkpoints.back();
+    checkpoint.inputOffset = _inputStreamOffset - _inputAvail;
+    checkpoint.outputOffset = outputOffset;
+    checkpoint.inflator = _inflator;
+    checkpoint.dictionary.reset(new uint8[OutputBufferSize]);
+    std::memcpy(checkpoint.dictionary.get(), _outputBuffer.get(), OutputBufferSize);
+}
+
+void ZipInputStreambuf::restoreCheckpoint(const Checkpoint &checkpoint)
+{
+    _inflator = checkpoint.inflator;
+    std::memcpy(_outputBuffer.get(), checkpoint.dictionary.get(), OutputBufferSize);
+
+    _inputStreamOffset = checkpoint.inputOffset;
+    _outputStreamOffset = checkpoint.outputOffset - OutputBufferSize;
+    _inputAvail = 0;
+    _inputBufOffset = 0;
+    _outputBufOffset = OutputBufferSize;
+    _status = TINFL_STATUS_HAS_MORE_OUTPUT;
+}
+
+// Inflates the chunks starting at firstChunk that have not been inflated yet,
+// up to one chunk per thread
+bool ZipInputStreambuf::inflateChunks(size_t firstChunk)
+{
+    size_t batchSize = ThreadUtils::pool ? max(ThreadUtils::pool->threadCount(), 1u) : 1;
+    size_t endChunk = firstChunk;
+    while (endChunk < _chunks.size() && endChunk - firstChunk < batchSize && !_chunks[endChunk])
+        endChunk++;
+
+    uint64 inputStart = _chunkOffsets[firstChunk];
+    uint64 inputSize = _chunkOffsets[endChunk] - inputStart;
+    std::unique_ptr<uint8[]> input(new uint8[size_t(inputSize)]);
+    _in->seekg(_header.file_ofs + inputStart);
+    _in->read(reinterpret_cast<char *>(input.get()), inputSize);
+    if (uint64(_in->gcount()) != inputSize)
+        return false;
+
+    auto inflateChunk = [&](uint32 i) {
+        size_t chunk = firstChunk + i;
+        size_t outputSize = size_t(chunkLength(chunk));
+        size_t inputBufSize = size_t(_chunkOffsets[chunk + 1] - _chunkOffsets[chunk]);
+        size_t outputBufSize = outputSize;
+        std::unique_ptr<uint8[]> output(new uint8[outputSize]);
+
+        // All chunks but the last end in a sync flush instead of a final block
+        tinfl_decompressor inflator;
+        tinfl_init(&inflator);
+        int flags = TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF;
+        if (chunk + 1 < _chunks.size())
+            flags |= TINFL_FLAG_HAS_MORE_INPUT;
+        tinfl_status status = tinfl_decompress(
+            &inflator,
+            input.get() + (_chunkOffsets[chunk] - inputStart),
+            &inputBufSize,
+            output.get(),
+            output.get(),
+            &outputBufSize,
+            flags
+        );
+
+        if (status >= TINFL_STATUS_DONE && outputBufSize == outputSize)
+            _chunks[chunk] = std::move(output);
+    };
+    uint32 numChunks = uint32(endChunk - firstChunk);
+    if (ThreadUtils::pool && numChunks > 1)
+        ThreadUtils::parallelFor(0, numChunks, numChunks, inflateChunk);
+    else
+        for (uint32 i = 0; i < numChunks; ++i)
+            inflateChunk(i);
+
+    for (size_t i = firstChunk; i < endChunk; ++i)
+        if (!_chunks[i])
+            return false;
+    return true;
+}
+
+ZipInputStreambuf::int_type ZipInputStreambuf::underflowChunked()
+{
+    if (uint64(_seekOffset) >= _uncompressedSize)
+        return traits_type::eof();
+
+    size_t chunk = size_t(uint64(_seekOffset)/_chunkSize);
+    if (!_chunks[chunk] && !inflateChunks(chunk)) {
+        DBG("ZipInputStreambuf: Failed to inflate chunk %d", chunk);
+        return traits_type::eof();
+    }
+
+    _outputStreamOffset = chunk*_chunkSize;
+    uint64 length = chunkLength(chunk);
+    char *start = reinterpret_cast<char *>(_chunks[chunk].get());
+    setg(start, start + (_seekOffset - int64(_outputStreamOffset)), start + length);
+    _seekOffset = _outputStreamOffset + length;
+
+    return traits_type::to_int_type(*gptr());
+}
+
 ZipInputStreambuf::int_type ZipInputStreambuf::underflow()
 {
     if (gptr() < egptr())
         return traits_type::to_int_type(*gptr());
+    if (isChunked())
+        return underflowChunked();
     if (_status <= TINFL_STATUS_DONE)
         return traits_type::eof();
 
     if (_header.is_compressed) {
         _in->seekg(_header.file_ofs + _inputStreamOffset);
         do {
+            if (_outputBufOffset == OutputBufferSize)
+                saveCheckpoint();
+
             _outputStreamOffset += _outputBufOffset;
             _outputBufOffset = 0;
 
@@ -106,8 +242,24 @@ ZipInputStreambuf::int_type ZipInputStreambuf::underflow()
 
 std::streampos ZipInputStreambuf::seekpos(std::streampos pos, std::ios_base::openmode /*which*/)
 {
-    if (_header.is_compressed) {
-        if (pos >= int64(_outputStreamOffset)) {
+    if (isChunked()) {
+        _seekOffset = pos;
+        char *start = reinterpret_cast<char *>(_outputBuffer.get());
+        setg(start, start, start);
+    } else if (_header.is_compressed) {
+        auto next = std::upper_bound(_checkpoints.begin(), _checkpoints.end(), uint64(pos),
+                [](uint64 offset, const Checkpoint &c) { return offset < c.outputOffset; });
+        const Checkpoint *closest = (next == _checkpoints.begin()) ? nullptr : &*(next - 1);
+
+        if (pos >= int64(_outputStreamOffset) && (!closest ||
+                closest->outputOffset <= _outputStreamOffset + _outputBufOffset)) {
+            _seekOffset = pos;
+            char *start = reinterpret_cast<char *>(_outputBuffer.get());
+            int64 off = std::min(_seekOffset - int64(_outputStreamOffset), int64(_outputBufOffset));
+            setg(start, start + off, start + _outputBufOffset);
+        } else if (closest) {
+            restoreCheckpoint(*closest);
+
             _seekOffset = pos;
             char *start = reinterpret_cast<char *>(_outputBuffer.get());
             int64 off = std::min(_seekOffset - int64(_outputStreamOffset), int64(_outputBufOffset));
@@ -8,13 +8,28 @@
 #include <miniz/miniz.h>
 #include <streambuf>
 #include <memory>
+#include <vector>
 
 namespace Tungsten {
 
 struct ZipEntry;
 
+// Reads a file from a zip archive. Compressed files normally have to be inflated
+// sequentially, so the inflator state is saved at regular intervals while
+// reading, and seeks backwards resume from the closest saved state instead of
+// the start of the file. Files that ZipWriter compressed in independent chunks
+// are random access instead: they are inflated a batch of chunks at a time,
+// with the chunks of a batch inflated in parallel
 class ZipInputStreambuf : public std::basic_streambuf<char>
 {
+    struct Checkpoint
+    {
+        uint64 inputOffset;
+        uint64 outputOffset;
+        tinfl_decompressor inflator;
+        std::unique_ptr<uint8[]> dictionary;
+    };
+
     InputStreamHandle _in;
     mz_zip_file_header _header;
     tinfl_decompressor _inflator;
@@ -33,6 +48,23 @@ class ZipInputStreambuf : public std::basic_streambuf<char>
     std::unique_ptr<uint8[]> _inputBuffer;
     std::unique_ptr<uint8[]> _outputBuffer;
 
+    std::vector<Checkpoint> _checkpoints;
+
+    uint64 _chunkSize;
+    std::vector<uint64> _chunkOffsets;
+    std::vector<std::unique_ptr<uint8[]>> _chunks;
+
+    bool isChunked() const
+    {
+        return !_chunkOffsets.empty();
+    }
+    uint64 chunkLength(size_t chunk) const;
+
+    void saveCheckpoint();
+    void restoreCheckpoint(const Checkpoint &checkpoint);
+    bool inflateChunks(size_t firstChunk);
+
+    int_type underflowChunked();
     int_type underflow() override final;
 
     std::streampos seekpos(std::streampos pos, std::ios_base::openmode which) override final;
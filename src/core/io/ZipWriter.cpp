@@ -1,11 +1,18 @@
 #include "ZipWriter.hpp"
+#include "ZipEntry.hpp"
 #include "Debug.hpp"
 #include "Path.hpp"
 
+#include "thread/ThreadUtils.hpp"
+
+#include <tinyformat/tinyformat.hpp>
 #include <cstring>
+#include <vector>
 
 namespace Tungsten {
 
+static const size_t ChunkSize = 1024*1024;
+
 static size_t zipStreamWriteFunc(void *userPtr, mz_uint64 file_ofs, const void *pBuf, size_t n)
 {
     std::ostream &out = *static_cast<std::ostream *>(userPtr);
@@ -40,14 +47,78 @@ ZipWriter::~ZipWriter()
     close();
 }
 
+static mz_bool appendToBuffer(const void *buf, int len, void *user)
+{
+    std::vector<uint8> &dst = *static_cast<std::vector<uint8> *>(user);
+    const uint8 *src = static_cast<const uint8 *>(buf);
+    dst.insert(dst.end(), src, src + len);
+    return MZ_TRUE;
+}
+
+bool ZipWriter::addChunked(const void *src, size_t len, const Path &dst, int compressionLevel)
+{
+    size_t numChunks = (len + ChunkSize - 1)/ChunkSize;
+    std::vector<std::vector<uint8>> compressed(numChunks);
+    std::unique_ptr<bool[]> success(new bool[numChunks]);
+
+    // Every chunk starts with an empty dictionary, and all but the last one
+    // end in a full flush, which aligns them to a byte boundary. Concatenated,
+    // they form a single deflate stream
+    mz_uint flags = tdefl_create_comp_flags_from_zip_params(compressionLevel, -15, MZ_DEFAULT_STRATEGY);
+    ThreadUtils::parallelFor(0, uint32(numChunks), uint32(numChunks), [&](uint32 i) {
+        size_t offset = i*ChunkSize;
+        bool last = i + 1 == numChunks;
+        std::unique_ptr<tdefl_compressor> compressor(new tdefl_compressor);
+        success[i] = tdefl_init(compressor.get(), &appendToBuffer, &compressed[i], flags) == TDEFL_STATUS_OKAY
+            && tdefl_compress_buffer(compressor.get(), static_cast<const uint8 *>(src) + offset,
+                    std::min(ChunkSize, len - offset), last ? TDEFL_FINISH : TDEFL_FULL_FLUSH)
+                == (last ? TDEFL_STATUS_DONE : TDEFL_STATUS_OKAY);
+    });
+
+    std::string comment = tfm::format("%s %d", ZipChunkIndexTag, ChunkSize);
+    size_t compressedSize = 0;
+    for (size_t i = 0; i < numChunks; ++i) {
+        if (!success[i])
+            return false;
+        comment += tfm::format(" %d", compressed[i].size());
+        compressedSize += compressed[i].size();
+    }
+    if (comment.size() > 0xFFFF)
+        return false;
+
+    std::vector<uint8> data;
+    data.reserve(compressedSize);
+    for (const std::vector<uint8> &chunk : compressed)
+        data.insert(data.end(), chunk.begin(), chunk.end());
+
+    mz_uint32 crc = mz_uint32(mz_crc32(MZ_CRC32_INIT, static_cast<const uint8 *>(src), len));
+    return mz_zip_writer_add_mem_ex(&_archive, dst.asString().c_str(), data.data(), data.size(),
+            comment.c_str(), mz_uint16(comment.size()), compressionLevel | MZ_ZIP_FLAG_COMPRESSED_DATA,
+            len, crc) != 0;
+}
+
 bool ZipWriter::addFile(const Path &src, const Path &dst, int compressionLevel)
 {
+    uint64 size = FileUtils::fileSize(src);
+    if (ThreadUtils::pool && compressionLevel > 0 && size > ChunkSize) {
+        InputStreamHandle in = FileUtils::openInputStream(src);
+        if (in) {
+            std::unique_ptr<uint8[]> data(new uint8[size_t(size)]);
+            in->read(reinterpret_cast<char *>(data.get()), size);
+            if (uint64(in->gcount()) == size)
+                return addFile(data.get(), size_t(size), dst, compressionLevel);
+        }
+    }
+
     return mz_zip_writer_add_file(&_archive, dst.asString().c_str(), src.absolute().asString().c_str(),
             0, 0, compressionLevel) != 0;
 }
 
 bool ZipWriter::addFile(const void *src, size_t len, const Path &dst, int compressionLevel)
 {
+    if (ThreadUtils::pool && compressionLevel > 0 && len > ChunkSize
+            && addChunked(src, len, dst, compressionLevel))
+        return true;
     return mz_zip_writer_add_mem(&_archive, dst.asString().c_str(), src, len, compressionLevel) != 0;
 }
 
@@ -9,11 +9,16 @@ namespace Tungsten {
 
 class Path;
 
+// Files larger than a chunk are compressed in parallel, as a sequence of
+// independently compressed chunks (see ZipEntry.hpp). This produces a regular
+// deflate stream that other zip tools can read as usual
 class ZipWriter
 {
     mz_zip_archive _archive;
     OutputStreamHandle _out;
 
+    bool addChunked(const void *src, size_t len, const Path &dst, int compressionLevel);
+
 public:
     ZipWriter(const Path &dst);
     ZipWriter(OutputStreamHandle dst);
@@ -0,0 +1,53 @@
+#include "ErfTable.hpp"
+
+#include "math/Angle.hpp"
+
+namespace Tungsten {
+
+CONSTEXPR float ErfTable::MaxInverseZ;
+
+// exp(u^2)*erfc(u) in double precision. erfc underflows past u = 26, so large
+// arguments switch to the asymptotic expansion, which is accurate to 1e-8 there
+static double scaledErfcReference(double u)
+{
+    if (u < 25.0)
+        return std::exp(u*u)*std::erfc(u);
+    double invUSq = 1.0/(u*u);
+    return (1.0 - 0.5*invUSq + 0.75*invUSq*invUSq)/(u*double(SQRT_PI));
+}
+
+ErfTable::ErfTable()
+: _size(0)
+{
+}
+
+void ErfTable::init(int size)
+{
+    _size = max(size, 2);
+    _scaledErfc.reset(new float[_size]);
+    _inverseErfc.reset(new float[_size]);
+
+    _scaledErfc[0] = 0.0f;
+    for (int i = 1; i < _size; ++i) {
+        double x = double(i)/(_size - 1);
+        _scaledErfc[i] = float(scaledErfcReference(1.0/x - 1.0));
+    }
+
+    // Newton iteration on log(erfc(u)) + z^2 = 0. The left hand side is concave
+    // and decreasing in u, so after the first step the iteration approaches the
+    // root monotonically from above. Each entry starts from the previous solution
+    double u = 0.0;
+    for (int i = 0; i < _size; ++i) {
+        double z = (double(i)/(_size - 1))*MaxInverseZ;
+        for (int iter = 0; iter < 100; ++iter) {
+            double erfcx = scaledErfcReference(u);
+            double step = (std::log(erfcx) - u*u + z*z)*0.5*double(SQRT_PI)*erfcx;
+            u = max(u + step, 0.0);
+            if (std::abs(step) < 1e-12)
+                break;
+        }
+        _inverseErfc[i] = float(u);
+    }
+}
+
+}
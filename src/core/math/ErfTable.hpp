@@ -0,0 +1,60 @@
+#ifndef ERFTABLE_HPP_
+#define ERFTABLE_HPP_
+
+#include "math/MathUtil.hpp"
+
+#include <memory>
+#include <cmath>
+
+namespace Tungsten {
+
+// Tabulated complementary error function and its inverse, accurate relative to
+// the function value far into the tails (where erf itself rounds to +-1).
+// The forward table stores the scaled complement erfcx(u) = exp(u^2)*erfc(u)
+// over x = 1/(1 + u), which maps [0, inf) to a finite interval on which erfcx
+// is smooth. The inverse table stores erfc^-1(exp(-z^2)) over z, which is
+// close to linear for large z. Both are linearly interpolated; the error drops
+// quadratically with the table size
+class ErfTable
+{
+    static CONSTEXPR float MaxInverseZ = 10.0f;
+
+    int _size;
+    std::unique_ptr<float[]> _scaledErfc;
+    std::unique_ptr<float[]> _inverseErfc;
+
+    inline float lookup(const float *table, float x) const
+    {
+        int i = clamp(int(x), 0, _size - 2);
+        float u = x - i;
+        return table[i]*(1.0f - u) + table[i + 1]*u;
+    }
+
+public:
+    ErfTable();
+
+    void init(int size);
+
+    int size() const
+    {
+        return _size;
+    }
+
+    // exp(u^2)*erfc(u) for u >= 0. Goes to zero as u goes to infinity
+    inline float scaledErfc(float u) const
+    {
+        return lookup(_scaledErfc.get(), (_size - 1)/(1.0f + u));
+    }
+
+    // Solves erfc(u) = r for r in [0, 1]. Solutions for r in [1, 2] follow from
+    // erfc(-u) = 2 - erfc(u); callers should track 2 - r directly in that case,
+    // since r itself cannot resolve values close to 2
+    inline float erfcInv(float r) const
+    {
+        return lookup(_inverseErfc.get(), min(std::sqrt(-std::log(r)), MaxInverseZ)*((_size - 1)/MaxInverseZ));
+    }
+};
+
+}
+
+#endif /* ERFTABLE_HPP_ */
@@ -0,0 +1,110 @@
+#ifndef HALF_HPP_
+#define HALF_HPP_
+
+#include "BitManip.hpp"
+
+#include "IntTypes.hpp"
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+namespace Tungsten {
+
+// IEEE 754 binary16 floating point number. Only meant for storage; all
+// arithmetic happens in single precision. Conversions round to nearest even,
+// values beyond the half range become infinity, and NaNs stay NaNs
+class Half
+{
+    uint16 _bits;
+
+public:
+    // Left uninitialized, so that large arrays of halves are not touched on allocation
+    Half() = default;
+
+    explicit Half(float f)
+    : _bits(fromFloat(f))
+    {
+    }
+
+    operator float() const
+    {
+        return toFloat(_bits);
+    }
+
+    uint16 bits() const
+    {
+        return _bits;
+    }
+
+    static uint16 fromFloat(float f)
+    {
+        uint32 x = BitManip::floatBitsToUint(f);
+        uint32 sign = (x >> 16) & 0x8000u;
+        uint32 absX = x & 0x7FFFFFFFu;
+
+        // Infinity or NaN
+        if (absX >= 0x7F800000u)
+            return uint16(sign | 0x7C00u | (absX > 0x7F800000u ? 0x200u : 0u));
+        // Rounds to a value larger than the largest half
+        if (absX >= 0x477FF000u)
+            return uint16(sign | 0x7C00u);
+
+        uint32 result, remainder, halfway;
+        if (absX < 0x38800000u) {
+            // Result is subnormal. Anything below half the smallest subnormal rounds to zero
+            if (absX < 0x33000000u)
+                return uint16(sign);
+            uint32 shift = 126u - (absX >> 23);
+            uint32 mantissa = (absX & 0x7FFFFFu) | 0x800000u;
+            result = mantissa >> shift;
+            remainder = mantissa & ((1u << shift) - 1u);
+            halfway = 1u << (shift - 1u);
+        } else {
+            // Rebias the exponent from 127 to 15
+            result = (absX - 0x38000000u) >> 13;
+            remainder = absX & 0x1FFFu;
+            halfway = 0x1000u;
+        }
+        // A carry out of the mantissa correctly increments the exponent
+        if (remainder > halfway || (remainder == halfway && (result & 1u)))
+            result++;
+
+        return uint16(sign | result);
+    }
+
+    static float toFloat(uint16 h)
+    {
+#ifdef __F16C__
+        return _cvtsh_ss(h);
+#else
+        uint32 sign = uint32(h & 0x8000u) << 16;
+        uint32 exponent = (h >> 10) & 0x1Fu;
+        uint32 mantissa = h & 0x3FFu;
+
+        if (exponent == 0x1Fu)
+            return BitManip::uintBitsToFloat(sign | 0x7F800000u | (mantissa << 13));
+        if (exponent == 0) {
+            float f = float(mantissa)*5.9604644775390625e-8f;
+            return sign ? -f : f;
+        }
+        return BitManip::uintBitsToFloat(sign | ((exponent + 112u) << 23) | (mantissa << 13));
+#endif
+    }
+
+    // Converts four consecutive halves at once. Used for RGB data, where the
+    // fourth value is read and discarded, so src must stay readable up to src[3]
+    static void toFloat4(const Half *src, float *dst)
+    {
+#ifdef __F16C__
+        _mm_storeu_ps(dst, _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src))));
+#else
+        for (int i = 0; i < 4; ++i)
+            dst[i] = src[i];
+#endif
+    }
+};
+
+}
+
+#endif /* HALF_HPP_ */
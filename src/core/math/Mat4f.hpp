@@ -165,6 +165,19 @@ public:
         );
     }
 
+    bool operator==(const Mat4f &o) const
+    {
+        for (int i = 0; i < 16; ++i)
+            if (a[i] != o[i])
+                return false;
+        return true;
+    }
+
+    bool operator!=(const Mat4f &o) const
+    {
+        return !(*this == o);
+    }
+
     Mat4f operator-(const Mat4f &o) const
     {
         Mat4f tmp(*this);
@@ -18,7 +18,8 @@ AtmosphericMedium::AtmosphericMedium()
   _density(1.0f),
   _falloffScale(1.0f),
   _radius(1.0f),
-  _center(0.0f)
+  _center(0.0f),
+  _opticalDepthTableSize(0)
 {
 }
 
@@ -34,6 +35,7 @@ void AtmosphericMedium::fromJson(JsonPtr value, const Scene &scene)
     value.getField("falloff_scale", _falloffScale);
     value.getField("radius", _radius);
     value.getField("center", _center);
+    value.getField("optical_depth_table_size", _opticalDepthTableSize);
 }
 
 rapidjson::Value AtmosphericMedium::toJson(Allocator &allocator) const
@@ -44,7 +46,8 @@ rapidjson::Value AtmosphericMedium::toJson(Allocator &allocator) const
         "sigma_s", _materialSigmaS,
         "density", _density,
         "falloff_scale", _falloffScale,
-        "radius", _radius
+        "radius", _radius,
+        "optical_depth_table_size", _opticalDepthTableSize
     };
     if (!_primName.empty())
         result.add("pivot", _primName);
@@ -74,6 +77,9 @@ void AtmosphericMedium::prepareForRender()
     _sigmaS = _materialSigmaS*_density;
     _sigmaT = _sigmaA + _sigmaS;
     _absorptionOnly = _sigmaS == 0.0f;
+
+    if (_opticalDepthTableSize > 0 && _erfTable.size() != _opticalDepthTableSize)
+        _erfTable.init(_opticalDepthTableSize);
 }
 
 Vec3f AtmosphericMedium::sigmaA(Vec3f p) const
@@ -103,6 +109,9 @@ inline float AtmosphericMedium::density(float h, float t0) const
 
 inline float AtmosphericMedium::densityIntegral(float h, float t0, float t1) const
 {
+    if (_opticalDepthTableSize > 0)
+        return tabulatedDensityIntegral(h, t0, t1);
+
     float s = _effectiveFalloffScale;
     if (t1 == Ray::infinity())
         return (SQRT_PI*0.5f/s)*std::exp((-h*h + _radius*_radius)*s*s)*Erf::erfc(s*t0);
@@ -112,6 +121,9 @@ inline float AtmosphericMedium::densityIntegral(float h, float t0, float t1) con
 
 inline float AtmosphericMedium::inverseOpticalDepth(double h, double t0, double sigmaT, double xi) const
 {
+    if (_opticalDepthTableSize > 0)
+        return tabulatedInverseOpticalDepth(float(h), float(t0), float(sigmaT), float(xi));
+
     double s = _effectiveFalloffScale;
     double inner = std::erf(s*t0) - 2.0*double(INV_SQRT_PI)*std::exp(s*s*(h - _radius)*(h + _radius))*s*std::log(xi)/sigmaT;
 
@@ -121,6 +133,58 @@ inline float AtmosphericMedium::inverseOpticalDepth(double h, double t0, double
         return Erf::erfInv(inner)/s;
 }
 
+// The density along a ray is density(h, 0)*exp(-s^2*t^2), so the integral from
+// t to infinity is density(h, 0)*sqrt(pi)/(2s)*erfc(s*t). The tabulated variants
+// evaluate this through erfcx, which keeps full relative precision in the tails
+// where the analytic erf difference cancels. For negative t, the integral over
+// the symmetric half is subtracted from the total instead
+inline float AtmosphericMedium::tabulatedDensityIntegral(float h, float t0, float t1) const
+{
+    float s = _effectiveFalloffScale;
+    float logRho0 = -s*s*(h - _radius)*(h + _radius);
+    // Vanishes for t = infinity
+    auto tail = [&](float t) {
+        float u = s*t;
+        return std::exp(logRho0 - u*u)*_erfTable.scaledErfc(u);
+    };
+
+    float integral;
+    if (t0 >= 0.0f)
+        integral = tail(t0) - tail(t1);
+    else if (t1 <= 0.0f)
+        integral = tail(-t1) - tail(-t0);
+    else
+        integral = 2.0f*std::exp(logRho0) - tail(-t0) - tail(t1);
+
+    return (SQRT_PI*0.5f/s)*integral;
+}
+
+inline float AtmosphericMedium::tabulatedInverseOpticalDepth(float h, float t0, float sigmaT, float xi) const
+{
+    float s = _effectiveFalloffScale;
+    float u0 = s*t0;
+    float tail = std::exp(-u0*u0)*_erfTable.scaledErfc(std::abs(u0));
+    // Optical depth of -log(xi) in units of the erfc argument
+    float depth = -2.0f*INV_SQRT_PI*std::exp(s*s*(h - _radius)*(h + _radius))*s*std::log(xi)/sigmaT;
+
+    // Solves erfc(s*t) = erfc(s*t0) - depth. For t0 < 0, erfc(s*t0) = 2 - tail is
+    // close to 2, so the distance of the target to 2 is tracked instead
+    float r;
+    if (u0 >= 0.0f) {
+        r = tail - depth;
+    } else {
+        float complement = tail + depth;
+        if (complement <= 1.0f)
+            return -_erfTable.erfcInv(complement)/s;
+        r = 2.0f - complement;
+    }
+
+    if (r <= 0.0f)
+        return Ray::infinity();
+    else
+        return _erfTable.erfcInv(r)/s;
+}
+
 bool AtmosphericMedium::sampleDistance(PathSampleGenerator &sampler, const Ray &ray,
         MediumState &state, MediumSample &sample) const
 {
@@ -138,7 +202,8 @@ bool AtmosphericMedium::sampleDistance(PathSampleGenerator &sampler, const Ray &
         sample.pdf = 1.0f;
         sample.exited = true;
     } else {
-        int component = sampler.nextDiscrete(3);
+        Vec3f probabilities = channelProbabilities(state);
+        int component = sampleChannel(sampler, probabilities);
         float sigmaTc = _sigmaT[component];
         float xi = 1.0f - sampler.next1D();
 
@@ -147,10 +212,10 @@ bool AtmosphericMedium::sampleDistance(PathSampleGenerator &sampler, const Ray &
         sample.weight = std::exp(-_sigmaT*densityIntegral(h, t0, sample.t));
         sample.exited = (t >= maxT);
         if (sample.exited) {
-            sample.pdf = sample.weight.avg();
+            sample.pdf = probabilities.dot(sample.weight);
         } else {
             float rho = density(h, sample.t);
-            sample.pdf = (rho*_sigmaT*sample.weight).avg();
+            sample.pdf = probabilities.dot(rho*_sigmaT*sample.weight);
             sample.weight *= rho*_sigmaS;
         }
         sample.weight /= sample.pdf;
@@ -5,6 +5,8 @@
 
 #include "textures/Texture.hpp"
 
+#include "math/ErfTable.hpp"
+
 #include <memory>
 
 namespace Tungsten {
@@ -19,16 +21,20 @@ class AtmosphericMedium : public Medium
     float _falloffScale;
     float _radius;
     Vec3f _center;
+    int _opticalDepthTableSize;
 
     float _effectiveFalloffScale;
     Vec3f _sigmaA, _sigmaS;
     Vec3f _sigmaT;
     bool _absorptionOnly;
+    ErfTable _erfTable;
 
     inline float density(Vec3f p) const;
     inline float density(float h, float t0) const;
     inline float densityIntegral(float h, float t0, float t1) const;
     inline float inverseOpticalDepth(double h, double t0, double sigmaT, double xi) const;
+    inline float tabulatedDensityIntegral(float h, float t0, float t1) const;
+    inline float tabulatedInverseOpticalDepth(float h, float t0, float sigmaT, float xi) const;
 
 public:
     AtmosphericMedium();
@@ -38,6 +44,23 @@ public:
 
     virtual bool isHomogeneous() const override;
 
+    // Switches between the analytic optical depth (size 0) and lookup tables of
+    // the given size. Takes effect on the next call to prepareForRender
+    void setOpticalDepthTableSize(int size)
+    {
+        _opticalDepthTableSize = size;
+    }
+
+    Vec3f center() const
+    {
+        return _center;
+    }
+
+    float radius() const
+    {
+        return _radius;
+    }
+
     virtual void prepareForRender() override;
 
     virtual Vec3f sigmaA(Vec3f p) const override;
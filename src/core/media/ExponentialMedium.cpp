@@ -121,7 +121,8 @@ bool ExponentialMedium::sampleDistance(PathSampleGenerator &sampler, const Ray &
         sample.pdf = 1.0f;
         sample.exited = true;
     } else {
-        int component = sampler.nextDiscrete(3);
+        Vec3f probabilities = channelProbabilities(state);
+        int component = sampleChannel(sampler, probabilities);
         float sigmaTc = _sigmaT[component];
         float xi = 1.0f - sampler.next1D();
         float logXi = std::log(xi);
@@ -131,10 +132,10 @@ bool ExponentialMedium::sampleDistance(PathSampleGenerator &sampler, const Ray &
         sample.weight = std::exp(-_sigmaT*densityIntegral(x, dx, sample.t));
         sample.exited = (t >= maxT);
         if (sample.exited) {
-            sample.pdf = sample.weight.avg();
+            sample.pdf = probabilities.dot(sample.weight);
         } else {
             float rho = density(x, dx, sample.t);
-            sample.pdf = (rho*_sigmaT*sample.weight).avg();
+            sample.pdf = probabilities.dot(rho*_sigmaT*sample.weight);
             sample.weight *= rho*_sigmaS;
         }
         sample.weight /= sample.pdf;
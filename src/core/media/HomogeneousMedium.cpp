@@ -77,7 +77,8 @@ bool HomogeneousMedium::sampleDistance(PathSampleGenerator &sampler, const Ray &
         sample.pdf = 1.0f;
         sample.exited = true;
     } else {
-        int component = sampler.nextDiscrete(3);
+        Vec3f probabilities = channelProbabilities(state);
+        int component = sampleChannel(sampler, probabilities);
         float sigmaTc = _sigmaT[component];
 
         float t = -std::log(1.0f - sampler.next1D())/sigmaTc;
@@ -85,9 +86,9 @@ bool HomogeneousMedium::sampleDistance(PathSampleGenerator &sampler, const Ray &
         sample.weight = std::exp(-sample.t*_sigmaT);
         sample.exited = (t >= maxT);
         if (sample.exited) {
-            sample.pdf = sample.weight.avg();
+            sample.pdf = probabilities.dot(sample.weight);
         } else {
-            sample.pdf = (_sigmaT*sample.weight).avg();
+            sample.pdf = probabilities.dot(_sigmaT*sample.weight);
             sample.weight *= _sigmaS;
         }
         sample.weight /= sample.pdf;
@@ -2,6 +2,8 @@
 
 #include "phasefunctions/IsotropicPhaseFunction.hpp"
 
+#include "sampling/PathSampleGenerator.hpp"
+
 #include "io/JsonObject.hpp"
 #include "io/Scene.hpp"
 
@@ -31,6 +33,38 @@ rapidjson::Value Medium::toJson(Allocator &allocator) const
     };
 }
 
+// Distance sampling in chromatic media uses spectral MIS: the distance is
+// sampled with the extinction of a single color channel, and weighted with the
+// pdf of the one-sample MIS mixture over all three channels. Picking channels
+// uniformly wastes most samples once the path throughput has become strongly
+// chromatic (e.g. deep inside skin or tinted smoke), and the channels that still
+// matter then receive large weights, which shows up as fireflies. Instead,
+// channels are picked in proportion to the path throughput, so that
+// throughput[c]/probability[c] stays bounded by the total throughput
+Vec3f Medium::channelProbabilities(const MediumState &state)
+{
+    Vec3f weights = abs(state.throughput);
+    float sum = weights.sum();
+    if (!(sum > 0.0f) || !std::isfinite(sum))
+        return Vec3f(1.0f/3.0f);
+    return weights/sum;
+}
+
+int Medium::sampleChannel(PathSampleGenerator &sampler, const Vec3f &probabilities)
+{
+    float xi = sampler.uniformGenerator().next1D();
+    int channel = 0;
+    for (; channel < 2; ++channel) {
+        if (xi < probabilities[channel])
+            break;
+        xi -= probabilities[channel];
+    }
+    // Rounding must not select a channel that can never be picked
+    while (channel > 0 && probabilities[channel] == 0.0f)
+        channel--;
+    return channel;
+}
+
 Vec3f Medium::transmittanceAndPdfs(PathSampleGenerator &sampler, const Ray &ray, bool startOnSurface,
         bool endOnSurface, float &pdfForward, float &pdfBackward) const
 {
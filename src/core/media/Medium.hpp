@@ -27,11 +27,17 @@ public:
         bool firstScatter;
         int component;
         int bounce;
+        // Throughput of the path up to the current segment, used to pick the color
+        // channel that distances are sampled with. Integrators whose MIS weights
+        // need to recompute distance pdfs from the medium alone (BDPT) leave this
+        // at one, which makes the channel choice uniform
+        Vec3f throughput;
 
         void reset()
         {
             firstScatter = true;
             bounce = 0;
+            throughput = Vec3f(1.0f);
         }
 
         void advance()
@@ -41,6 +47,11 @@ public:
         }
     };
 
+protected:
+    static Vec3f channelProbabilities(const MediumState &state);
+    static int sampleChannel(PathSampleGenerator &sampler, const Vec3f &probabilities);
+
+public:
     Medium();
 
     virtual void fromJson(JsonPtr value, const Scene &scene) override;
@@ -125,7 +125,8 @@ bool VoxelMedium::sampleDistance(PathSampleGenerator &sampler, const Ray &ray,
         sample.pdf = 1.0f;
         sample.exited = true;
     } else {
-        int component = sampler.nextDiscrete(3);
+        Vec3f probabilities = channelProbabilities(state);
+        int component = sampleChannel(sampler, probabilities);
         float sigmaTc = _sigmaT[component];
         float xi = 1.0f - sampler.next1D();
         float logXi = -std::log(xi);
@@ -136,10 +137,10 @@ bool VoxelMedium::sampleDistance(PathSampleGenerator &sampler, const Ray &ray,
         float opticalDepth = sample.exited ? tAndDensity.y()/sigmaTc : logXi/sigmaTc;
         sample.weight = std::exp(-_sigmaT*opticalDepth);
         if (sample.exited) {
-            sample.pdf = sample.weight.avg();
+            sample.pdf = probabilities.dot(sample.weight);
         } else {
             float rho = tAndDensity.y();
-            sample.pdf = (rho*_sigmaT*sample.weight).avg();
+            sample.pdf = probabilities.dot(rho*_sigmaT*sample.weight);
             sample.weight *= rho*_sigmaS;
         }
         sample.weight /= sample.pdf;
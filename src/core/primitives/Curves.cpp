@@ -24,6 +24,11 @@ DEFINE_STRINGABLE_ENUM(Curves::CurveMode, "curve mode", ({
     {"ribbon", Curves::MODE_RIBBON}
 }))
 
+DEFINE_STRINGABLE_ENUM(Curves::CurveBvh, "curve BVH", ({
+    {"binary", Curves::BVH_BINARY},
+    {"oriented", Curves::BVH_ORIENTED}
+}))
+
 struct CurveIntersection
 {
     uint32 curveP0;
@@ -145,10 +150,12 @@ static inline void precomputeBSplineCoefficients(T &p0, T &p1, T &p2)
 
 // Implementation of "Ray tracing for curves primitive" by Nakamaru and Ohno
 // http://wscg.zcu.cz/wscg2002/Papers_2002/A83.pdf
+// Only the part of the curve in [tStart, tEnd] is intersected. startDepth
+// accounts for subdivision that already happened at BVH build time.
 template<bool isRibbon>
 static bool pointOnSpline(Vec4f q0, Vec4f q1, Vec4f q2,
         float tMin, float tMax, CurveIntersection &isect,
-        Vec3f n0, Vec3f n1, Vec3f n2)
+        Vec3f n0, Vec3f n1, Vec3f n2, float tStart, float tEnd, int startDepth)
 {
 
     CONSTEXPR int MaxDepth = 5;
@@ -163,9 +170,9 @@ static bool pointOnSpline(Vec4f q0, Vec4f q1, Vec4f q2,
     float xFlat = xyFlat.x(), yFlat = xyFlat.y();
 
     StackNode cur{
-        q2,
-        q0 + q1 + q2,
-        0.0f, 1.0f, 0
+        q0*(tStart*tStart) + q1*tStart + q2,
+        q0*(tEnd*tEnd) + q1*tEnd + q2,
+        tStart, tEnd, startDepth
     };
     float closestDepth = tMax;
 
@@ -235,8 +242,24 @@ static Box3f curveBox(const Vec4f &q0, const Vec4f &q1, const Vec4f &q2)
     );
 }
 
+// Number of pieces a segment is split into at build time. The deviation of the curve
+// from its chord shrinks quadratically with the number of pieces; we split until it
+// is below the curve width, so that the oriented bounds of each piece stay tight
+static int segmentSubdivision(const Vec4f &p0, const Vec4f &p1, const Vec4f &p2)
+{
+    CONSTEXPR int MaxPieces = 4;
+
+    float deviation = (p1.xyz()*2.0f - p0.xyz() - p2.xyz()).length()*0.125f;
+    float width = max(p0.w(), p1.w(), p2.w());
+    int pieces = 1;
+    while (pieces < MaxPieces && deviation > width*sqr(pieces))
+        pieces *= 2;
+    return pieces;
+}
+
 Curves::Curves()
 : _mode("half_cylinder"),
+  _bvhType("binary"),
   _curveThickness(0.01f),
   _subsample(0.0f),
   _overrideThickness(false),
@@ -249,6 +272,7 @@ Curves::Curves(const Curves &o)
 : Primitive(o)
 {
     _mode              = o._mode;
+    _bvhType           = o._bvhType;
     _curveThickness    = o._curveThickness;
     _taperThickness    = o._taperThickness;
     _overrideThickness = o._overrideThickness;
@@ -268,6 +292,7 @@ Curves::Curves(std::vector<uint32> curveEnds, std::vector<Vec4f> nodeData, std::
 : Primitive(name),
   _path(std::make_shared<Path>(name.append(".fiber"))),
   _mode("half_cylinder"),
+  _bvhType("binary"),
   _curveThickness(0.01f),
   _overrideThickness(false),
   _taperThickness(false),
@@ -376,6 +401,7 @@ void Curves::fromJson(JsonPtr value, const Scene &scene)
     if (auto path = value["file"]) _path = scene.fetchResource(path);
     if (auto bsdf = value["bsdf"]) _bsdf = scene.fetchBsdf(bsdf);
     _mode = value["mode"];
+    _bvhType = value["bvh"];
     value.getField("curve_taper", _taperThickness);
     value.getField("subsample", _subsample);
     _overrideThickness = value.getField("curve_thickness", _curveThickness);
@@ -388,6 +414,7 @@ rapidjson::Value Curves::toJson(Allocator &allocator) const
         "curve_taper", _taperThickness,
         "subsample", _subsample,
         "mode", _mode.toString(),
+        "bvh", _bvhType.toString(),
         "bsdf", *_bsdf
     };
     if (_path)
@@ -444,7 +471,7 @@ bool Curves::intersectTemplate(Ray &ray, IntersectionTemporary &data) const
     bool didIntersect = false;
     CurveIntersection &isect = *data.as<CurveIntersection>();
 
-    _bvh->trace(ray, [&](Ray &ray, uint32 id, float /*tMin*/, const Vec3pf &/*bounds*/) {
+    auto intersectSegment = [&](Ray &ray, uint32 id, float tStart, float tEnd, int depth) {
         Vec4f q0(project(o, lx, ly, lz, _nodeData[id - 2]));
         Vec4f q1(project(o, lx, ly, lz, _nodeData[id - 1]));
         Vec4f q2(project(o, lx, ly, lz, _nodeData[id - 0]));
@@ -456,12 +483,23 @@ bool Curves::intersectTemplate(Ray &ray, IntersectionTemporary &data) const
             n2 = project(lx, ly, lz, _nodeNormals[id - 0]);
         }
 
-        if (pointOnSpline<isRibbon>(q0, q1, q2, ray.nearT(), ray.farT(), isect, n0, n1, n2)) {
+        if (pointOnSpline<isRibbon>(q0, q1, q2, ray.nearT(), ray.farT(), isect, n0, n1, n2, tStart, tEnd, depth)) {
             ray.setFarT(isect.t);
             isect.curveP0 = id - 2;
             didIntersect = true;
         }
-    });
+    };
+
+    if (_orientedBvh) {
+        _orientedBvh->trace(ray, [&](Ray &ray, uint32 idx) {
+            const SegmentPiece &piece = _pieces[idx];
+            intersectSegment(ray, piece.id, piece.tMin, piece.tMax, piece.depth);
+        });
+    } else {
+        _bvh->trace(ray, [&](Ray &ray, uint32 id, float /*tMin*/, const Vec3pf &/*bounds*/) {
+            intersectSegment(ray, id, 0.0f, 1.0f, 0);
+        });
+    }
 
     if (didIntersect)
         data.primitive = this;
@@ -569,21 +607,11 @@ const TriangleMesh &Curves::asTriangleMesh()
     return *_proxy;
 }
 
-void Curves::prepareForRender()
+void Curves::buildBinaryBvh()
 {
     Bvh::PrimVector prims;
     prims.reserve(_nodeCount - 2*_curveCount);
 
-    float widthScale = _transform.extractScaleVec().avg();
-
-    for (Vec4f &data : _nodeData) {
-        Vec3f newP = _transform*data.xyz();
-        data.x() = newP.x();
-        data.y() = newP.y();
-        data.z() = newP.z();
-        data.w() *= widthScale;
-    }
-
     UniformSampler rand;
     for (uint32 i = 0; i < _curveCount; ++i) {
         uint32 start = 0;
@@ -607,6 +635,69 @@ void Curves::prepareForRender()
     }
 
     _bvh.reset(new Bvh::BinaryBvh(std::move(prims), 2));
+}
+
+void Curves::buildOrientedBvh()
+{
+    std::vector<Bvh::OrientedQuadBvh::Segment> segments;
+    segments.reserve(_nodeCount - 2*_curveCount);
+    _pieces.clear();
+    _pieces.reserve(_nodeCount - 2*_curveCount);
+
+    UniformSampler rand;
+    for (uint32 i = 0; i < _curveCount; ++i) {
+        uint32 start = 0;
+        if (i > 0)
+            start = _curveEnds[i - 1];
+
+        if (_subsample > 0.0f && rand.next1D() < _subsample)
+            continue;
+
+        for (uint32 t = start + 2; t < _curveEnds[i]; ++t) {
+            Vec4f q0 = _nodeData[t - 2];
+            Vec4f q1 = _nodeData[t - 1];
+            Vec4f q2 = _nodeData[t - 0];
+            int pieces = segmentSubdivision(q0, q1, q2);
+            int depth = pieces == 4 ? 2 : (pieces == 2 ? 1 : 0);
+            precomputeBSplineCoefficients(q0, q1, q2);
+
+            for (int j = 0; j < pieces; ++j) {
+                float tMin = j/float(pieces);
+                float tMax = (j + 1)/float(pieces);
+
+                // Bezier control points of the piece. The quadratic is contained
+                // in their convex hull, which the BVH dilates by the maximum width
+                Vec4f b0 = q0*(tMin*tMin) + q1*tMin + q2;
+                Vec4f b2 = q0*(tMax*tMax) + q1*tMax + q2;
+                Vec4f b1 = b0 + (q0*(2.0f*tMin) + q1)*(0.5f*(tMax - tMin));
+
+                segments.push_back(Bvh::OrientedQuadBvh::Segment{
+                    b0.xyz(), b1.xyz(), b2.xyz(), max(b0.w(), b1.w(), b2.w())
+                });
+                _pieces.push_back(SegmentPiece{t, tMin, tMax, depth});
+            }
+        }
+    }
+
+    _orientedBvh.reset(new Bvh::OrientedQuadBvh(segments));
+}
+
+void Curves::prepareForRender()
+{
+    float widthScale = _transform.extractScaleVec().avg();
+
+    for (Vec4f &data : _nodeData) {
+        Vec3f newP = _transform*data.xyz();
+        data.x() = newP.x();
+        data.y() = newP.y();
+        data.z() = newP.z();
+        data.w() *= widthScale;
+    }
+
+    if (_bvhType == BVH_ORIENTED)
+        buildOrientedBvh();
+    else
+        buildBinaryBvh();
 
     //_needsRayTransform = true;
 
@@ -618,6 +709,8 @@ void Curves::prepareForRender()
 void Curves::teardownAfterRender()
 {
     _bvh.reset();
+    _orientedBvh.reset();
+    _pieces.clear();
     // TODO
     loadCurves();
 
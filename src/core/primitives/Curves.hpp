@@ -3,6 +3,7 @@
 
 #include "Primitive.hpp"
 
+#include "bvh/OrientedQuadBvh.hpp"
 #include "bvh/BinaryBvh.hpp"
 
 #include "io/Path.hpp"
@@ -29,8 +30,26 @@ class Curves : public Primitive
     typedef StringableEnum<CurveModeEnum> CurveMode;
     friend CurveMode;
 
+    enum CurveBvhEnum
+    {
+        BVH_BINARY,
+        BVH_ORIENTED,
+    };
+    typedef StringableEnum<CurveBvhEnum> CurveBvh;
+    friend CurveBvh;
+
+    // Piece of a curve segment referenced by the oriented BVH.
+    // Long and strongly bent segments are subdivided at build time
+    struct SegmentPiece
+    {
+        uint32 id;
+        float tMin, tMax;
+        int depth;
+    };
+
     PathPtr _path;
     CurveMode _mode;
+    CurveBvh _bvhType;
     float _curveThickness;
     float _subsample;
     bool _overrideThickness;
@@ -50,10 +69,14 @@ class Curves : public Primitive
     Box3f _bounds;
 
     std::unique_ptr<Bvh::BinaryBvh> _bvh;
+    std::unique_ptr<Bvh::OrientedQuadBvh> _orientedBvh;
+    std::vector<SegmentPiece> _pieces;
 
     void loadCurves();
     void computeBounds();
     void buildProxy();
+    void buildBinaryBvh();
+    void buildOrientedBvh();
 
     template<bool isRibbon>
     bool intersectTemplate(Ray &ray, IntersectionTemporary &data) const;
@@ -105,6 +128,16 @@ public:
     {
         return _path;
     }
+
+    const char *bvhTypeName() const
+    {
+        return _bvhType.toString();
+    }
+
+    void setBvhTypeName(const std::string &name)
+    {
+        _bvhType = name;
+    }
 };
 
 }
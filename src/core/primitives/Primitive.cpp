@@ -98,6 +98,14 @@ Vec3f Primitive::evalDirect(const IntersectionTemporary &data, const Intersectio
     return (*_emission)[info];
 }
 
+bool Primitive::isTransparent()
+{
+    for (int i = 0; i < numBsdfs(); ++i)
+        if (bsdf(i)->lobes().hasForward())
+            return true;
+    return false;
+}
+
 void Primitive::prepareForRender()
 {
     if (_power) {
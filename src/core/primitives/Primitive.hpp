@@ -95,6 +95,10 @@ public:
     virtual std::shared_ptr<Bsdf> &bsdf(int index) = 0;
     virtual void setBsdf(int index, std::shared_ptr<Bsdf> &bsdf) = 0;
 
+    // Whether shadow rays need to evaluate the surface when passing through it.
+    // Only valid after prepareForRender
+    virtual bool isTransparent();
+
     virtual Primitive *clone() = 0;
 
     void setupTangentFrame(const IntersectionTemporary &data,
@@ -1,10 +1,14 @@
 #include "TriangleMesh.hpp"
 #include "EmbreeUtil.hpp"
 
+#include "bsdfs/TransparencyBsdf.hpp"
+
 #include "sampling/PathSampleGenerator.hpp"
 #include "sampling/SampleWarp.hpp"
 
 #include "math/TangentFrame.hpp"
+#include "math/MathUtil.hpp"
+#include "math/BitManip.hpp"
 #include "math/Mat4f.hpp"
 #include "math/Vec.hpp"
 #include "math/Box.hpp"
@@ -333,7 +337,12 @@ void TriangleMesh::intersectionInfo(const IntersectionTemporary &data, Intersect
         info.Ns = info.Ng;
     info.uv = uvAt(isect->primId, isect->u, isect->v);
     info.primitive = this;
-    info.bsdf = _bsdfs[_tris[isect->primId].material].get();
+    int material = _tris[isect->primId].material;
+    // Hits that survive the alpha test are opaque
+    if (_alphaBsdfs[material])
+        info.bsdf = _alphaBsdfs[material]->base().get();
+    else
+        info.bsdf = _bsdfs[material].get();
 }
 
 bool TriangleMesh::hitBackside(const IntersectionTemporary &data) const
@@ -507,6 +516,18 @@ void TriangleMesh::prepareForRender()
 {
     computeBounds();
 
+    bool alphaTested = false;
+    _alphaBsdfs.clear();
+    for (const std::shared_ptr<Bsdf> &bsdf : _bsdfs) {
+        const TransparencyBsdf *transparency = dynamic_cast<const TransparencyBsdf *>(bsdf.get());
+        if (transparency && transparency->alphaTested()) {
+            _alphaBsdfs.push_back(transparency);
+            alphaTested = true;
+        } else {
+            _alphaBsdfs.push_back(nullptr);
+        }
+    }
+
     if (_verts.empty() || _tris.empty())
         return;
 
@@ -545,6 +566,33 @@ void TriangleMesh::prepareForRender()
     rtcUnmapBuffer(_scene, _geomId, RTC_VERTEX_BUFFER);
     rtcUnmapBuffer(_scene, _geomId, RTC_INDEX_BUFFER);
 
+    // Alpha tested hits are rejected inside traversal, so that rays continue
+    // to the next hit instead of being restarted from the surface
+    if (alphaTested) {
+        auto alphaFilter = [](void *ptr, RTCRay &ray) {
+            const TriangleMesh &mesh = *static_cast<const TriangleMesh *>(ptr);
+            const TransparencyBsdf *bsdf = mesh._alphaBsdfs[mesh._tris[ray.primID].material];
+            if (!bsdf)
+                return;
+
+            // Stochastic alpha needs a random number, but there is no sampler
+            // in here. Hashing the ray and the hit gives the same decision to
+            // every query made with the same ray
+            uint32 hash = MathUtil::hash32(ray.primID);
+            for (int i = 0; i < 3; ++i) {
+                hash = MathUtil::hash32(hash ^ BitManip::floatBitsToUint(ray.org[i]));
+                hash = MathUtil::hash32(hash ^ BitManip::floatBitsToUint(ray.dir[i]));
+            }
+            float xi = (hash >> 8)*(1.0f/(1 << 24));
+
+            if (!bsdf->alphaTest(mesh.uvAt(ray.primID, ray.u, ray.v), xi))
+                ray.geomID = RTC_INVALID_GEOMETRY_ID;
+        };
+        rtcSetUserData(_scene, _geomId, this);
+        rtcSetIntersectionFilterFunction(_scene, _geomId, alphaFilter);
+        rtcSetOcclusionFilterFunction(_scene, _geomId, alphaFilter);
+    }
+
     rtcCommit(_scene);
 
     //if (_backfaceCulling)
@@ -578,6 +626,22 @@ std::shared_ptr<Bsdf> &TriangleMesh::bsdf(int index)
 void TriangleMesh::setBsdf(int index, std::shared_ptr<Bsdf> &bsdf)
 {
     _bsdfs[index] = bsdf;
+
+    // Prepared meshes keep their alpha test pointed at the current BSDF
+    if (size_t(index) < _alphaBsdfs.size() && _alphaBsdfs[index]) {
+        const TransparencyBsdf *transparency = dynamic_cast<const TransparencyBsdf *>(bsdf.get());
+        _alphaBsdfs[index] = transparency && transparency->alphaTested() ? transparency : nullptr;
+    }
+}
+
+bool TriangleMesh::isTransparent()
+{
+    for (size_t i = 0; i < _bsdfs.size(); ++i) {
+        const Bsdf *bsdf = _alphaBsdfs[i] ? _alphaBsdfs[i]->base().get() : _bsdfs[i].get();
+        if (bsdf->lobes().hasForward())
+            return true;
+    }
+    return false;
 }
 
 Primitive *TriangleMesh::clone()
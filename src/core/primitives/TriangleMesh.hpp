@@ -18,6 +18,7 @@
 
 namespace Tungsten {
 
+class TransparencyBsdf;
 class Scene;
 
 class TriangleMesh : public Primitive
@@ -32,6 +33,8 @@ class TriangleMesh : public Primitive
     std::vector<TriangleI> _tris;
 
     std::vector<std::shared_ptr<Bsdf>> _bsdfs;
+    // Per BSDF, if it is alpha tested during BVH traversal
+    std::vector<const TransparencyBsdf *> _alphaBsdfs;
 
     std::unique_ptr<Distribution1D> _triSampler;
     float _totalArea;
@@ -113,6 +116,7 @@ public:
     virtual int numBsdfs() const override;
     virtual std::shared_ptr<Bsdf> &bsdf(int index) override;
     virtual void setBsdf(int index, std::shared_ptr<Bsdf> &bsdf) override;
+    virtual bool isTransparent() override;
 
     virtual Primitive *clone() override;
 
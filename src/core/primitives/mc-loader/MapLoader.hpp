@@ -5,39 +5,70 @@
 #include "MemBuf.hpp"
 #include "NBT.hpp"
 
+#include "thread/ThreadUtils.hpp"
+#include "thread/ThreadPool.hpp"
+
 #include "io/FileIterables.hpp"
 #include "io/Path.hpp"
 
 #include <tinyformat/tinyformat.hpp>
 #include <miniz/miniz.h>
 #include <functional>
+#include <exception>
+#include <algorithm>
 #include <iostream>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <cstdio>
 
 namespace Tungsten {
 namespace MinecraftLoader {
 
+// Region files are split into four 256x256 quadrants, which are decoded
+// concurrently on the thread pool. Each decoding task owns the buffers for
+// a single quadrant and hands it to the region handler as soon as it is
+// decoded, so peak memory is bounded by the number of tasks rather than the
+// size of the map.
 template<typename ElementType>
 class MapLoader
 {
     static const size_t CompressedChunkSize = 1024*1024;
     static const size_t DecompressedChunkSize = 5*1024*1024;
+    // Each in-flight quadrant holds a full 256x256x256 grid
+    static const uint32 MaxConcurrentQuadrants = 8;
 
-    Path _path;
+    struct RegionFile
+    {
+        Path path;
+        int x, z;
+    };
+
+    struct DecodeBuffers
+    {
+        std::unique_ptr<uint8[]> locationTable;
+        std::unique_ptr<uint8[]> compressedChunk, decompressedChunk;
+        std::unique_ptr<ElementType[]> grid;
+        std::unique_ptr<uint8[]> biomes;
+        int height;
+
+        DecodeBuffers()
+        : locationTable(new uint8[4096]),
+          compressedChunk(new uint8[CompressedChunkSize]),
+          decompressedChunk(new uint8[DecompressedChunkSize]),
+          grid(new ElementType[256*256*256]),
+          biomes(new uint8[256*256]),
+          height(0)
+        {
+        }
+    };
 
-    std::unique_ptr<uint8[]> _locationTable, _timestampTable;
-    std::unique_ptr<uint8[]> _compressedChunk, _decompressedChunk;
-    std::unique_ptr<ElementType[]> _regionGrid;
-    std::unique_ptr<uint8[]> _biomes;
-    int _regionHeight;
+    Path _path;
 
-    void loadChunk(std::istream &in, int chunkX, int chunkZ)
+    static void loadChunk(DecodeBuffers &buffers, std::istream &in, int chunkX, int chunkZ)
     {
         NbtTag root(in);
 
-        int gridOffset = (chunkX/16) + 2*(chunkZ/16);
-
         NbtTag &sections = root["Level"]["Sections"];
         for (int i = 0; i < sections.size(); ++i) {
             NbtTag &blocks = sections.subtag(i)["Blocks"];
@@ -45,7 +76,7 @@ class MapLoader
             NbtTag &data   = sections.subtag(i)["Data"];
             int chunkY = sections.subtag(i)["Y"].asInt();
 
-            int base = gridOffset*256*256*256 + 16*((chunkX % 16) + 256*chunkY + 256*256*(chunkZ % 16));
+            int base = 16*((chunkX % 16) + 256*chunkY + 256*256*(chunkZ % 16));
 
             for (int z = 0; z < 16; ++z) {
                 for (int y = 0; y < 16; ++y) {
@@ -57,10 +88,10 @@ class MapLoader
                         if (add   ) blockId |= ((static_cast<uint8>(add [idx/2]) >> ((idx & 1)*4)) & 0xF) << 12;
                         if (data  ) blockId |= ((static_cast<uint8>(data[idx/2]) >> ((idx & 1)*4)) & 0xF);
 
-                        _regionGrid[base + x + 256*y + 256*256*z] = blockId;
+                        buffers.grid[base + x + 256*y + 256*256*z] = blockId;
 
                         if (blockId)
-                            _regionHeight = max(_regionHeight, chunkY*16 + y + 1);
+                            buffers.height = max(buffers.height, chunkY*16 + y + 1);
                     }
                 }
             }
@@ -68,79 +99,89 @@ class MapLoader
 
         NbtTag &biomes = root["Level"]["Biomes"];
         if (biomes) {
-            int base = gridOffset*256*256 + 16*((chunkX % 16) + 256*(chunkZ % 16));
+            int base = 16*((chunkX % 16) + 256*(chunkZ % 16));
 
             for (int z = 0; z < 16; ++z)
                 for (int x = 0; x < 16; ++x)
-                    _biomes[base + x + z*256] = static_cast<uint8>(biomes[x + z*16]);
+                    buffers.biomes[base + x + z*256] = static_cast<uint8>(biomes[x + z*16]);
         }
     }
 
-    void loadRegion(std::istream &in)
+    // Decodes the chunks of one quadrant of a region file. Returns false if
+    // the region file could not be opened
+    static bool loadQuadrant(DecodeBuffers &buffers, const Path &path, int quadrantX, int quadrantZ)
     {
-        FileUtils::streamRead(in, _locationTable.get(), 4096);
-        FileUtils::streamRead(in, _timestampTable.get(), 4096);
+        InputStreamHandle in = FileUtils::openInputStream(path);
+        if (!in)
+            return false;
 
-        std::memset(_regionGrid.get(), 0, 512*256*512*sizeof(ElementType));
-        std::memset(_biomes.get(), 0xFF, 512*512*sizeof(uint8));
-        _regionHeight = 0;
+        FileUtils::streamRead(*in, buffers.locationTable.get(), 4096);
+
+        std::memset(buffers.grid.get(), 0, 256*256*256*sizeof(ElementType));
+        std::memset(buffers.biomes.get(), 0xFF, 256*256*sizeof(uint8));
+        buffers.height = 0;
 
         for (int i = 0; i < 1024; ++i) {
             int chunkX = i % 32;
             int chunkZ = i / 32;
+            if (chunkX/16 != quadrantX || chunkZ/16 != quadrantZ)
+                continue;
 
             uint32 offset = 4*1024*(
-                (uint32(_locationTable[i*4 + 0]) << 16) +
-                (uint32(_locationTable[i*4 + 1]) <<  8) +
-                 uint32(_locationTable[i*4 + 2]));
-            uint32 length = uint32(_locationTable[i*4 + 3])*4*1024;
+                (uint32(buffers.locationTable[i*4 + 0]) << 16) +
+                (uint32(buffers.locationTable[i*4 + 1]) <<  8) +
+                 uint32(buffers.locationTable[i*4 + 2]));
+            uint32 length = uint32(buffers.locationTable[i*4 + 3])*4*1024;
 
             if (offset == 0 || length == 0)
                 continue;
 
-            in.seekg(offset);
-            FileUtils::streamRead(in, _compressedChunk.get(), length);
+            uint8 *compressedChunk = buffers.compressedChunk.get();
+            in->seekg(offset);
+            FileUtils::streamRead(*in, compressedChunk, length);
 
             uint32 chunkLength =
-                (uint32(_compressedChunk[0]) << 24) +
-                (uint32(_compressedChunk[1]) << 16) +
-                (uint32(_compressedChunk[2]) <<  8) +
-                 uint32(_compressedChunk[3]);
-            if (_compressedChunk[4] != 2) {
+                (uint32(compressedChunk[0]) << 24) +
+                (uint32(compressedChunk[1]) << 16) +
+                (uint32(compressedChunk[2]) <<  8) +
+                 uint32(compressedChunk[3]);
+            if (compressedChunk[4] != 2) {
                 // Only accept Zlib compression
-                tfm::printf("Ignoring chunk %i, %i with unsupported compression mode %i\n", chunkX, chunkZ, _compressedChunk[4]);
+                tfm::printf("Ignoring chunk %i, %i with unsupported compression mode %i\n", chunkX, chunkZ, compressedChunk[4]);
                 std::cout.flush();
                 continue;
             }
 
             uLongf destLength = DecompressedChunkSize;
-            if (uncompress(_decompressedChunk.get(), &destLength, _compressedChunk.get() + 5, chunkLength) != Z_OK) {
+            if (uncompress(buffers.decompressedChunk.get(), &destLength, compressedChunk + 5, chunkLength) != Z_OK) {
                 tfm::printf("Decompression failed for chunk %i, %i\n", chunkX, chunkZ);
                 std::cout.flush();
                 continue;
             }
 
-            MemBuf buffer(reinterpret_cast<char *>(_decompressedChunk.get()), destLength);
+            MemBuf buffer(reinterpret_cast<char *>(buffers.decompressedChunk.get()), destLength);
             std::istream bufferStream(&buffer);
 
-            loadChunk(bufferStream, i % 32, i/32);
+            loadChunk(buffers, bufferStream, chunkX, chunkZ);
         }
+
+        return true;
     }
 
 public:
+    // The handler receives the quadrant index, the quadrant coordinates, the
+    // height of the tallest block and the block and biome grids of one quadrant.
+    // It is invoked concurrently from pool threads, and the buffers are only
+    // valid for the duration of the call. Quadrant indices are dense and
+    // independent of scheduling, so that callers can produce deterministic output
+    typedef std::function<void(uint32, int, int, int, ElementType *, uint8 *)> RegionHandler;
+
     MapLoader(const Path &path)
-    : _path(path),
-      _regionHeight(0)
+    : _path(path)
     {
-        _locationTable.reset(new uint8[4096]);
-        _timestampTable.reset(new uint8[4096]);
-        _compressedChunk.reset(new uint8[CompressedChunkSize]);
-        _decompressedChunk.reset(new uint8[DecompressedChunkSize]);
-        _regionGrid.reset(new ElementType[512*256*512]);
-        _biomes.reset(new uint8[512*512]);
     }
 
-    void loadRegions(const std::function<void(int, int, int, ElementType *, uint8 *)> &regionHandler) {
+    void loadRegions(const RegionHandler &regionHandler) {
         if (!_path.exists() || !_path.isDirectory()) {
             DBG("Failed to open minecraft map folder at '%s'", _path);
             return;
@@ -151,6 +192,7 @@ public:
             return;
         }
 
+        std::vector<RegionFile> regions;
         for (const Path &p : region.files("mca")) {
             std::string base = p.baseName().asString();
             if (base.length() < 2 || tolower(base.front()) != 'r' || base[1] != '.')
@@ -158,17 +200,57 @@ public:
             int x, z;
             if (std::sscanf(base.c_str() + 2, "%i.%i", &x, &z) != 2)
                 continue;
+            regions.push_back(RegionFile{p, x, z});
+        }
+        if (regions.empty())
+            return;
 
-            InputStreamHandle in = FileUtils::openInputStream(p);
-            if (!in)
-                continue;
-            loadRegion(*in);
-
-            regionHandler(x*2 + 0, z*2 + 0, _regionHeight, _regionGrid.get(),                 _biomes.get());
-            regionHandler(x*2 + 1, z*2 + 0, _regionHeight, _regionGrid.get() + 256*256*256,   _biomes.get() + 256*256);
-            regionHandler(x*2 + 0, z*2 + 1, _regionHeight, _regionGrid.get() + 256*256*256*2, _biomes.get() + 256*256*2);
-            regionHandler(x*2 + 1, z*2 + 1, _regionHeight, _regionGrid.get() + 256*256*256*3, _biomes.get() + 256*256*3);
+        // Directory iteration order is platform dependent
+        std::sort(regions.begin(), regions.end(), [](const RegionFile &a, const RegionFile &b) {
+            return a.z < b.z || (a.z == b.z && a.x < b.x);
+        });
+
+        uint32 numQuadrants = uint32(regions.size()*4);
+
+        std::atomic<uint32> nextQuadrant(0);
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        auto decodeQuadrants = [&](uint32, uint32, uint32) {
+            DecodeBuffers buffers;
+
+            uint32 idx;
+            while ((idx = nextQuadrant++) < numQuadrants) {
+                const RegionFile &file = regions[idx/4];
+                int quadrantX = idx % 2, quadrantZ = idx/2 % 2;
+
+                try {
+                    if (!loadQuadrant(buffers, file.path, quadrantX, quadrantZ))
+                        continue;
+                    regionHandler(idx, file.x*2 + quadrantX, file.z*2 + quadrantZ, buffers.height,
+                            buffers.grid.get(), buffers.biomes.get());
+                } catch (...) {
+                    std::unique_lock<std::mutex> lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                    nextQuadrant = numQuadrants;
+                }
+            }
+        };
+
+        // Tools that load scenes without starting the thread pool decode
+        // all quadrants on the calling thread
+        if (ThreadUtils::pool) {
+            uint32 numTasks = min(min(ThreadUtils::pool->threadCount(), uint32(MaxConcurrentQuadrants)), numQuadrants);
+            std::shared_ptr<TaskGroup> group = ThreadUtils::pool->enqueue(decodeQuadrants, numTasks);
+            // Do some work while we wait
+            ThreadUtils::pool->yield(*group);
+        } else {
+            decodeQuadrants(0, 1, 0);
         }
+
+        if (error)
+            std::rethrow_exception(error);
     }
 };
 
@@ -24,6 +24,7 @@
 
 #include <tinyformat/tinyformat.hpp>
 #include <unordered_set>
+#include <mutex>
 
 namespace Tungsten {
 namespace MinecraftLoader {
@@ -242,7 +243,7 @@ int TraceableMinecraftMap::fetchBsdf(ResourcePackLoader &pack, const TexturedQua
     return _materials.size() - 1;
 }
 
-void TraceableMinecraftMap::buildBiomeColors(ResourcePackLoader &pack, int rx, int rz, uint8 *biomes)
+std::unique_ptr<BiomeTileTexture> TraceableMinecraftMap::buildBiomeColors(const ResourcePackLoader &pack, const uint8 *biomes) const
 {
     std::unique_ptr<uint8[]> grassTop(new uint8[256*256*4]), grassBottom(new uint8[256*256*4]);
     std::unique_ptr<uint8[]> foliageTop(new uint8[256*256*4]), foliageBottom(new uint8[256*256*4]);
@@ -297,15 +298,13 @@ void TraceableMinecraftMap::buildBiomeColors(ResourcePackLoader &pack, int rx, i
     blurColors(foliageTop);
     blurColors(foliageBottom);
 
-    _biomes.emplace_back(new BiomeTileTexture{
+    return std::unique_ptr<BiomeTileTexture>(new BiomeTileTexture{
         makeTexture(grassTop.release()),
         makeTexture(grassBottom.release()),
         makeTexture(foliageTop.release()),
         makeTexture(foliageBottom.release()),
         std::move(heights)
     });
-
-    _biomeMap.insert(std::make_pair(Vec2i(rx, rz), _biomes.back().get()));
 }
 
 void TraceableMinecraftMap::convertQuads(ResourcePackLoader &pack, const std::vector<TexturedQuad> &model, const Mat4f &transform)
@@ -597,8 +596,32 @@ void TraceableMinecraftMap::loadResources()
             ResourcePackLoader pack(packs);
             buildModels(pack);
 
+            // Regions are decoded and converted concurrently, but committed
+            // in quadrant order to keep grid indices deterministic
+            struct LoadedRegion
+            {
+                int x, z, height;
+                std::unique_ptr<HierarchicalGrid> grid;
+                std::unique_ptr<BiomeTileTexture> biomes;
+            };
+            std::vector<LoadedRegion> loadedRegions;
+            std::mutex regionMutex;
+
             MapLoader<ElementType> loader(*_mapPath);
-            loader.loadRegions([&](int x, int z, int height, ElementType *data, uint8 *biomes) {
+            loader.loadRegions([&](uint32 idx, int x, int z, int height, ElementType *data, uint8 *biomes) {
+                std::unique_ptr<HierarchicalGrid> grid(new HierarchicalGrid(Vec3f(x*256.0f, 0.0f, z*256.0f), data));
+                std::unique_ptr<BiomeTileTexture> biomeTile = buildBiomeColors(pack, biomes);
+
+                std::unique_lock<std::mutex> lock(regionMutex);
+                if (idx >= loadedRegions.size())
+                    loadedRegions.resize(idx + 1);
+                loadedRegions[idx] = LoadedRegion{x, z, height, std::move(grid), std::move(biomeTile)};
+            });
+
+            for (LoadedRegion &region : loadedRegions) {
+                if (!region.grid)
+                    continue;
+                int x = region.x, z = region.z, height = region.height;
                 Box3f bounds(Vec3f(x*256.0f, 0.0f, z*256.0f), Vec3f((x + 1)*256.0f, float(height), (z + 1)*256.0f));
                 Vec3f centroid((x + 0.5f)*256.0f, height*0.5f, (z + 0.5f)*256.0f);
 
@@ -606,11 +629,12 @@ void TraceableMinecraftMap::loadResources()
 
                 prims.emplace_back(bounds, centroid, int(_grids.size()));
 
-                buildBiomeColors(pack, x, z, biomes);
+                _biomes.emplace_back(std::move(region.biomes));
+                _biomeMap.insert(std::make_pair(Vec2i(x, z), _biomes.back().get()));
 
-                _grids.emplace_back(new HierarchicalGrid(bounds.min(), data));
+                _grids.emplace_back(std::move(region.grid));
                 _regions[Vec2i(x, z)] = _grids.back().get();
-            });
+            }
 
             resolveBlocks(pack);
         } catch (const std::runtime_error &e) {
@@ -75,7 +75,7 @@ class TraceableMinecraftMap : public Primitive
             const uint8 *mask, int maskW, int maskH);
     int fetchBsdf(ResourcePackLoader &pack, const TexturedQuad &quad);
 
-    void buildBiomeColors(ResourcePackLoader &pack, int x, int z, uint8 *biomes);
+    std::unique_ptr<BiomeTileTexture> buildBiomeColors(const ResourcePackLoader &pack, const uint8 *biomes) const;
 
     void convertQuads(ResourcePackLoader &pack, const std::vector<TexturedQuad> &model, const Mat4f &transform);
     void buildModel(ResourcePackLoader &pack, const ModelRef &model);
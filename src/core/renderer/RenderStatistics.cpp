@@ -0,0 +1,181 @@
+#include "RenderStatistics.hpp"
+
+#include "bsdfs/Bsdf.hpp"
+
+#include "io/JsonObject.hpp"
+
+#include <tinyformat/tinyformat.hpp>
+#include <algorithm>
+#include <sstream>
+#include <mutex>
+
+namespace Tungsten {
+
+namespace RenderStatistics {
+
+static std::mutex bsdfMutex;
+static std::vector<std::string> bsdfNames(1, "other");
+
+#ifdef ENABLE_RENDER_STATISTICS
+static ThreadCounters threadCounters[MaxThreads];
+static std::atomic<uint32> numThreadCounters(0);
+#endif
+
+static std::string formatCount(uint64 count)
+{
+    if (count >= 10000000000ull)
+        return tfm::format("%.1fG", count*1e-9);
+    else if (count >= 10000000ull)
+        return tfm::format("%.1fM", count*1e-6);
+    else if (count >= 10000ull)
+        return tfm::format("%.1fK", count*1e-3);
+    return tfm::format("%d", count);
+}
+
+Snapshot::Snapshot()
+{
+    std::fill(counters, counters + CounterCount, 0);
+}
+
+Snapshot Snapshot::operator-(const Snapshot &o) const
+{
+    // BSDF types and threads are only ever added,
+    // so the newer snapshot always has the longer lists
+    Snapshot result(*this);
+    for (int i = 0; i < CounterCount; ++i)
+        result.counters[i] -= o.counters[i];
+    for (size_t i = 0; i < min(bsdfSamples.size(), o.bsdfSamples.size()); ++i) {
+        result.bsdfSamples[i] -= o.bsdfSamples[i];
+        result.bsdfEvals[i] -= o.bsdfEvals[i];
+    }
+    for (size_t i = 0; i < min(raysPerThread.size(), o.raysPerThread.size()); ++i)
+        result.raysPerThread[i] -= o.raysPerThread[i];
+    return result;
+}
+
+std::string Snapshot::toString() const
+{
+    std::stringstream ss;
+    ss << tfm::format("%s primary, %s secondary, %s shadow rays; %s paths with average length %.2f, "
+            "%s terminated by roulette; %s medium samples, %s medium scattering events; %s NaN and %s failed paths",
+            formatCount(counters[PrimaryRays]), formatCount(counters[SecondaryRays]), formatCount(counters[ShadowRays]),
+            formatCount(counters[Paths]), averagePathLength(), formatCount(counters[RouletteTerminations]),
+            formatCount(counters[MediumSamples]), formatCount(counters[MediumScatterEvents]),
+            formatCount(counters[NanPaths]), formatCount(counters[ErrorPaths]));
+
+    bool first = true;
+    for (size_t i = 0; i < bsdfNames.size(); ++i) {
+        if (bsdfSamples[i] == 0 && bsdfEvals[i] == 0)
+            continue;
+        ss << (first ? "; BSDF samples/evals: " : ", ");
+        ss << tfm::format("%s %s/%s", bsdfNames[i], formatCount(bsdfSamples[i]), formatCount(bsdfEvals[i]));
+        first = false;
+    }
+
+    return ss.str();
+}
+
+rapidjson::Value Snapshot::toJson(rapidjson::Document::AllocatorType &allocator) const
+{
+    JsonObject result{allocator,
+        "primary_rays", counters[PrimaryRays],
+        "secondary_rays", counters[SecondaryRays],
+        "shadow_rays", counters[ShadowRays],
+        "paths", counters[Paths],
+        "path_vertices", counters[PathVertices],
+        "average_path_length", averagePathLength(),
+        "roulette_terminations", counters[RouletteTerminations],
+        "medium_samples", counters[MediumSamples],
+        "medium_scatter_events", counters[MediumScatterEvents],
+        "nan_paths", counters[NanPaths],
+        "error_paths", counters[ErrorPaths]
+    };
+
+    rapidjson::Value bsdfValue(rapidjson::kObjectType);
+    for (size_t i = 0; i < bsdfNames.size(); ++i) {
+        if (bsdfSamples[i] == 0 && bsdfEvals[i] == 0)
+            continue;
+        bsdfValue.AddMember(JsonUtils::toJson(bsdfNames[i], allocator), JsonObject{allocator,
+            "samples", bsdfSamples[i],
+            "evals", bsdfEvals[i]
+        }, allocator);
+    }
+    rapidjson::Value threadValue(rapidjson::kArrayType);
+    for (uint64 rays : raysPerThread)
+        threadValue.PushBack(JsonUtils::toJson(rays, allocator), allocator);
+
+    result.add("bsdfs", std::move(bsdfValue),
+               "rays_per_thread", std::move(threadValue));
+
+    return result;
+}
+
+ThreadCounters *acquireThreadCounters()
+{
+#ifdef ENABLE_RENDER_STATISTICS
+    uint32 idx = numThreadCounters++;
+    return &threadCounters[min(idx, MaxThreads - 1)];
+#else
+    return nullptr;
+#endif
+}
+
+void registerBsdf(Bsdf &bsdf)
+{
+    if (!Enabled)
+        return;
+
+    // BSDFs do not know their type name, but their serialized form does
+    rapidjson::Document document;
+    rapidjson::Value value = bsdf.toJson(document.GetAllocator());
+    auto member = value.FindMember("type");
+    if (member == value.MemberEnd() || !member->value.IsString())
+        return;
+    std::string type = member->value.GetString();
+
+    std::unique_lock<std::mutex> lock(bsdfMutex);
+    auto iter = std::find(bsdfNames.begin(), bsdfNames.end(), type);
+    uint32 slot = uint32(iter - bsdfNames.begin());
+    if (iter == bsdfNames.end()) {
+        if (bsdfNames.size() < MaxBsdfTypes)
+            bsdfNames.push_back(type);
+        else
+            slot = 0;
+    }
+    bsdf.setStatisticsSlot(slot);
+}
+
+Snapshot snapshot()
+{
+    Snapshot result;
+    {
+        std::unique_lock<std::mutex> lock(bsdfMutex);
+        result.bsdfNames = bsdfNames;
+    }
+    result.bsdfSamples.resize(result.bsdfNames.size(), 0);
+    result.bsdfEvals.resize(result.bsdfNames.size(), 0);
+
+#ifdef ENABLE_RENDER_STATISTICS
+    uint32 numThreads = min(numThreadCounters.load(), MaxThreads);
+    result.raysPerThread.resize(numThreads, 0);
+    for (uint32 t = 0; t < numThreads; ++t) {
+        const ThreadCounters &block = threadCounters[t];
+        for (int i = 0; i < CounterCount; ++i)
+            result.counters[i] += block.counters[i].load(std::memory_order_relaxed);
+        for (size_t i = 0; i < result.bsdfNames.size(); ++i) {
+            result.bsdfSamples[i] += block.bsdfSamples[i].load(std::memory_order_relaxed);
+            result.bsdfEvals[i] += block.bsdfEvals[i].load(std::memory_order_relaxed);
+        }
+        result.raysPerThread[t] =
+            block.counters[PrimaryRays  ].load(std::memory_order_relaxed) +
+            block.counters[SecondaryRays].load(std::memory_order_relaxed) +
+            block.counters[ShadowRays   ].load(std::memory_order_relaxed);
+    }
+#endif
+
+    return result;
+}
+
+}
+
+}
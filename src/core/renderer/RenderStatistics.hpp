@@ -0,0 +1,162 @@
+#ifndef RENDERSTATISTICS_HPP_
+#define RENDERSTATISTICS_HPP_
+
+#include "IntTypes.hpp"
+
+#include <rapidjson/document.h>
+#include <string>
+#include <vector>
+#include <atomic>
+
+namespace Tungsten {
+
+class Bsdf;
+
+// Counters of the work done by the integrators, meant for sizing machines and
+// spotting pathological scenes. Every thread increments its own cache line
+// aligned block of counters without synchronization, and the blocks are only
+// summed up when a snapshot is taken. Counting is compiled in with the
+// ENABLE_RENDER_STATISTICS CMake option; without it, the RENDER_STAT macros
+// expand to nothing and snapshots are always empty
+namespace RenderStatistics {
+
+enum Counter
+{
+    PrimaryRays,
+    SecondaryRays,
+    ShadowRays,
+    // Paths and vertices of camera paths traced by the path tracer
+    Paths,
+    PathVertices,
+    RouletteTerminations,
+    MediumSamples,
+    MediumScatterEvents,
+    NanPaths,
+    ErrorPaths,
+    CounterCount
+};
+
+#ifdef ENABLE_RENDER_STATISTICS
+static CONSTEXPR bool Enabled = true;
+#else
+static CONSTEXPR bool Enabled = false;
+#endif
+
+// BSDF types beyond this limit are counted in slot 0 together with
+// BSDFs that were never registered
+static CONSTEXPR uint32 MaxBsdfTypes = 32;
+// Threads beyond this limit share the last block. Their counts may be lossy
+static CONSTEXPR uint32 MaxThreads = 256;
+
+struct alignas(64) ThreadCounters
+{
+    std::atomic<uint64> counters[CounterCount];
+    std::atomic<uint64> bsdfSamples[MaxBsdfTypes];
+    std::atomic<uint64> bsdfEvals[MaxBsdfTypes];
+};
+
+struct Snapshot
+{
+    uint64 counters[CounterCount];
+    std::vector<std::string> bsdfNames;
+    std::vector<uint64> bsdfSamples;
+    std::vector<uint64> bsdfEvals;
+    std::vector<uint64> raysPerThread;
+
+    Snapshot();
+
+    uint64 totalRays() const
+    {
+        return counters[PrimaryRays] + counters[SecondaryRays] + counters[ShadowRays];
+    }
+
+    double averagePathLength() const
+    {
+        return counters[Paths] ? double(counters[PathVertices])/counters[Paths] : 0.0;
+    }
+
+    Snapshot operator-(const Snapshot &o) const;
+
+    std::string toString() const;
+    rapidjson::Value toJson(rapidjson::Document::AllocatorType &allocator) const;
+};
+
+ThreadCounters *acquireThreadCounters();
+
+#ifdef ENABLE_RENDER_STATISTICS
+inline ThreadCounters &local()
+{
+    static thread_local ThreadCounters *counters = acquireThreadCounters();
+    return *counters;
+}
+
+// Only the owning thread writes to its counters, so the
+// increment does not need to be an atomic read-modify-write
+inline void increment(std::atomic<uint64> &counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+#endif
+
+// Discards everything the current thread counts while the scope is alive.
+// Used for work that is thrown away again, such as preview samples
+class DiscardScope
+{
+#ifdef ENABLE_RENDER_STATISTICS
+    uint64 _counters[CounterCount];
+    uint64 _bsdfSamples[MaxBsdfTypes];
+    uint64 _bsdfEvals[MaxBsdfTypes];
+
+public:
+    DiscardScope()
+    {
+        ThreadCounters &block = local();
+        for (int i = 0; i < CounterCount; ++i)
+            _counters[i] = block.counters[i].load(std::memory_order_relaxed);
+        for (uint32 i = 0; i < MaxBsdfTypes; ++i) {
+            _bsdfSamples[i] = block.bsdfSamples[i].load(std::memory_order_relaxed);
+            _bsdfEvals[i] = block.bsdfEvals[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    ~DiscardScope()
+    {
+        ThreadCounters &block = local();
+        for (int i = 0; i < CounterCount; ++i)
+            block.counters[i].store(_counters[i], std::memory_order_relaxed);
+        for (uint32 i = 0; i < MaxBsdfTypes; ++i) {
+            block.bsdfSamples[i].store(_bsdfSamples[i], std::memory_order_relaxed);
+            block.bsdfEvals[i].store(_bsdfEvals[i], std::memory_order_relaxed);
+        }
+    }
+#else
+public:
+    // User-provided, so that scopes do not count as unused variables
+    DiscardScope() {}
+    ~DiscardScope() {}
+#endif
+};
+
+// Assigns the BSDF a counter slot shared by all BSDFs of the same type
+void registerBsdf(Bsdf &bsdf);
+
+Snapshot snapshot();
+
+}
+
+}
+
+#ifdef ENABLE_RENDER_STATISTICS
+# define RENDER_STAT(COUNTER) \
+    ::Tungsten::RenderStatistics::increment(::Tungsten::RenderStatistics::local().counters[COUNTER])
+# define RENDER_STAT_BSDF_SAMPLE(SLOT) \
+    ::Tungsten::RenderStatistics::increment(::Tungsten::RenderStatistics::local().bsdfSamples[SLOT])
+# define RENDER_STAT_BSDF_EVAL(SLOT) \
+    ::Tungsten::RenderStatistics::increment(::Tungsten::RenderStatistics::local().bsdfEvals[SLOT])
+#else
+# define RENDER_STAT(COUNTER) ((void)0)
+# define RENDER_STAT_BSDF_SAMPLE(SLOT) ((void)0)
+# define RENDER_STAT_BSDF_EVAL(SLOT) ((void)0)
+#endif
+
+#endif /* RENDERSTATISTICS_HPP_ */
@@ -26,6 +26,8 @@ class RendererSettings : public JsonSerializable
     bool _useSobol;
     uint32 _spp;
     uint32 _sppStep;
+    uint32 _bucketSize;
+    bool _progressivePreview;
     std::string _checkpointInterval;
     std::string _timeout;
     std::vector<OutputBufferSettings> _outputs;
@@ -41,6 +43,8 @@ public:
       _useSobol(true),
       _spp(32),
       _sppStep(16),
+      _bucketSize(0),
+      _progressivePreview(false),
       _checkpointInterval("0"),
       _timeout("0")
     {
@@ -64,6 +68,8 @@ public:
         value.getField("scene_bvh", _useSceneBvh);
         value.getField("spp", _spp);
         value.getField("spp_step", _sppStep);
+        value.getField("bucket_size", _bucketSize);
+        value.getField("progressive_preview", _progressivePreview);
         value.getField("checkpoint_interval", _checkpointInterval);
         value.getField("timeout", _timeout);
 
@@ -85,6 +91,8 @@ public:
             "scene_bvh", _useSceneBvh,
             "spp", _spp,
             "spp_step", _sppStep,
+            "bucket_size", _bucketSize,
+            "progressive_preview", _progressivePreview,
             "checkpoint_interval", _checkpointInterval,
             "timeout", _timeout
         };
@@ -189,6 +197,20 @@ public:
         return _sppStep;
     }
 
+    // Side length of the buckets the image is rendered in, or 0 to render
+    // the whole image at once
+    uint32 bucketSize() const
+    {
+        return _bucketSize;
+    }
+
+    // Whether renders start with low resolution preview passes, so that
+    // interactive front ends show a first image as early as possible
+    bool progressivePreview() const
+    {
+        return _progressivePreview;
+    }
+
     std::string checkpointInterval() const
     {
         return _checkpointInterval;
@@ -218,6 +240,11 @@ public:
     {
         _sppStep = step;
     }
+
+    void setProgressivePreview(bool value)
+    {
+        _progressivePreview = value;
+    }
 };
 
 }
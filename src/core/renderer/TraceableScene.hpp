@@ -13,7 +13,12 @@
 
 #include "media/Medium.hpp"
 
+#include "RenderStatistics.hpp"
 #include "RendererSettings.hpp"
+
+#include "Timeline.hpp"
+
+#include <unordered_map>
 #include <vector>
 #include <memory>
 
@@ -37,9 +42,15 @@ class TraceableScene
     {
         const Ray &ray;
         unsigned userGeomId;
-
-        OcclusionRay(RTCRay eRay, const Ray &ray_, unsigned userGeomId_)
-        : RTCRay(eRay), ray(ray_), userGeomId(userGeomId_) {}
+        // Only set for shadow rays that pass through transparent primitives
+        bool opaqueOnly;
+        const Primitive *endCap;
+        bool hitTransparent;
+
+        OcclusionRay(RTCRay eRay, const Ray &ray_, unsigned userGeomId_,
+                bool opaqueOnly_ = false, const Primitive *endCap_ = nullptr)
+        : RTCRay(eRay), ray(ray_), userGeomId(userGeomId_),
+          opaqueOnly(opaqueOnly_), endCap(endCap_), hitTransparent(false) {}
     };
 
     const float DefaultEpsilon = 5e-4f;
@@ -52,6 +63,8 @@ class TraceableScene
     std::vector<std::shared_ptr<Primitive>> _lights;
     std::vector<std::shared_ptr<Primitive>> _infiniteLights;
     std::vector<const Primitive *> _finites;
+    // Finites with a BSDF that has a forward lobe, i.e. that shadow rays may pass through
+    std::vector<bool> _transparentFinites;
     RendererSettings _settings;
 
     RTCScene _scene = nullptr;
@@ -59,13 +72,43 @@ class TraceableScene
 
     Box3f _sceneBounds;
 
+    // Primitives prepared by this scene and the transforms they were prepared
+    // with. Primitives handed over to the scene of the next frame are removed
+    // from here, since that scene then owns their teardown
+    std::unordered_map<const Primitive *, Mat4f> _preparedPrimitives;
+
+    bool intersectRay(Ray &ray, IntersectionTemporary &data, IntersectionInfo &info) const
+    {
+        info.primitive = nullptr;
+        data.primitive = nullptr;
+
+        if (_settings.useSceneBvh()) {
+            IntersectionRay eRay(EmbreeUtil::convert(ray), data, ray, _userGeomId);
+            rtcIntersect(_scene, eRay);
+        } else {
+            for (const Primitive *prim : _finites)
+                prim->intersect(ray, data);
+        }
+
+        if (data.primitive) {
+            info.p = ray.pos() + ray.dir()*ray.farT();
+            info.w = ray.dir();
+            info.epsilon = DefaultEpsilon;
+            data.primitive->intersectionInfo(data, info);
+            return true;
+        } else {
+            return false;
+        }
+    }
+
 public:
     TraceableScene(Camera &cam, Integrator &integrator,
             std::vector<std::shared_ptr<Primitive>> &primitives,
             std::vector<std::shared_ptr<Bsdf>> &bsdfs,
             std::vector<std::shared_ptr<Medium>> &media,
             RendererSettings settings,
-            uint32 seed)
+            uint32 seed,
+            TraceableScene *previous = nullptr)
     : _cam(cam),
       _integrator(integrator),
       _primitives(primitives),
@@ -73,21 +116,45 @@ public:
       _media(media),
       _settings(settings)
     {
+        Timeline::Scope prepareScope("Prepare scene");
+
         _cam.prepareForRender();
+        if (_settings.bucketSize() > 0 && _integrator.supportsBucketRendering())
+            _cam.setOutputWindowSize(Vec2u(_settings.bucketSize()));
         _cam.requestOutputBuffers(_settings.renderOutputs());
 
         for (std::shared_ptr<Medium> &m : _media)
             m->prepareForRender();
 
-        for (std::shared_ptr<Bsdf> &b : _bsdfs)
+        for (std::shared_ptr<Bsdf> &b : _bsdfs) {
             b->prepareForRender();
+            RenderStatistics::registerBsdf(*b);
+        }
 
         int finiteCount = 0, lightCount = 0;
         for (std::shared_ptr<Primitive> &m : _primitives) {
-            m->prepareForRender();
-            for (int i = 0; i < m->numBsdfs(); ++i)
-                if (m->bsdf(i)->unnamed())
+            // Primitives still prepared by the previous frame only need to be
+            // prepared again if they moved
+            bool prepared = false;
+            if (previous) {
+                auto iter = previous->_preparedPrimitives.find(m.get());
+                if (iter != previous->_preparedPrimitives.end()) {
+                    prepared = iter->second == m->transform();
+                    if (!prepared)
+                        m->teardownAfterRender();
+                    previous->_preparedPrimitives.erase(iter);
+                }
+            }
+            if (!prepared)
+                m->prepareForRender();
+            _preparedPrimitives.insert(std::make_pair(m.get(), m->transform()));
+
+            for (int i = 0; i < m->numBsdfs(); ++i) {
+                if (m->bsdf(i)->unnamed()) {
                     m->bsdf(i)->prepareForRender();
+                    RenderStatistics::registerBsdf(*m->bsdf(i));
+                }
+            }
 
             if (!m->isDirac() && !m->isInfinite())
                 finiteCount++;
@@ -113,9 +180,12 @@ public:
 
             _sceneBounds.grow(m->bounds());
             _finites.push_back(m.get());
+            _transparentFinites.push_back(m->isTransparent());
         }
 
         if (_settings.useSceneBvh()) {
+            Timeline::Scope commitScope("Embree commit");
+
             _scene = rtcDeviceNewScene(EmbreeUtil::getDevice(), RTC_SCENE_STATIC | RTC_SCENE_INCOHERENT, RTC_INTERSECT1);
             _userGeomId = rtcNewUserGeometry(_scene, _finites.size());
             rtcSetUserData(_scene, _userGeomId, this);
@@ -133,13 +203,21 @@ public:
             });
             rtcSetOccludedFunction(_scene, _userGeomId, [](void *ptr, RTCRay &embreeRay, size_t i) {
                 OcclusionRay &ray = *static_cast<OcclusionRay *>(&embreeRay);
-                if (static_cast<TraceableScene *>(ptr)->finites()[i]->occluded(ray.ray))
-                    embreeRay.geomID = 0;
+                const TraceableScene &scene = *static_cast<TraceableScene *>(ptr);
+                if (ray.opaqueOnly && scene._finites[i] == ray.endCap)
+                    return;
+                if (scene._finites[i]->occluded(ray.ray)) {
+                    if (ray.opaqueOnly && scene._transparentFinites[i])
+                        ray.hitTransparent = true;
+                    else
+                        embreeRay.geomID = 0;
+                }
             });
 
             rtcCommit(_scene);
         }
 
+        Timeline::Scope integratorScope("Prepare integrator");
         _integrator.prepareForRender(*this, seed);
     }
 
@@ -155,6 +233,8 @@ public:
             b->teardownAfterRender();
 
         for (std::shared_ptr<Primitive> &m : _primitives) {
+            if (!_preparedPrimitives.count(m.get()))
+                continue;
             m->teardownAfterRender();
             for (int i = 0; i < m->numBsdfs(); ++i)
                 if (m->bsdf(i)->unnamed())
@@ -165,28 +245,33 @@ public:
         _scene = nullptr;
     }
 
-    bool intersect(Ray &ray, IntersectionTemporary &data, IntersectionInfo &info) const
+    // Rays cast by the calling thread. Unlike the render statistics, these are
+    // always counted; the render cost buffer uses them to attribute rays to pixels
+    struct RayCount
     {
-        info.primitive = nullptr;
-        data.primitive = nullptr;
+        uint64 pathRays;
+        uint64 shadowRays;
+    };
 
-        if (_settings.useSceneBvh()) {
-            IntersectionRay eRay(EmbreeUtil::convert(ray), data, ray, _userGeomId);
-            rtcIntersect(_scene, eRay);
-        } else {
-            for (const Primitive *prim : _finites)
-                prim->intersect(ray, data);
-        }
+    static RayCount &threadRayCount()
+    {
+        static thread_local RayCount count = {0, 0};
+        return count;
+    }
 
-        if (data.primitive) {
-            info.p = ray.pos() + ray.dir()*ray.farT();
-            info.w = ray.dir();
-            info.epsilon = DefaultEpsilon;
-            data.primitive->intersectionInfo(data, info);
-            return true;
-        } else {
-            return false;
-        }
+    bool intersect(Ray &ray, IntersectionTemporary &data, IntersectionInfo &info) const
+    {
+        RENDER_STAT(ray.isPrimaryRay() ? RenderStatistics::PrimaryRays : RenderStatistics::SecondaryRays);
+        threadRayCount().pathRays++;
+        return intersectRay(ray, data, info);
+    }
+
+    // Identical to intersect, but not counted. Used to step through the
+    // transparent occluders of a shadow ray after occludedByOpaque, which
+    // already counted the ray
+    bool intersectShadow(Ray &ray, IntersectionTemporary &data, IntersectionInfo &info) const
+    {
+        return intersectRay(ray, data, info);
     }
 
     bool intersectInfinites(Ray &ray, IntersectionTemporary &data, IntersectionInfo &info) const
@@ -208,6 +293,9 @@ public:
 
     bool occluded(const Ray &ray) const
     {
+        RENDER_STAT(RenderStatistics::ShadowRays);
+        threadRayCount().shadowRays++;
+
         if (_settings.useSceneBvh()) {
             OcclusionRay eRay(EmbreeUtil::convert(ray), ray, _userGeomId);
             rtcOccluded(_scene, eRay);
@@ -220,6 +308,33 @@ public:
         }
     }
 
+    // Any-hit query for shadow rays ending on endCap, which only stops at
+    // primitives that no light can pass through. Whether the ray passed
+    // through any transparent primitive is returned in hitTransparent, in
+    // which case the caller needs to find and evaluate them in order
+    bool occludedByOpaque(const Ray &ray, const Primitive *endCap, bool &hitTransparent) const
+    {
+        RENDER_STAT(RenderStatistics::ShadowRays);
+        threadRayCount().shadowRays++;
+
+        hitTransparent = false;
+        if (_settings.useSceneBvh()) {
+            OcclusionRay eRay(EmbreeUtil::convert(ray), ray, _userGeomId, true, endCap);
+            rtcOccluded(_scene, eRay);
+            hitTransparent = eRay.hitTransparent;
+            return eRay.geomID != RTC_INVALID_GEOMETRY_ID;
+        } else {
+            for (size_t i = 0; i < _finites.size(); ++i) {
+                if (_finites[i] == endCap || !_finites[i]->occluded(ray))
+                    continue;
+                if (!_transparentFinites[i])
+                    return true;
+                hitTransparent = true;
+            }
+            return false;
+        }
+    }
+
     const Box3f &bounds() const
     {
         return _sceneBounds;
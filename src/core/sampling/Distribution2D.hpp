@@ -8,17 +8,25 @@
 
 namespace Tungsten {
 
+// The row pdfs are not stored separately, but recovered as differences of
+// the row cdfs. This halves the size of the tables of large environment maps,
+// and keeps pdfs exactly consistent with the probabilities warp samples with
 class Distribution2D
 {
     int _w, _h;
     std::vector<float> _marginalPdf, _marginalCdf;
-    std::vector<float> _pdf;
     std::vector<float> _cdf;
+
+    float rowPdf(int idxC) const
+    {
+        return _cdf[idxC + 1] - _cdf[idxC];
+    }
+
 public:
     Distribution2D(std::vector<float> weights, int w, int h)
-    : _w(w), _h(h), _pdf(std::move(weights))
+    : _w(w), _h(h)
     {
-        _cdf.resize(_pdf.size() + h);
+        _cdf.resize(weights.size() + h);
         _marginalPdf.resize(h, 0.0f);
         _marginalCdf.resize(h + 1);
 
@@ -29,28 +37,24 @@ public:
 
             _cdf[idxC] = 0.0f;
             for (int x = 0; x < w; ++x, ++idxP, ++idxC) {
-                _marginalPdf[y] += _pdf[idxP];
-                _cdf[idxC + 1] = _cdf[idxC] + _pdf[idxP];
+                _marginalPdf[y] += weights[idxP];
+                _cdf[idxC + 1] = _cdf[idxC] + weights[idxP];
             }
             _marginalCdf[y + 1] = _marginalCdf[y] + _marginalPdf[y];
         }
+        weights = std::vector<float>();
 
         for (int y = 0; y < h; ++y) {
-            int idxP = y*w;
             int idxC = y*(w + 1);
             int idxTail = idxC + w;
 
             float rowWeight = _cdf[idxTail];
             if (rowWeight < 1e-4f) {
-                for (int x = 0; x < w; ++x, ++idxP, ++idxC) {
-                    _pdf[idxP] = 1.0f/w;
+                for (int x = 0; x < w; ++x, ++idxC)
                     _cdf[idxC] = x/float(w);
-                }
             } else {
-                for (int x = 0; x < w; ++x, ++idxP, ++idxC) {
-                    _pdf[idxP] /= rowWeight;
+                for (int x = 0; x < w; ++x, ++idxC)
                     _cdf[idxC] /= rowWeight;
-                }
             }
             _cdf[idxTail] = 1.0f;
         }
@@ -71,15 +75,14 @@ public:
         auto rowEnd = rowStart + (_w + 1);
         column = int(std::distance(rowStart, std::upper_bound(rowStart, rowEnd, uv.x())) - 1);
         int idxC = row*(_w + 1) + column;
-        int idxP = row*_w + column;
-        uv.x() = clamp((uv.x() - _cdf[idxC])/_pdf[idxP], 0.0f, 1.0f);
+        uv.x() = clamp((uv.x() - _cdf[idxC])/rowPdf(idxC), 0.0f, 1.0f);
     }
 
     float pdf(int row, int column) const
     {
         row    = clamp(row,    0, _h - 1);
         column = clamp(column, 0, _w - 1);
-        return _pdf[row*_w + column]*_marginalPdf[row];
+        return rowPdf(row*(_w + 1) + column)*_marginalPdf[row];
     }
 };
 
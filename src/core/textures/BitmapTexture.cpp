@@ -1,4 +1,5 @@
 #include "BitmapTexture.hpp"
+#include "TexelCompression.hpp"
 
 #include "primitives/IntersectionInfo.hpp"
 
@@ -6,6 +7,7 @@
 
 #include "math/MathUtil.hpp"
 #include "math/Angle.hpp"
+#include "math/Half.hpp"
 
 #include "io/JsonObject.hpp"
 #include "io/Scene.hpp"
@@ -40,6 +42,8 @@ BitmapTexture::BitmapTexture(PathPtr path, TexelConversion conversion,
   _gammaCorrect(gammaCorrect),
   _linear(linear),
   _clamp(clamp),
+  _compress(false),
+  _halfPrecision(false),
   _valid(false),
   _min(0.0f), _max(0.0f), _avg(0.0f),
   _texels(nullptr),
@@ -52,6 +56,8 @@ BitmapTexture::BitmapTexture(PathPtr path, TexelConversion conversion,
 BitmapTexture::BitmapTexture(void *texels, int w, int h, TexelType texelType, bool linear, bool clamp)
 : _linear(linear),
   _clamp(clamp),
+  _compress(false),
+  _halfPrecision(false),
   _valid(true),
   _scale(1.0f)
 {
@@ -65,6 +71,8 @@ BitmapTexture::BitmapTexture(const BitmapTexture &o)
     _gammaCorrect    = o._gammaCorrect;
     _linear          = o._linear;
     _clamp           = o._clamp;
+    _compress        = o._compress;
+    _halfPrecision   = o._halfPrecision;
     _valid           = o._valid;
     _min             = o._min;
     _max             = o._max;
@@ -75,27 +83,19 @@ BitmapTexture::BitmapTexture(const BitmapTexture &o)
     _scale           = o._scale;
 
     if (o._texels) {
-        size_t size = 0;
         switch (_texelType) {
-        case TexelType::SCALAR_LDR:
-            _texels = new uint8[_w*_h];
-            size = _w*_h*sizeof(uint8);
-            break;
-        case TexelType::SCALAR_HDR:
-            _texels = new float[_w*_h];
-            size = _w*_h*sizeof(float);
-            break;
-        case TexelType::RGB_LDR:
-            _texels = new uint8[_w*_h*4];
-            size = _w*_h*4*sizeof(uint8);
-            break;
-        case TexelType::RGB_HDR:
-            _texels = new Vec3f[_w*_h];
-            size = _w*_h*sizeof(Vec3f);
-            break;
+        case TexelType::SCALAR_LDR: _texels = new uint8[_w*_h]; break;
+        case TexelType::SCALAR_HDR: _texels = new float[_w*_h]; break;
+        case TexelType::RGB_LDR:    _texels = new uint8[_w*_h*4]; break;
+        case TexelType::RGB_HDR:    _texels = new Vec3f[_w*_h]; break;
+        case TexelType::SCALAR_BC4:
+        case TexelType::RGB_BC1:    _texels = new TexelCompression::Block[TexelCompression::blockCount(_w, _h)]; break;
+        case TexelType::RGB_9E5:    _texels = new uint32[_w*_h]; break;
+        case TexelType::SCALAR_HALF: _texels = new Half[_w*_h]; break;
+        case TexelType::RGB_HALF:    _texels = new Half[_w*_h*3 + 1]; break;
         }
 
-        std::memcpy(_texels, o._texels, size);
+        std::memcpy(_texels, o._texels, texelBytes());
     }
 }
 
@@ -106,6 +106,11 @@ BitmapTexture::~BitmapTexture()
     case TexelType::SCALAR_HDR: delete[] as<float>(); break;
     case TexelType::RGB_LDR: delete[] as<uint8>(); break;
     case TexelType::RGB_HDR: delete[] as<Vec3f>(); break;
+    case TexelType::SCALAR_BC4:
+    case TexelType::RGB_BC1: delete[] as<TexelCompression::Block>(); break;
+    case TexelType::RGB_9E5: delete[] as<uint32>(); break;
+    case TexelType::SCALAR_HALF:
+    case TexelType::RGB_HALF: delete[] as<Half>(); break;
     }
 }
 
@@ -139,18 +144,27 @@ inline const T *BitmapTexture::as() const
 
 inline float BitmapTexture::getScalar(int x, int y) const
 {
-    if (isHdr())
-        return as<float>()[x + y*_w];
-    else
-        return float(as<uint8>()[x + y*_w])*(1.0f/255.0f);
+    switch (_texelType) {
+    case TexelType::SCALAR_HDR: return as<float>()[x + y*_w];
+    case TexelType::SCALAR_BC4: return TexelCompression::decodeBc4(as<TexelCompression::Block>(), _w, x, y);
+    case TexelType::SCALAR_HALF: return as<Half>()[x + y*_w];
+    default:                    return float(as<uint8>()[x + y*_w])*(1.0f/255.0f);
+    }
 }
 
 inline Vec3f BitmapTexture::getRgb(int x, int y) const
 {
-    if (isHdr())
-        return as<Vec3f>()[x + y*_w];
-    else
-        return as<Rgba>()[x + y*_w].normalize();
+    switch (_texelType) {
+    case TexelType::RGB_HDR: return as<Vec3f>()[x + y*_w];
+    case TexelType::RGB_BC1: return TexelCompression::decodeBc1(as<TexelCompression::Block>(), _w, x, y);
+    case TexelType::RGB_9E5: return TexelCompression::decodeRgb9e5(as<uint32>()[x + y*_w]);
+    case TexelType::RGB_HALF: {
+        float rgba[4];
+        Half::toFloat4(as<Half>() + (x + y*_w)*3, rgba);
+        return Vec3f(rgba[0], rgba[1], rgba[2]);
+    }
+    default:                 return as<Rgba>()[x + y*_w].normalize();
+    }
 }
 
 inline float BitmapTexture::weight(int x, int y) const
@@ -161,6 +175,83 @@ inline float BitmapTexture::weight(int x, int y) const
         return getScalar(x, y);
 }
 
+size_t BitmapTexture::texelBytes() const
+{
+    size_t texelCount = size_t(_w)*size_t(_h);
+    switch (_texelType) {
+    case TexelType::SCALAR_LDR: return texelCount*sizeof(uint8);
+    case TexelType::SCALAR_HDR: return texelCount*sizeof(float);
+    case TexelType::RGB_LDR:    return texelCount*4*sizeof(uint8);
+    case TexelType::RGB_HDR:    return texelCount*sizeof(Vec3f);
+    case TexelType::SCALAR_BC4:
+    case TexelType::RGB_BC1:    return TexelCompression::blockCount(_w, _h)*sizeof(TexelCompression::Block);
+    case TexelType::RGB_9E5:    return texelCount*sizeof(uint32);
+    case TexelType::SCALAR_HALF: return texelCount*sizeof(Half);
+    case TexelType::RGB_HALF:    return (texelCount*3 + 1)*sizeof(Half);
+    }
+    return 0;
+}
+
+// Scalar HDR textures have no compressed format and stay as they are
+void BitmapTexture::compressTexels()
+{
+    void *compressed;
+    TexelType type;
+    switch (_texelType) {
+    case TexelType::SCALAR_LDR:
+        compressed = TexelCompression::compressBc4(as<uint8>(), _w, _h).release();
+        type = TexelType::SCALAR_BC4;
+        delete[] as<uint8>();
+        break;
+    case TexelType::RGB_LDR:
+        compressed = TexelCompression::compressBc1(as<uint8>(), _w, _h).release();
+        type = TexelType::RGB_BC1;
+        delete[] as<uint8>();
+        break;
+    case TexelType::RGB_HDR:
+        // RGB9E5 clamps bright texels, such as a sun in an environment map, and
+        // drops negative ones. Such textures stay uncompressed
+        if (_max.max() > TexelCompression::MaxRgb9e5 || _min.min() < 0.0f)
+            return;
+        compressed = TexelCompression::compressRgb9e5(as<Vec3f>(), _w, _h).release();
+        type = TexelType::RGB_9E5;
+        delete[] as<Vec3f>();
+        break;
+    default:
+        return;
+    }
+
+    init(compressed, _w, _h, type);
+}
+
+// Textures with values outside the half range, such as a very bright sun in an
+// environment map, stay in single precision
+void BitmapTexture::convertToHalf()
+{
+    const float HalfMax = 65504.0f;
+    if (max(_max.max(), -_min.min()) > HalfMax)
+        return;
+
+    if (_texelType == TexelType::SCALAR_HDR) {
+        size_t count = size_t(_w)*size_t(_h);
+        Half *texels = new Half[count];
+        for (size_t i = 0; i < count; ++i)
+            texels[i] = Half(as<float>()[i]);
+        delete[] as<float>();
+        init(texels, _w, _h, TexelType::SCALAR_HALF);
+    } else if (_texelType == TexelType::RGB_HDR) {
+        size_t count = size_t(_w)*size_t(_h);
+        // One extra element, since lookups read four halves at a time
+        Half *texels = new Half[count*3 + 1];
+        for (size_t i = 0; i < count; ++i)
+            for (int j = 0; j < 3; ++j)
+                texels[i*3 + j] = Half(as<Vec3f>()[i][j]);
+        texels[count*3] = Half(0.0f);
+        delete[] as<Vec3f>();
+        init(texels, _w, _h, TexelType::RGB_HALF);
+    }
+}
+
 BitmapTexture::TexelType BitmapTexture::getTexelType(bool isRgb, bool isHdr)
 {
     if (isRgb && isHdr)
@@ -215,18 +306,22 @@ void BitmapTexture::fromJson(JsonPtr value, const Scene &scene)
     value.getField("gamma_correct", _gammaCorrect);
     value.getField("interpolate", _linear);
     value.getField("clamp", _clamp);
+    value.getField("compress", _compress);
+    value.getField("half_precision", _halfPrecision);
     value.getField("scale", _scale);
 }
 
 rapidjson::Value BitmapTexture::toJson(Allocator &allocator) const
 {
-    bool writeFullStruct = !_gammaCorrect || !_linear || _clamp || _scale != 1.0f;
+    bool writeFullStruct = !_gammaCorrect || !_linear || _clamp || _compress || _halfPrecision || _scale != 1.0f;
     if (writeFullStruct) {
         JsonObject result{Texture::toJson(allocator), allocator,
             "type", "bitmap",
             "gamma_correct", _gammaCorrect,
             "interpolate", _linear,
             "clamp", _clamp,
+            "compress", _compress,
+            "half_precision", _halfPrecision,
             "scale", _scale
         };
         if (_path)
@@ -273,6 +368,11 @@ void BitmapTexture::loadResources()
     }
 
     init(pixels, w, h, getTexelType(isRgb, isHdr));
+
+    if (_compress && _valid)
+        compressTexels();
+    if (_halfPrecision && _valid)
+        convertToHalf();
 }
 
 bool BitmapTexture::isConstant() const
@@ -13,11 +13,18 @@ class Distribution2D;
 class BitmapTexture : public Texture
 {
 public:
+    // Bit 0 is set for HDR, bit 1 for RGB, bit 2 for compressed and bit 3
+    // for half precision texels. See TexelCompression for the compressed formats
     enum class TexelType : uint32 {
         SCALAR_LDR = 0,
         SCALAR_HDR = 1,
         RGB_LDR    = 2,
         RGB_HDR    = 3,
+        SCALAR_BC4 = 4,
+        RGB_BC1    = 6,
+        RGB_9E5    = 7,
+        SCALAR_HALF = 9,
+        RGB_HALF    = 11,
     };
 
 private:
@@ -27,6 +34,8 @@ private:
     TexelConversion _texelConversion;
     bool _gammaCorrect;
     bool _linear, _clamp;
+    bool _compress;
+    bool _halfPrecision;
     bool _valid;
 
     Vec3f _min, _max, _avg;
@@ -41,6 +50,10 @@ private:
     inline bool isRgb() const;
     inline bool isHdr() const;
 
+    size_t texelBytes() const;
+    void compressTexels();
+    void convertToHalf();
+
     inline float lerp(float x00, float x01, float x10, float x11, float u, float v) const;
     inline Vec3f lerp(Vec3f x00, Vec3f x01, Vec3f x10, Vec3f x11, float u, float v) const;
 
@@ -124,6 +137,16 @@ public:
         return _linear;
     }
 
+    bool compress() const
+    {
+        return _compress;
+    }
+
+    bool halfPrecision() const
+    {
+        return _halfPrecision;
+    }
+
     void setClamp(bool clamp)
     {
         _clamp = clamp;
@@ -139,6 +162,18 @@ public:
         _linear = linear;
     }
 
+    // Takes effect when the texture is loaded
+    void setCompress(bool compress)
+    {
+        _compress = compress;
+    }
+
+    // Takes effect when the texture is loaded
+    void setHalfPrecision(bool halfPrecision)
+    {
+        _halfPrecision = halfPrecision;
+    }
+
     TexelConversion texelConversion() const
     {
         return _texelConversion;
@@ -157,6 +192,8 @@ public:
             _gammaCorrect != o._gammaCorrect ? _gammaCorrect < o._gammaCorrect :
             _linear != o._linear ? _linear < o._linear :
             _clamp != o._clamp ? _clamp < o._clamp :
+            _compress != o._compress ? _compress < o._compress :
+            _halfPrecision != o._halfPrecision ? _halfPrecision < o._halfPrecision :
             false;
 
     }
@@ -168,7 +205,9 @@ public:
             _texelConversion == o._texelConversion &&
             _gammaCorrect == o._gammaCorrect &&
             _linear == o._linear &&
-            _clamp == o._clamp;
+            _clamp == o._clamp &&
+            _compress == o._compress &&
+            _halfPrecision == o._halfPrecision;
     }
 };
 
@@ -0,0 +1,217 @@
+#include "TexelCompression.hpp"
+
+#include "math/MathUtil.hpp"
+
+#include <cmath>
+
+namespace Tungsten {
+
+namespace TexelCompression {
+
+// Gathers the 16 texels of a block. Blocks hanging over the edge of the
+// texture repeat its last row and column
+template<typename T, typename Fetch>
+static void gatherBlock(int bx, int by, int w, int h, T *dst, Fetch fetch)
+{
+    for (int y = 0; y < 4; ++y)
+        for (int x = 0; x < 4; ++x)
+            dst[x + y*4] = fetch(min(bx*4 + x, w - 1), min(by*4 + y, h - 1));
+}
+
+static uint32 quantizeRgb565(Vec3f c)
+{
+    c = clamp(c, Vec3f(0.0f), Vec3f(1.0f));
+    uint32 r = uint32(c.x()*31.0f + 0.5f);
+    uint32 g = uint32(c.y()*63.0f + 0.5f);
+    uint32 b = uint32(c.z()*31.0f + 0.5f);
+    return (r << 11) | (g << 5) | b;
+}
+
+// Picks the closest palette entry for each texel for the given endpoints
+static Block fitBc1Indices(const Vec3f *colors, uint32 c0, uint32 c1, float &error)
+{
+    Vec3f p0 = decodeRgb565(c0);
+    Vec3f p1 = decodeRgb565(c1);
+    Vec3f palette[] = {p0, p1, (p0*2.0f + p1)*(1.0f/3.0f), (p0 + p1*2.0f)*(1.0f/3.0f)};
+
+    Block block = Block(c0) | (Block(c1) << 16);
+    error = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        int bestIndex = 0;
+        float bestError = (colors[i] - palette[0]).lengthSq();
+        for (int j = 1; j < 4; ++j) {
+            float e = (colors[i] - palette[j]).lengthSq();
+            if (e < bestError) {
+                bestError = e;
+                bestIndex = j;
+            }
+        }
+        block |= Block(bestIndex) << (32 + 2*i);
+        error += bestError;
+    }
+    return block;
+}
+
+// Endpoints start out at the extremes of the block along its principal axis
+// and are then refined by a few rounds of least squares fitting to the
+// current index assignment
+static Block compressBc1Block(const Vec3f *colors)
+{
+    Vec3f mean(0.0f);
+    for (int i = 0; i < 16; ++i)
+        mean += colors[i]*(1.0f/16.0f);
+
+    float cov[6] = {0.0f};
+    for (int i = 0; i < 16; ++i) {
+        Vec3f d = colors[i] - mean;
+        cov[0] += d.x()*d.x(); cov[1] += d.x()*d.y(); cov[2] += d.x()*d.z();
+        cov[3] += d.y()*d.y(); cov[4] += d.y()*d.z(); cov[5] += d.z()*d.z();
+    }
+
+    Vec3f axis(1.0f);
+    for (int i = 0; i < 8; ++i) {
+        axis = Vec3f(
+            cov[0]*axis.x() + cov[1]*axis.y() + cov[2]*axis.z(),
+            cov[1]*axis.x() + cov[3]*axis.y() + cov[4]*axis.z(),
+            cov[2]*axis.x() + cov[4]*axis.y() + cov[5]*axis.z()
+        );
+        float length = axis.length();
+        if (length < 1e-12f) {
+            float error;
+            uint32 c = quantizeRgb565(mean);
+            return fitBc1Indices(colors, c, c, error);
+        }
+        axis /= length;
+    }
+
+    float minT = 0.0f, maxT = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        float t = (colors[i] - mean).dot(axis);
+        minT = min(minT, t);
+        maxT = max(maxT, t);
+    }
+    Vec3f e0 = mean + axis*maxT;
+    Vec3f e1 = mean + axis*minT;
+
+    static const float Weights[] = {1.0f, 0.0f, 2.0f/3.0f, 1.0f/3.0f};
+
+    Block best = 0;
+    float bestError = -1.0f;
+    for (int iter = 0; iter < 3; ++iter) {
+        float error;
+        Block block = fitBc1Indices(colors, quantizeRgb565(e0), quantizeRgb565(e1), error);
+        if (bestError < 0.0f || error < bestError) {
+            best = block;
+            bestError = error;
+        }
+
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        Vec3f ac(0.0f), bc(0.0f);
+        for (int i = 0; i < 16; ++i) {
+            float a = Weights[(block >> (32 + 2*i)) & 3];
+            float b = 1.0f - a;
+            aa += a*a;
+            ab += a*b;
+            bb += b*b;
+            ac += colors[i]*a;
+            bc += colors[i]*b;
+        }
+        float det = aa*bb - ab*ab;
+        if (std::abs(det) < 1e-6f)
+            break;
+        e0 = (ac*bb - bc*ab)/det;
+        e1 = (bc*aa - ac*ab)/det;
+    }
+
+    return best;
+}
+
+static Block compressBc4Block(const uint8 *values)
+{
+    int a0 = values[0], a1 = values[0];
+    for (int i = 1; i < 16; ++i) {
+        a0 = max(a0, int(values[i]));
+        a1 = min(a1, int(values[i]));
+    }
+
+    Block block = Block(a0) | (Block(a1) << 8);
+    if (a0 == a1)
+        return block;
+
+    for (int i = 0; i < 16; ++i) {
+        // Position of the value between a0 and a1 in sevenths, rounded
+        int step = ((a0 - values[i])*14 + (a0 - a1))/((a0 - a1)*2);
+        int index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+        block |= Block(index) << (16 + 3*i);
+    }
+
+    return block;
+}
+
+std::unique_ptr<Block[]> compressBc1(const uint8 *texels, int w, int h)
+{
+    std::unique_ptr<Block[]> blocks(new Block[blockCount(w, h)]);
+
+    Vec3f colors[16];
+    int bw = (w + 3)/4, bh = (h + 3)/4;
+    for (int by = 0; by < bh; ++by) {
+        for (int bx = 0; bx < bw; ++bx) {
+            gatherBlock(bx, by, w, h, colors, [&](int x, int y) {
+                const uint8 *c = texels + (x + y*w)*4;
+                return Vec3f(float(c[0]), float(c[1]), float(c[2]))*(1.0f/255.0f);
+            });
+            blocks[bx + by*bw] = compressBc1Block(colors);
+        }
+    }
+
+    return blocks;
+}
+
+std::unique_ptr<Block[]> compressBc4(const uint8 *texels, int w, int h)
+{
+    std::unique_ptr<Block[]> blocks(new Block[blockCount(w, h)]);
+
+    uint8 values[16];
+    int bw = (w + 3)/4, bh = (h + 3)/4;
+    for (int by = 0; by < bh; ++by) {
+        for (int bx = 0; bx < bw; ++bx) {
+            gatherBlock(bx, by, w, h, values, [&](int x, int y) { return texels[x + y*w]; });
+            blocks[bx + by*bw] = compressBc4Block(values);
+        }
+    }
+
+    return blocks;
+}
+
+uint32 encodeRgb9e5(Vec3f c)
+{
+    // Also flushes NaNs to zero
+    for (int i = 0; i < 3; ++i)
+        c[i] = c[i] > 0.0f ? min(c[i], MaxRgb9e5) : 0.0f;
+
+    int exponent;
+    std::frexp(c.max(), &exponent);
+    int sharedExponent = max(exponent + 15, 0);
+    float scale = std::ldexp(1.0f, 24 - sharedExponent);
+    if (int(c.max()*scale + 0.5f) > 511) {
+        sharedExponent++;
+        scale *= 0.5f;
+    }
+
+    uint32 r = min(uint32(c.x()*scale + 0.5f), 511u);
+    uint32 g = min(uint32(c.y()*scale + 0.5f), 511u);
+    uint32 b = min(uint32(c.z()*scale + 0.5f), 511u);
+    return r | (g << 9) | (b << 18) | (uint32(sharedExponent) << 27);
+}
+
+std::unique_ptr<uint32[]> compressRgb9e5(const Vec3f *texels, int w, int h)
+{
+    std::unique_ptr<uint32[]> result(new uint32[size_t(w)*size_t(h)]);
+    for (size_t i = 0; i < size_t(w)*size_t(h); ++i)
+        result[i] = encodeRgb9e5(texels[i]);
+    return result;
+}
+
+}
+
+}
@@ -0,0 +1,94 @@
+#ifndef TEXELCOMPRESSION_HPP_
+#define TEXELCOMPRESSION_HPP_
+
+#include "math/BitManip.hpp"
+#include "math/Vec.hpp"
+
+#include "IntTypes.hpp"
+
+#include <memory>
+
+namespace Tungsten {
+
+// Compressed storage for bitmap textures. LDR textures are stored in blocks of
+// 4x4 texels, with two endpoints and a per-texel index into a palette
+// interpolated between them: BC1 for RGB and BC4 for scalar textures, both at
+// 4 bits per texel. Unlike the GPU formats, BC1 blocks always use the four
+// color palette. HDR RGB textures are stored as RGB9E5 (9 bit mantissas with a
+// shared 5 bit exponent), at 32 bits per texel.
+//
+// Individual texels decode with a handful of integer operations, so lookups
+// decode on the fly and never expand a texture in memory.
+namespace TexelCompression {
+
+// Blocks are packed into 64 bit words. BC1: 2x16 bit RGB565 endpoints followed
+// by 16 2 bit indices. BC4: 2x8 bit endpoints followed by 16 3 bit indices
+typedef uint64 Block;
+
+// Largest value RGB9E5 can represent, (511/512)*2^16. Larger values are clamped
+static CONSTEXPR float MaxRgb9e5 = 65408.0f;
+
+static inline int blockCount(int w, int h)
+{
+    return ((w + 3)/4)*((h + 3)/4);
+}
+
+static inline Block fetchBlock(const Block *blocks, int w, int x, int y)
+{
+    return blocks[(x >> 2) + (y >> 2)*((w + 3) >> 2)];
+}
+
+static inline int texelIndex(int x, int y)
+{
+    return (x & 3) + (y & 3)*4;
+}
+
+// Expects RGBA texels with 4 bytes each; alpha is ignored
+std::unique_ptr<Block[]> compressBc1(const uint8 *texels, int w, int h);
+std::unique_ptr<Block[]> compressBc4(const uint8 *texels, int w, int h);
+std::unique_ptr<uint32[]> compressRgb9e5(const Vec3f *texels, int w, int h);
+
+uint32 encodeRgb9e5(Vec3f c);
+
+static inline Vec3f decodeRgb565(uint32 c)
+{
+    return Vec3f(float(c >> 11), float((c >> 5) & 0x3F), float(c & 0x1F))*Vec3f(1.0f/31.0f, 1.0f/63.0f, 1.0f/31.0f);
+}
+
+static inline Vec3f decodeBc1(const Block *blocks, int w, int x, int y)
+{
+    Block block = fetchBlock(blocks, w, x, y);
+    Vec3f c0 = decodeRgb565(uint32(block) & 0xFFFF);
+    Vec3f c1 = decodeRgb565(uint32(block >> 16) & 0xFFFF);
+    switch ((block >> (32 + 2*texelIndex(x, y))) & 3) {
+    case 0:  return c0;
+    case 1:  return c1;
+    case 2:  return (c0*2.0f + c1)*(1.0f/3.0f);
+    default: return (c0 + c1*2.0f)*(1.0f/3.0f);
+    }
+}
+
+static inline float decodeBc4(const Block *blocks, int w, int x, int y)
+{
+    Block block = fetchBlock(blocks, w, x, y);
+    int a0 = int(block & 0xFF);
+    int a1 = int((block >> 8) & 0xFF);
+    int i = int((block >> (16 + 3*texelIndex(x, y))) & 7);
+    // Index 0 and 1 are the endpoints, 2-7 step from a0 to a1
+    if (i < 2)
+        return float(i ? a1 : a0)*(1.0f/255.0f);
+    return float((8 - i)*a0 + (i - 1)*a1)*(1.0f/(7.0f*255.0f));
+}
+
+static inline Vec3f decodeRgb9e5(uint32 c)
+{
+    // 2^(exponent - 15 - 9)
+    float scale = BitManip::uintBitsToFloat(((c >> 27) + 127u - 24u) << 23);
+    return Vec3f(float(c & 0x1FF), float((c >> 9) & 0x1FF), float((c >> 18) & 0x1FF))*scale;
+}
+
+}
+
+}
+
+#endif /* TEXELCOMPRESSION_HPP_ */
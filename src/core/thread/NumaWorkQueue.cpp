@@ -0,0 +1,58 @@
+#include "NumaWorkQueue.hpp"
+#include "ThreadUtils.hpp"
+#include "ThreadPool.hpp"
+
+#include <vector>
+
+namespace Tungsten {
+
+NumaWorkQueue::NumaWorkQueue()
+: _numNodes(0)
+{
+}
+
+NumaWorkQueue::NumaWorkQueue(uint32 numItems)
+{
+    init(numItems);
+}
+
+void NumaWorkQueue::init(uint32 numItems)
+{
+    _numNodes = ThreadUtils::pool ? ThreadUtils::pool->numaNodeCount() : 1;
+    _nodes.reset(new NodeRange[_numNodes]);
+
+    std::vector<uint32> threadsPerNode(_numNodes, 0);
+    uint32 threadCount = ThreadUtils::pool ? ThreadUtils::pool->threadCount() : 0;
+    for (uint32 i = 0; i < threadCount; ++i)
+        threadsPerNode[ThreadUtils::pool->threadNode(i)]++;
+
+    uint32 threadsSoFar = 0;
+    for (uint32 i = 0; i < _numNodes; ++i) {
+        _nodes[i].start = threadCount ? uint32((uint64(numItems)*threadsSoFar)/threadCount) : 0;
+        threadsSoFar += threadsPerNode[i];
+        _nodes[i].end = threadCount ? uint32((uint64(numItems)*threadsSoFar)/threadCount) : numItems;
+    }
+    reset();
+}
+
+void NumaWorkQueue::reset()
+{
+    for (uint32 i = 0; i < _numNodes; ++i)
+        _nodes[i].next = _nodes[i].start;
+}
+
+bool NumaWorkQueue::pop(uint32 threadId, uint32 &item)
+{
+    uint32 home = ThreadUtils::pool ? ThreadUtils::pool->threadNode(threadId) : 0;
+    for (uint32 i = 0; i < _numNodes; ++i) {
+        NodeRange &node = _nodes[(home + i) % _numNodes];
+        if (node.next.load(std::memory_order_relaxed) >= node.end)
+            continue;
+        item = node.next++;
+        if (item < node.end)
+            return true;
+    }
+    return false;
+}
+
+}
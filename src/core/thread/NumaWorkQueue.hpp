@@ -0,0 +1,43 @@
+#ifndef NUMAWORKQUEUE_HPP_
+#define NUMAWORKQUEUE_HPP_
+
+#include "IntTypes.hpp"
+
+#include <atomic>
+#include <memory>
+
+namespace Tungsten {
+
+// Hands out the items [0, numItems) to the threads of the thread pool. Every
+// NUMA node of the pool owns a contiguous range of items, proportional to the
+// number of threads running on it, and threads only take items from other
+// nodes once the range of their own node is exhausted. Image tiles are numbered
+// in scanline order, so each node renders a contiguous band of the image and
+// keeps writing to the same framebuffer pages in every pass.
+// Without thread pinning, the pool reports a single node and this degenerates
+// to a plain shared counter
+class NumaWorkQueue
+{
+    struct NodeRange
+    {
+        std::atomic<uint32> next;
+        uint32 start, end;
+    };
+
+    std::unique_ptr<NodeRange[]> _nodes;
+    uint32 _numNodes;
+
+public:
+    NumaWorkQueue();
+    NumaWorkQueue(uint32 numItems);
+
+    void init(uint32 numItems);
+    // Makes all items available again
+    void reset();
+
+    bool pop(uint32 threadId, uint32 &item);
+};
+
+}
+
+#endif /* NUMAWORKQUEUE_HPP_ */
@@ -2,6 +2,7 @@
 #define TASKGROUP_HPP_
 
 #include "IntTypes.hpp"
+#include "Timeline.hpp"
 
 #include <condition_variable>
 #include <functional>
@@ -32,8 +33,10 @@ class TaskGroup
 
     void finish()
     {
-        if (_finisher && !_abort)
+        if (_finisher && !_abort) {
+            Timeline::Scope scope("Finisher");
             _finisher();
+        }
 
         std::unique_lock<std::mutex> lock(_waitMutex);
         _done = true;
@@ -54,6 +57,8 @@ public:
 
     void run(uint32 threadId, uint32 taskId)
     {
+        Timeline::Scope scope("Subtask", "subtask", taskId);
+
         try {
             _func(taskId, _numSubTasks, threadId);
         } catch (...) {
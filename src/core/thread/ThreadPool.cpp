@@ -1,13 +1,21 @@
 #include "ThreadPool.hpp"
+#include "ThreadUtils.hpp"
 
+#include "math/MathUtil.hpp"
+
+#include <tinyformat/tinyformat.hpp>
+#include <iostream>
 #include <chrono>
 
 namespace Tungsten {
 
-ThreadPool::ThreadPool(uint32 threadCount)
+ThreadPool::ThreadPool(uint32 threadCount, bool pinThreads)
 : _threadCount(threadCount),
+  _pinThreads(pinThreads),
+  _numaNodeCount(1),
   _terminateFlag(false)
 {
+    assignCpus();
     startThreads();
 }
 
@@ -16,6 +24,40 @@ ThreadPool::~ThreadPool()
     stop();
 }
 
+// Every NUMA node receives a share of the threads proportional to its
+// number of CPUs. Threads are numbered node by node, so that consecutive
+// thread ids share a node, and nodes without threads are skipped
+void ThreadPool::assignCpus()
+{
+    _threadNodes.assign(_threadCount, 0);
+    if (!_pinThreads)
+        return;
+
+    std::vector<std::vector<uint32>> nodes = ThreadUtils::numaTopology();
+    uint32 totalCpus = 0;
+    for (const std::vector<uint32> &cpus : nodes)
+        totalCpus += uint32(cpus.size());
+
+    _threadCpus.clear();
+    _threadNodes.clear();
+    _numaNodeCount = 0;
+    uint32 cpusSoFar = 0;
+    for (const std::vector<uint32> &cpus : nodes) {
+        cpusSoFar += uint32(cpus.size());
+        uint32 end = uint32((uint64(_threadCount)*cpusSoFar)/totalCpus);
+        if (end == _threadCpus.size())
+            continue;
+        for (uint32 i = 0; _threadCpus.size() < end; ++i) {
+            _threadCpus.push_back(cpus[i % cpus.size()]);
+            _threadNodes.push_back(_numaNodeCount);
+        }
+        _numaNodeCount++;
+    }
+
+    std::cout << tfm::format("Pinning %d threads to %d CPUs on %d NUMA node(s)",
+            _threadCount, min(_threadCount, totalCpus), _numaNodeCount) << std::endl;
+}
+
 std::shared_ptr<TaskGroup> ThreadPool::acquireTask(uint32 &subTaskId)
 {
     if (_terminateFlag)
@@ -33,6 +75,11 @@ std::shared_ptr<TaskGroup> ThreadPool::acquireTask(uint32 &subTaskId)
 
 void ThreadPool::runWorker(uint32 threadId)
 {
+    if (_pinThreads && !ThreadUtils::pinCurrentThread(_threadCpus[threadId]))
+        std::cout << tfm::format("Failed to pin worker %d to CPU %d", threadId, _threadCpus[threadId]) << std::endl;
+    if (Timeline::enabled())
+        Timeline::setThreadName(tfm::format("Worker %d", threadId));
+
     while (!_terminateFlag) {
         uint32 subTaskId;
         std::shared_ptr<TaskGroup> task;
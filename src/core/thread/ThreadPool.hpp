@@ -23,6 +23,10 @@ class ThreadPool
     typedef std::function<void()> Finisher;
 
     uint32 _threadCount;
+    bool _pinThreads;
+    uint32 _numaNodeCount;
+    std::vector<uint32> _threadCpus;
+    std::vector<uint32> _threadNodes;
     std::vector<std::unique_ptr<std::thread>> _workers;
     std::atomic<bool> _terminateFlag;
 
@@ -32,12 +36,13 @@ class ThreadPool
 
     std::unordered_map<std::thread::id, uint32> _idToNumericId;
 
+    void assignCpus();
     std::shared_ptr<TaskGroup> acquireTask(uint32 &subTaskId);
     void runWorker(uint32 threadId);
     void startThreads();
 
 public:
-    ThreadPool(uint32 threadCount);
+    ThreadPool(uint32 threadCount, bool pinThreads = false);
     ~ThreadPool();
 
     void yield(TaskGroup &wait);
@@ -52,6 +57,18 @@ public:
     {
         return _threadCount;
     }
+
+    // Without pinning, threads may migrate between nodes at any time,
+    // and all of them are reported as belonging to node 0
+    uint32 numaNodeCount() const
+    {
+        return _numaNodeCount;
+    }
+
+    uint32 threadNode(uint32 threadId) const
+    {
+        return threadId < _threadNodes.size() ? _threadNodes[threadId] : 0;
+    }
 };
 
 }
@@ -1,13 +1,21 @@
+#include "NumaWorkQueue.hpp"
 #include "ThreadPool.hpp"
 
 #include "math/MathUtil.hpp"
 
+#include <tinyformat/tinyformat.hpp>
+#include <fstream>
+#include <cstring>
 #include <thread>
 #if _WIN32
 #include <windows.h>
 #else
 #include <unistd.h>
 #endif
+#if __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace Tungsten {
 
@@ -37,9 +45,88 @@ uint32 idealThreadCount()
     return 4;
 }
 
-void startThreads(int numThreads)
+void startThreads(int numThreads, bool pinThreads)
+{
+    pool = new ThreadPool(numThreads, pinThreads);
+}
+
+#if __linux__
+// Parses cpu lists of the form "0-3,8,10-11"
+static std::vector<uint32> parseCpuList(const std::string &list)
+{
+    std::vector<uint32> result;
+    const char *s = list.c_str();
+    while (*s) {
+        char *end;
+        uint32 first = uint32(std::strtoul(s, &end, 10));
+        if (end == s)
+            break;
+        uint32 last = first;
+        s = end;
+        if (*s == '-') {
+            last = uint32(std::strtoul(s + 1, &end, 10));
+            s = end;
+        }
+        for (uint32 cpu = first; cpu <= last; ++cpu)
+            result.push_back(cpu);
+        if (*s == ',')
+            s++;
+        else
+            break;
+    }
+    return result;
+}
+#endif
+
+std::vector<std::vector<uint32>> numaTopology()
+{
+    std::vector<std::vector<uint32>> result;
+#if __linux__
+    // Node ids may be sparse, e.g. on machines with memory-only nodes
+    const int MaxNodes = 64;
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool haveAffinity = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    for (int node = 0; node < MaxNodes; ++node) {
+        std::ifstream in(tfm::format("/sys/devices/system/node/node%d/cpulist", node));
+        std::string list;
+        if (!in.good() || !std::getline(in, list))
+            continue;
+
+        std::vector<uint32> cpus;
+        for (uint32 cpu : parseCpuList(list))
+            if (cpu < CPU_SETSIZE && (!haveAffinity || CPU_ISSET(cpu, &allowed)))
+                cpus.push_back(cpu);
+        if (!cpus.empty())
+            result.emplace_back(std::move(cpus));
+    }
+#endif
+    if (result.empty()) {
+        result.emplace_back();
+        for (uint32 i = 0; i < idealThreadCount(); ++i)
+            result.back().push_back(i);
+    }
+    return result;
+}
+
+bool pinCurrentThread(uint32 cpu)
 {
-    pool = new ThreadPool(numThreads);
+#if __linux__
+    if (cpu >= CPU_SETSIZE)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif _WIN32
+    if (cpu >= sizeof(DWORD_PTR)*8)
+        return false;
+    return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+#else
+    return false;
+#endif
 }
 
 void parallelFor(uint32 start, uint32 end, uint32 partitions, std::function<void(uint32)> func)
@@ -58,6 +145,28 @@ void parallelFor(uint32 start, uint32 end, uint32 partitions, std::function<void
         pool->yield(*pool->enqueue(taskRun, partitions));
 }
 
+void parallelZero(void *data, size_t bytes)
+{
+    // Multiple of the page size
+    const size_t ChunkSize = 256*1024;
+
+    uint32 numChunks = uint32((bytes + ChunkSize - 1)/ChunkSize);
+    if (!pool || numChunks <= 1) {
+        std::memset(data, 0, bytes);
+        return;
+    }
+
+    char *base = static_cast<char *>(data);
+    NumaWorkQueue queue(numChunks);
+    pool->yield(*pool->enqueue([&](uint32 /*idx*/, uint32 /*num*/, uint32 threadId) {
+        uint32 chunk;
+        if (queue.pop(threadId, chunk)) {
+            size_t offset = chunk*ChunkSize;
+            std::memset(base + offset, 0, min(ChunkSize, bytes - offset));
+        }
+    }, numChunks));
+}
+
 }
 
 }
@@ -4,6 +4,8 @@
 #include "IntTypes.hpp"
 
 #include <functional>
+#include <memory>
+#include <vector>
 
 namespace Tungsten {
 
@@ -14,10 +16,31 @@ namespace ThreadUtils {
 extern ThreadPool *pool;
 
 uint32 idealThreadCount();
-void startThreads(int numThreads);
+// If pinThreads is set, every worker is pinned to a CPU, and thread ids
+// are numbered NUMA node by NUMA node
+void startThreads(int numThreads, bool pinThreads = false);
+
+// CPUs that this process may run on, grouped by NUMA node. Systems without
+// NUMA or without topology information report a single node
+std::vector<std::vector<uint32>> numaTopology();
+bool pinCurrentThread(uint32 cpu);
 
 void parallelFor(uint32 start, uint32 end, uint32 partitions, std::function<void(uint32)> func);
 
+// Zeroes memory in parallel, with the memory split into chunks that are handed
+// out by a NumaWorkQueue. Pages are placed on the NUMA node of the thread that
+// first touches them, so with pinned threads, large framebuffers end up on the
+// nodes that render the matching tiles
+void parallelZero(void *data, size_t bytes);
+
+template<typename T>
+inline std::unique_ptr<T[]> parallelZeroAlloc(size_t size)
+{
+    std::unique_ptr<T[]> result(new T[size]);
+    parallelZero(result.get(), size*sizeof(T));
+    return result;
+}
+
 }
 
 }
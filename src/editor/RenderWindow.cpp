@@ -134,7 +134,17 @@ void RenderWindow::startRender()
         return;
 
     if (!_flattenedScene) {
+        // Renders in the editor always start with preview passes, without
+        // changing the setting in the scene document
+        RendererSettings &settings = _scene->rendererSettings();
+        bool progressivePreview = settings.progressivePreview();
+        settings.setProgressivePreview(true);
         _flattenedScene.reset(_scene->makeTraceable());
+        settings.setProgressivePreview(progressivePreview);
+
+        // Previews start from the part of the image at the centre of the view
+        _flattenedScene->integrator().setPreviewFocus(clamp(Vec2f(
+                0.5f - _panX/_image->width(), 0.5f - _panY/_image->height()), Vec2f(0.0f), Vec2f(1.0f)));
 
         _image->fill(Qt::black);
         repaint();
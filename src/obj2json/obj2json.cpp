@@ -8,6 +8,8 @@
 #include "io/FileUtils.hpp"
 #include "io/Scene.hpp"
 
+#include "thread/ThreadUtils.hpp"
+
 using namespace Tungsten;
 
 static const int OPT_VERSION = 0;
@@ -35,6 +37,8 @@ int main(int argc, const char *argv[])
     if (!dstDir.empty() && !FileUtils::createDirectory(dstDir))
         parser.fail("Unable to create target directory '%s'", dstDir);
 
+    ThreadUtils::startThreads(ThreadUtils::idealThreadCount());
+
     Scene *scene = ObjLoader::load(Path(parser.operands()[0]));
 
     if (!scene)
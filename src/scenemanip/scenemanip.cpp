@@ -1,7 +1,10 @@
 #include "Version.hpp"
 
+#include "thread/ThreadUtils.hpp"
+
 #include "io/JsonLoadException.hpp"
 #include "io/FileIterables.hpp"
+#include "io/SceneBundle.hpp"
 #include "io/ZipWriter.hpp"
 #include "io/CliParser.hpp"
 #include "io/Scene.hpp"
@@ -25,6 +28,7 @@ static const int OPT_COMPRESSION_LEVEL = 6;
 static const int OPT_RELOCATE          = 7;
 static const int OPT_COPY_RELOCATE     = 8;
 static const int OPT_PATHS_ONLY        = 9;
+static const int OPT_BAKE              = 10;
 
 static void listResources(Scene *scene, CliParser &/*parser*/)
 {
@@ -41,6 +45,9 @@ static void zipResources(Scene *scene, CliParser &parser)
     if (parser.isPresent(OPT_COMPRESSION_LEVEL))
         compressionLevel = std::atoi(parser.param(OPT_COMPRESSION_LEVEL).c_str());
 
+    // Large files are compressed in parallel
+    ThreadUtils::startThreads(ThreadUtils::idealThreadCount());
+
     std::unordered_set<Path> remappedPaths;
     auto remap = [&](const Path &p) {
         Path result = p.stripParent();
@@ -143,6 +150,16 @@ static void relocateResources(Scene *scene, CliParser &parser)
     Scene::save(scene->path(), *scene);
 }
 
+static void bakeScene(Scene *scene, CliParser &parser)
+{
+    if (!parser.isPresent(OPT_OUTPUT))
+        parser.fail("No output file specified");
+
+    Path output(parser.param(OPT_OUTPUT));
+    if (!SceneBundle::bake(*scene, output))
+        parser.fail("Failed to write scene bundle to '%s'", output);
+}
+
 int main(int argc, const char *argv[])
 {
     CliParser parser("scenemanip");
@@ -155,6 +172,7 @@ int main(int argc, const char *argv[])
     parser.addOption('\0', "relocate", "Moves all resources referenced by the scene file into the specified output directory", false, OPT_RELOCATE);
     parser.addOption('\0', "copy", "Copy resources instead of moving them when running --relocate", false, OPT_COPY_RELOCATE);
     parser.addOption('\0', "paths-only", "Only modify resource paths in the scene file when running --relocate, don't copy or move any files", false, OPT_PATHS_ONLY);
+    parser.addOption('b', "bake", "Loads and decodes all resources referenced by the scene file and writes them together with the scene into a single binary bundle, which tungsten can render directly", false, OPT_BAKE);
 
     parser.parse(argc, argv);
 
@@ -184,6 +202,8 @@ int main(int argc, const char *argv[])
         zipResources(scene, parser);
     else if (parser.isPresent(OPT_RELOCATE))
         relocateResources(scene, parser);
+    else if (parser.isPresent(OPT_BAKE))
+        bakeScene(scene, parser);
     else
         parser.fail("Don't know what to do! No action specified");
 
@@ -0,0 +1,464 @@
+#include "Version.hpp"
+
+#include "primitives/IntersectionTemporary.hpp"
+#include "primitives/Curves.hpp"
+
+#include "sampling/UniformPathSampler.hpp"
+#include "sampling/SampleWarp.hpp"
+
+#include "samplerecords/DirectionSample.hpp"
+#include "samplerecords/PositionSample.hpp"
+#include "samplerecords/MediumSample.hpp"
+
+#include "media/AtmosphericMedium.hpp"
+
+#include "cameras/Camera.hpp"
+
+#include "renderer/TraceableScene.hpp"
+
+#include "primitives/EmbreeUtil.hpp"
+
+#include "thread/ThreadUtils.hpp"
+
+#include "io/DirectoryChange.hpp"
+#include "io/JsonDocument.hpp"
+#include "io/TextureCache.hpp"
+#include "io/JsonObject.hpp"
+#include "io/CliParser.hpp"
+#include "io/FileUtils.hpp"
+#include "io/ImageIO.hpp"
+#include "io/Scene.hpp"
+
+#include "Timer.hpp"
+
+#include <tinyformat/tinyformat.hpp>
+#include <rapidjson/document.h>
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <cmath>
+
+using namespace Tungsten;
+
+static const int OPT_VERSION = 0;
+static const int OPT_HELP    = 1;
+static const int OPT_RAYS    = 2;
+static const int OPT_THREADS = 3;
+static const int OPT_REFERENCE = 4;
+static const int OPT_TIME      = 5;
+static const int OPT_VARIANTS  = 6;
+static const int OPT_OUTPUT    = 7;
+
+// Render settings compared by the convergence benchmark by default. Every
+// variant is merged into the scene document, so settings it does not mention,
+// such as bounce limits, are taken from the scene
+static const char *DefaultVariants = R"([
+    {"name": "path_tracer", "integrator": {"type": "path_tracer"},
+        "renderer": {"stratified_sampler": true, "adaptive_sampling": false}},
+    {"name": "path_tracer_uniform", "integrator": {"type": "path_tracer"},
+        "renderer": {"stratified_sampler": false, "adaptive_sampling": false}},
+    {"name": "path_tracer_adaptive", "integrator": {"type": "path_tracer"},
+        "renderer": {"stratified_sampler": true, "adaptive_sampling": true}},
+    {"name": "bidirectional_path_tracer", "integrator": {"type": "bidirectional_path_tracer"},
+        "renderer": {"stratified_sampler": true, "adaptive_sampling": false}}
+])";
+
+// Applied on top of every variant. Renders are only limited by the time budget
+static const char *BenchmarkOverrides = R"({
+    "renderer": {"spp": 1000000000, "timeout": "0", "checkpoint_interval": "0", "bucket_size": 0,
+        "enable_resume_render": false, "progressive_preview": false}
+})";
+
+struct ConvergenceSample
+{
+    uint32 spp;
+    double time;
+    double rmse;
+    double relMse;
+
+    // Inverse of the product of error and render time. Higher is better, and
+    // for an unbiased estimator it stays roughly constant as the render converges.
+    // Zero if the product vanishes, since the efficiency is undefined then
+    double efficiency() const
+    {
+        double product = relMse*time;
+        return product > 0.0 ? 1.0/product : 0.0;
+    }
+};
+
+// Traces primary camera rays against every curves primitive in the scene, followed
+// by one uniformly scattered secondary ray per hit to approximate the incoherent rays
+// produced by multiple scattering in hair. Each BVH type is built and timed in turn
+static void benchmarkCurves(Scene &scene, uint32 numRays)
+{
+    Camera &cam = *scene.camera();
+    cam.prepareForRender();
+    Vec2u res = cam.resolution();
+
+    for (const std::shared_ptr<Primitive> &prim : scene.primitives()) {
+        Curves *curves = dynamic_cast<Curves *>(prim.get());
+        if (!curves)
+            continue;
+
+        std::cout << tfm::format("Curves primitive '%s'", curves->name()) << std::endl;
+        for (const char *bvhType : {"binary", "oriented"}) {
+            curves->setBvhTypeName(bvhType);
+
+            Timer buildTimer;
+            curves->prepareForRender();
+            buildTimer.stop();
+
+            UniformPathSampler sampler(0xBA5EBA11);
+            uint32 primaryHits = 0, secondaryHits = 0, secondaryRays = 0;
+
+            Timer traceTimer;
+            for (uint32 i = 0; i < numRays; ++i) {
+                Vec2u pixel(sampler.next2D()*Vec2f(res));
+                pixel = min(pixel, res - 1u);
+                PositionSample point;
+                DirectionSample direction;
+                if (!cam.samplePosition(sampler, point) || !cam.sampleDirection(sampler, point, pixel, direction))
+                    continue;
+
+                IntersectionTemporary data;
+                Ray ray(point.p, direction.d);
+                if (!curves->intersect(ray, data))
+                    continue;
+                primaryHits++;
+
+                Vec3f p = ray.pos() + ray.dir()*ray.farT();
+                Ray secondary(p, SampleWarp::uniformSphere(sampler.next2D()), 1e-3f);
+                secondaryRays++;
+                if (curves->intersect(secondary, data))
+                    secondaryHits++;
+            }
+            traceTimer.stop();
+
+            uint32 totalRays = numRays + secondaryRays;
+            std::cout << tfm::format("  %-8s build %8.3f s, trace %8.3f s, %7.3f Mrays/s (%d/%d primary hits, %d/%d secondary hits)",
+                    bvhType, buildTimer.elapsed(), traceTimer.elapsed(), totalRays*1e-6/traceTimer.elapsed(),
+                    primaryHits, numRays, secondaryHits, secondaryRays) << std::endl;
+
+            curves->teardownAfterRender();
+        }
+    }
+}
+
+// Times transmittance and distance sampling queries of every atmospheric medium
+// in the scene with the analytic optical depth and with lookup tables of
+// increasing size, and reports how far the tables deviate from the analytic path.
+// Rays start anywhere within twice the atmosphere radius; half of them are unbounded
+static void benchmarkAtmosphere(Scene &scene, uint32 numRays)
+{
+    for (const std::shared_ptr<Medium> &medium : scene.media()) {
+        AtmosphericMedium *atmosphere = dynamic_cast<AtmosphericMedium *>(medium.get());
+        if (!atmosphere)
+            continue;
+
+        atmosphere->setOpticalDepthTableSize(0);
+        atmosphere->prepareForRender();
+
+        std::vector<Ray> rays;
+        UniformPathSampler raySampler(0xBA5EBA11);
+        for (uint32 i = 0; i < numRays; ++i) {
+            Vec3f p = atmosphere->center() + SampleWarp::uniformSphere(raySampler.next2D())*
+                    (2.0f*atmosphere->radius()*raySampler.next1D());
+            Vec3f d = SampleWarp::uniformSphere(raySampler.next2D());
+            float farT = (i & 1) ? Ray::infinity() : 4.0f*atmosphere->radius()*raySampler.next1D();
+            rays.emplace_back(p, d, 0.0f, farT);
+        }
+
+        std::vector<Vec3f> referenceTransmittance, transmittance(numRays);
+        std::vector<MediumSample> referenceSamples, samples(numRays);
+
+        std::cout << tfm::format("Atmospheric medium '%s'", atmosphere->name()) << std::endl;
+        for (int tableSize : {0, 256, 1024, 4096, 16384}) {
+            atmosphere->setOpticalDepthTableSize(tableSize);
+            Timer buildTimer;
+            atmosphere->prepareForRender();
+            buildTimer.stop();
+
+            UniformPathSampler sampler(0xBA5EBA11);
+            Timer transmittanceTimer;
+            for (uint32 i = 0; i < numRays; ++i)
+                transmittance[i] = atmosphere->transmittance(sampler, rays[i]);
+            transmittanceTimer.stop();
+
+            Timer sampleTimer;
+            for (uint32 i = 0; i < numRays; ++i) {
+                Medium::MediumState state;
+                state.reset();
+                atmosphere->sampleDistance(sampler, rays[i], state, samples[i]);
+            }
+            sampleTimer.stop();
+
+            std::string label = tableSize ? tfm::format("table %d", tableSize) : std::string("analytic");
+            std::cout << tfm::format("  %-12s transmittance %7.2f ns/call, sample distance %7.2f ns/call",
+                    label, transmittanceTimer.elapsed()*1e9/numRays, sampleTimer.elapsed()*1e9/numRays);
+
+            if (tableSize == 0) {
+                referenceTransmittance = transmittance;
+                referenceSamples = samples;
+                std::cout << std::endl;
+                continue;
+            }
+
+            // Both paths consume the same random numbers, so sampled distances can be
+            // compared one to one. They are reported relative to the atmosphere radius
+            float maxTransmittanceDifference = 0.0f, maxDistanceDifference = 0.0f;
+            uint32 exitMismatches = 0;
+            for (uint32 i = 0; i < numRays; ++i) {
+                Vec3f difference = std::abs(transmittance[i] - referenceTransmittance[i]);
+                maxTransmittanceDifference = max(maxTransmittanceDifference, difference.max());
+                if (samples[i].exited != referenceSamples[i].exited)
+                    exitMismatches++;
+                else if (!samples[i].exited)
+                    maxDistanceDifference = max(maxDistanceDifference,
+                            std::abs(samples[i].t - referenceSamples[i].t)/atmosphere->radius());
+            }
+            std::cout << tfm::format(", build %6.3f ms, max transmittance difference %.2e, "
+                    "max distance difference %.2e, %d exit mismatches", buildTimer.elapsed()*1e3,
+                    maxTransmittanceDifference, maxDistanceDifference, exitMismatches) << std::endl;
+        }
+    }
+}
+
+static void mergeJson(rapidjson::Value &dst, const rapidjson::Value &src, rapidjson::Document::AllocatorType &allocator)
+{
+    for (auto member = src.MemberBegin(); member != src.MemberEnd(); ++member) {
+        auto existing = dst.FindMember(member->name);
+        if (existing != dst.MemberEnd() && existing->value.IsObject() && member->value.IsObject()) {
+            mergeJson(existing->value, member->value, allocator);
+        } else {
+            if (existing != dst.MemberEnd())
+                dst.RemoveMember(existing);
+            dst.AddMember(rapidjson::Value(member->name, allocator), rapidjson::Value(member->value, allocator), allocator);
+        }
+    }
+}
+
+static ConvergenceSample measureError(const Camera &cam, const float *reference, uint32 spp, double time)
+{
+    Vec2u res = cam.resolution();
+    double squaredError = 0.0, relSquaredError = 0.0;
+    for (uint32 y = 0, idx = 0; y < res.y(); ++y) {
+        for (uint32 x = 0; x < res.x(); ++x, ++idx) {
+            Vec3f c = cam.getLinear(x, y);
+            for (int i = 0; i < 3; ++i) {
+                double r = reference[idx*3 + i];
+                double d = double(c[i]) - r;
+                squaredError += d*d;
+                relSquaredError += d*d/(r*r + 1e-2);
+            }
+        }
+    }
+    double n = double(res.product())*3.0;
+    return ConvergenceSample{spp, time, std::sqrt(squaredError/n), relSquaredError/n};
+}
+
+// Renders the scene with each variant for the same amount of wall clock time
+// and records the error against a reference image after every spp_step. Only
+// render passes count towards the budget; scene setup and error evaluation do
+// not. Results go to <output>.json and <output>.csv
+static void benchmarkConvergence(CliParser &parser, const Path &scenePath)
+{
+    if (!parser.isPresent(OPT_REFERENCE))
+        parser.fail("The convergence benchmark requires a reference image (--reference)");
+    Path referencePath(parser.param(OPT_REFERENCE));
+    double timeBudget = parser.isPresent(OPT_TIME) ? std::atof(parser.param(OPT_TIME).c_str()) : 60.0;
+    Path outputPath(parser.isPresent(OPT_OUTPUT) ? parser.param(OPT_OUTPUT) : std::string("convergence"));
+
+    int refW, refH;
+    std::unique_ptr<float[]> reference = ImageIO::loadHdr(referencePath, TexelConversion::REQUEST_RGB, refW, refH);
+    if (!reference)
+        parser.fail("Unable to load reference image '%s'", referencePath);
+
+    std::string sceneJson = FileUtils::loadText(scenePath);
+    if (sceneJson.empty())
+        parser.fail("Unable to load scene '%s'", scenePath);
+
+    std::string variantsJson = parser.isPresent(OPT_VARIANTS) ?
+            FileUtils::loadText(Path(parser.param(OPT_VARIANTS))) : std::string(DefaultVariants);
+    rapidjson::Document variants, overrides;
+    variants.Parse<0>(variantsJson.c_str());
+    overrides.Parse<0>(BenchmarkOverrides);
+    if (variants.HasParseError() || !variants.IsArray())
+        parser.fail("Variants must be a JSON array of objects");
+
+    EmbreeUtil::initDevice();
+    std::shared_ptr<TextureCache> cache = std::make_shared<TextureCache>();
+
+    rapidjson::Document results;
+    results.SetObject();
+    rapidjson::Value variantResults(rapidjson::kArrayType);
+    OutputStreamHandle csv = FileUtils::openOutputStream(outputPath + ".csv");
+    if (csv)
+        *csv << "variant,spp,time,rmse,relmse,efficiency" << std::endl;
+
+    // The first variant is the baseline that the others are compared to
+    double baselineEfficiency = 0.0;
+    for (rapidjson::SizeType i = 0; i < variants.Size(); ++i) {
+        rapidjson::Value variant(variants[i], variants.GetAllocator());
+        if (!variant.IsObject())
+            parser.fail("Variants must be a JSON array of objects");
+        std::string name = tfm::format("variant%d", i);
+        if (variant.HasMember("name") && variant["name"].IsString()) {
+            name = variant["name"].GetString();
+            variant.RemoveMember("name");
+        }
+
+        rapidjson::Document document;
+        document.Parse<0>(sceneJson.c_str());
+        if (document.HasParseError() || !document.IsObject())
+            parser.fail("Unable to parse scene '%s'", scenePath);
+        mergeJson(document, variant, document.GetAllocator());
+        mergeJson(document, overrides, document.GetAllocator());
+
+        std::vector<ConvergenceSample> samples;
+        double setupTime = 0.0;
+        try {
+            JsonDocument json(scenePath, JsonUtils::jsonToString(document));
+            DirectoryChange context(scenePath.parent());
+
+            Timer setupTimer;
+            std::unique_ptr<Scene> scene(new Scene(scenePath.parent(), cache));
+            scene->fromJson(json, *scene);
+            scene->setPath(scenePath);
+            scene->loadResources();
+            std::unique_ptr<TraceableScene> flattenedScene(scene->makeTraceable());
+            setupTimer.stop();
+            setupTime = setupTimer.elapsed();
+
+            const Camera &cam = flattenedScene->cam();
+            if (int(cam.resolution().x()) != refW || int(cam.resolution().y()) != refH)
+                parser.fail("Reference image is %dx%d, but the scene renders at %dx%d", refW, refH,
+                        cam.resolution().x(), cam.resolution().y());
+
+            Integrator &integrator = flattenedScene->integrator();
+            double renderTime = 0.0;
+            while (!integrator.done() && renderTime < timeBudget) {
+                Timer passTimer;
+                integrator.startRender([](){});
+                integrator.waitForCompletion();
+                passTimer.stop();
+                renderTime += passTimer.elapsed();
+
+                samples.push_back(measureError(cam, reference.get(), integrator.currentSpp(), renderTime));
+            }
+        } catch (const std::exception &e) {
+            parser.fail("Unable to render variant '%s': %s", name, e.what());
+        }
+        if (samples.empty()) {
+            if (i == 0)
+                std::cout << tfm::format("Baseline variant %s did not complete a render pass; "
+                        "relative efficiencies are not reported", name) << std::endl;
+            continue;
+        }
+
+        rapidjson::Value sampleResults(rapidjson::kArrayType);
+        for (const ConvergenceSample &s : samples) {
+            sampleResults.PushBack(JsonObject{results.GetAllocator(),
+                "spp", s.spp,
+                "time", s.time,
+                "rmse", s.rmse,
+                "relmse", s.relMse,
+                "efficiency", s.efficiency()
+            }, results.GetAllocator());
+            if (csv)
+                *csv << tfm::format("%s,%d,%.6f,%.8g,%.8g,%.8g", name, s.spp, s.time, s.rmse, s.relMse,
+                        s.efficiency()) << std::endl;
+        }
+
+        const ConvergenceSample &last = samples.back();
+        if (i == 0) {
+            baselineEfficiency = last.efficiency();
+            if (baselineEfficiency == 0.0)
+                std::cout << tfm::format("Baseline variant %s has zero error or render time; "
+                        "relative efficiencies are not reported", name) << std::endl;
+        }
+        variantResults.PushBack(JsonObject{rapidjson::Value(variants[i], results.GetAllocator()),
+            results.GetAllocator(),
+            "setup_time", setupTime,
+            "efficiency", last.efficiency(),
+            "samples", std::move(sampleResults)
+        }, results.GetAllocator());
+
+        std::string relative = tfm::format("%.2fx", last.efficiency()/baselineEfficiency);
+        if (baselineEfficiency == 0.0)
+            relative = "invalid baseline";
+        else if (last.efficiency() == 0.0)
+            relative = "undefined";
+        std::cout << tfm::format("%-28s %6d spp in %7.2f s, RMSE %.4e, relMSE %.4e, efficiency %.4e (%s)",
+                name, last.spp, last.time, last.rmse, last.relMse, last.efficiency(), relative) << std::endl;
+    }
+
+    results.AddMember("scene", JsonUtils::toJson(scenePath, results.GetAllocator()), results.GetAllocator());
+    results.AddMember("reference", JsonUtils::toJson(referencePath, results.GetAllocator()), results.GetAllocator());
+    results.AddMember("time_budget", timeBudget, results.GetAllocator());
+    results.AddMember("variants", variantResults, results.GetAllocator());
+    if (!FileUtils::writeJson(results, outputPath + ".json"))
+        std::cerr << tfm::format("Unable to write results to '%s'", outputPath + ".json") << std::endl;
+}
+
+int main(int argc, const char *argv[])
+{
+    CliParser parser("tungsten_bench", "[options] benchmark scene\n"
+        "Available benchmarks:\n"
+        "  curves      Compares curve BVH build and traversal performance\n"
+        "  atmosphere  Compares analytic and tabulated optical depth of atmospheric media\n"
+        "  convergence Compares error against a reference image over time for several\n"
+        "              integrators and render settings");
+    parser.addOption('h', "help", "Prints this help text", false, OPT_HELP);
+    parser.addOption('v', "version", "Prints version information", false, OPT_VERSION);
+    parser.addOption('r', "rays", "Number of primary rays to trace or media queries to run (default: 1000000)", true, OPT_RAYS);
+    parser.addOption('t', "threads", "Specifies number of threads to use for BVH builds and rendering (default: number of cores)", true, OPT_THREADS);
+    parser.addOption('\0', "reference", "Reference image for the convergence benchmark, e.g. a high spp render of the scene", true, OPT_REFERENCE);
+    parser.addOption('\0', "time", "Render time in seconds given to each variant of the convergence benchmark (default: 60)", true, OPT_TIME);
+    parser.addOption('\0', "variants", "JSON file with an array of scene overrides to compare in the convergence benchmark. Each may have a \"name\" (default: path tracer with and without Sobol and adaptive sampling, and bidirectional path tracer)", true, OPT_VARIANTS);
+    parser.addOption('o', "output", "Output path of the convergence benchmark results, without extension (default: convergence)", true, OPT_OUTPUT);
+
+    parser.parse(argc, argv);
+
+    if (parser.isPresent(OPT_VERSION)) {
+        std::cout << "tungsten_bench, version " << VERSION_STRING << std::endl;
+        return 0;
+    }
+    if (parser.operands().size() != 2 || parser.isPresent(OPT_HELP)) {
+        parser.printHelpText();
+        return 0;
+    }
+
+    uint32 numRays = 1000000;
+    if (parser.isPresent(OPT_RAYS))
+        numRays = std::atoi(parser.param(OPT_RAYS).c_str());
+    int threadCount = ThreadUtils::idealThreadCount();
+    if (parser.isPresent(OPT_THREADS))
+        threadCount = max(std::atoi(parser.param(OPT_THREADS).c_str()), 1);
+    ThreadUtils::startThreads(threadCount);
+
+    const std::string &benchmark = parser.operands()[0];
+    Path scenePath(parser.operands()[1]);
+
+    // Loads the scene once for every variant itself
+    if (benchmark == "convergence") {
+        benchmarkConvergence(parser, scenePath);
+        return 0;
+    }
+
+    std::unique_ptr<Scene> scene;
+    try {
+        scene.reset(Scene::load(scenePath));
+        scene->loadResources();
+    } catch (const std::exception &e) {
+        parser.fail("Unable to load scene '%s': %s", scenePath, e.what());
+    }
+
+    if (benchmark == "curves")
+        benchmarkCurves(*scene, numRays);
+    else if (benchmark == "atmosphere")
+        benchmarkAtmosphere(*scene, numRays);
+    else
+        parser.fail("Unknown benchmark '%s'", benchmark);
+
+    return 0;
+}
@@ -3,8 +3,11 @@
 
 #include "primitives/EmbreeUtil.hpp"
 
+#include "renderer/RenderStatistics.hpp"
 #include "renderer/TraceableScene.hpp"
 
+#include "bsdfs/PrecomputedTableCache.hpp"
+
 #include "thread/ThreadUtils.hpp"
 
 #include "io/JsonLoadException.hpp"
@@ -15,12 +18,14 @@
 #include "io/CliParser.hpp"
 #include "io/Scene.hpp"
 
+#include "Timeline.hpp"
 #include "Timer.hpp"
 
 #include <tinyformat/tinyformat.hpp>
 #include <rapidjson/document.h>
 #include <cstdlib>
 #include <vector>
+#include <thread>
 #include <mutex>
 #include <deque>
 
@@ -41,6 +46,11 @@ static const int OPT_SEED              = 7;
 static const int OPT_TIMEOUT           = 8;
 static const int OPT_OUTPUT_FILE       = 9;
 static const int OPT_HDR_OUTPUT_FILE   = 10;
+static const int OPT_TABLE_CACHE       = 11;
+static const int OPT_TRACE             = 12;
+static const int OPT_PIN_THREADS       = 13;
+static const int OPT_SEQUENCE          = 14;
+static const int OPT_PREVIEW           = 15;
 
 enum RenderState
 {
@@ -65,6 +75,10 @@ struct RendererStatus
     int nextSpp;
     int totalSpp;
 
+    // Totals since the start of the current render and of the last spp step
+    RenderStatistics::Snapshot statistics;
+    RenderStatistics::Snapshot stepStatistics;
+
     std::vector<Path> completedScenes;
     Path currentScene;
     std::deque<Path> queuedScenes;
@@ -89,6 +103,9 @@ struct RendererStatus
 
         result.add("completed_scenes", std::move(completedValue),
                    "queued_scenes", std::move(queuedValue));
+        if (RenderStatistics::Enabled)
+            result.add("statistics", statistics.toJson(allocator),
+                       "step_statistics", stepStatistics.toJson(allocator));
 
         return result;
     }
@@ -103,10 +120,18 @@ class StandaloneRenderer
     double _timeout;
     int _threadCount;
     Path _outputDirectory;
+    Path _traceFile;
 
     std::unique_ptr<Scene> _scene;
     std::unique_ptr<TraceableScene> _flattenedScene;
 
+    // In sequence mode, the previous frame stays alive until the next frame
+    // has taken over its primitives and its outputs have been written
+    std::shared_ptr<TextureCache> _textureCache;
+    std::unique_ptr<Scene> _previousScene;
+    std::unique_ptr<TraceableScene> _previousFlattenedScene;
+    std::thread _outputWriter;
+
     std::mutex _statusMutex;
     std::mutex _logMutex;
     std::mutex _sceneMutex;
@@ -118,6 +143,17 @@ class StandaloneRenderer
         _logStream << s << std::endl;
     }
 
+    void finishPreviousFrame()
+    {
+        if (_outputWriter.joinable())
+            _outputWriter.join();
+
+        _previousFlattenedScene.reset();
+        _previousScene.reset();
+        if (_textureCache)
+            _textureCache->prune();
+    }
+
 public:
     StandaloneRenderer(CliParser &parser, std::ostream &logStream)
     : _parser(parser),
@@ -140,6 +176,16 @@ public:
         parser.addOption('s', "seed", "Specifies the random seed to use", true, OPT_SEED);
         parser.addOption('o', "output-file", "Specifies the output file name. Overrides the setting in the scene file", true, OPT_OUTPUT_FILE);
         parser.addOption('e', "hdr-output-file", "Specifies the hdr output file name. Overrides the setting in the scene file", true, OPT_HDR_OUTPUT_FILE);
+        parser.addOption('\0', "table-cache", "Specifies a directory in which precomputed BSDF tables are cached across renders", true, OPT_TABLE_CACHE);
+        parser.addOption('\0', "trace", "Records a timeline of render phases and thread pool tasks to the specified file in Chrome trace format", true, OPT_TRACE);
+        parser.addOption('\0', "pin-threads", "Pins render threads to CPUs, grouped by NUMA node, and keeps each part of the image on the node that renders it", false, OPT_PIN_THREADS);
+        parser.addOption('\0', "sequence", "Renders the scene files as frames of an animation. Textures and primitives unchanged between frames are only loaded once, and outputs are saved while the next frame renders", false, OPT_SEQUENCE);
+        parser.addOption('\0', "preview", "Starts renders with low resolution preview passes, so that the frame buffer shows a first image almost immediately. Overrides the setting in the scene file", false, OPT_PREVIEW);
+    }
+
+    ~StandaloneRenderer()
+    {
+        finishPreviousFrame();
     }
 
     void setup()
@@ -159,13 +205,22 @@ public:
         if (_parser.isPresent(OPT_TIMEOUT))
             _timeout = StringUtils::parseDuration(_parser.param(OPT_TIMEOUT));
 
+        // Enabled before the thread pool starts, so that workers are named in the timeline
+        if (_parser.isPresent(OPT_TRACE)) {
+            _traceFile = Path(_parser.param(OPT_TRACE));
+            _traceFile.freezeWorkingDirectory();
+            _traceFile = _traceFile.absolute();
+            Timeline::enable();
+            Timeline::setThreadName("Main");
+        }
+
         EmbreeUtil::initDevice();
 
 #ifdef OPENVDB_AVAILABLE
         openvdb::initialize();
 #endif
 
-        ThreadUtils::startThreads(_threadCount);
+        ThreadUtils::startThreads(_threadCount, _parser.isPresent(OPT_PIN_THREADS));
 
         if (_parser.isPresent(OPT_OUTPUT_DIRECTORY)) {
             _outputDirectory = Path(_parser.param(OPT_OUTPUT_DIRECTORY));
@@ -175,8 +230,17 @@ public:
                 FileUtils::createDirectory(_outputDirectory, true);
         }
 
+        if (_parser.isPresent(OPT_TABLE_CACHE)) {
+            Path cacheDir(_parser.param(OPT_TABLE_CACHE));
+            cacheDir.freezeWorkingDirectory();
+            PrecomputedTableCache::setPersistentDirectory(cacheDir.absolute());
+        }
+
         for (const std::string &p : _parser.operands())
             _status.queuedScenes.emplace_back(p);
+
+        if (_parser.isPresent(OPT_SEQUENCE))
+            _textureCache = std::make_shared<TextureCache>();
     }
 
     bool renderScene()
@@ -184,11 +248,15 @@ public:
         Path currentScene;
         {
             std::unique_lock<std::mutex> lock(_statusMutex);
-            if (_status.queuedScenes.empty())
+            if (_status.queuedScenes.empty()) {
+                lock.unlock();
+                finishPreviousFrame();
                 return false;
+            }
 
             _status.state = STATE_LOADING;
             _status.startSpp = _status.currentSpp = _status.nextSpp = _status.totalSpp = 0;
+            _status.statistics = _status.stepStatistics = RenderStatistics::Snapshot();
 
             currentScene = _status.currentScene = _status.queuedScenes.front();
             _status.queuedScenes.pop_front();
@@ -197,7 +265,16 @@ public:
         writeLogLine(tfm::format("Loading scene '%s'...", currentScene));
         try {
             std::unique_lock<std::mutex> lock(_sceneMutex);
-            _scene.reset(Scene::load(Path(currentScene)));
+            {
+                Timeline::Scope scope("Load scene");
+                _scene.reset(Scene::load(Path(currentScene), _textureCache));
+            }
+            if (_previousScene) {
+                int reusedCount = _scene->reusePrimitives(*_previousScene);
+                writeLogLine(tfm::format("Reusing %d/%d primitives of the previous frame",
+                        reusedCount, _scene->primitives().size()));
+            }
+            Timeline::Scope scope("Load resources");
             _scene->loadResources();
         } catch (const JsonLoadException &e) {
             std::cerr << e.what() << std::endl;
@@ -210,6 +287,13 @@ public:
 
         if (_parser.isPresent(OPT_SPP))
             _scene->rendererSettings().setSpp(std::atoi(_parser.param(OPT_SPP).c_str()));
+        if (_parser.isPresent(OPT_PREVIEW))
+            _scene->rendererSettings().setProgressivePreview(true);
+
+        // Outputs of a frame are saved after the working directory has moved
+        // on to the next frame, so their paths must not depend on it
+        if (_textureCache)
+            _scene->rendererSettings().setOutputDirectory(_scene->rendererSettings().outputDirectory());
 
         if (_parser.isPresent(OPT_OUTPUT_FILE)) {
             Path p(_parser.param(OPT_OUTPUT_FILE));
@@ -240,7 +324,7 @@ public:
             int maxSpp = _scene->rendererSettings().spp();
             {
                 std::unique_lock<std::mutex> lock(_sceneMutex);
-                _flattenedScene.reset(_scene->makeTraceable(seed));
+                _flattenedScene.reset(_scene->makeTraceable(seed, _previousFlattenedScene.get()));
             }
             Integrator &integrator = _flattenedScene->integrator();
             bool resumeRender = _scene->rendererSettings().enableResumeRender();
@@ -249,6 +333,9 @@ public:
                              "but is not supported by the current integrator");
                 resumeRender = false;
             }
+            if (_scene->rendererSettings().bucketSize() > 0 && !integrator.supportsBucketRendering())
+                writeLogLine("Warning: Bucket rendering is enabled in the scene file, "
+                             "but is not supported by the current integrator");
 
             if (!_parser.isPresent(OPT_CHECKPOINTS))
                 _checkpointInterval = StringUtils::parseDuration(_scene->rendererSettings().checkpointInterval());
@@ -257,6 +344,7 @@ public:
 
             if (resumeRender && !_parser.isPresent(OPT_RESTART)) {
                 writeLogLine("Trying to resume render from saved state... ");
+                Timeline::Scope scope("Resume render");
                 if (integrator.resumeRender(*_scene))
                     writeLogLine("Resume successful");
                 else
@@ -268,8 +356,10 @@ public:
             }
 
             writeLogLine("Starting render...");
-            Timer timer, checkpointTimer;
+            Timer timer, checkpointTimer, stepTimer;
             double totalElapsed = 0.0;
+            RenderStatistics::Snapshot startStatistics = RenderStatistics::snapshot();
+            RenderStatistics::Snapshot lastStatistics = startStatistics;
             while (!integrator.done()) {
                 {
                     std::unique_lock<std::mutex> lock(_statusMutex);
@@ -278,9 +368,28 @@ public:
                     _status.nextSpp = integrator.nextSpp();
                 }
 
-                integrator.startRender([](){});
-                integrator.waitForCompletion();
-                writeLogLine(tfm::format("Completed %d/%d spp", integrator.currentSpp(), maxSpp));
+                {
+                    Timeline::Scope scope("Render pass", "spp", integrator.nextSpp());
+                    integrator.startRender([](){});
+                    integrator.waitForCompletion();
+                }
+                if (integrator.currentSpp() == 0 && maxSpp > 0)
+                    writeLogLine("Completed preview pass");
+                else
+                    writeLogLine(tfm::format("Completed %d/%d spp", integrator.currentSpp(), maxSpp));
+                if (RenderStatistics::Enabled) {
+                    stepTimer.stop();
+                    RenderStatistics::Snapshot statistics = RenderStatistics::snapshot();
+                    RenderStatistics::Snapshot step = statistics - lastStatistics;
+                    writeLogLine(tfm::format("%.2f Mrays/s: %s", step.totalRays()*1e-6/stepTimer.elapsed(), step.toString()));
+                    {
+                        std::unique_lock<std::mutex> lock(_statusMutex);
+                        _status.statistics = statistics - startStatistics;
+                        _status.stepStatistics = step;
+                    }
+                    lastStatistics = statistics;
+                    stepTimer.start();
+                }
                 timer.stop();
                 if (_timeout > 0.0 && timer.elapsed() > _timeout)
                     break;
@@ -290,6 +399,7 @@ public:
                     writeLogLine(tfm::format("Saving checkpoint after %s",
                             StringUtils::durationToString(totalElapsed)));
                     Timer ioTimer;
+                    Timeline::Scope scope("Save checkpoint");
                     checkpointTimer.start();
                     integrator.saveCheckpoint();
                     if (resumeRender)
@@ -304,11 +414,36 @@ public:
             writeLogLine(tfm::format("Finished render. Render time %s",
                     StringUtils::durationToString(timer.elapsed())));
 
-            integrator.saveOutputs();
-            if (_scene->rendererSettings().enableResumeRender())
-                integrator.saveRenderResumeData(*_scene);
+            if (_textureCache) {
+                finishPreviousFrame();
+
+                // Saved in the background while the next frame renders. The
+                // frame is kept alive until the writer is done with it
+                Scene *scene = _scene.get();
+                Integrator *integratorPtr = &integrator;
+                _outputWriter = std::thread([this, scene, integratorPtr, currentScene]() {
+                    {
+                        Timeline::Scope scope("Save outputs");
+                        integratorPtr->saveOutputs();
+                        if (scene->rendererSettings().enableResumeRender())
+                            integratorPtr->saveRenderResumeData(*scene);
+                    }
+
+                    std::unique_lock<std::mutex> lock(_statusMutex);
+                    _status.completedScenes.push_back(currentScene);
+                });
+
+                std::unique_lock<std::mutex> lock(_sceneMutex);
+                _previousFlattenedScene = std::move(_flattenedScene);
+                _previousScene = std::move(_scene);
+            } else {
+                {
+                    Timeline::Scope scope("Save outputs");
+                    integrator.saveOutputs();
+                    if (_scene->rendererSettings().enableResumeRender())
+                        integrator.saveRenderResumeData(*_scene);
+                }
 
-            {
                 std::unique_lock<std::mutex> lock(_statusMutex);
                 _status.completedScenes.push_back(currentScene);
             }
@@ -319,10 +454,16 @@ public:
 
         {
             std::unique_lock<std::mutex> lock(_sceneMutex);
+            Timeline::Scope scope("Teardown scene");
             _flattenedScene.reset();
             _scene.reset();
         }
 
+        // Rewritten after every scene, so that long running servers
+        // produce a usable timeline before they exit
+        if (!_traceFile.empty())
+            Timeline::save(_traceFile);
+
         return true;
     }
 